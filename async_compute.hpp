@@ -0,0 +1,207 @@
+#pragma once
+
+#ifndef VULKAN_HPP_NO_STRUCT_CONSTRUCTORS
+#	define VULKAN_HPP_NO_STRUCT_CONSTRUCTORS
+#endif
+#include <vulkan/vulkan_raii.hpp>
+
+#include "frame_pacer.hpp"
+
+#include <algorithm>
+#include <array>
+#include <iostream>
+#include <optional>
+#include <utility>
+#include <vector>
+
+struct AsyncComputeStats
+{
+	uint64_t submissions = 0;
+	uint64_t gpuSamples = 0;       // frames whose compute and graphics timestamps were both read back
+	double   gpuMsTotal = 0.0;     // compute queue time of those frames
+	double   overlapMsTotal = 0.0; // part of it that ran while the graphics queue was busy
+	double   lastOverlapPercent = 0.0;
+
+	[[nodiscard]] double avgGpuMs() const
+	{
+		return gpuSamples ? gpuMsTotal / static_cast<double>(gpuSamples) : 0.0;
+	}
+
+	[[nodiscard]] double overlapPercent() const
+	{
+		return gpuMsTotal > 0.0 ? 100.0 * overlapMsTotal / gpuMsTotal : 0.0;
+	}
+};
+
+// Per-frame work on a compute queue next to the graphics queue. Frame N's compute submission waits only for its
+// uploads and signals value N on its own timeline semaphore, which the graphics submission of frame N waits for
+// where it consumes the results; the compute work is thus free to run while the graphics queue still draws
+// frame N - 1. Slots are reused at the pace of the frame timeline, which only passes N after the compute work of
+// frame N has finished.
+//
+// A start/end timestamp pair per slot, compared with the frame's graphics timestamps (FramePacer), measures how
+// much of the compute time actually overlapped graphics work. This assumes both queues count on the same
+// timestamp clock, which holds for the queues of one device in practice.
+class AsyncComputeQueue
+{
+public:
+	void init(vk::raii::Device const& device, vk::raii::PhysicalDevice const& physicalDevice, vk::raii::Queue const& queue, uint32_t queueFamilyIndex,
+			  uint32_t graphicsFamilyIndex, uint32_t framesInFlight)
+	{
+		this->queue = &queue;
+
+		vk::StructureChain<vk::SemaphoreCreateInfo, vk::SemaphoreTypeCreateInfo> timelineInfo = {
+			{},
+			{.semaphoreType = vk::SemaphoreType::eTimeline, .initialValue = 0} };
+		timeline = vk::raii::Semaphore(device, timelineInfo.get<vk::SemaphoreCreateInfo>());
+
+		vk::CommandPoolCreateInfo poolInfo{ .flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer, .queueFamilyIndex = queueFamilyIndex };
+		commandPool = vk::raii::CommandPool(device, poolInfo);
+		vk::CommandBufferAllocateInfo allocInfo{ .commandPool = commandPool, .level = vk::CommandBufferLevel::ePrimary, .commandBufferCount = framesInFlight };
+		commandBuffers = vk::raii::CommandBuffers(device, allocInfo);
+		slotUsed.assign(framesInFlight, false);
+
+		// compare timestamps on the bits both families count
+		std::vector<vk::QueueFamilyProperties> const families = physicalDevice.getQueueFamilyProperties();
+		uint32_t const timestampBits = std::min(families[queueFamilyIndex].timestampValidBits, families[graphicsFamilyIndex].timestampValidBits);
+		if (timestampBits != 0)
+		{
+			timestampMask = timestampBits >= 64 ? ~0ull : ((1ull << timestampBits) - 1);
+			timestampPeriod = physicalDevice.getProperties().limits.timestampPeriod;
+			vk::QueryPoolCreateInfo queryPoolInfo{ .queryType = vk::QueryType::eTimestamp, .queryCount = 2 * framesInFlight };
+			queryPool = vk::raii::QueryPool(device, queryPoolInfo);
+			queryPool.reset(0, 2 * framesInFlight);
+		}
+	}
+
+	// Starts recording slot's command buffer. The slot's previous frame must have completed (FramePacer::waitForSlot());
+	// graphicsFrame is that frame's graphics interval as read back by the pacer, used for the overlap statistics.
+	vk::raii::CommandBuffer const& begin(uint32_t slot, std::optional<GpuTimestampInterval> const& graphicsFrame)
+	{
+		if (slotUsed[slot])
+		{
+			readTimestamps(slot, graphicsFrame);
+		}
+		slotUsed[slot] = true;
+
+		vk::raii::CommandBuffer const& commandBuffer = commandBuffers[slot];
+		commandBuffer.reset();
+		commandBuffer.begin({ .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
+		if (*queryPool)
+		{
+			commandBuffer.writeTimestamp2(vk::PipelineStageFlagBits2::eTopOfPipe, *queryPool, 2 * slot);
+		}
+		return commandBuffer;
+	}
+
+	// Ends slot's command buffer and submits it after the uploads up to uploadValue (0: none), signaling frameValue.
+	void submit(uint32_t slot, vk::Semaphore uploadTimeline, uint64_t uploadValue, uint64_t frameValue)
+	{
+		vk::raii::CommandBuffer const& commandBuffer = commandBuffers[slot];
+		if (*queryPool)
+		{
+			commandBuffer.writeTimestamp2(vk::PipelineStageFlagBits2::eBottomOfPipe, *queryPool, 2 * slot + 1);
+		}
+		commandBuffer.end();
+
+		vk::SemaphoreSubmitInfo const     waitInfo{ .semaphore = uploadTimeline, .value = uploadValue, .stageMask = vk::PipelineStageFlagBits2::eAllCommands };
+		vk::SemaphoreSubmitInfo const     signalInfo{ .semaphore = *timeline, .value = frameValue, .stageMask = vk::PipelineStageFlagBits2::eAllCommands };
+		vk::CommandBufferSubmitInfo const commandBufferInfo{ .commandBuffer = *commandBuffer };
+		vk::SubmitInfo2 const             submitInfo{ .waitSemaphoreInfoCount = uploadValue != 0 ? 1u : 0u,
+													  .pWaitSemaphoreInfos = &waitInfo,
+													  .commandBufferInfoCount = 1,
+													  .pCommandBufferInfos = &commandBufferInfo,
+													  .signalSemaphoreInfoCount = 1,
+													  .pSignalSemaphoreInfos = &signalInfo };
+		queue->submit2(submitInfo);
+		stats.submissions++;
+	}
+
+	// The graphics submission of a frame waits for the frame's value on this semaphore.
+	[[nodiscard]] vk::Semaphore semaphore() const
+	{
+		return *timeline;
+	}
+
+	[[nodiscard]] AsyncComputeStats const& getStats() const
+	{
+		return stats;
+	}
+
+	void report(std::ostream& out) const
+	{
+		out << "async compute: " << stats.submissions << " submissions";
+		if (stats.gpuSamples != 0)
+		{
+			out << ", gpu avg " << stats.avgGpuMs() << " ms, " << stats.overlapPercent() << "% overlapped with graphics (last " << stats.lastOverlapPercent << "%)";
+		}
+		out << std::endl;
+	}
+
+private:
+	vk::raii::Queue const*               queue = nullptr;
+	vk::raii::Semaphore                  timeline = nullptr;
+	vk::raii::CommandPool                commandPool = nullptr;
+	std::vector<vk::raii::CommandBuffer> commandBuffers;
+	std::vector<bool>                    slotUsed;
+
+	vk::raii::QueryPool                 queryPool = nullptr;
+	uint64_t                            timestampMask = 0;
+	float                               timestampPeriod = 1.0f;
+	std::optional<GpuTimestampInterval> previousGraphicsFrame; // graphics interval of the frame before the one read last
+
+	AsyncComputeStats stats;
+
+	void readTimestamps(uint32_t slot, std::optional<GpuTimestampInterval> const& graphicsFrame)
+	{
+		if (!*queryPool)
+		{
+			return;
+		}
+		auto [result, timestamps] = queryPool.getResult<std::array<uint64_t, 2>>(2 * slot, 2, sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+		queryPool.reset(2 * slot, 2);
+
+		// the compute work of frame N can overlap graphics frames N - 1 and N (up to where N waits for it)
+		std::optional<GpuTimestampInterval> const previous = std::exchange(previousGraphicsFrame, masked(graphicsFrame));
+		if (result != vk::Result::eSuccess || !graphicsFrame)
+		{
+			return;
+		}
+		GpuTimestampInterval const compute{ .start = timestamps[0] & timestampMask, .end = timestamps[1] & timestampMask };
+		if (compute.end <= compute.start)
+		{
+			return;
+		}
+		GpuTimestampInterval current = *previousGraphicsFrame;
+		uint64_t             overlap = 0;
+		if (previous)
+		{
+			overlap += intersection(compute, *previous);
+			current.start = std::max(current.start, previous->end);
+		}
+		overlap += intersection(compute, current);
+
+		double const computeMs = static_cast<double>(compute.end - compute.start) * timestampPeriod * 1e-6;
+		double const overlapMs = static_cast<double>(overlap) * timestampPeriod * 1e-6;
+		stats.gpuMsTotal += computeMs;
+		stats.overlapMsTotal += overlapMs;
+		stats.lastOverlapPercent = 100.0 * overlapMs / computeMs;
+		stats.gpuSamples++;
+	}
+
+	[[nodiscard]] std::optional<GpuTimestampInterval> masked(std::optional<GpuTimestampInterval> const& interval) const
+	{
+		if (!interval)
+		{
+			return std::nullopt;
+		}
+		return GpuTimestampInterval{ .start = interval->start & timestampMask, .end = interval->end & timestampMask };
+	}
+
+	[[nodiscard]] static uint64_t intersection(GpuTimestampInterval const& a, GpuTimestampInterval const& b)
+	{
+		uint64_t const start = std::max(a.start, b.start);
+		uint64_t const end = std::min(a.end, b.end);
+		return end > start ? end - start : 0;
+	}
+};
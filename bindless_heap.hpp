@@ -0,0 +1,209 @@
+#pragma once
+
+#ifndef VULKAN_HPP_NO_STRUCT_CONSTRUCTORS
+#	define VULKAN_HPP_NO_STRUCT_CONSTRUCTORS
+#endif
+#include <vulkan/vulkan_raii.hpp>
+
+#include <algorithm>
+#include <array>
+#include <deque>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Index into one of BindlessHeap's descriptor arrays; shaders receive it as a plain uint.
+using BindlessHandle = uint32_t;
+constexpr BindlessHandle INVALID_BINDLESS_HANDLE = ~0u;
+
+struct BindlessHeapStats
+{
+	std::array<uint32_t, 3> live = {}; // per BindlessHeap::Kind
+	std::array<uint32_t, 3> peak = {};
+	uint64_t                descriptorWrites = 0;
+};
+
+// Every sampled image, sampler and storage buffer a shader may touch, in one descriptor set that is bound once
+// per command buffer. Bindings are partially bound and update-after-bind, so a slot can be written while frames
+// in flight use the set, as long as they do not read that slot. Handles come from a free list; a released slot
+// is only handed out again once the frame-pacing timeline has passed the last frame that could still read it.
+// Not thread-safe: only the render thread adds and releases resources.
+class BindlessHeap
+{
+public:
+	// Also the binding number in set 0 of every pipeline layout that uses the heap (shaders/bindless.slang).
+	enum class Kind : uint32_t
+	{
+		eSampledImage,
+		eSampler,
+		eStorageBuffer
+	};
+	static constexpr uint32_t                            KIND_COUNT = 3;
+	static constexpr std::array<uint32_t, KIND_COUNT>    MAX_DESCRIPTORS = { 16384, 256, 16384 }; // clamped to the device limits
+	static constexpr std::array<char const*, KIND_COUNT> KIND_NAMES = { "sampled image", "sampler", "storage buffer" };
+
+	void init(vk::raii::Device const& device, vk::raii::PhysicalDevice const& physicalDevice)
+	{
+		this->device = &device;
+
+		auto const properties = physicalDevice.getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceDescriptorIndexingProperties>();
+		auto const& limits = properties.get<vk::PhysicalDeviceDescriptorIndexingProperties>();
+		capacity = { std::min({ MAX_DESCRIPTORS[0], limits.maxDescriptorSetUpdateAfterBindSampledImages, limits.maxPerStageDescriptorUpdateAfterBindSampledImages }),
+					 std::min({ MAX_DESCRIPTORS[1], limits.maxDescriptorSetUpdateAfterBindSamplers, limits.maxPerStageDescriptorUpdateAfterBindSamplers }),
+					 std::min({ MAX_DESCRIPTORS[2], limits.maxDescriptorSetUpdateAfterBindStorageBuffers, limits.maxPerStageDescriptorUpdateAfterBindStorageBuffers }) };
+
+		std::array<vk::DescriptorSetLayoutBinding, KIND_COUNT> bindings;
+		std::array<vk::DescriptorBindingFlags, KIND_COUNT>     bindingFlags;
+		std::array<vk::DescriptorPoolSize, KIND_COUNT>         poolSizes;
+		for (uint32_t kind = 0; kind < KIND_COUNT; kind++)
+		{
+			bindings[kind] = { .binding = kind, .descriptorType = DESCRIPTOR_TYPES[kind], .descriptorCount = capacity[kind], .stageFlags = vk::ShaderStageFlagBits::eAll };
+			bindingFlags[kind] = vk::DescriptorBindingFlagBits::ePartiallyBound | vk::DescriptorBindingFlagBits::eUpdateAfterBind;
+			poolSizes[kind] = { .type = DESCRIPTOR_TYPES[kind], .descriptorCount = capacity[kind] };
+		}
+
+		vk::StructureChain<vk::DescriptorSetLayoutCreateInfo, vk::DescriptorSetLayoutBindingFlagsCreateInfo> layoutInfo = {
+			{.flags = vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPool, .bindingCount = KIND_COUNT, .pBindings = bindings.data()},
+			{.bindingCount = KIND_COUNT, .pBindingFlags = bindingFlags.data()} };
+		setLayout = vk::raii::DescriptorSetLayout(device, layoutInfo.get<vk::DescriptorSetLayoutCreateInfo>());
+
+		// raii descriptor sets free themselves, which the pool has to allow
+		vk::DescriptorPoolCreateInfo poolInfo{ .flags = vk::DescriptorPoolCreateFlagBits::eUpdateAfterBind | vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet,
+											   .maxSets = 1,
+											   .poolSizeCount = KIND_COUNT,
+											   .pPoolSizes = poolSizes.data() };
+		pool = vk::raii::DescriptorPool(device, poolInfo);
+
+		vk::DescriptorSetAllocateInfo allocInfo{ .descriptorPool = *pool, .descriptorSetCount = 1, .pSetLayouts = &*setLayout };
+		set = std::move(vk::raii::DescriptorSets(device, allocInfo).front());
+	}
+
+	// layout is the one the image will be in whenever a shader samples it.
+	BindlessHandle addImage(vk::ImageView view, vk::ImageLayout layout = vk::ImageLayout::eShaderReadOnlyOptimal)
+	{
+		BindlessHandle const    handle = allocate(Kind::eSampledImage);
+		vk::DescriptorImageInfo imageInfo{ .imageView = view, .imageLayout = layout };
+		write(Kind::eSampledImage, handle, { .pImageInfo = &imageInfo });
+		return handle;
+	}
+
+	BindlessHandle addSampler(vk::Sampler sampler)
+	{
+		BindlessHandle const    handle = allocate(Kind::eSampler);
+		vk::DescriptorImageInfo samplerInfo{ .sampler = sampler };
+		write(Kind::eSampler, handle, { .pImageInfo = &samplerInfo });
+		return handle;
+	}
+
+	BindlessHandle addBuffer(vk::Buffer buffer, vk::DeviceSize offset = 0, vk::DeviceSize range = vk::WholeSize)
+	{
+		BindlessHandle const     handle = allocate(Kind::eStorageBuffer);
+		vk::DescriptorBufferInfo bufferInfo{ .buffer = buffer, .offset = offset, .range = range };
+		write(Kind::eStorageBuffer, handle, { .pBufferInfo = &bufferInfo });
+		return handle;
+	}
+
+	// retireValue is the frame-pacing timeline value of the last frame that may read the slot.
+	void release(Kind kind, BindlessHandle handle, uint64_t retireValue)
+	{
+		if (handle == INVALID_BINDLESS_HANDLE)
+		{
+			return;
+		}
+		retiring.push_back({ .kind = kind, .handle = handle, .retireValue = retireValue });
+	}
+
+	// Returns every released slot whose last reader has completed to its free list.
+	void recycle(uint64_t completedValue)
+	{
+		while (!retiring.empty() && retiring.front().retireValue <= completedValue)
+		{
+			auto const index = static_cast<uint32_t>(retiring.front().kind);
+			freeList[index].push_back(retiring.front().handle);
+			stats.live[index]--;
+			retiring.pop_front();
+		}
+	}
+
+	// Binds the heap as set 0; layout must have been created with setLayoutHandle() first.
+	void bind(vk::raii::CommandBuffer const& commandBuffer, vk::PipelineBindPoint bindPoint, vk::PipelineLayout layout) const
+	{
+		commandBuffer.bindDescriptorSets(bindPoint, layout, 0, *set, {});
+	}
+
+	[[nodiscard]] vk::DescriptorSetLayout setLayoutHandle() const
+	{
+		return *setLayout;
+	}
+
+	[[nodiscard]] BindlessHeapStats const& getStats() const
+	{
+		return stats;
+	}
+
+	void report(std::ostream& out) const
+	{
+		out << "bindless heap:";
+		for (uint32_t kind = 0; kind < KIND_COUNT; kind++)
+		{
+			out << (kind ? "," : "") << " " << KIND_NAMES[kind] << "s " << stats.live[kind] << "/" << capacity[kind] << " (peak " << stats.peak[kind] << ")";
+		}
+		out << ", " << stats.descriptorWrites << " descriptor writes" << std::endl;
+	}
+
+private:
+	static constexpr std::array<vk::DescriptorType, KIND_COUNT> DESCRIPTOR_TYPES = { vk::DescriptorType::eSampledImage, vk::DescriptorType::eSampler,
+																					  vk::DescriptorType::eStorageBuffer };
+
+	struct Retiring
+	{
+		Kind           kind = Kind::eSampledImage;
+		BindlessHandle handle = INVALID_BINDLESS_HANDLE;
+		uint64_t       retireValue = 0;
+	};
+
+	vk::raii::Device const*                       device = nullptr;
+	vk::raii::DescriptorSetLayout                 setLayout = nullptr;
+	vk::raii::DescriptorPool                      pool = nullptr;
+	vk::raii::DescriptorSet                       set = nullptr;
+	std::array<uint32_t, KIND_COUNT>              capacity = {};
+	std::array<uint32_t, KIND_COUNT>              nextUnused = {}; // slots below this have been handed out at least once
+	std::array<std::vector<uint32_t>, KIND_COUNT> freeList;
+	std::deque<Retiring>                          retiring;        // in release order, so retire values only grow
+	BindlessHeapStats                             stats;
+
+	BindlessHandle allocate(Kind kind)
+	{
+		auto const     index = static_cast<uint32_t>(kind);
+		BindlessHandle handle;
+		if (!freeList[index].empty())
+		{
+			handle = freeList[index].back();
+			freeList[index].pop_back();
+		}
+		else if (nextUnused[index] < capacity[index])
+		{
+			handle = nextUnused[index]++;
+		}
+		else
+		{
+			throw std::runtime_error(std::string("bindless heap: out of ") + KIND_NAMES[index] + " slots!");
+		}
+		stats.live[index]++;
+		stats.peak[index] = std::max(stats.peak[index], stats.live[index]);
+		return handle;
+	}
+
+	// descriptor holds the kind's info pointer; binding, element and type are filled in here.
+	void write(Kind kind, BindlessHandle handle, vk::WriteDescriptorSet descriptor)
+	{
+		descriptor.dstSet = *set;
+		descriptor.dstBinding = static_cast<uint32_t>(kind);
+		descriptor.dstArrayElement = handle;
+		descriptor.descriptorCount = 1;
+		descriptor.descriptorType = DESCRIPTOR_TYPES[static_cast<uint32_t>(kind)];
+		device->updateDescriptorSets(descriptor, {});
+		stats.descriptorWrites++;
+	}
+};
@@ -0,0 +1,378 @@
+#pragma once
+
+#include "scene_loader.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <span>
+#include <utility>
+#include <vector>
+
+// Axis-aligned box; an empty box has min > max, so growing it by anything yields that thing.
+struct BvhBounds
+{
+	std::array<float, 3> min = { std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max() };
+	std::array<float, 3> max = { std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest() };
+
+	void grow(std::array<float, 3> const& point)
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			min[axis] = std::min(min[axis], point[axis]);
+			max[axis] = std::max(max[axis], point[axis]);
+		}
+	}
+
+	void grow(BvhBounds const& other)
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			min[axis] = std::min(min[axis], other.min[axis]);
+			max[axis] = std::max(max[axis], other.max[axis]);
+		}
+	}
+
+	[[nodiscard]] float area() const
+	{
+		float const x = max[0] - min[0];
+		float const y = max[1] - min[1];
+		float const z = max[2] - min[2];
+		return x < 0.0f ? 0.0f : x * y + y * z + z * x;
+	}
+
+	[[nodiscard]] float center(int axis) const
+	{
+		return 0.5f * (min[axis] + max[axis]);
+	}
+};
+
+// One node in 32 bytes, two to a cache line (BvhNode in shaders/shadow_data.slang). The children of an interior
+// node are stored next to each other, so one index finds both; a leaf holds count primitives from first on.
+struct BvhNode
+{
+	std::array<float, 3> boundsMin = {};
+	uint32_t             leftOrFirst = 0; // interior: left child, the right one follows; leaf: first primitive
+	std::array<float, 3> boundsMax = {};
+	uint32_t             count = 0;       // primitives of a leaf, 0 for an interior node
+};
+static_assert(sizeof(BvhNode) == 32);
+
+// A triangle by its corners, so the traversal reads one record per candidate instead of chasing indices
+// (BvhTriangle in shaders/shadow_data.slang).
+struct BvhTriangle
+{
+	std::array<float, 4> v0 = {};
+	std::array<float, 4> v1 = {};
+	std::array<float, 4> v2 = {};
+};
+static_assert(sizeof(BvhTriangle) == 48);
+
+// Where one draw's tree starts in SceneBvh::nodes() and its triangles in SceneBvh::triangles(); the node and
+// primitive indices within the tree are relative to these.
+struct BvhMesh
+{
+	uint32_t firstNode = 0;
+	uint32_t firstTriangle = 0;
+};
+
+// Binned SAH builder over a set of primitive boxes, the nodes in depth-first order so every parent precedes its
+// children. Each split tries BINS planes per axis across the centroid bounds and keeps the one with the lowest
+// surface area cost; a node becomes a leaf once no split is cheaper than testing its primitives and it has at
+// most maxLeafSize of them, or once it is MAX_DEPTH levels below the root, whatever its size. order() maps the
+// leaves' primitive ranges back to the input boxes.
+class Bvh
+{
+public:
+	static constexpr uint32_t BINS = 16;
+	static constexpr float    TRAVERSAL_COST = 1.0f; // relative to one primitive test
+	// BVH_STACK_SIZE of shaders/shadow_bvh.slang: a near-first traversal holds at most one pending far child per
+	// level above the node it is at, so no tree this deep overflows the stack
+	static constexpr uint32_t MAX_DEPTH = 32;
+
+	static Bvh build(std::span<BvhBounds const> boxes, uint32_t maxLeafSize)
+	{
+		Bvh bvh;
+		bvh.primitiveOrder.resize(boxes.size());
+		for (uint32_t i = 0; i < bvh.primitiveOrder.size(); i++)
+		{
+			bvh.primitiveOrder[i] = i;
+		}
+		bvh.nodeList.reserve(std::max<size_t>(2 * boxes.size(), 1) - 1);
+		bvh.nodeList.push_back(BvhNode{ .leftOrFirst = 0, .count = static_cast<uint32_t>(boxes.size()) });
+
+		std::vector<std::pair<uint32_t, uint32_t>> stack = { { 0, 0 } }; // node, depth
+		while (!stack.empty())
+		{
+			auto const [nodeIndex, depth] = stack.back();
+			stack.pop_back();
+			bvh.maxDepth = std::max(bvh.maxDepth, depth);
+			if (depth == MAX_DEPTH)
+			{
+				continue;
+			}
+			if (std::optional<uint32_t> const left = bvh.split(nodeIndex, boxes, maxLeafSize))
+			{
+				// right first, so the left subtree is laid out right behind its parent
+				stack.emplace_back(*left + 1, depth + 1);
+				stack.emplace_back(*left, depth + 1);
+			}
+		}
+		bvh.refit(boxes);
+		return bvh;
+	}
+
+	// Recomputes every node's bounds bottom-up for moved primitives, keeping the topology. Cheaper than a
+	// rebuild by far, at the cost of looser boxes the further the primitives move from where they were built.
+	void refit(std::span<BvhBounds const> boxes)
+	{
+		for (size_t i = nodeList.size(); i-- > 0;)
+		{
+			BvhNode&  node = nodeList[i];
+			BvhBounds bounds;
+			if (isLeaf(node))
+			{
+				for (uint32_t primitive = node.leftOrFirst; primitive < node.leftOrFirst + node.count; primitive++)
+				{
+					bounds.grow(boxes[primitiveOrder[primitive]]);
+				}
+			}
+			else
+			{
+				bounds.grow(nodeBounds(nodeList[node.leftOrFirst]));
+				bounds.grow(nodeBounds(nodeList[node.leftOrFirst + 1]));
+			}
+			node.boundsMin = bounds.min;
+			node.boundsMax = bounds.max;
+		}
+	}
+
+	[[nodiscard]] std::vector<BvhNode> const& nodes() const
+	{
+		return nodeList;
+	}
+
+	// Input box index of every leaf primitive slot.
+	[[nodiscard]] std::vector<uint32_t> const& order() const
+	{
+		return primitiveOrder;
+	}
+
+	// Levels below the root of the deepest leaf, at most MAX_DEPTH.
+	[[nodiscard]] uint32_t depth() const
+	{
+		return maxDepth;
+	}
+
+private:
+	std::vector<BvhNode>  nodeList;
+	std::vector<uint32_t> primitiveOrder;
+	uint32_t              maxDepth = 0;
+
+	struct Bin
+	{
+		BvhBounds bounds;
+		uint32_t  count = 0;
+	};
+
+	// the root of an empty tree is a leaf of no primitives; any other node's children come after the root
+	static bool isLeaf(BvhNode const& node)
+	{
+		return node.count != 0 || node.leftOrFirst == 0;
+	}
+
+	static BvhBounds nodeBounds(BvhNode const& node)
+	{
+		return { .min = node.boundsMin, .max = node.boundsMax };
+	}
+
+	// Splits a leaf in two and returns the index of its left child, or nothing if it stays a leaf.
+	std::optional<uint32_t> split(uint32_t nodeIndex, std::span<BvhBounds const> boxes, uint32_t maxLeafSize)
+	{
+		uint32_t const first = nodeList[nodeIndex].leftOrFirst;
+		uint32_t const count = nodeList[nodeIndex].count;
+		if (count <= 1)
+		{
+			return std::nullopt;
+		}
+
+		BvhBounds bounds;
+		BvhBounds centroids;
+		for (uint32_t i = first; i < first + count; i++)
+		{
+			BvhBounds const& box = boxes[primitiveOrder[i]];
+			bounds.grow(box);
+			centroids.grow(std::array<float, 3>{ box.center(0), box.center(1), box.center(2) });
+		}
+
+		float    bestCost = std::numeric_limits<float>::max();
+		int      bestAxis = -1;
+		uint32_t bestBin = 0;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float const extent = centroids.max[axis] - centroids.min[axis];
+			if (extent <= 0.0f)
+			{
+				continue;
+			}
+			float const           scale = static_cast<float>(BINS) / extent;
+			std::array<Bin, BINS> bins;
+			for (uint32_t i = first; i < first + count; i++)
+			{
+				BvhBounds const& box = boxes[primitiveOrder[i]];
+				Bin&             bin = bins[binIndex(box.center(axis), centroids.min[axis], scale)];
+				bin.bounds.grow(box);
+				bin.count++;
+			}
+
+			// sweep from both ends, then cost every plane between two bins
+			std::array<float, BINS - 1>    leftArea;
+			std::array<uint32_t, BINS - 1> leftCount;
+			BvhBounds                      leftBounds;
+			uint32_t                       leftSum = 0;
+			for (uint32_t plane = 0; plane < BINS - 1; plane++)
+			{
+				leftBounds.grow(bins[plane].bounds);
+				leftSum += bins[plane].count;
+				leftArea[plane] = leftBounds.area();
+				leftCount[plane] = leftSum;
+			}
+			BvhBounds rightBounds;
+			uint32_t  rightSum = 0;
+			for (uint32_t plane = BINS - 1; plane-- > 0;)
+			{
+				rightBounds.grow(bins[plane + 1].bounds);
+				rightSum += bins[plane + 1].count;
+				if (leftCount[plane] == 0 || rightSum == 0)
+				{
+					continue;
+				}
+				float const cost = leftArea[plane] * static_cast<float>(leftCount[plane]) + rightBounds.area() * static_cast<float>(rightSum);
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestBin = plane;
+				}
+			}
+		}
+
+		float const area = bounds.area();
+		float const leafCost = static_cast<float>(count);
+		float const splitCost = area > 0.0f ? TRAVERSAL_COST + bestCost / area : TRAVERSAL_COST + leafCost;
+		if (count <= maxLeafSize && splitCost >= leafCost)
+		{
+			return std::nullopt;
+		}
+
+		uint32_t middle = first;
+		if (bestAxis >= 0)
+		{
+			float const scale = static_cast<float>(BINS) / (centroids.max[bestAxis] - centroids.min[bestAxis]);
+			auto const  begin = primitiveOrder.begin() + first;
+			middle = static_cast<uint32_t>(std::partition(begin, begin + count, [&](uint32_t primitive) {
+				return binIndex(boxes[primitive].center(bestAxis), centroids.min[bestAxis], scale) <= bestBin;
+			}) - primitiveOrder.begin());
+		}
+		if (middle == first || middle == first + count)
+		{
+			// every centroid in one spot, which binning cannot separate: halve the range instead
+			middle = first + count / 2;
+		}
+
+		uint32_t const left = static_cast<uint32_t>(nodeList.size());
+		nodeList.push_back(BvhNode{ .leftOrFirst = first, .count = middle - first });
+		nodeList.push_back(BvhNode{ .leftOrFirst = middle, .count = first + count - middle });
+		nodeList[nodeIndex].leftOrFirst = left;
+		nodeList[nodeIndex].count = 0;
+		return left;
+	}
+
+	static uint32_t binIndex(float center, float min, float scale)
+	{
+		return std::min(static_cast<uint32_t>(std::max((center - min) * scale, 0.0f)), BINS - 1);
+	}
+};
+
+// The shadow rays' software fallback: a SAH tree per scene draw over its triangles in scene space, built on the
+// CPU at load time, with the triangles reordered so every leaf is one contiguous range. Instances of a draw share
+// its tree; a tree over the instances on top (ShadowTracer) places them in the world.
+class SceneBvh
+{
+public:
+	static constexpr uint32_t MAX_LEAF_TRIANGLES = 4;
+
+	// Scene is a SceneSource or a MeshCache.
+	template <typename Scene>
+	static SceneBvh build(Scene const& scene)
+	{
+		SceneBvh                 bvh;
+		std::vector<uint32_t>    sourceIndices;
+		std::vector<SceneVertex> sourceVertices;
+		std::vector<BvhBounds>   boxes;
+		for (SceneDraw const& draw : scene.draws())
+		{
+			sourceIndices.resize(draw.indexCount);
+			scene.writeIndices(draw.firstIndex, draw.indexCount, sourceIndices.data());
+			sourceVertices.resize(draw.vertexCount);
+			scene.writeVertices(static_cast<uint64_t>(draw.vertexOffset), draw.vertexCount, sourceVertices.data());
+
+			boxes.clear();
+			for (uint32_t i = 0; i + 2 < draw.indexCount; i += 3)
+			{
+				BvhBounds box;
+				for (uint32_t corner = 0; corner < 3; corner++)
+				{
+					box.grow(sourceVertices[sourceIndices[i + corner]].position);
+				}
+				boxes.push_back(box);
+			}
+
+			Bvh const tree = Bvh::build(boxes, MAX_LEAF_TRIANGLES);
+			bvh.maxDepth = std::max(bvh.maxDepth, tree.depth());
+			bvh.meshList.push_back({ .firstNode = static_cast<uint32_t>(bvh.nodeList.size()), .firstTriangle = static_cast<uint32_t>(bvh.triangleList.size()) });
+			bvh.nodeList.insert(bvh.nodeList.end(), tree.nodes().begin(), tree.nodes().end());
+			for (uint32_t triangle : tree.order())
+			{
+				auto const corner = [&](uint32_t c) {
+					std::array<float, 3> const& p = sourceVertices[sourceIndices[3 * triangle + c]].position;
+					return std::array<float, 4>{ p[0], p[1], p[2], 1.0f };
+				};
+				bvh.triangleList.push_back({ .v0 = corner(0), .v1 = corner(1), .v2 = corner(2) });
+			}
+		}
+		return bvh;
+	}
+
+	// Every draw's tree, one after the other.
+	[[nodiscard]] std::vector<BvhNode> const& nodes() const
+	{
+		return nodeList;
+	}
+
+	[[nodiscard]] std::vector<BvhTriangle> const& triangles() const
+	{
+		return triangleList;
+	}
+
+	// One per scene draw, in the same order.
+	[[nodiscard]] std::vector<BvhMesh> const& meshes() const
+	{
+		return meshList;
+	}
+
+	// Of the deepest draw's tree.
+	[[nodiscard]] uint32_t depth() const
+	{
+		return maxDepth;
+	}
+
+private:
+	std::vector<BvhNode>     nodeList;
+	std::vector<BvhTriangle> triangleList;
+	std::vector<BvhMesh>     meshList;
+	uint32_t                 maxDepth = 0;
+};
@@ -0,0 +1,83 @@
+#pragma once
+
+#ifndef GLM_FORCE_DEPTH_ZERO_TO_ONE
+#	define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#endif
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+// Perspective camera looking at a target point. World space is y-up and right-handed, like glTF and OBJ.
+struct Camera
+{
+	glm::vec3 position = { 0.0f, 0.0f, 2.0f };
+	glm::vec3 target = { 0.0f, 0.0f, 0.0f };
+	glm::vec3 up = { 0.0f, 1.0f, 0.0f };
+	float     fovY = glm::radians(60.0f);
+	float     nearPlane = 0.01f;
+	float     farPlane = 100.0f;
+
+	[[nodiscard]] glm::mat4 viewProjection(float aspect) const
+	{
+		glm::mat4 projection = glm::perspective(fovY, aspect, nearPlane, farPlane);
+		// Vulkan clip space is y-down
+		projection[1][1] *= -1.0f;
+		return projection * glm::lookAt(position, target, up);
+	}
+
+	// Looks down -z at the bounds from just far enough away that their bounding sphere fills the vertical field of view.
+	static Camera framing(std::array<float, 3> const& boundsMin, std::array<float, 3> const& boundsMax)
+	{
+		glm::vec3 const lo(boundsMin[0], boundsMin[1], boundsMin[2]);
+		glm::vec3 const hi(boundsMax[0], boundsMax[1], boundsMax[2]);
+		float const     radius = std::max(0.5f * glm::length(hi - lo), 1e-3f);
+
+		Camera      camera;
+		float const distance = radius / std::sin(0.5f * camera.fovY);
+		camera.target = 0.5f * (lo + hi);
+		camera.position = camera.target + glm::vec3(0.0f, 0.0f, distance);
+		camera.nearPlane = 0.01f * distance;
+		camera.farPlane = 100.0f * distance;
+		return camera;
+	}
+
+	// The camera moved onto a circle around its target at its current distance: `turns` of a revolution about
+	// the y axis, starting on the +z side, and raised by elevation radians.
+	[[nodiscard]] Camera orbiting(float turns, float elevation) const
+	{
+		float const distance = glm::length(position - target);
+		float const angle = glm::two_pi<float>() * turns;
+
+		Camera camera = *this;
+		camera.position = target + distance * glm::vec3(std::cos(elevation) * std::sin(angle), std::sin(elevation), std::cos(elevation) * std::cos(angle));
+		return camera;
+	}
+};
+
+// The six planes of a view-projection matrix's view volume (Gribb/Hartmann), normalized and pointing inward:
+// a point p is inside when dot(plane.xyz, p) + plane.w >= 0 for all of them.
+struct Frustum
+{
+	std::array<glm::vec4, 6> planes;
+
+	static Frustum fromViewProjection(glm::mat4 const& m)
+	{
+		// glm is column-major: row i of the matrix is (m[0][i], m[1][i], m[2][i], m[3][i])
+		glm::vec4 const row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+		glm::vec4 const row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+		glm::vec4 const row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+		glm::vec4 const row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+		// depth is [0, w], so the near plane is row2 alone
+		Frustum frustum{ .planes = { row3 + row0, row3 - row0, row3 + row1, row3 - row1, row2, row3 - row2 } };
+		for (glm::vec4& plane : frustum.planes)
+		{
+			plane /= glm::length(glm::vec3(plane));
+		}
+		return frustum;
+	}
+};
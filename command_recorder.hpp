@@ -0,0 +1,136 @@
+#pragma once
+
+#ifndef VULKAN_HPP_NO_STRUCT_CONSTRUCTORS
+#	define VULKAN_HPP_NO_STRUCT_CONSTRUCTORS
+#endif
+#include <vulkan/vulkan_raii.hpp>
+
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <span>
+#include <utility>
+#include <vector>
+
+// Splits a range of draws across worker threads, each recording a secondary command buffer that the primary
+// then executes inside its rendering scope. The range comes in segments that no secondary crosses, so the
+// primary can wrap each segment's secondaries in something of its own. Command pools are not thread safe, so
+// every (frame in flight, chunk) pair gets its own pool; a chunk is only ever recorded by one thread at a time and a frame's pools are
+// reset wholesale once that frame's timeline value has been reached. Workers are private to the recorder so recording
+// never queues behind long-running jobs such as pipeline builds; the calling thread records the first chunk.
+class ParallelCommandRecorder
+{
+public:
+	static constexpr uint32_t MIN_DRAWS_PER_CHUNK = 64;
+
+	void init(vk::raii::Device const& device, uint32_t queueFamilyIndex, uint32_t framesInFlight, uint32_t threadCount)
+	{
+		this->device = &device;
+		this->queueFamilyIndex = queueFamilyIndex;
+		chunkCount = std::max(1u, threadCount);
+		workers = chunkCount > 1 ? std::make_unique<ThreadPool>(chunkCount - 1) : nullptr;
+
+		frames.clear();
+		frames.resize(framesInFlight);
+		for (auto& frame : frames)
+		{
+			addChunks(frame, chunkCount);
+		}
+	}
+
+	[[nodiscard]] uint32_t threadCount() const
+	{
+		return chunkCount;
+	}
+
+	// Records the draws up to segmentEnds.back() into secondaries for frameIndex, segment i ending before draw
+	// segmentEnds[i] (ascending). Returns the secondaries of every segment, in draw order. recordRange(commandBuffer,
+	// first, last) must be safe to call concurrently for disjoint ranges and must set all state the draws need
+	// (none is inherited).
+	template <typename RecordRange>
+	std::vector<std::span<vk::CommandBuffer const>> const& record(uint32_t frameIndex, std::span<uint32_t const> segmentEnds,
+																	vk::CommandBufferInheritanceRenderingInfo const& renderingInfo, RecordRange&& recordRange)
+	{
+		auto& frame = frames[frameIndex];
+		frame.ranges.clear();
+		uint32_t segmentFirst = 0;
+		for (uint32_t const segmentEnd : segmentEnds)
+		{
+			uint32_t const drawCount = segmentEnd - segmentFirst;
+			uint32_t const chunks = chunksFor(drawCount);
+			uint32_t const drawsPerChunk = (drawCount + chunks - 1) / chunks;
+			for (uint32_t chunk = 0; chunk < chunks; chunk++)
+			{
+				uint32_t const first = std::min(chunk * drawsPerChunk, drawCount);
+				frame.ranges.emplace_back(segmentFirst + first, segmentFirst + std::min(first + drawsPerChunk, drawCount));
+			}
+			segmentFirst = segmentEnd;
+		}
+		// more segments than threads need more chunks than init() made; they are kept for the following frames
+		if (frame.ranges.size() > frame.pools.size())
+		{
+			addChunks(frame, static_cast<uint32_t>(frame.ranges.size() - frame.pools.size()));
+		}
+
+		auto recordChunk = [&](uint32_t chunk) {
+			auto const [first, last] = frame.ranges[chunk];
+
+			frame.pools[chunk].reset();
+			auto&                            commandBuffer = frame.commandBuffers[chunk];
+			vk::CommandBufferInheritanceInfo inheritanceInfo{ .pNext = &renderingInfo };
+			commandBuffer.begin({ .flags = vk::CommandBufferUsageFlagBits::eRenderPassContinue | vk::CommandBufferUsageFlagBits::eOneTimeSubmit,
+								  .pInheritanceInfo = &inheritanceInfo });
+			recordRange(commandBuffer, first, last);
+			commandBuffer.end();
+		};
+
+		parallelFor(workers.get(), static_cast<uint32_t>(frame.ranges.size()), recordChunk);
+
+		frame.segments.clear();
+		segmentFirst = 0;
+		size_t firstChunk = 0;
+		for (uint32_t const segmentEnd : segmentEnds)
+		{
+			uint32_t const chunks = chunksFor(segmentEnd - segmentFirst);
+			frame.segments.emplace_back(frame.handles.data() + firstChunk, chunks);
+			firstChunk += chunks;
+			segmentFirst = segmentEnd;
+		}
+		return frame.segments;
+	}
+
+private:
+	struct FrameCommands
+	{
+		std::vector<vk::raii::CommandPool>              pools;
+		std::vector<vk::raii::CommandBuffer>            commandBuffers;
+		std::vector<vk::CommandBuffer>                  handles;  // of commandBuffers
+		std::vector<std::pair<uint32_t, uint32_t>>      ranges;   // draws [first, last) of each chunk this frame
+		std::vector<std::span<vk::CommandBuffer const>> segments; // of handles, what record() returns
+	};
+
+	vk::raii::Device const*     device = nullptr;
+	uint32_t                    queueFamilyIndex = 0;
+	std::vector<FrameCommands>  frames;
+	uint32_t                    chunkCount = 1;
+	std::unique_ptr<ThreadPool> workers;
+
+	[[nodiscard]] uint32_t chunksFor(uint32_t drawCount) const
+	{
+		return std::clamp((drawCount + MIN_DRAWS_PER_CHUNK - 1) / MIN_DRAWS_PER_CHUNK, 1u, chunkCount);
+	}
+
+	void addChunks(FrameCommands& frame, uint32_t count) const
+	{
+		for (uint32_t chunk = 0; chunk < count; chunk++)
+		{
+			vk::CommandPoolCreateInfo     poolInfo{ .flags = vk::CommandPoolCreateFlagBits::eTransient, .queueFamilyIndex = queueFamilyIndex };
+			vk::raii::CommandPool         pool(*device, poolInfo);
+			vk::CommandBufferAllocateInfo allocInfo{ .commandPool = pool, .level = vk::CommandBufferLevel::eSecondary, .commandBufferCount = 1 };
+			frame.commandBuffers.push_back(std::move(vk::raii::CommandBuffers(*device, allocInfo).front()));
+			frame.handles.push_back(*frame.commandBuffers.back());
+			frame.pools.push_back(std::move(pool));
+		}
+	}
+};
@@ -0,0 +1,323 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Heap allocations made by the calling thread so far. The global operator new in main.cpp counts them; without
+// it the count stays 0.
+struct HeapAllocationCounter
+{
+	static inline thread_local uint64_t count = 0;
+};
+
+struct FrameArenaStats
+{
+	uint64_t frames = 0;
+	size_t   lastBytes = 0;               // allocated by the last frame that finished
+	size_t   peakBytes = 0;
+	size_t   capacity = 0;                // all slots together
+	uint32_t growths = 0;                 // frames that outgrew their slot's block and needed overflow blocks
+	uint64_t heapAllocations = 0;         // on the render thread, between begin() and end()
+	uint64_t maxFrameHeapAllocations = 0;
+	uint64_t steadyFrames = 0;            // frames after the warm-up
+	uint64_t allocatingSteadyFrames = 0;
+};
+
+// A bump allocator for data that lives no longer than one frame. Allocation is a pointer increment and
+// nothing is freed individually; reset() drops everything at once. A frame that outgrows the block chains
+// overflow blocks from the heap, and the next reset() replaces them all with one block of the combined size,
+// so after warming up a frame allocates nothing from the heap. Destructors are never run, so only trivially
+// destructible objects may be created in it directly; containers go through ArenaAllocator.
+class FrameArena
+{
+public:
+	explicit FrameArena(size_t capacity = 0)
+	{
+		if (capacity > 0)
+		{
+			blocks.push_back(Block::make(capacity));
+		}
+	}
+
+	FrameArena(FrameArena&&) = default;
+	FrameArena& operator=(FrameArena&&) = default;
+
+	void* allocate(size_t size, size_t alignment)
+	{
+		if (!blocks.empty())
+		{
+			if (void* const memory = blocks.back().take(size, alignment))
+			{
+				used += size;
+				return memory;
+			}
+		}
+		size_t const capacity = blocks.empty() ? 0 : blocks.back().capacity;
+		blocks.push_back(Block::make(std::max(2 * capacity, size + alignment)));
+		overflowed = true;
+		used += size;
+		return blocks.back().take(size, alignment);
+	}
+
+	// Gives the memory back only if it is the last allocation, which is what a growing vector frees.
+	void deallocate(void* memory, size_t size)
+	{
+		if (!blocks.empty() && blocks.back().giveBack(memory, size))
+		{
+			used -= size;
+		}
+	}
+
+	template <typename T, typename... Args>
+	T* create(Args&&... args)
+	{
+		static_assert(std::is_trivially_destructible_v<T>, "FrameArena never runs destructors");
+		return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+	}
+
+	// Forgets every allocation; returns whether the frame needed overflow blocks.
+	bool reset()
+	{
+		bool const grew = overflowed;
+		if (blocks.size() > 1)
+		{
+			size_t total = 0;
+			for (Block const& block : blocks)
+			{
+				total += block.capacity;
+			}
+			blocks.clear();
+			blocks.push_back(Block::make(total));
+		}
+		else if (!blocks.empty())
+		{
+			blocks.back().top = 0;
+		}
+		overflowed = false;
+		used = 0;
+		return grew;
+	}
+
+	[[nodiscard]] size_t bytesUsed() const
+	{
+		return used;
+	}
+
+	[[nodiscard]] size_t capacity() const
+	{
+		size_t total = 0;
+		for (Block const& block : blocks)
+		{
+			total += block.capacity;
+		}
+		return total;
+	}
+
+private:
+	struct Block
+	{
+		std::unique_ptr<std::byte[]> memory;
+		size_t                       capacity = 0;
+		size_t                       top = 0;
+
+		static Block make(size_t capacity)
+		{
+			return { .memory = std::make_unique_for_overwrite<std::byte[]>(capacity), .capacity = capacity };
+		}
+
+		void* take(size_t size, size_t alignment)
+		{
+			auto const   base = reinterpret_cast<uintptr_t>(memory.get());
+			size_t const offset = ((base + top + alignment - 1) & ~(uintptr_t(alignment) - 1)) - base;
+			if (offset + size > capacity)
+			{
+				return nullptr;
+			}
+			top = offset + size;
+			return memory.get() + offset;
+		}
+
+		bool giveBack(void* pointer, size_t size)
+		{
+			if (static_cast<std::byte*>(pointer) + size != memory.get() + top)
+			{
+				return false;
+			}
+			top -= size;
+			return true;
+		}
+	};
+
+	std::vector<Block> blocks; // the last one is allocated from
+	size_t             used = 0;
+	bool               overflowed = false;
+};
+
+// Lets standard containers allocate from a FrameArena. A default-constructed allocator has no arena and uses
+// the heap, so containers can be members that are bound to an arena per frame by assigning a fresh container.
+template <typename T>
+class ArenaAllocator
+{
+public:
+	using value_type = T;
+	using propagate_on_container_copy_assignment = std::true_type;
+	using propagate_on_container_move_assignment = std::true_type;
+	using propagate_on_container_swap = std::true_type;
+
+	ArenaAllocator() = default;
+
+	ArenaAllocator(FrameArena& arena) : arena(&arena) {}
+
+	template <typename U>
+	ArenaAllocator(ArenaAllocator<U> const& other) : arena(other.arena)
+	{
+	}
+
+	T* allocate(size_t count)
+	{
+		if (!arena)
+		{
+			return std::allocator<T>().allocate(count);
+		}
+		return static_cast<T*>(arena->allocate(count * sizeof(T), alignof(T)));
+	}
+
+	void deallocate(T* pointer, size_t count)
+	{
+		if (!arena)
+		{
+			std::allocator<T>().deallocate(pointer, count);
+			return;
+		}
+		arena->deallocate(pointer, count * sizeof(T));
+	}
+
+	template <typename U>
+	bool operator==(ArenaAllocator<U> const& other) const
+	{
+		return arena == other.arena;
+	}
+
+private:
+	template <typename U>
+	friend class ArenaAllocator;
+
+	FrameArena* arena = nullptr;
+};
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+template <typename Signature>
+class FrameFunction;
+
+// A callable copied into a FrameArena, for callbacks that only live for the frame; std::function would put
+// every capture larger than a couple of pointers on the heap. The callable has to be trivially destructible,
+// which lambdas capturing references and plain values are.
+template <typename R, typename... Args>
+class FrameFunction<R(Args...)>
+{
+public:
+	FrameFunction() = default;
+
+	template <typename Function>
+	FrameFunction(FrameArena& arena, Function&& function)
+	{
+		using Callable = std::decay_t<Function>;
+		callable = arena.create<Callable>(std::forward<Function>(function));
+		invoke = [](void* callable, Args... args) -> R { return (*static_cast<Callable*>(callable))(std::forward<Args>(args)...); };
+	}
+
+	R operator()(Args... args) const
+	{
+		return invoke(callable, std::forward<Args>(args)...);
+	}
+
+	explicit operator bool() const
+	{
+		return invoke != nullptr;
+	}
+
+private:
+	void* callable = nullptr;
+	R (*invoke)(void*, Args...) = nullptr;
+};
+
+// One FrameArena per frame in flight. begin() hands out the slot's arena once the frame that last used the slot
+// has retired, which is when everything allocated from it during that frame is dead. It also samples the
+// render thread's HeapAllocationCounter around the frame, which is how steady-state frames are held to zero heap
+// allocations.
+class FrameArenas
+{
+public:
+	static constexpr size_t   DEFAULT_CAPACITY = 256 * 1024;
+	static constexpr uint64_t WARMUP_FRAMES = 64; // pipeline variants and streamed textures settle in these
+
+	void init(uint32_t framesInFlight, size_t capacity = DEFAULT_CAPACITY)
+	{
+		arenas.clear();
+		for (uint32_t slot = 0; slot < framesInFlight; slot++)
+		{
+			arenas.emplace_back(capacity);
+		}
+		stats = {};
+	}
+
+	FrameArena& begin(uint32_t slot)
+	{
+		current = slot;
+		stats.growths += arenas[slot].reset();
+		frameStartAllocations = HeapAllocationCounter::count;
+		return arenas[slot];
+	}
+
+	void end()
+	{
+		uint64_t const allocations = HeapAllocationCounter::count - frameStartAllocations;
+		stats.frames++;
+		stats.heapAllocations += allocations;
+		stats.maxFrameHeapAllocations = std::max(stats.maxFrameHeapAllocations, allocations);
+		if (stats.frames > WARMUP_FRAMES)
+		{
+			stats.steadyFrames++;
+			stats.allocatingSteadyFrames += allocations > 0;
+		}
+		stats.lastBytes = arenas[current].bytesUsed();
+		stats.peakBytes = std::max(stats.peakBytes, stats.lastBytes);
+		stats.capacity = 0;
+		for (FrameArena const& arena : arenas)
+		{
+			stats.capacity += arena.capacity();
+		}
+	}
+
+	[[nodiscard]] FrameArenaStats const& getStats() const
+	{
+		return stats;
+	}
+
+	void report(std::ostream& out) const
+	{
+		if (stats.frames == 0)
+		{
+			return;
+		}
+		out << "frame arenas: " << stats.lastBytes / 1024 << " KiB last frame, " << stats.peakBytes / 1024 << " KiB peak, " << stats.capacity / 1024
+			<< " KiB reserved, " << stats.growths << " growths; render thread heap allocations: "
+			<< static_cast<double>(stats.heapAllocations) / static_cast<double>(stats.frames) << " per frame (max " << stats.maxFrameHeapAllocations << "), "
+			<< stats.allocatingSteadyFrames << " of " << stats.steadyFrames << " steady-state frames allocated" << std::endl;
+	}
+
+private:
+	std::vector<FrameArena> arenas;
+	uint32_t                current = 0;
+	uint64_t                frameStartAllocations = 0;
+	FrameArenaStats         stats;
+};
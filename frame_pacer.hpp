@@ -0,0 +1,196 @@
+#pragma once
+
+#ifndef VULKAN_HPP_NO_STRUCT_CONSTRUCTORS
+#	define VULKAN_HPP_NO_STRUCT_CONSTRUCTORS
+#endif
+#include <vulkan/vulkan_raii.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <iostream>
+#include <optional>
+#include <vector>
+
+// A span of GPU time in raw timestamp ticks (already masked to the queue family's valid bits).
+struct GpuTimestampInterval
+{
+	uint64_t start = 0;
+	uint64_t end = 0;
+};
+
+struct FramePacingStats
+{
+	double   lastCpuWaitMs = 0.0; // time the CPU blocked before it could reuse a frame slot
+	double   lastGpuIdleMs = 0.0; // gap between the end of one frame and the start of the next on the GPU
+	double   maxCpuWaitMs = 0.0;
+	double   maxGpuIdleMs = 0.0;
+	double   cpuWaitMsTotal = 0.0;
+	double   gpuIdleMsTotal = 0.0;
+	uint64_t frames = 0;
+	uint64_t gpuSamples = 0;
+
+	[[nodiscard]] double avgCpuWaitMs() const
+	{
+		return frames ? cpuWaitMsTotal / static_cast<double>(frames) : 0.0;
+	}
+
+	[[nodiscard]] double avgGpuIdleMs() const
+	{
+		return gpuSamples ? gpuIdleMsTotal / static_cast<double>(gpuSamples) : 0.0;
+	}
+};
+
+// Paces frames with a single timeline semaphore: frame N signals value N, and slot N % framesInFlight may be
+// reused once the semaphore reaches the value of the frame that last used it. A start/end timestamp pair per
+// slot measures how long the GPU sat idle between consecutive frames, the other side of the latency trade-off.
+class FramePacer
+{
+public:
+	void init(vk::raii::Device const& device, vk::raii::PhysicalDevice const& physicalDevice, uint32_t queueFamilyIndex, uint32_t framesInFlight)
+	{
+		this->device = &device;
+
+		vk::StructureChain<vk::SemaphoreCreateInfo, vk::SemaphoreTypeCreateInfo> timelineInfo = {
+			{},
+			{.semaphoreType = vk::SemaphoreType::eTimeline, .initialValue = 0} };
+		timeline = vk::raii::Semaphore(device, timelineInfo.get<vk::SemaphoreCreateInfo>());
+		slotValues.assign(framesInFlight, 0);
+
+		uint32_t const timestampBits = physicalDevice.getQueueFamilyProperties()[queueFamilyIndex].timestampValidBits;
+		if (timestampBits != 0)
+		{
+			timestampMask = timestampBits >= 64 ? ~0ull : ((1ull << timestampBits) - 1);
+			timestampPeriod = physicalDevice.getProperties().limits.timestampPeriod;
+			vk::QueryPoolCreateInfo queryPoolInfo{ .queryType = vk::QueryType::eTimestamp, .queryCount = 2 * framesInFlight };
+			queryPool = vk::raii::QueryPool(device, queryPoolInfo);
+			queryPool.reset(0, 2 * framesInFlight);
+		}
+	}
+
+	// Blocks until the GPU has finished the frame that last used slot, then returns the value this frame signals.
+	uint64_t waitForSlot(uint32_t slot)
+	{
+		auto const waitStart = std::chrono::steady_clock::now();
+		if (slotValues[slot] != 0)
+		{
+			vk::Semaphore const   semaphore = *timeline;
+			vk::SemaphoreWaitInfo waitInfo{ .semaphoreCount = 1, .pSemaphores = &semaphore, .pValues = &slotValues[slot] };
+			while (vk::Result::eTimeout == device->waitSemaphores(waitInfo, UINT64_MAX))
+				;
+		}
+		stats.lastCpuWaitMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - waitStart).count();
+		stats.maxCpuWaitMs = std::max(stats.maxCpuWaitMs, stats.lastCpuWaitMs);
+		stats.cpuWaitMsTotal += stats.lastCpuWaitMs;
+		stats.frames++;
+
+		if (slotValues[slot] != 0)
+		{
+			readTimestamps(slot);
+		}
+		return submittedValue + 1;
+	}
+
+	void writeFrameStart(vk::raii::CommandBuffer const& commandBuffer, uint32_t slot) const
+	{
+		if (*queryPool)
+		{
+			commandBuffer.writeTimestamp2(vk::PipelineStageFlagBits2::eTopOfPipe, *queryPool, 2 * slot);
+		}
+	}
+
+	void writeFrameEnd(vk::raii::CommandBuffer const& commandBuffer, uint32_t slot) const
+	{
+		if (*queryPool)
+		{
+			commandBuffer.writeTimestamp2(vk::PipelineStageFlagBits2::eBottomOfPipe, *queryPool, 2 * slot + 1);
+		}
+	}
+
+	// Call after the submission signaling value (as returned by waitForSlot) has been queued.
+	void frameSubmitted(uint32_t slot, uint64_t value)
+	{
+		slotValues[slot] = value;
+		submittedValue = value;
+	}
+
+	[[nodiscard]] vk::Semaphore semaphore() const
+	{
+		return *timeline;
+	}
+
+	// The value of the last submitted frame: a resource released now may be read by every frame up to it.
+	[[nodiscard]] uint64_t lastSubmittedValue() const
+	{
+		return submittedValue;
+	}
+
+	[[nodiscard]] uint64_t completedValue() const
+	{
+		return timeline.getCounterValue();
+	}
+
+	// GPU start and end of the frame whose timestamps the last waitForSlot() read back, if it read any.
+	[[nodiscard]] std::optional<GpuTimestampInterval> lastFrameInterval() const
+	{
+		return lastFrameValid ? std::optional(lastFrame) : std::nullopt;
+	}
+
+	[[nodiscard]] FramePacingStats const& getStats() const
+	{
+		return stats;
+	}
+
+	void report(std::ostream& out) const
+	{
+		out << "frame pacing: " << slotValues.size() << " frames in flight, cpu wait avg " << stats.avgCpuWaitMs() << " max " << stats.maxCpuWaitMs
+			<< " ms, gpu idle avg " << stats.avgGpuIdleMs() << " max " << stats.maxGpuIdleMs << " ms" << std::endl;
+	}
+
+private:
+	vk::raii::Device const* device = nullptr;
+	vk::raii::Semaphore     timeline = nullptr;
+	std::vector<uint64_t>   slotValues; // timeline value of the last frame submitted from each slot
+	uint64_t                submittedValue = 0;
+
+	vk::raii::QueryPool  queryPool = nullptr;
+	uint64_t             timestampMask = 0;
+	float                timestampPeriod = 1.0f;
+	uint64_t             lastFrameEnd = 0;
+	bool                 haveLastFrameEnd = false;
+	GpuTimestampInterval lastFrame;
+	bool                 lastFrameValid = false;
+
+	FramePacingStats stats;
+
+	void readTimestamps(uint32_t slot)
+	{
+		if (!*queryPool)
+		{
+			return;
+		}
+		lastFrameValid = false;
+		// read into an array rather than getResults()' vector: this runs every frame and should not allocate
+		auto [result, timestamps] = queryPool.getResult<std::array<uint64_t, 2>>(2 * slot, 2, sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+		queryPool.reset(2 * slot, 2);
+		if (result != vk::Result::eSuccess)
+		{
+			return;
+		}
+
+		// slots complete in submission order, so this frame directly follows the one read last time
+		uint64_t const start = timestamps[0] & timestampMask;
+		if (haveLastFrameEnd)
+		{
+			uint64_t const gap = start > lastFrameEnd ? start - lastFrameEnd : 0;
+			stats.lastGpuIdleMs = static_cast<double>(gap) * timestampPeriod * 1e-6;
+			stats.maxGpuIdleMs = std::max(stats.maxGpuIdleMs, stats.lastGpuIdleMs);
+			stats.gpuIdleMsTotal += stats.lastGpuIdleMs;
+			stats.gpuSamples++;
+		}
+		lastFrameEnd = timestamps[1] & timestampMask;
+		haveLastFrameEnd = true;
+		lastFrame = { .start = start, .end = lastFrameEnd };
+		lastFrameValid = true;
+	}
+};
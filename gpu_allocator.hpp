@@ -0,0 +1,374 @@
+#pragma once
+
+#ifndef VULKAN_HPP_NO_STRUCT_CONSTRUCTORS
+#	define VULKAN_HPP_NO_STRUCT_CONSTRUCTORS
+#endif
+#include <vulkan/vulkan_raii.hpp>
+
+#include "tlsf_allocator.hpp"
+
+#include <cassert>
+#include <iostream>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+struct GpuAllocation
+{
+	vk::DeviceMemory memory;
+	vk::DeviceSize   offset = 0;
+	vk::DeviceSize   size = 0;
+	void*            mapped = nullptr; // host pointer to offset, null unless the memory type is host visible
+	uint32_t         blockIndex = ~0u;
+	uint32_t         node = TlsfAllocator::INVALID;
+
+	explicit operator bool() const
+	{
+		return blockIndex != ~0u;
+	}
+};
+
+struct GpuAllocatorStats
+{
+	uint32_t       deviceMemoryCount = 0; // live vkAllocateMemory allocations
+	uint32_t       allocationCount = 0;   // live sub-allocations
+	vk::DeviceSize reservedBytes = 0;     // total size of all device memory blocks
+	vk::DeviceSize usedBytes = 0;
+	vk::DeviceSize largestFreeRegion = 0;
+	uint32_t       freeRegionCount = 0;
+
+	// 0 when all free space is one contiguous region, approaching 1 as it splinters.
+	[[nodiscard]] double fragmentation() const
+	{
+		vk::DeviceSize const freeBytes = reservedBytes - usedBytes;
+		return freeBytes == 0 ? 0.0 : 1.0 - static_cast<double>(largestFreeRegion) / static_cast<double>(freeBytes);
+	}
+};
+
+// Sub-allocates resources out of large vk::DeviceMemory blocks, one TLSF range per block. Blocks are kept per
+// memory type and per resource kind (linear buffers vs optimal-tiling images never share a block, which sidesteps
+// bufferImageGranularity). Host-visible blocks are mapped once at creation and stay mapped.
+class GpuAllocator
+{
+public:
+	static constexpr vk::DeviceSize DEFAULT_BLOCK_SIZE = 64ull * 1024 * 1024;
+
+	enum class ResourceKind
+	{
+		eLinear,
+		eOptimal
+	};
+
+	void init(vk::raii::Device const& device, vk::raii::PhysicalDevice const& physicalDevice, vk::DeviceSize blockSize = DEFAULT_BLOCK_SIZE)
+	{
+		this->device = &device;
+		this->blockSize = blockSize;
+		memoryProperties = physicalDevice.getMemoryProperties();
+		maxMemoryAllocationCount = physicalDevice.getProperties().limits.maxMemoryAllocationCount;
+	}
+
+	// Picks a memory type with all of required and, if possible, all of preferred.
+	GpuAllocation allocate(vk::MemoryRequirements const& requirements, vk::MemoryPropertyFlags required, vk::MemoryPropertyFlags preferred, ResourceKind kind)
+	{
+		uint32_t memoryType = findMemoryType(requirements.memoryTypeBits, required | preferred);
+		if (memoryType == ~0u)
+		{
+			memoryType = findMemoryType(requirements.memoryTypeBits, required);
+		}
+		if (memoryType == ~0u)
+		{
+			throw std::runtime_error("failed to find suitable memory type!");
+		}
+
+		// anything larger than half a block gets a dedicated allocation rather than wasting the rest of one
+		bool const dedicated = requirements.size > blockSize / 2;
+		if (!dedicated)
+		{
+			for (uint32_t blockIndex = 0; blockIndex < blocks.size(); blockIndex++)
+			{
+				auto& block = blocks[blockIndex];
+				if (block && !block->dedicated && block->memoryType == memoryType && block->kind == kind)
+				{
+					if (auto allocation = suballocate(blockIndex, requirements))
+					{
+						return allocation;
+					}
+				}
+			}
+		}
+
+		uint32_t const blockIndex = createBlock(memoryType, kind, dedicated ? requirements.size : blockSize, dedicated);
+		GpuAllocation  allocation = suballocate(blockIndex, requirements);
+		assert(allocation);
+		return allocation;
+	}
+
+	void free(GpuAllocation& allocation)
+	{
+		if (!allocation)
+		{
+			return;
+		}
+		auto& block = blocks[allocation.blockIndex];
+		block->range.free(TlsfAllocator::Allocation{ .offset = allocation.offset, .size = allocation.size, .node = allocation.node });
+		// dedicated blocks go back to the driver right away; regular blocks are kept for reuse
+		if (block->dedicated && block->range.empty())
+		{
+			block.reset();
+			freeBlockSlots.push_back(allocation.blockIndex);
+		}
+		allocation = {};
+	}
+
+	[[nodiscard]] GpuAllocatorStats stats() const
+	{
+		GpuAllocatorStats s;
+		for (auto const& block : blocks)
+		{
+			if (!block)
+			{
+				continue;
+			}
+			TlsfAllocator::Stats const blockStats = block->range.stats();
+			s.deviceMemoryCount++;
+			s.allocationCount += blockStats.allocationCount;
+			s.reservedBytes += blockStats.capacity;
+			s.usedBytes += blockStats.usedBytes;
+			s.largestFreeRegion = std::max(s.largestFreeRegion, blockStats.largestFreeRegion);
+			s.freeRegionCount += blockStats.freeRegionCount;
+		}
+		return s;
+	}
+
+	void report(std::ostream& out) const
+	{
+		GpuAllocatorStats const s = stats();
+		out << "gpu memory: " << s.allocationCount << " allocations in " << s.deviceMemoryCount << " device memory blocks (limit "
+			<< maxMemoryAllocationCount << "), " << s.usedBytes / 1024 << " / " << s.reservedBytes / 1024 << " KiB used, "
+			<< s.freeRegionCount << " free regions, fragmentation " << s.fragmentation() << std::endl;
+	}
+
+private:
+	struct Block
+	{
+		vk::raii::DeviceMemory memory = nullptr;
+		TlsfAllocator          range;
+		void*                  mapped = nullptr;
+		uint32_t               memoryType = 0;
+		ResourceKind           kind = ResourceKind::eLinear;
+		bool                   dedicated = false;
+	};
+
+	vk::raii::Device const*             device = nullptr;
+	vk::PhysicalDeviceMemoryProperties  memoryProperties;
+	vk::DeviceSize                      blockSize = DEFAULT_BLOCK_SIZE;
+	uint32_t                            maxMemoryAllocationCount = 0;
+	std::vector<std::unique_ptr<Block>> blocks;
+	std::vector<uint32_t>               freeBlockSlots;
+
+	uint32_t findMemoryType(uint32_t typeFilter, vk::MemoryPropertyFlags properties) const
+	{
+		for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+		{
+			if ((typeFilter & (1 << i)) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+			{
+				return i;
+			}
+		}
+		return ~0u;
+	}
+
+	uint32_t createBlock(uint32_t memoryType, ResourceKind kind, vk::DeviceSize size, bool dedicated)
+	{
+		if (stats().deviceMemoryCount >= maxMemoryAllocationCount)
+		{
+			throw std::runtime_error("gpu allocator: maxMemoryAllocationCount exceeded");
+		}
+
+		// any buffer may be read through its device address, so linear blocks are allocated with that capability
+		vk::MemoryAllocateFlagsInfo flagsInfo{ .flags = vk::MemoryAllocateFlagBits::eDeviceAddress };
+		vk::MemoryAllocateInfo      allocInfo{ .pNext = kind == ResourceKind::eLinear ? &flagsInfo : nullptr, .allocationSize = size, .memoryTypeIndex = memoryType };
+		auto block = std::make_unique<Block>(Block{ .memory = vk::raii::DeviceMemory(*device, allocInfo),
+												   .range = TlsfAllocator(size),
+												   .memoryType = memoryType,
+												   .kind = kind,
+												   .dedicated = dedicated });
+		if (memoryProperties.memoryTypes[memoryType].propertyFlags & vk::MemoryPropertyFlagBits::eHostVisible)
+		{
+			block->mapped = block->memory.mapMemory(0, size);
+		}
+
+		if (!freeBlockSlots.empty())
+		{
+			uint32_t const blockIndex = freeBlockSlots.back();
+			freeBlockSlots.pop_back();
+			blocks[blockIndex] = std::move(block);
+			return blockIndex;
+		}
+		blocks.push_back(std::move(block));
+		return static_cast<uint32_t>(blocks.size() - 1);
+	}
+
+	GpuAllocation suballocate(uint32_t blockIndex, vk::MemoryRequirements const& requirements)
+	{
+		Block& block = *blocks[blockIndex];
+		auto   range = block.range.allocate(requirements.size, requirements.alignment);
+		if (!range)
+		{
+			return {};
+		}
+		return GpuAllocation{ .memory = *block.memory,
+							  .offset = range->offset,
+							  .size = range->size,
+							  .mapped = block.mapped ? static_cast<char*>(block.mapped) + range->offset : nullptr,
+							  .blockIndex = blockIndex,
+							  .node = range->node };
+	}
+};
+
+// A buffer together with the memory it is bound to; the buffer is destroyed before its memory is released.
+// Buffers are owned by one queue family at a time, unless sharedFamilies names several: then every queue of
+// those families may use the buffer without ownership transfers (concurrent sharing).
+class GpuBuffer
+{
+public:
+	GpuBuffer() = default;
+
+	GpuBuffer(GpuAllocator& allocator, vk::raii::Device const& device, vk::DeviceSize size, vk::BufferUsageFlags usage,
+			  vk::MemoryPropertyFlags required, vk::MemoryPropertyFlags preferred = {}, std::span<uint32_t const> sharedFamilies = {}) :
+		allocator(&allocator), size(size), concurrent(sharedFamilies.size() > 1)
+	{
+		vk::BufferCreateInfo bufferInfo{ .size = size,
+										 .usage = usage,
+										 .sharingMode = concurrent ? vk::SharingMode::eConcurrent : vk::SharingMode::eExclusive,
+										 .queueFamilyIndexCount = concurrent ? static_cast<uint32_t>(sharedFamilies.size()) : 0,
+										 .pQueueFamilyIndices = concurrent ? sharedFamilies.data() : nullptr };
+		buffer = vk::raii::Buffer(device, bufferInfo);
+		allocation = allocator.allocate(buffer.getMemoryRequirements(), required, preferred, GpuAllocator::ResourceKind::eLinear);
+		buffer.bindMemory(allocation.memory, allocation.offset);
+	}
+
+	GpuBuffer(GpuBuffer&& other) noexcept :
+		allocator(std::exchange(other.allocator, nullptr)), allocation(std::exchange(other.allocation, {})), buffer(std::move(other.buffer)), size(other.size),
+		concurrent(other.concurrent)
+	{}
+
+	GpuBuffer& operator=(GpuBuffer&& other) noexcept
+	{
+		if (this != &other)
+		{
+			release();
+			allocator = std::exchange(other.allocator, nullptr);
+			allocation = std::exchange(other.allocation, {});
+			buffer = std::move(other.buffer);
+			size = other.size;
+			concurrent = other.concurrent;
+		}
+		return *this;
+	}
+
+	~GpuBuffer()
+	{
+		release();
+	}
+
+	[[nodiscard]] vk::Buffer operator*() const
+	{
+		return *buffer;
+	}
+
+	[[nodiscard]] void* mapped() const
+	{
+		return allocation.mapped;
+	}
+
+	[[nodiscard]] vk::DeviceSize getSize() const
+	{
+		return size;
+	}
+
+	[[nodiscard]] bool isConcurrent() const
+	{
+		return concurrent;
+	}
+
+private:
+	GpuAllocator*    allocator = nullptr;
+	GpuAllocation    allocation;
+	vk::raii::Buffer buffer = nullptr;
+	vk::DeviceSize   size = 0;
+	bool             concurrent = false;
+
+	void release()
+	{
+		buffer = nullptr;
+		if (allocator)
+		{
+			allocator->free(allocation);
+		}
+	}
+};
+
+// An image together with the memory it is bound to; the image is destroyed before its memory is released.
+class GpuImage
+{
+public:
+	GpuImage() = default;
+
+	GpuImage(GpuAllocator& allocator, vk::raii::Device const& device, vk::ImageCreateInfo const& imageInfo, vk::MemoryPropertyFlags required) :
+		allocator(&allocator)
+	{
+		image = vk::raii::Image(device, imageInfo);
+		auto const kind = imageInfo.tiling == vk::ImageTiling::eLinear ? GpuAllocator::ResourceKind::eLinear : GpuAllocator::ResourceKind::eOptimal;
+		allocation = allocator.allocate(image.getMemoryRequirements(), required, {}, kind);
+		image.bindMemory(allocation.memory, allocation.offset);
+	}
+
+	GpuImage(GpuImage&& other) noexcept :
+		allocator(std::exchange(other.allocator, nullptr)), allocation(std::exchange(other.allocation, {})), image(std::move(other.image))
+	{}
+
+	GpuImage& operator=(GpuImage&& other) noexcept
+	{
+		if (this != &other)
+		{
+			release();
+			allocator = std::exchange(other.allocator, nullptr);
+			allocation = std::exchange(other.allocation, {});
+			image = std::move(other.image);
+		}
+		return *this;
+	}
+
+	~GpuImage()
+	{
+		release();
+	}
+
+	[[nodiscard]] vk::Image operator*() const
+	{
+		return *image;
+	}
+
+	// Bytes of device memory the image is bound to.
+	[[nodiscard]] vk::DeviceSize getSize() const
+	{
+		return allocation.size;
+	}
+
+private:
+	GpuAllocator*   allocator = nullptr;
+	GpuAllocation   allocation;
+	vk::raii::Image image = nullptr;
+
+	void release()
+	{
+		image = nullptr;
+		if (allocator)
+		{
+			allocator->free(allocation);
+		}
+	}
+};
@@ -0,0 +1,440 @@
+#pragma once
+
+#ifndef VULKAN_HPP_NO_STRUCT_CONSTRUCTORS
+#	define VULKAN_HPP_NO_STRUCT_CONSTRUCTORS
+#endif
+#include <vulkan/vulkan_raii.hpp>
+
+#include "camera.hpp"
+#include "gpu_allocator.hpp"
+#include "lod_builder.hpp"
+#include "uniform_ring.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <span>
+#include <vector>
+
+// One drawable object, a copy of one scene draw, as the shaders see it (shaders/scene_data.slang). The vertex
+// and mesh shaders fetch the material through the object index, and the transform from the frame's
+// GpuTransformTable through the object's scene graph node.
+struct GpuObject
+{
+	std::array<float, 4> boundingSphere; // object-space center, radius
+	uint32_t             material = 0;   // index into the material table
+	uint32_t             node = 0;       // SceneGraph slot, the index into GpuTransformTable
+	uint32_t             mesh = 0;       // scene draw it is a copy of, whose BVH or BLAS the shadow rays trace
+	uint32_t             padding = 0;
+};
+static_assert(sizeof(GpuObject) == 32);
+
+// This frame's scene graph world transforms in the UniformRing, one array per component indexed by slot
+// (TransformTable in shaders/scene_data.slang).
+struct GpuTransformTable
+{
+	vk::DeviceAddress translationScale = 0; // vec4: translation, uniform scale
+	vk::DeviceAddress rotation = 0;         // vec4: unit quaternion, vector part in xyz
+};
+
+// Up to GpuCuller::CLUSTER_GROUP_SIZE meshlets of one object; the unit of work of one cull or task workgroup.
+struct ClusterGroup
+{
+	uint32_t objectIndex = 0;
+	uint32_t firstMeshlet = 0;
+	uint32_t meshletCount = 0;
+	uint32_t indexInObject = 0; // 0 for the object's first group, which alone draws the object at a coarser LOD
+};
+
+// The LOD chain of one scene draw (SceneLodChain) as the cull and task shaders pick from it (LodChain in
+// shaders/scene_data.slang). The levels are ranges of the shared index buffer, drawn with the draw's vertexOffset.
+struct GpuLodChain
+{
+	std::array<SceneLod, MAX_SCENE_LODS> levels = {};
+	uint32_t                             count = 0;
+	int32_t                              vertexOffset = 0;
+	std::array<uint32_t, 2>              padding = {};
+};
+static_assert(sizeof(GpuLodChain) == 80);
+
+// Device addresses and sizes of the scene data the cull and meshlet shaders read.
+struct GpuCullScene
+{
+	vk::DeviceAddress objects = 0;
+	vk::DeviceAddress meshlets = 0;
+	vk::DeviceAddress groups = 0;
+	vk::DeviceAddress meshletVertices = 0;
+	vk::DeviceAddress meshletTriangles = 0;
+	vk::DeviceAddress vertices = 0;
+	vk::DeviceAddress lods = 0;    // GpuLodChain per scene draw
+	vk::DeviceAddress indices = 0; // the shared index buffer; mesh shader mode only, which draws the LODs from it
+	uint32_t          materials = ~0u;          // bindless storage buffer handle of the material table
+	uint32_t          textures = ~0u;           // bindless storage buffer handle of the streamed texture table
+	uint32_t          objectCount = 0;
+	uint32_t          groupCount = 0;
+	uint32_t          meshletInstanceCount = 0; // meshlets summed over all objects: the most draws a frame can produce
+};
+
+struct GpuCullingStats
+{
+	uint32_t lastVisible = 0;
+	uint64_t visibleTotal = 0;
+	uint64_t trianglesTotal = 0;     // submitted by the survivors
+	uint64_t baseTrianglesTotal = 0; // the surviving meshlets would have submitted without LODs
+	uint64_t frames = 0;
+
+	[[nodiscard]] double avgVisible() const
+	{
+		return frames ? static_cast<double>(visibleTotal) / static_cast<double>(frames) : 0.0;
+	}
+};
+
+// GPU-driven meshlet culling, so the CPU cost of a frame no longer grows with the object count. Each cluster group
+// first tests its object's bounding sphere, then every meshlet's sphere against the frustum and its normal cone
+// against the camera position. With mesh shaders the task shader does this and launches one mesh workgroup per
+// surviving meshlet. Otherwise a compute dispatch appends one VkDrawIndexedIndirectCommand per survivor and a
+// single drawIndexedIndirectCount draws them. Per-frame inputs go into the UniformRing; draws and the survivor
+// count live in buffers owned by each frame-in-flight slot, and the count is host visible and read back once the
+// slot's frame retired.
+//
+// LODs are picked ahead of culling by a dispatch of their own (selectLods()), one byte of state per object kept
+// from frame to frame, so the choice sees the previous one and switches with the hysteresis of the CPU path. An
+// object at one of its LODs is drawn as that level's index range instead of its meshlets, by its first group
+// alone: one indirect draw, or one mesh workgroup per LOD_CHUNK_TRIANGLES of it (shaders/meshlet.slang); each
+// counts as one survivor. Next to the survivor count, the triangles submitted and those the surviving meshlets
+// would have submitted without LODs are counted and read back the same way.
+class GpuCuller
+{
+public:
+	static constexpr uint32_t CLUSTER_GROUP_SIZE = 32;     // numthreads of cullMain and taskMain
+	static constexpr uint32_t LOD_GROUP_SIZE = 64;         // numthreads of lodMain, each thread picking for four objects
+	static constexpr uint32_t MAX_GROUPS_PER_ROW = 65535;  // guaranteed maxComputeWorkGroupCount[0] and maxTaskWorkGroupCount[0]
+	// the push constant range drawMeshTasks() writes; the fragment shader reads the material table through it
+	static constexpr vk::ShaderStageFlags MESH_SHADING_STAGES = vk::ShaderStageFlagBits::eTaskEXT | vk::ShaderStageFlagBits::eMeshEXT | vk::ShaderStageFlagBits::eFragment;
+
+	enum class Mode
+	{
+		eComputeIndirect,
+		eMeshShader
+	};
+
+	// cullShaderCode holds lodMain, used in both modes, and cullMain, used in compute mode only. sharedFamilies
+	// lists the queue families using the draws and count when culling runs on another queue than the draws (see
+	// GpuBuffer).
+	void init(vk::raii::Device const& device, GpuAllocator& allocator, vk::raii::PipelineCache const& pipelineCache, Mode mode, std::vector<char> const& cullShaderCode,
+			  uint32_t framesInFlight, GpuCullScene const& scene, std::span<uint32_t const> sharedFamilies = {})
+	{
+		this->mode = mode;
+		this->scene = scene;
+		stats = {};
+
+		vk::PushConstantRange        pushConstantRange{ .stageFlags = vk::ShaderStageFlagBits::eCompute, .offset = 0, .size = sizeof(vk::DeviceAddress) };
+		vk::PipelineLayoutCreateInfo pipelineLayoutInfo{ .setLayoutCount = 0, .pushConstantRangeCount = 1, .pPushConstantRanges = &pushConstantRange };
+		pipelineLayout = vk::raii::PipelineLayout(device, pipelineLayoutInfo);
+		lodPipeline = createPipeline(device, pipelineCache, cullShaderCode, "lodMain");
+		if (mode == Mode::eComputeIndirect)
+		{
+			pipeline = createPipeline(device, pipelineCache, cullShaderCode, "cullMain");
+		}
+
+		// every object starts at its finest level; one byte each, four to a word
+		vk::BufferUsageFlags const addressable = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eShaderDeviceAddress;
+		vk::DeviceSize const       lodStateBytes = std::max<vk::DeviceSize>(lodWords(), 1) * sizeof(uint32_t);
+		lodStates = GpuBuffer(allocator, device, lodStateBytes, addressable, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, {},
+							  sharedFamilies);
+		memset(lodStates.mapped(), 0, lodStateBytes);
+		lodStatesAddress = device.getBufferAddress(vk::BufferDeviceAddressInfo{ .buffer = *lodStates });
+
+		slots.clear();
+		slots.resize(framesInFlight);
+		for (Slot& slot : slots)
+		{
+			slot.count = GpuBuffer(allocator, device, sizeof(Counters), addressable | vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eTransferDst,
+								   vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, {}, sharedFamilies);
+			if (mode == Mode::eComputeIndirect)
+			{
+				slot.draws = GpuBuffer(allocator, device, std::max<vk::DeviceSize>(scene.meshletInstanceCount, 1) * sizeof(vk::DrawIndexedIndirectCommand),
+									   addressable | vk::BufferUsageFlagBits::eIndirectBuffer, vk::MemoryPropertyFlagBits::eDeviceLocal, {}, sharedFamilies);
+				slot.drawsAddress = device.getBufferAddress(vk::BufferDeviceAddressInfo{ .buffer = *slot.draws });
+			}
+			slot.countAddress = device.getBufferAddress(vk::BufferDeviceAddressInfo{ .buffer = *slot.count });
+		}
+	}
+
+	// Swaps in the LOD and, in compute mode, cull pipelines built from recompiled SPIR-V. Frames up to retireValue
+	// may still use the old ones, so recycle() destroys them once they completed. A single compute stage builds
+	// quickly enough to do it on the render thread at a frame boundary.
+	void reloadShader(vk::raii::Device const& device, vk::raii::PipelineCache const& pipelineCache, std::vector<char> const& cullShaderCode, uint64_t retireValue)
+	{
+		try
+		{
+			vk::raii::Pipeline reloadedLod = createPipeline(device, pipelineCache, cullShaderCode, "lodMain");
+			vk::raii::Pipeline reloaded = mode == Mode::eComputeIndirect ? createPipeline(device, pipelineCache, cullShaderCode, "cullMain") : nullptr;
+			retiredPipelines.push_back({ .pipeline = std::move(lodPipeline), .retireValue = retireValue });
+			lodPipeline = std::move(reloadedLod);
+			if (mode == Mode::eComputeIndirect)
+			{
+				retiredPipelines.push_back({ .pipeline = std::move(pipeline), .retireValue = retireValue });
+				pipeline = std::move(reloaded);
+			}
+		}
+		catch (vk::SystemError const& e)
+		{
+			std::cerr << "gpu culling: keeping the previous cull pipeline: " << e.what() << std::endl;
+		}
+	}
+
+	void recycle(uint64_t completedValue)
+	{
+		while (!retiredPipelines.empty() && retiredPipelines.front().retireValue <= completedValue)
+		{
+			retiredPipelines.pop_front();
+		}
+	}
+
+	[[nodiscard]] bool enabled() const
+	{
+		return !slots.empty();
+	}
+
+	[[nodiscard]] Mode getMode() const
+	{
+		return mode;
+	}
+
+	// Reads the counters of the frame that last used slot. Only valid once that frame has completed.
+	void collect(uint32_t slot)
+	{
+		if (!enabled() || !slots[slot].pending)
+		{
+			return;
+		}
+		Counters counters;
+		memcpy(&counters, slots[slot].count.mapped(), sizeof(Counters));
+		stats.lastVisible = counters.visible;
+		stats.visibleTotal += counters.visible;
+		stats.trianglesTotal += counters.triangles;
+		stats.baseTrianglesTotal += counters.baseTriangles;
+		stats.frames++;
+		slots[slot].pending = false;
+	}
+
+	// Writes this frame's camera, transforms and texture feedback buffer into the ring, which has to be allocating
+	// for slot; the slot's previous frame must have completed. lodPixelsPerUnit is how many pixels one world unit
+	// covers at distance one, which scales the LOD errors to the screen; 0 keeps every object on its meshlets.
+	void beginFrame(uint32_t slot, UniformRing& ring, glm::mat4 const& viewProjection, glm::vec3 const& cameraPosition, GpuTransformTable const& transforms,
+					vk::DeviceAddress textureFeedback, float lodPixelsPerUnit)
+	{
+		Frustum const frustum = Frustum::fromViewProjection(viewProjection);
+		FrameData     frameData{ .viewProjection = viewProjection,
+								 .cameraPosition = glm::vec4(cameraPosition, 1.0f),
+								 .objects = scene.objects,
+								 .meshlets = scene.meshlets,
+								 .groups = scene.groups,
+								 .meshletVertices = scene.meshletVertices,
+								 .meshletTriangles = scene.meshletTriangles,
+								 .vertices = scene.vertices,
+								 .draws = slots[slot].drawsAddress,
+								 .counters = slots[slot].countAddress,
+								 .groupCount = scene.groupCount,
+								 .groupsPerRow = groupsPerRow(),
+								 .materials = scene.materials,
+								 .textures = scene.textures,
+								 .textureFeedback = textureFeedback,
+								 .transforms = transforms,
+								 .lods = scene.lods,
+								 .lodStates = lodStatesAddress,
+								 .indices = scene.indices,
+								 .lodPixelsPerUnit = lodPixelsPerUnit,
+								 .objectCount = scene.objectCount };
+		std::ranges::copy(frustum.planes, frameData.frustumPlanes.begin());
+		slots[slot].frameDataAddress = ring.push(frameData).address;
+		slots[slot].pending = true;
+	}
+
+	// Zeroes the slot's counters; a transfer write that must be made visible to the cull dispatch or task shader.
+	void resetCount(vk::raii::CommandBuffer const& commandBuffer, uint32_t slot) const
+	{
+		commandBuffer.fillBuffer(*slots[slot].count, 0, sizeof(Counters), 0);
+	}
+
+	// Compute mode on an async compute queue: resets the count, picks the LODs and culls, ordering the three itself
+	// since no render graph sees this command buffer. The queue submission's semaphore makes the results visible.
+	void recordCull(vk::raii::CommandBuffer const& commandBuffer, uint32_t slot) const
+	{
+		resetCount(commandBuffer, slot);
+		// the previous frames' LOD dispatches and culls on this queue are done with the LOD states as well
+		vk::MemoryBarrier2 const lodStatesFree{ .srcStageMask = vk::PipelineStageFlagBits2::eComputeShader,
+												.srcAccessMask = vk::AccessFlagBits2::eShaderStorageWrite,
+												.dstStageMask = vk::PipelineStageFlagBits2::eComputeShader,
+												.dstAccessMask = vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite };
+		commandBuffer.pipelineBarrier2(vk::DependencyInfo{ .memoryBarrierCount = 1, .pMemoryBarriers = &lodStatesFree });
+		selectLods(commandBuffer, slot);
+		vk::MemoryBarrier2 const cullInputsDone{ .srcStageMask = vk::PipelineStageFlagBits2::eClear | vk::PipelineStageFlagBits2::eComputeShader,
+												 .srcAccessMask = vk::AccessFlagBits2::eTransferWrite | vk::AccessFlagBits2::eShaderStorageWrite,
+												 .dstStageMask = vk::PipelineStageFlagBits2::eComputeShader,
+												 .dstAccessMask = vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite };
+		commandBuffer.pipelineBarrier2(vk::DependencyInfo{ .memoryBarrierCount = 1, .pMemoryBarriers = &cullInputsDone });
+		dispatch(commandBuffer, slot);
+	}
+
+	// Both modes: moves every object's LOD state on by this frame's camera. Must come after the previous frame's
+	// culls are done reading the states, and be made visible to this frame's cull dispatch or task shader.
+	void selectLods(vk::raii::CommandBuffer const& commandBuffer, uint32_t slot) const
+	{
+		commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, *lodPipeline);
+		commandBuffer.pushConstants<vk::DeviceAddress>(*pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, slots[slot].frameDataAddress);
+		commandBuffer.dispatch(std::max((lodWords() + LOD_GROUP_SIZE - 1) / LOD_GROUP_SIZE, 1u), 1, 1);
+	}
+
+	// Compute mode: writes the slot's draws and count; both must be made visible to the indirect draw afterwards.
+	void dispatch(vk::raii::CommandBuffer const& commandBuffer, uint32_t slot) const
+	{
+		commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, *pipeline);
+		commandBuffer.pushConstants<vk::DeviceAddress>(*pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, slots[slot].frameDataAddress);
+		commandBuffer.dispatch(groupsPerRow(), groupRows(), 1);
+	}
+
+	// Compute mode: draws whatever the slot's dispatch let through, with the pipeline and buffers bound by the caller.
+	void drawIndirect(vk::raii::CommandBuffer const& commandBuffer, uint32_t slot) const
+	{
+		commandBuffer.drawIndexedIndirectCount(*slots[slot].draws, 0, *slots[slot].count, 0, scene.meshletInstanceCount, sizeof(vk::DrawIndexedIndirectCommand));
+	}
+
+	// Mesh shader mode: launches the task workgroups with the bound meshlet pipeline, whose layout takes the
+	// frame data address as its only push constant.
+	void drawMeshTasks(vk::raii::CommandBuffer const& commandBuffer, uint32_t slot, vk::PipelineLayout layout) const
+	{
+		commandBuffer.pushConstants<vk::DeviceAddress>(layout, MESH_SHADING_STAGES, 0, slots[slot].frameDataAddress);
+		commandBuffer.drawMeshTasksEXT(groupsPerRow(), groupRows(), 1);
+	}
+
+	[[nodiscard]] vk::Buffer drawBuffer(uint32_t slot) const
+	{
+		return *slots[slot].draws;
+	}
+
+	[[nodiscard]] vk::Buffer countBuffer(uint32_t slot) const
+	{
+		return *slots[slot].count;
+	}
+
+	// Read and written by selectLods(), read by the cull dispatch and task shader, across frames.
+	[[nodiscard]] vk::Buffer lodStateBuffer() const
+	{
+		return *lodStates;
+	}
+
+	[[nodiscard]] GpuCullingStats const& getStats() const
+	{
+		return stats;
+	}
+
+	void report(std::ostream& out) const
+	{
+		if (!enabled())
+		{
+			return;
+		}
+		double const avgVisible = stats.avgVisible();
+		out << "gpu culling (" << (mode == Mode::eMeshShader ? "mesh shaders" : "compute + indirect") << "): " << scene.objectCount << " objects, "
+			<< scene.meshletInstanceCount << " meshlets, visible avg " << avgVisible << " (last " << stats.lastVisible << "), culled avg "
+			<< static_cast<double>(scene.meshletInstanceCount) - avgVisible << " over " << stats.frames << " frames" << std::endl;
+	}
+
+private:
+	// CullFrame in shaders/scene_data.slang
+	struct FrameData
+	{
+		glm::mat4                viewProjection;
+		std::array<glm::vec4, 6> frustumPlanes;
+		glm::vec4                cameraPosition;
+		vk::DeviceAddress        objects = 0;
+		vk::DeviceAddress        meshlets = 0;
+		vk::DeviceAddress        groups = 0;
+		vk::DeviceAddress        meshletVertices = 0;
+		vk::DeviceAddress        meshletTriangles = 0;
+		vk::DeviceAddress        vertices = 0;
+		vk::DeviceAddress        draws = 0;
+		vk::DeviceAddress        counters = 0;
+		uint32_t                 groupCount = 0;
+		uint32_t                 groupsPerRow = 0;
+		uint32_t                 materials = 0;
+		uint32_t                 textures = 0;
+		vk::DeviceAddress        textureFeedback = 0;
+		GpuTransformTable        transforms;
+		vk::DeviceAddress        lods = 0;
+		vk::DeviceAddress        lodStates = 0;
+		vk::DeviceAddress        indices = 0;
+		float                    lodPixelsPerUnit = 0.0f;
+		uint32_t                 objectCount = 0;
+	};
+	static_assert(offsetof(FrameData, objects) == 176 && offsetof(FrameData, groupCount) == 240 && offsetof(FrameData, transforms) == 264 &&
+				  offsetof(FrameData, lodPixelsPerUnit) == 304);
+
+	// CullCounters in shaders/scene_data.slang; visible doubles as the indirect draw count
+	struct Counters
+	{
+		uint32_t visible = 0;
+		uint32_t triangles = 0;
+		uint32_t baseTriangles = 0;
+	};
+
+	struct Slot
+	{
+		GpuBuffer         count;
+		GpuBuffer         draws; // compute mode only
+		vk::DeviceAddress frameDataAddress = 0; // in the uniform ring, rewritten by beginFrame()
+		vk::DeviceAddress countAddress = 0;
+		vk::DeviceAddress drawsAddress = 0;
+		bool              pending = false; // a frame was recorded whose count has not been collected yet
+	};
+
+	struct RetiredPipeline
+	{
+		vk::raii::Pipeline pipeline = nullptr;
+		uint64_t           retireValue = 0;
+	};
+
+	Mode                        mode = Mode::eComputeIndirect;
+	GpuCullScene                scene;
+	vk::raii::PipelineLayout    pipelineLayout = nullptr;
+	vk::raii::Pipeline          pipeline = nullptr;
+	vk::raii::Pipeline          lodPipeline = nullptr;
+	GpuBuffer                   lodStates; // host visible, only ever zeroed by the host
+	vk::DeviceAddress           lodStatesAddress = 0;
+	std::deque<RetiredPipeline> retiredPipelines; // replaced by reloadShader(), in retire order
+	std::vector<Slot>           slots;
+	GpuCullingStats             stats;
+
+	[[nodiscard]] vk::raii::Pipeline createPipeline(vk::raii::Device const& device, vk::raii::PipelineCache const& pipelineCache,
+													std::vector<char> const& cullShaderCode, char const* entry) const
+	{
+		vk::ShaderModuleCreateInfo shaderInfo{ .codeSize = cullShaderCode.size(), .pCode = reinterpret_cast<uint32_t const*>(cullShaderCode.data()) };
+		vk::raii::ShaderModule     shaderModule(device, shaderInfo);
+
+		vk::ComputePipelineCreateInfo pipelineInfo{ .stage = {.stage = vk::ShaderStageFlagBits::eCompute, .module = *shaderModule, .pName = entry},
+													.layout = *pipelineLayout };
+		return vk::raii::Pipeline(device, pipelineCache, pipelineInfo);
+	}
+
+	// words of lodStates, four objects to each
+	[[nodiscard]] uint32_t lodWords() const
+	{
+		return (scene.objectCount + 3) / 4;
+	}
+
+	// cluster groups are dispatched as a 2D grid, since a single row is capped at MAX_GROUPS_PER_ROW
+	[[nodiscard]] uint32_t groupsPerRow() const
+	{
+		return std::clamp(scene.groupCount, 1u, MAX_GROUPS_PER_ROW);
+	}
+
+	[[nodiscard]] uint32_t groupRows() const
+	{
+		return (scene.groupCount + groupsPerRow() - 1) / groupsPerRow();
+	}
+};
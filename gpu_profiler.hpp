@@ -0,0 +1,255 @@
+#pragma once
+
+#ifndef VULKAN_HPP_NO_STRUCT_CONSTRUCTORS
+#	define VULKAN_HPP_NO_STRUCT_CONSTRUCTORS
+#endif
+#include <vulkan/vulkan_raii.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+struct GpuScopeStats
+{
+	double   minMs = 0.0;
+	double   avgMs = 0.0;
+	double   p99Ms = 0.0;
+	uint32_t samples = 0;
+};
+
+// Timestamp-query profiler with one query pool per frame-in-flight slot. Scopes recorded into a slot are
+// read back only after the GPU has finished that slot's frame, so reading never stalls the frames still in flight.
+// An uninitialized profiler is disabled: scopes are a single branch and no pools, resets or readbacks happen.
+class GpuProfiler
+{
+public:
+	static constexpr uint32_t MAX_SCOPES_PER_FRAME = 128;
+	static constexpr size_t   HISTORY_LENGTH = 256;
+	static constexpr uint32_t INVALID_SCOPE = ~0u; // beginScope() once the frame's scopes ran out, or while disabled
+
+	void init(vk::raii::Device const& device, vk::raii::PhysicalDevice const& physicalDevice, uint32_t queueFamilyIndex, uint32_t framesInFlight)
+	{
+		uint32_t const validBits = physicalDevice.getQueueFamilyProperties()[queueFamilyIndex].timestampValidBits;
+		if (validBits == 0)
+		{
+			std::cerr << "gpu profiler: queue family " << queueFamilyIndex << " does not support timestamps, profiling disabled" << std::endl;
+			return;
+		}
+		validMask = validBits >= 64 ? ~0ull : ((1ull << validBits) - 1);
+		timestampPeriod = physicalDevice.getProperties().limits.timestampPeriod;
+
+		vk::QueryPoolCreateInfo queryPoolInfo{ .queryType = vk::QueryType::eTimestamp, .queryCount = 2 * MAX_SCOPES_PER_FRAME };
+		frames.clear();
+		frames.resize(framesInFlight);
+		for (auto& frame : frames)
+		{
+			frame.queryPool = vk::raii::QueryPool(device, queryPoolInfo);
+			frame.scopes.reserve(MAX_SCOPES_PER_FRAME);
+		}
+	}
+
+	[[nodiscard]] bool enabled() const
+	{
+		return !frames.empty();
+	}
+
+	// Must be recorded outside of a rendering scope, before any other scope of this frame.
+	void beginFrame(vk::raii::CommandBuffer const& commandBuffer, uint32_t frameIndex)
+	{
+		if (!enabled())
+		{
+			return;
+		}
+		current = &frames[frameIndex];
+		current->scopes.clear();
+		commandBuffer.resetQueryPool(*current->queryPool, 0, 2 * MAX_SCOPES_PER_FRAME);
+	}
+
+	// Returns a scope id for endScope(); names must outlive the frame (string literals in practice).
+	uint32_t beginScope(vk::raii::CommandBuffer const& commandBuffer, char const* name)
+	{
+		if (!enabled() || current->scopes.size() == MAX_SCOPES_PER_FRAME)
+		{
+			return INVALID_SCOPE;
+		}
+		auto const scope = static_cast<uint32_t>(current->scopes.size());
+		current->scopes.push_back(name);
+		commandBuffer.writeTimestamp2(vk::PipelineStageFlagBits2::eTopOfPipe, *current->queryPool, 2 * scope);
+		return scope;
+	}
+
+	void endScope(vk::raii::CommandBuffer const& commandBuffer, uint32_t scope)
+	{
+		if (scope == INVALID_SCOPE)
+		{
+			return;
+		}
+		commandBuffer.writeTimestamp2(vk::PipelineStageFlagBits2::eBottomOfPipe, *current->queryPool, 2 * scope + 1);
+	}
+
+	// Call once the GPU has finished the frame last recorded into frameIndex, before that slot is recorded again.
+	void resolve(uint32_t frameIndex)
+	{
+		if (!enabled())
+		{
+			return;
+		}
+		auto& frame = frames[frameIndex];
+		if (frame.scopes.empty())
+		{
+			return;
+		}
+
+		// read into an array rather than getResults()' vector, and total into a fixed one rather than a map: this runs
+		// every frame and should not allocate
+		auto const queryCount = static_cast<uint32_t>(2 * frame.scopes.size());
+		auto [result, timestamps] = frame.queryPool.getResult<std::array<uint64_t, 2 * MAX_SCOPES_PER_FRAME>>(0, queryCount, sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+		if (result != vk::Result::eSuccess)
+		{
+			return;
+		}
+
+		// scopes sharing a name (e.g. one per variant run) are summed into a single sample for the frame
+		std::array<std::pair<std::string_view, double>, MAX_SCOPES_PER_FRAME> frameTotals;
+		size_t                                                                totalCount = 0;
+		for (size_t scope = 0; scope < frame.scopes.size(); scope++)
+		{
+			uint64_t const begin = timestamps[2 * scope] & validMask;
+			uint64_t const end = timestamps[2 * scope + 1] & validMask;
+			double const   elapsedMs = static_cast<double>((end - begin) & validMask) * timestampPeriod * 1e-6;
+			std::string_view const name = frame.scopes[scope];
+			auto const total = std::find_if(frameTotals.begin(), frameTotals.begin() + totalCount, [&](auto const& entry) { return entry.first == name; });
+			if (total == frameTotals.begin() + totalCount)
+			{
+				frameTotals[totalCount++] = { name, elapsedMs };
+			}
+			else
+			{
+				total->second += elapsedMs;
+			}
+		}
+		for (size_t i = 0; i < totalCount; i++)
+		{
+			auto const& [name, elapsedMs] = frameTotals[i];
+			auto it = history.find(name);
+			if (it == history.end())
+			{
+				it = history.emplace(std::string(name), ScopeHistory{}).first;
+			}
+			it->second.push(elapsedMs);
+		}
+		frame.scopes.clear();
+	}
+
+	[[nodiscard]] std::optional<GpuScopeStats> stats(std::string_view name) const
+	{
+		auto it = history.find(name);
+		if (it == history.end())
+		{
+			return std::nullopt;
+		}
+		return it->second.stats();
+	}
+
+	[[nodiscard]] std::vector<std::string> scopeNames() const
+	{
+		std::vector<std::string> names;
+		names.reserve(history.size());
+		for (auto const& [name, scopeHistory] : history)
+		{
+			names.push_back(name);
+		}
+		return names;
+	}
+
+	void report(std::ostream& out) const
+	{
+		if (!enabled())
+		{
+			return;
+		}
+		out << "gpu scopes (ms, last " << HISTORY_LENGTH << " frames):\n";
+		for (auto const& [name, scopeHistory] : history)
+		{
+			GpuScopeStats const s = scopeHistory.stats();
+			out << "  " << std::left << std::setw(28) << name << std::right
+				<< " min " << s.minMs << " avg " << s.avgMs << " p99 " << s.p99Ms << "\n";
+		}
+		out.flush();
+	}
+
+	// RAII helper for bracketing a block of commands.
+	class Scope
+	{
+	public:
+		Scope(GpuProfiler& profiler, vk::raii::CommandBuffer const& commandBuffer, char const* name) :
+			profiler(profiler), commandBuffer(commandBuffer), scope(profiler.beginScope(commandBuffer, name))
+		{}
+		~Scope()
+		{
+			profiler.endScope(commandBuffer, scope);
+		}
+		Scope(Scope const&) = delete;
+		Scope& operator=(Scope const&) = delete;
+
+	private:
+		GpuProfiler&                   profiler;
+		vk::raii::CommandBuffer const& commandBuffer;
+		uint32_t                       scope;
+	};
+
+private:
+	struct FrameQueries
+	{
+		vk::raii::QueryPool      queryPool = nullptr;
+		std::vector<char const*> scopes;
+	};
+
+	struct ScopeHistory
+	{
+		std::array<double, HISTORY_LENGTH> samples{};
+		size_t                             count = 0;
+		size_t                             next = 0;
+
+		void push(double sample)
+		{
+			samples[next] = sample;
+			next = (next + 1) % HISTORY_LENGTH;
+			count = std::min(count + 1, HISTORY_LENGTH);
+		}
+
+		[[nodiscard]] GpuScopeStats stats() const
+		{
+			GpuScopeStats s{ .samples = static_cast<uint32_t>(count) };
+			if (count == 0)
+			{
+				return s;
+			}
+			std::array<double, HISTORY_LENGTH> sorted = samples;
+			std::sort(sorted.begin(), sorted.begin() + count);
+			double sum = 0.0;
+			for (size_t i = 0; i < count; i++)
+			{
+				sum += sorted[i];
+			}
+			s.minMs = sorted[0];
+			s.avgMs = sum / static_cast<double>(count);
+			s.p99Ms = sorted[std::min(count - 1, count * 99 / 100)];
+			return s;
+		}
+	};
+
+	std::vector<FrameQueries>                          frames;
+	FrameQueries*                                      current = nullptr;
+	std::map<std::string, ScopeHistory, std::less<>>   history;
+	uint64_t                                           validMask = ~0ull;
+	float                                              timestampPeriod = 1.0f;
+};
@@ -0,0 +1,407 @@
+#pragma once
+
+#include "scene_loader.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <span>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+constexpr uint32_t MAX_SCENE_LODS = 4; // simplified levels per draw, after the draw itself
+
+// One simplified version of a draw: a range of SceneLods::indices(), local to the draw's vertices like the draw's
+// own indices, so it is drawn with the draw's vertexOffset.
+struct SceneLod
+{
+	uint32_t firstIndex = 0;
+	uint32_t indexCount = 0;
+	float    error = 0.0f; // how far, in scene units, the simplified surface may lie from the original
+	uint32_t reserved = 0;
+};
+
+// The LODs of one draw, finest first. The draw itself is level 0, with no error, and is not stored.
+struct SceneLodChain
+{
+	uint32_t                             count = 0;
+	std::array<SceneLod, MAX_SCENE_LODS> levels = {};
+};
+
+// LOD chains for every draw of a scene, built at import with quadric error metrics (Garland and Heckbert) and
+// half-edge collapses: a vertex is only ever moved onto one of its neighbours, so the levels reuse the draw's
+// vertices and add nothing but indices. One simplification run per draw takes a snapshot every time the
+// triangle count halves, so every level's error is measured against the original surface. Vertices on an open
+// border or an attribute seam (several vertices at one position) never move, which keeps silhouettes, UV seams
+// and the joins between draws closed, and collapses that would fold a triangle over are rejected.
+class SceneLods
+{
+public:
+	static constexpr uint32_t MIN_TRIANGLES = 64;    // smaller draws are cheap enough as they are
+	static constexpr double   MAX_KEPT = 0.85;       // a level that keeps more of the previous one's triangles ends the chain
+
+	// Scene is a SceneSource or a MeshCache.
+	template <typename Scene>
+	static SceneLods build(Scene const& scene)
+	{
+		SceneLods                lods;
+		std::vector<uint32_t>    sourceIndices;
+		std::vector<SceneVertex> sourceVertices;
+		for (SceneDraw const& draw : scene.draws())
+		{
+			SceneLodChain chain;
+			if (draw.indexCount / 3 >= MIN_TRIANGLES)
+			{
+				sourceIndices.resize(draw.indexCount);
+				scene.writeIndices(draw.firstIndex, draw.indexCount, sourceIndices.data());
+				sourceVertices.resize(draw.vertexCount);
+				scene.writeVertices(static_cast<uint64_t>(draw.vertexOffset), draw.vertexCount, sourceVertices.data());
+				Simplifier(sourceVertices, sourceIndices).run(chain, lods.indexList);
+			}
+			lods.chainList.push_back(chain);
+		}
+		return lods;
+	}
+
+	static SceneLods fromData(std::vector<SceneLodChain> chains, std::vector<uint32_t> indices)
+	{
+		SceneLods lods;
+		lods.chainList = std::move(chains);
+		lods.indexList = std::move(indices);
+		return lods;
+	}
+
+	// One chain per scene draw, in the same order.
+	[[nodiscard]] std::vector<SceneLodChain> const& chains() const
+	{
+		return chainList;
+	}
+
+	[[nodiscard]] std::vector<uint32_t> const& indices() const
+	{
+		return indexList;
+	}
+
+	[[nodiscard]] uint64_t indexCount() const
+	{
+		return indexList.size();
+	}
+
+	void writeIndices(uint64_t first, uint64_t count, uint32_t* out) const
+	{
+		memcpy(out, indexList.data() + first, count * sizeof(uint32_t));
+	}
+
+private:
+	std::vector<SceneLodChain> chainList;
+	std::vector<uint32_t>      indexList;
+
+	// Symmetric 4x4 matrix summing the squared distances to a set of planes.
+	struct Quadric
+	{
+		std::array<double, 10> a = {}; // a00 a01 a02 a03 a11 a12 a13 a22 a23 a33
+
+		static Quadric plane(double nx, double ny, double nz, double d)
+		{
+			return { { nx * nx, nx * ny, nx * nz, nx * d, ny * ny, ny * nz, ny * d, nz * nz, nz * d, d * d } };
+		}
+
+		Quadric& operator+=(Quadric const& other)
+		{
+			for (size_t i = 0; i < a.size(); i++)
+			{
+				a[i] += other.a[i];
+			}
+			return *this;
+		}
+
+		[[nodiscard]] double evaluate(std::array<float, 3> const& p) const
+		{
+			double const x = p[0], y = p[1], z = p[2];
+			return x * x * a[0] + 2.0 * x * y * a[1] + 2.0 * x * z * a[2] + 2.0 * x * a[3] + y * y * a[4] + 2.0 * y * z * a[5] + 2.0 * y * a[6] + z * z * a[7] +
+				   2.0 * z * a[8] + a[9];
+		}
+	};
+
+	struct Collapse
+	{
+		double   cost = 0.0;
+		uint32_t from = 0;
+		uint32_t to = 0;
+		uint32_t version = 0; // of `from` when queued; a newer one makes the entry stale
+
+		bool operator>(Collapse const& other) const
+		{
+			return cost > other.cost;
+		}
+	};
+
+	class Simplifier
+	{
+	public:
+		Simplifier(std::span<SceneVertex const> vertices, std::vector<uint32_t> const& indices) : vertices(vertices), triangles(indices)
+		{
+			uint32_t const vertexCount = static_cast<uint32_t>(vertices.size());
+			liveTriangles = static_cast<uint32_t>(triangles.size() / 3);
+
+			// vertices sharing a position (attribute seams) share one quadric and one position id
+			std::unordered_map<PositionKey, uint32_t, PositionHash> positionIds;
+			position.resize(vertexCount);
+			std::vector<uint32_t> copies;
+			for (uint32_t v = 0; v < vertexCount; v++)
+			{
+				PositionKey key;
+				memcpy(key.data(), vertices[v].position.data(), sizeof(key));
+				auto const [it, inserted] = positionIds.try_emplace(key, static_cast<uint32_t>(copies.size()));
+				if (inserted)
+				{
+					copies.push_back(0);
+				}
+				position[v] = it->second;
+				copies[it->second]++;
+			}
+			locked.assign(copies.size(), false);
+			for (uint32_t id = 0; id < copies.size(); id++)
+			{
+				locked[id] = copies[id] > 1;
+			}
+
+			// edges used by one triangle are open borders, by more than two non-manifold; both ends stay put
+			std::unordered_map<uint64_t, uint32_t> edgeUses;
+			quadrics.assign(copies.size(), {});
+			vertexTriangles.resize(vertexCount);
+			for (uint32_t t = 0; t < liveTriangles; t++)
+			{
+				for (uint32_t corner = 0; corner < 3; corner++)
+				{
+					uint32_t const a = position[triangles[3 * t + corner]];
+					uint32_t const b = position[triangles[3 * t + (corner + 1) % 3]];
+					edgeUses[uint64_t(std::min(a, b)) << 32 | std::max(a, b)]++;
+					vertexTriangles[triangles[3 * t + corner]].push_back(t);
+				}
+				std::array<double, 3> const n = normal(t, ~0u, 0);
+				double const                length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+				if (length > 0.0)
+				{
+					auto const&   p = vertices[triangles[3 * t]].position;
+					double const  nx = n[0] / length, ny = n[1] / length, nz = n[2] / length;
+					Quadric const plane = Quadric::plane(nx, ny, nz, -(nx * p[0] + ny * p[1] + nz * p[2]));
+					for (uint32_t corner = 0; corner < 3; corner++)
+					{
+						quadrics[position[triangles[3 * t + corner]]] += plane;
+					}
+				}
+			}
+			for (auto const& [edge, uses] : edgeUses)
+			{
+				if (uses != 2)
+				{
+					locked[edge >> 32] = true;
+					locked[edge & 0xffffffffu] = true;
+				}
+			}
+			removedTriangle.assign(liveTriangles, false);
+			version.assign(vertexCount, 0);
+		}
+
+		// Collapses until the triangle count has halved MAX_SCENE_LODS times or nothing can go, appending a
+		// snapshot of the triangles at every halving.
+		void run(SceneLodChain& chain, std::vector<uint32_t>& lodIndices)
+		{
+			for (uint32_t v = 0; v < vertices.size(); v++)
+			{
+				queueBest(v);
+			}
+
+			uint32_t kept = liveTriangles;
+			double   maxCost = 0.0;
+			while (chain.count < MAX_SCENE_LODS)
+			{
+				uint32_t const target = kept / 2;
+				while (liveTriangles > target && !queue.empty())
+				{
+					Collapse const collapse = queue.top();
+					queue.pop();
+					if (collapse.version != version[collapse.from] || !apply(collapse))
+					{
+						continue;
+					}
+					maxCost = std::max(maxCost, collapse.cost);
+				}
+				if (liveTriangles > kept * MAX_KEPT || liveTriangles == 0)
+				{
+					break;
+				}
+				SceneLod& level = chain.levels[chain.count++];
+				level.firstIndex = static_cast<uint32_t>(lodIndices.size());
+				level.error = static_cast<float>(std::sqrt(maxCost));
+				for (uint32_t t = 0; t < removedTriangle.size(); t++)
+				{
+					if (!removedTriangle[t])
+					{
+						lodIndices.insert(lodIndices.end(), triangles.begin() + 3 * t, triangles.begin() + 3 * t + 3);
+					}
+				}
+				level.indexCount = static_cast<uint32_t>(lodIndices.size()) - level.firstIndex;
+				kept = liveTriangles;
+			}
+		}
+
+	private:
+		std::span<SceneVertex const>                                             vertices;
+		std::vector<uint32_t>                                                    triangles; // rewritten as vertices collapse
+		std::vector<uint32_t>                                                    position;  // by vertex
+		std::vector<bool>                                                        locked;    // by position
+		std::vector<Quadric>                                                     quadrics;  // by position
+		std::vector<std::vector<uint32_t>>                                       vertexTriangles; // may list removed triangles
+		std::vector<bool>                                                        removedTriangle;
+		std::vector<uint32_t>                                                    version;   // by vertex, bumped when its neighbourhood changes
+		std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> queue;
+		uint32_t                                                                 liveTriangles = 0;
+
+		// Bit patterns, so only exactly equal positions are merged.
+		using PositionKey = std::array<uint32_t, 3>;
+
+		struct PositionHash
+		{
+			size_t operator()(PositionKey const& key) const
+			{
+				uint64_t hash = 0xcbf29ce484222325ull;
+				for (uint32_t const word : key)
+				{
+					hash = (hash ^ word) * 0x100000001b3ull;
+					hash ^= hash >> 32;
+				}
+				return static_cast<size_t>(hash);
+			}
+		};
+
+		// Unnormalized normal of triangle t, with vertex `from` moved onto vertex `to` when from is one of its corners.
+		[[nodiscard]] std::array<double, 3> normal(uint32_t t, uint32_t from, uint32_t to) const
+		{
+			std::array<std::array<double, 3>, 3> p;
+			for (uint32_t corner = 0; corner < 3; corner++)
+			{
+				uint32_t const v = triangles[3 * t + corner] == from ? to : triangles[3 * t + corner];
+				p[corner] = { vertices[v].position[0], vertices[v].position[1], vertices[v].position[2] };
+			}
+			std::array<double, 3> const ab = { p[1][0] - p[0][0], p[1][1] - p[0][1], p[1][2] - p[0][2] };
+			std::array<double, 3> const ac = { p[2][0] - p[0][0], p[2][1] - p[0][1], p[2][2] - p[0][2] };
+			return { ab[1] * ac[2] - ab[2] * ac[1], ab[2] * ac[0] - ab[0] * ac[2], ab[0] * ac[1] - ab[1] * ac[0] };
+		}
+
+		[[nodiscard]] bool hasCorner(uint32_t t, uint32_t v) const
+		{
+			return triangles[3 * t] == v || triangles[3 * t + 1] == v || triangles[3 * t + 2] == v;
+		}
+
+		// Queues the cheapest collapse of v onto one of its neighbours.
+		void queueBest(uint32_t v)
+		{
+			if (locked[position[v]])
+			{
+				return;
+			}
+			Collapse best{ .cost = std::numeric_limits<double>::max(), .from = v, .to = v, .version = version[v] };
+			for (uint32_t const t : vertexTriangles[v])
+			{
+				if (removedTriangle[t])
+				{
+					continue;
+				}
+				for (uint32_t corner = 0; corner < 3; corner++)
+				{
+					uint32_t const to = triangles[3 * t + corner];
+					if (position[to] == position[v])
+					{
+						continue;
+					}
+					Quadric combined = quadrics[position[v]];
+					combined += quadrics[position[to]];
+					double const cost = std::max(0.0, combined.evaluate(vertices[to].position));
+					if (cost < best.cost)
+					{
+						best.cost = cost;
+						best.to = to;
+					}
+				}
+			}
+			if (best.to != v)
+			{
+				queue.push(best);
+			}
+		}
+
+		// Moves collapse.from onto collapse.to unless that folds a triangle over.
+		bool apply(Collapse const& collapse)
+		{
+			uint32_t const from = collapse.from;
+			uint32_t const to = collapse.to;
+			for (uint32_t const t : vertexTriangles[from])
+			{
+				if (removedTriangle[t] || hasCorner(t, to))
+				{
+					continue;
+				}
+				std::array<double, 3> const before = normal(t, ~0u, 0);
+				std::array<double, 3> const after = normal(t, from, to);
+				if (before[0] * after[0] + before[1] * after[1] + before[2] * after[2] <= 0.0)
+				{
+					return false;
+				}
+			}
+
+			quadrics[position[to]] += quadrics[position[from]];
+			for (uint32_t const t : vertexTriangles[from])
+			{
+				if (removedTriangle[t])
+				{
+					continue;
+				}
+				for (uint32_t corner = 0; corner < 3; corner++)
+				{
+					if (triangles[3 * t + corner] == from)
+					{
+						triangles[3 * t + corner] = to;
+					}
+				}
+				uint32_t const a = position[triangles[3 * t]], b = position[triangles[3 * t + 1]], c = position[triangles[3 * t + 2]];
+				if (a == b || b == c || a == c)
+				{
+					removedTriangle[t] = true;
+					liveTriangles--;
+				}
+				else
+				{
+					vertexTriangles[to].push_back(t);
+				}
+			}
+			vertexTriangles[from].clear();
+			version[from]++;
+
+			// the cost of every collapse around `to` changed
+			std::vector<uint32_t> neighbours = { to };
+			for (uint32_t const t : vertexTriangles[to])
+			{
+				if (!removedTriangle[t])
+				{
+					neighbours.insert(neighbours.end(), triangles.begin() + 3 * t, triangles.begin() + 3 * t + 3);
+				}
+			}
+			std::ranges::sort(neighbours);
+			neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+			for (uint32_t const v : neighbours)
+			{
+				version[v]++;
+				queueBest(v);
+			}
+			return true;
+		}
+	};
+};
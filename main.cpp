@@ -5,20 +5,61 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
+// tinyobjloader and stb_image are header-only; this translation unit compiles their implementations
+#define TINYOBJLOADER_IMPLEMENTATION
+#define STB_IMAGE_IMPLEMENTATION
+#include "async_compute.hpp"
+#include "bindless_heap.hpp"
+#include "camera.hpp"
+#include "command_recorder.hpp"
+#include "frame_arena.hpp"
+#include "frame_pacer.hpp"
+#include "gpu_allocator.hpp"
+#include "gpu_culler.hpp"
+#include "gpu_profiler.hpp"
+#include "lod_builder.hpp"
+#include "mesh_cache.hpp"
+#include "meshlet_builder.hpp"
+#include "pipeline_cache.hpp"
+#include "pipeline_manager.hpp"
+#include "pipeline_variants.hpp"
+#include "present_control.hpp"
+#include "render_graph.hpp"
+#include "scene_graph.hpp"
+#include "scene_loader.hpp"
+#include "shader_reloader.hpp"
+#include "shadow_tracer.hpp"
+#include "texture_streamer.hpp"
+#include "thread_pool.hpp"
+#include "uniform_ring.hpp"
+#include "upload_manager.hpp"
+
 #include <algorithm>
+#include <array>
 #include <assert.h>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
 #include <cstdlib>
 #include <cstring>
+#include <deque>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <limits>
 #include <memory>
+#include <new>
+#include <optional>
+#include <span>
 #include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
 #include <vector>
 
 constexpr uint32_t WIDTH = 800;
 constexpr uint32_t HEIGHT = 600;
-constexpr int      MAX_FRAMES_IN_FLIGHT = 2;
 
 const std::vector<char const*> validationLayers = {
 	"VK_LAYER_KHRONOS_validation" };
@@ -29,18 +70,246 @@ constexpr bool enableValidationLayers = false;
 constexpr bool enableValidationLayers = true;
 #endif
 
+// set by CMakeLists.txt to the slangc that compiles the shaders at build time
+#ifndef RSTD_SLANGC
+#	define RSTD_SLANGC ""
+#endif
+
+// Every heap allocation goes through here to be counted per thread (see FrameArenas). The array and nothrow
+// forms forward to this one; over-aligned allocations are not counted.
+void* operator new(std::size_t size)
+{
+	HeapAllocationCounter::count++;
+	if (void* const memory = std::malloc(size == 0 ? 1 : size))
+	{
+		return memory;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+	std::free(memory);
+}
+
+// Describes SceneVertex, the format every scene is converted to on load, to the vertex input stage.
+struct VertexLayout
+{
+	static vk::VertexInputBindingDescription getBindingDescription()
+	{
+		return { .binding = 0, .stride = sizeof(SceneVertex), .inputRate = vk::VertexInputRate::eVertex };
+	}
+
+	static std::vector<vk::VertexInputAttributeDescription> getAttributeDescriptions()
+	{
+		return {
+			{.location = 0, .binding = 0, .format = vk::Format::eR32G32B32Sfloat, .offset = offsetof(SceneVertex, position)},
+			{.location = 1, .binding = 0, .format = vk::Format::eR32G32B32Sfloat, .offset = offsetof(SceneVertex, normal)},
+			{.location = 2, .binding = 0, .format = vk::Format::eR32G32Sfloat, .offset = offsetof(SceneVertex, uv)} };
+	}
+};
+
+// The scene drawn when no --scene is given, y-up and counter-clockwise like every other scene. The shader colors
+// by |normal|, so the axis-aligned normals keep the classic red, green and blue corners.
+const std::vector<SceneVertex> triangleVertices = {
+	{{0.0f, 0.5f, 0.0f}, {1.0f, 0.0f, 0.0f}, {0.5f, 0.0f}},
+	{{0.5f, -0.5f, 0.0f}, {0.0f, 1.0f, 0.0f}, {1.0f, 1.0f}},
+	{{-0.5f, -0.5f, 0.0f}, {0.0f, 0.0f, 1.0f}, {0.0f, 1.0f}} };
+
+const std::vector<uint32_t> triangleIndices = {
+	0, 2, 1 };
+
+// This frame's camera and transforms, written into the uniform ring (FrameUniforms in shaders/scene_data.slang).
+struct FrameUniforms
+{
+	glm::mat4         viewProjection = glm::mat4(1.0f);
+	glm::vec4         cameraPosition = glm::vec4(0.0f);
+	GpuTransformTable transforms;
+	vk::DeviceAddress textureFeedback = 0; // this frame's TextureStreamer feedback
+};
+static_assert(sizeof(FrameUniforms) == 104);
+
+// Vertex and fragment stage push constants; objects is the device address of the GpuObject array indexed by
+// instance, frame the address of this frame's FrameUniforms.
+struct DrawConstants
+{
+	vk::DeviceAddress frame = 0;
+	vk::DeviceAddress objects = 0;
+	BindlessHandle    materials = INVALID_BINDLESS_HANDLE; // the material table, read by the fragment shader
+	BindlessHandle    textures = INVALID_BINDLESS_HANDLE;  // the streamed texture table
+};
+
+// A swapchain replaced by recreateSwapChain(), kept with its views and present semaphores until the frames
+// submitted before the replacement, the last that could use them, have finished.
+struct RetiredSwapChain
+{
+	vk::raii::SwapchainKHR           swapChain = nullptr;
+	std::vector<vk::raii::ImageView> imageViews;
+	std::vector<vk::raii::Semaphore> renderFinishedSemaphores;
+	uint64_t                         retireValue = 0; // frame timeline value
+};
+
+struct SwapChainRecreateStats
+{
+	uint32_t recreations = 0;
+	double   recreateMsTotal = 0.0; // the CPU time recreateSwapChain() took
+	double   maxRecreateMs = 0.0;
+	uint32_t hitches = 0;
+	double   hitchMsTotal = 0.0; // from deciding to recreate until the first image of the new swapchain was presented
+	double   maxHitchMs = 0.0;
+};
+
+// the render graph's transient depth attachment; both graphics pipelines test and write it
+constexpr vk::Format DEPTH_FORMAT = vk::Format::eD32Sfloat;
+
+// towards the directional light the shadow rays are traced to, world space; normalized by ShadowTracer
+constexpr std::array<float, 3> SHADOW_LIGHT_DIRECTION = { 0.4f, 1.0f, 0.3f };
+
+// An object switches to a coarser LOD once that level's error projects to less than LOD_PIXEL_ERROR pixels times
+// LOD_HYSTERESIS, and back to a finer one once its own error exceeds LOD_PIXEL_ERROR, so objects near the
+// switching distance do not pop back and forth every frame. The GPU-driven paths keep each object's LOD in a
+// buffer and apply the same rule (selectLod() in shaders/scene_data.slang, which holds a copy of both).
+constexpr float LOD_PIXEL_ERROR = 1.0f;
+constexpr float LOD_HYSTERESIS = 0.75f;
+
+constexpr vk::ShaderStageFlags DRAW_CONSTANT_STAGES = vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment;
+
+// One entry of the material table, a bindless storage buffer indexed by GpuObject::material (shaders/bindless.slang).
+struct GpuMaterial
+{
+	std::array<float, 4>    baseColorFactor = { 1.0f, 1.0f, 1.0f, 1.0f };
+	uint32_t                baseColorTexture = SCENE_NONE; // TextureStreamer id, which is the scene's texture index
+	BindlessHandle          baseColorSampler = INVALID_BINDLESS_HANDLE;
+	float                   alphaCutoff = 0.0f; // less alpha is discarded by the alpha test variants
+	uint32_t                features = 0;       // shaderFeatureBit()s the material needs
+};
+static_assert(sizeof(GpuMaterial) == 32);
+
+// Both scene pipelines draw solid, back-face culled, counter-clockwise triangles, and specialize the material
+// shading on the features below (shaders/features.slang).
+using ScenePipelineState = StaticPipelineState<vk::PrimitiveTopology::eTriangleList, vk::CullModeFlagBits::eBack, vk::FrontFace::eCounterClockwise>;
+using SceneShaderFeatures = ShaderFeatureSet<ShaderFeature::eAlphaTest, ShaderFeature::eVertexColor>;
+using ScenePipelines = std::array<vk::Pipeline, SceneShaderFeatures::VARIANT_COUNT>; // per variant, null if not in use
+
+// A pipeline family that hot shader reload can rebuild while frames are in flight. The rebuild compiles in the
+// background and replaces the family's variants once ready; until then the pending shader module has to stay alive.
+struct HotPipeline
+{
+	vk::raii::ShaderModule    shaderModule = nullptr;
+	PipelineFamily            family;
+	vk::raii::ShaderModule    pendingShaderModule = nullptr;
+	bool                      stale = false; // reloaded again while the pending build was running
+	ShaderReloader::ProgramId program = ShaderReloader::INVALID_PROGRAM;
+};
+
+struct DrawItem
+{
+	uint32_t indexCount = 0;
+	uint32_t firstIndex = 0;
+	int32_t  vertexOffset = 0;
+	uint32_t firstInstance = 0;
+	uint32_t variant = 0;   // of SceneShaderFeatures, from the material
+	uint32_t sceneDraw = 0; // index into sceneDraws and sceneLods
+	uint32_t lod = 0;       // level drawn, 0 for the draw itself
+};
+
+// Which path traces the shadow rays (ShadowTracer::Mode), chosen with --shadows.
+enum class ShadowMode
+{
+	eAuto,     // ray queries where the device has them, the compute BVH elsewhere
+	eRayQuery, // falls back to the compute BVH without VK_KHR_ray_query
+	eBvh,
+	eOff,
+};
+
+// How the headless benchmark loop moves the camera. The path depends on the frame number only, never on the
+// clock, so every run renders the same frames.
+enum class CameraPath
+{
+	eFixed,
+	eOrbit,    // around the original copy of the scene
+	eOrbitAll, // around all --draws copies
+};
+
+struct AppConfig
+{
+	// Render into offscreen images without a window, surface or swapchain.
+	bool     headless = false;
+	// Number of frames drawn by the headless benchmark loop.
+	uint32_t frameCount = 1000;
+	// Record GPU timestamp queries around every pass and report per-scope timings.
+	bool     profileGpu = false;
+	// Driver pipeline cache blob, loaded at startup and written back at shutdown. Empty disables it.
+	std::string pipelineCachePath = "pipeline_cache.bin";
+	// Number of copies of the scene, laid out on a grid around the original, to load the draw submission path.
+	uint32_t    drawCount = 1;
+	// Cull meshlets and build the draw list on the GPU when the device supports drawIndexedIndirectCount.
+	bool        gpuCulling = true;
+	// Let the task shader cull meshlets and mesh shaders draw them when VK_EXT_mesh_shader is available.
+	bool        meshShaders = true;
+	// Threads recording secondary command buffers; 1 records everything into the primary buffer.
+	uint32_t    recordThreads = std::max(1u, std::thread::hardware_concurrency());
+	// glTF (.gltf/.glb) or OBJ file to draw instead of the built-in triangle.
+	std::string         scenePath;
+	SceneImportSettings importSettings;
+	// Directory of baked scenes (see rstd_bake), filled on first load. Empty disables it.
+	std::string         meshCacheDir = "mesh_cache";
+	// Frames the CPU may run ahead of the GPU. More hides CPU/GPU jitter, fewer cuts input latency.
+	uint32_t    framesInFlight = 2;
+	// Device memory and per-frame upload limits of texture streaming.
+	TextureStreamerSettings textureSettings;
+	// slangc that recompiles edited shaders while the window is open. Empty disables hot reload.
+	std::string shaderCompiler = RSTD_SLANGC;
+	// Fail when a frame past the warm-up allocates from the heap on the render thread.
+	bool        checkFrameAllocations = false;
+	// Present mode, frame rate cap and present queue depth of the window.
+	PresentSettings presentSettings;
+	// Draw distant objects with their simplified LODs, picked on the CPU or by the GPU-driven paths' shaders.
+	bool        lodEnabled = true;
+	// Threads updating the scene graph's world transforms.
+	uint32_t    sceneGraphThreads = std::max(1u, std::thread::hardware_concurrency());
+	// Run the GPU culling dispatch on a compute queue of its own, overlapping the previous frame's rendering.
+	bool        asyncCompute = true;
+	// How the shadow rays of the directional light are traced, if at all.
+	ShadowMode  shadows = ShadowMode::eAuto;
+	// Camera movement of the headless benchmark loop.
+	CameraPath  cameraPath = CameraPath::eFixed;
+	// JSON file the headless benchmark loop writes its results to (see tools/rstd_bench). Empty disables it.
+	std::string benchmarkJsonPath;
+	// Take the first suitable device whose name contains this, e.g. "llvmpipe" for lavapipe. Empty takes any.
+	std::string deviceName;
+};
+
 class HelloTriangleApplication
 {
 public:
+	explicit HelloTriangleApplication(AppConfig const& config) : config(config) {}
+
 	void run()
 	{
-		initWindow();
+		if (!config.headless)
+		{
+			initWindow();
+		}
 		initVulkan();
-		mainLoop();
+		if (config.headless)
+		{
+			benchmarkLoop();
+		}
+		else
+		{
+			mainLoop();
+		}
 		cleanup();
 	}
 
 private:
+	AppConfig   config;
 	GLFWwindow* window = nullptr;
 	vk::raii::Context                context;
 	vk::raii::Instance               instance = nullptr;
@@ -50,24 +319,105 @@ private:
 	vk::raii::Device                 device = nullptr;
 	uint32_t                         queueIndex = ~0;
 	vk::raii::Queue                  queue = nullptr;
+	uint32_t                         transferQueueIndex = ~0;
+	vk::raii::Queue                  transferQueue = nullptr; // same queue as `queue` when there is no separate transfer family
+	uint32_t                         computeQueueIndex = ~0;  // ~0 without an async compute queue
+	vk::raii::Queue                  computeQueue = nullptr;  // may be `transferQueue` when the transfer family is the compute one
+	std::vector<uint32_t>            sharedQueueFamilies;     // families of the buffers both queues use, when they differ
 	vk::raii::SwapchainKHR           swapChain = nullptr;
 	std::vector<vk::Image>           swapChainImages;
 	vk::SurfaceFormatKHR             swapChainSurfaceFormat;
 	vk::Extent2D                     swapChainExtent;
 	std::vector<vk::raii::ImageView> swapChainImageViews;
-
-	vk::raii::PipelineLayout pipelineLayout = nullptr;
-	vk::raii::Pipeline       graphicsPipeline = nullptr;
+	std::deque<RetiredSwapChain>     retiredSwapChains; // in retire order
+	bool                             swapChainSuspended = false; // minimized: no swapchain can be created until the window has a size again
+	SwapChainRecreateStats           recreateStats;
+	PresentControl                   presentControl;
+
+	std::optional<std::chrono::steady_clock::time_point> recreateStart; // of a recreation whose first present is still to come
+
+	GpuAllocator  allocator;
+	UploadManager uploads;
+	BindlessHeap  bindlessHeap;
+
+	// every draw picks its material by index; material 0 is the default, the scene's materials follow
+	vk::raii::Sampler        defaultSampler = nullptr;
+	BindlessHandle           defaultSamplerHandle = INVALID_BINDLESS_HANDLE;
+	std::vector<GpuMaterial> materials;
+	GpuBuffer                materialBuffer;
+
+	// headless mode renders into these instead of swapchain images; swapChainImages holds their handles
+	std::vector<GpuImage> offscreenImages;
+
+	ThreadPool                threadPool;
+	PersistentPipelineCache   pipelineCache;
+	vk::raii::PipelineLayout  pipelineLayout = nullptr;
+	vk::raii::PipelineLayout  meshletPipelineLayout = nullptr;
+	HotPipeline               trianglePipeline; // its shader modules outlive the builds pipelineManager has in flight
+	HotPipeline               meshletPipeline;
+	PipelineManager           pipelineManager;
+	ShaderReloader            shaderReloader; // compiles on threadPool
+	ShaderReloader::ProgramId cullProgram = ShaderReloader::INVALID_PROGRAM;
+	TextureStreamer           textureStreamer; // decodes on threadPool, so it is destroyed first
+
+	GpuBuffer                     vertexBuffer;
+	GpuBuffer                     indexBuffer; // in meshlet order, followed by the LOD levels
+	GpuBuffer                     lodBuffer;   // GpuLodChain per scene draw, for the GPU-driven paths
+	GpuBuffer                     meshletBuffer;
+	GpuBuffer                     meshletVertexBuffer;
+	GpuBuffer                     meshletTriangleBuffer;
+	GpuBuffer                     bvhNodeBuffer; // SceneBvh of the compute BVH shadow path
+	GpuBuffer                     bvhTriangleBuffer;
+	GpuBuffer                     bvhMeshBuffer;
+	double                        bvhBuildMs = 0.0;
+	std::vector<SceneDraw>        sceneDraws;
+	std::vector<MeshletRange>     sceneMeshlets; // per scene draw
+	std::vector<SceneLodChain>    sceneLods;     // per scene draw, firstIndex into indexBuffer
+	std::array<float, 3>          sceneBoundsMin = {};
+	std::array<float, 3>          sceneBoundsMax = {};
+	std::array<float, 3>          drawBoundsMin = {}; // of the grid holding every copy of the scene
+	std::array<float, 3>          drawBoundsMax = {};
+	Camera                        camera;
+	DrawConstants                 drawConstants;
+	SceneGraph                    sceneGraph;  // a root per scene copy with a node per object below it
+	std::vector<SceneGraph::Node> objectNodes; // by object index
+	UniformRing                   uniformRing; // camera, transforms and culling inputs, per frame in flight
 
 	vk::raii::CommandPool                commandPool = nullptr;
 	std::vector<vk::raii::CommandBuffer> commandBuffers;
+	ParallelCommandRecorder              recorder;
+	std::vector<DrawItem>                drawList;      // sorted by variant, so the CPU path switches pipelines rarely
+	std::vector<uint32_t>                variantEnds;   // drawList index past each run of one variant
+	uint32_t                             sceneFeatures = 0; // every feature some material needs; the GPU-driven paths draw with all of them
+	GpuBuffer                            objectBuffer; // one GpuObject per drawList entry
+	GpuBuffer                            clusterGroupBuffer;
+	GpuCuller                            gpuCuller;
+	ShadowTracer                         shadowTracer; // enabled unless --shadows off
+	vk::raii::ShaderModule               shadowCompositeModule = nullptr;
+	PipelineManager::Key                 shadowCompositePipeline = 0;
+	RenderGraph                          renderGraph; // rebuilt every frame; owns the transient attachments
+	FrameArenas                          frameArenas; // per frame in flight, for the frame's CPU-side transients
+	bool                                 drawIndirectCountSupported = false;
+	bool                                 meshShaderSupported = false;
+	bool                                 memoryBudgetSupported = false;
+	bool                                 presentWaitSupported = false;
+	bool                                 rayQuerySupported = false;
+	double                               recordMsTotal = 0.0;
+	uint64_t                             recordedFrames = 0;
+	uint64_t                             lodTrianglesTotal = 0;  // submitted by the CPU draw path
+	uint64_t                             baseTrianglesTotal = 0; // it would have submitted without LODs
+	uint64_t                             lodFrames = 0;
 
 	std::vector<vk::raii::Semaphore> presentCompleteSemaphores;
 	std::vector<vk::raii::Semaphore> renderFinishedSemaphores;
-	std::vector<vk::raii::Fence>     inFlightFences;
+	FramePacer                       framePacer;
+	AsyncComputeQueue                asyncCompute; // culls when computeQueueIndex is set
 	uint32_t                         frameIndex = 0;
 
+	GpuProfiler gpuProfiler;
+
 	bool framebufferResized = false;
+	bool presentModeCycleRequested = false; // P cycles through the supported present modes
 
 	std::vector<const char*> requiredDeviceExtension = {
 		vk::KHRSwapchainExtensionName,
@@ -85,6 +435,7 @@ private:
 		window = glfwCreateWindow(WIDTH, HEIGHT, "Vulkan", nullptr, nullptr);
 		glfwSetWindowUserPointer(window, this);
 		glfwSetFramebufferSizeCallback(window, framebufferResizeCallback);
+		glfwSetKeyCallback(window, keyCallback);
 	}
 
 	static void framebufferResizeCallback(GLFWwindow* window, int width, int height)
@@ -93,60 +444,419 @@ private:
 		app->framebufferResized = true;
 	}
 
+	static void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods)
+	{
+		auto app = reinterpret_cast<HelloTriangleApplication*>(glfwGetWindowUserPointer(window));
+		if (key == GLFW_KEY_P && action == GLFW_PRESS)
+		{
+			app->presentModeCycleRequested = true;
+		}
+	}
+
 	void initVulkan()
 	{
+		if (config.headless)
+		{
+			// no surface to present to, so neither the swapchain extension nor a present-capable queue is needed
+			std::erase_if(requiredDeviceExtension, [](char const* extension) { return strcmp(extension, vk::KHRSwapchainExtensionName) == 0; });
+		}
+
 		createInstance();
 		setupDebugMessenger();
-		createSurface();
+		if (!config.headless)
+		{
+			createSurface();
+		}
 		pickPhysicalDevice();
 		createLogicalDevice();
-		createSwapChain();
+		presentControl.init(config.presentSettings, presentWaitSupported);
+		allocator.init(device, physicalDevice);
+		renderGraph.init(device, allocator);
+		uploads.init(device, physicalDevice, allocator, transferQueue, transferQueueIndex, queueIndex);
+		bindlessHeap.init(device, physicalDevice);
+		if (config.headless)
+		{
+			createOffscreenTargets();
+		}
+		else
+		{
+			createSwapChain();
+		}
 		createImageViews();
+		createPipelineCache();
 		createGraphicsPipeline();
+		config.textureSettings.memoryBudgetSupported = memoryBudgetSupported;
+		textureStreamer.init(device, physicalDevice, allocator, bindlessHeap, threadPool, config.framesInFlight, config.textureSettings);
+		loadScene();
 		createCommandPool();
 		createCommandBuffers();
+		createDrawList();
+		createUniformRing();
 		createSyncObjects();
+		if (config.profileGpu)
+		{
+			gpuProfiler.init(device, physicalDevice, queueIndex, config.framesInFlight);
+		}
+		if (!config.headless && !config.shaderCompiler.empty())
+		{
+			createShaderReloader();
+		}
 	}
 
 	void mainLoop()
 	{
 		while (!glfwWindowShouldClose(window))
 		{
+			if (swapChainSuspended)
+			{
+				// minimized: sleep until the window changes instead of drawing into an out-of-date swapchain
+				glfwWaitEvents();
+				recreateSwapChain();
+				continue;
+			}
+			// the limiter sleeps before the input is read, so the frame starts with the freshest input
+			presentControl.limitFrameRate();
 			glfwPollEvents();
+			if (presentModeCycleRequested)
+			{
+				presentModeCycleRequested = false;
+				presentControl.cycleMode(physicalDevice.getSurfacePresentModesKHR(*surface));
+				recreateSwapChain();
+			}
 			drawFrame();
 		}
 
 		device.waitIdle();
+		resolvePendingFrames();
+		gpuProfiler.report(std::cout);
+		gpuCuller.report(std::cout);
+		if (computeQueueIndex != ~0)
+		{
+			asyncCompute.report(std::cout);
+		}
+		shadowTracer.report(std::cout);
+		sceneGraph.report(std::cout);
+		renderGraph.report(std::cout);
+		bindlessHeap.report(std::cout);
+		textureStreamer.report(std::cout);
+		pipelineManager.report(std::cout);
+		trianglePipeline.family.report(std::cout, "triangle");
+		if (meshShaderSupported)
+		{
+			meshletPipeline.family.report(std::cout, "meshlet");
+		}
+		shaderReloader.report(std::cout);
+		allocator.report(std::cout);
+		uniformRing.report(std::cout);
+		uploads.reclaim();
+		uploads.report(std::cout);
+		framePacer.report(std::cout);
+		presentControl.report(std::cout);
+		reportSwapChainRecreations();
+		frameArenas.report(std::cout);
+		reportLods();
+		checkFrameAllocations();
+	}
+
+	void benchmarkLoop()
+	{
+		std::vector<double> frameTimes;
+		frameTimes.reserve(config.frameCount);
+
+		Camera const pathStart = config.cameraPath == CameraPath::eOrbitAll ? Camera::framing(drawBoundsMin, drawBoundsMax) : camera;
+		auto const   benchmarkStart = std::chrono::steady_clock::now();
+		for (uint32_t frame = 0; frame < config.frameCount; frame++)
+		{
+			if (config.cameraPath != CameraPath::eFixed)
+			{
+				// one revolution over the run, from above so a grid of copies does not hide behind its front row
+				camera = pathStart.orbiting(static_cast<float>(frame) / static_cast<float>(config.frameCount), glm::radians(30.0f));
+			}
+			presentControl.limitFrameRate();
+			auto const frameStart = std::chrono::steady_clock::now();
+			drawFrame();
+			frameTimes.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count());
+		}
+		device.waitIdle();
+		double const totalSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - benchmarkStart).count();
+
+		reportFrameTimes(frameTimes, totalSeconds);
+		reportRecordTimes();
+		resolvePendingFrames();
+		reportLods();
+		gpuProfiler.report(std::cout);
+		gpuCuller.report(std::cout);
+		if (computeQueueIndex != ~0)
+		{
+			asyncCompute.report(std::cout);
+		}
+		shadowTracer.report(std::cout);
+		sceneGraph.report(std::cout);
+		renderGraph.report(std::cout);
+		bindlessHeap.report(std::cout);
+		textureStreamer.report(std::cout);
+		pipelineManager.report(std::cout);
+		trianglePipeline.family.report(std::cout, "triangle");
+		if (meshShaderSupported)
+		{
+			meshletPipeline.family.report(std::cout, "meshlet");
+		}
+		shaderReloader.report(std::cout);
+		allocator.report(std::cout);
+		uniformRing.report(std::cout);
+		uploads.reclaim();
+		uploads.report(std::cout);
+		framePacer.report(std::cout);
+		presentControl.report(std::cout);
+		frameArenas.report(std::cout);
+		if (!config.benchmarkJsonPath.empty())
+		{
+			writeBenchmarkJson(frameTimes, totalSeconds);
+		}
+		checkFrameAllocations();
 	}
 
-	void cleanupSwapChain()
+	// The benchmark loop's results, for tools/rstd_bench to collect and compare against a baseline. Call after
+	// resolvePendingFrames(), so the GPU pass timings include the last frames.
+	void writeBenchmarkJson(std::vector<double> frameTimes, double totalSeconds) const
 	{
-		swapChainImageViews.clear();
-		swapChain = nullptr;
+		nlohmann::json result;
+		result["device"] = std::string(physicalDevice.getProperties().deviceName.data());
+		result["drawPath"] = !gpuCuller.enabled() ? "cpu" : gpuCuller.getMode() == GpuCuller::Mode::eMeshShader ? "mesh shader" : "indirect";
+		result["draws"] = drawList.size();
+		result["frames"] = frameTimes.size();
+		result["fps"] = static_cast<double>(frameTimes.size()) / totalSeconds;
+
+		// --frames 0 still writes a complete file
+		if (frameTimes.empty())
+		{
+			frameTimes.push_back(0.0);
+		}
+		std::ranges::sort(frameTimes);
+		double sum = 0.0;
+		for (double frameTime : frameTimes)
+		{
+			sum += frameTime;
+		}
+		size_t const frames = frameTimes.size();
+		result["cpuFrameMs"] = { { "min", frameTimes.front() },
+								 { "avg", sum / static_cast<double>(frames) },
+								 { "median", frameTimes[frames / 2] },
+								 { "p99", frameTimes[std::min(frames - 1, frames * 99 / 100)] },
+								 { "max", frameTimes.back() } };
+
+		nlohmann::json& gpuPasses = result["gpuPassMs"] = nlohmann::json::object();
+		for (std::string const& name : gpuProfiler.scopeNames())
+		{
+			if (std::optional<GpuScopeStats> const stats = gpuProfiler.stats(name))
+			{
+				gpuPasses[name] = { { "min", stats->minMs }, { "avg", stats->avgMs }, { "p99", stats->p99Ms }, { "samples", stats->samples } };
+			}
+		}
+
+		if (shadowTracer.enabled())
+		{
+			ShadowTracerStats const& shadowStats = shadowTracer.getStats();
+			result["shadows"] = { { "mode", shadowTracer.getMode() == ShadowTracer::Mode::eRayQuery ? "ray query" : "compute bvh" },
+								  { "buildMs", shadowStats.buildMs },
+								  { "raysPerFrame", shadowStats.frames ? static_cast<double>(shadowStats.raysTotal) / static_cast<double>(shadowStats.frames) : 0.0 },
+								  { "raysPerSecond", shadowStats.raysPerSecond() } };
+		}
+
+		std::optional<std::pair<double, double>> const lodTriangles = avgLodTriangles();
+		result["triangles"] = { { "lod", config.lodEnabled },
+								{ "submitted", lodTriangles ? lodTriangles->first : 0.0 },
+								{ "withoutLod", lodTriangles ? lodTriangles->second : 0.0 } };
+
+		FrameArenaStats const& arenaStats = frameArenas.getStats();
+		result["heapAllocations"] = { { "renderThread", arenaStats.heapAllocations },
+									  { "maxPerFrame", arenaStats.maxFrameHeapAllocations },
+									  { "steadyFrames", arenaStats.steadyFrames },
+									  { "allocatingSteadyFrames", arenaStats.allocatingSteadyFrames } };
+
+		GpuAllocatorStats const    memory = allocator.stats();
+		TextureStreamerStats const textures = textureStreamer.getStats();
+		result["memory"] = { { "deviceMemoryBlocks", memory.deviceMemoryCount },
+							 { "deviceReservedBytes", memory.reservedBytes },
+							 { "deviceUsedBytes", memory.usedBytes },
+							 { "textureResidentBytes", textures.residentBytes },
+							 { "texturePeakBytes", textures.peakBytes },
+							 { "peakResidentSetBytes", peakResidentBytes() } };
+
+		std::ofstream file(config.benchmarkJsonPath);
+		if (!file)
+		{
+			throw std::runtime_error("failed to open " + config.benchmarkJsonPath + "!");
+		}
+		file << result.dump(2) << std::endl;
+	}
+
+	void reportRecordTimes() const
+	{
+		if (recordedFrames == 0)
+		{
+			return;
+		}
+		if (gpuCuller.enabled())
+		{
+			std::cout << "command recording: " << drawList.size() << " objects in one "
+					  << (gpuCuller.getMode() == GpuCuller::Mode::eMeshShader ? "mesh task" : "indirect") << " draw, avg "
+					  << recordMsTotal / static_cast<double>(recordedFrames) << " ms" << std::endl;
+			return;
+		}
+		std::cout << "command recording: " << drawList.size() << " draws, avg " << recordMsTotal / static_cast<double>(recordedFrames) << " ms on "
+				  << (drawList.size() >= ParallelCommandRecorder::MIN_DRAWS_PER_CHUNK ? recorder.threadCount() : 1) << " thread(s)" << std::endl;
+	}
+
+	void reportSwapChainRecreations() const
+	{
+		if (recreateStats.recreations == 0)
+		{
+			return;
+		}
+		std::cout << "swapchain recreation: " << recreateStats.recreations << " times, avg " << recreateStats.recreateMsTotal / recreateStats.recreations << " max "
+				  << recreateStats.maxRecreateMs << " ms";
+		if (recreateStats.hitches != 0)
+		{
+			std::cout << ", until the first new present avg " << recreateStats.hitchMsTotal / recreateStats.hitches << " max " << recreateStats.maxHitchMs << " ms";
+		}
+		std::cout << std::endl;
+	}
+
+	// Triangles submitted per frame and those the same draws would have submitted without LODs, averaged over the
+	// frames the active draw path counted: on the CPU by selectLods(), on the GPU by the cull or task shaders.
+	[[nodiscard]] std::optional<std::pair<double, double>> avgLodTriangles() const
+	{
+		GpuCullingStats const& gpuStats = gpuCuller.getStats();
+		bool const             gpuDriven = gpuCuller.enabled();
+		uint64_t const         frames = gpuDriven ? gpuStats.frames : lodFrames;
+		if (frames == 0)
+		{
+			return std::nullopt;
+		}
+		uint64_t const triangles = gpuDriven ? gpuStats.trianglesTotal : lodTrianglesTotal;
+		uint64_t const baseTriangles = gpuDriven ? gpuStats.baseTrianglesTotal : baseTrianglesTotal;
+		return std::pair{ static_cast<double>(triangles) / static_cast<double>(frames), static_cast<double>(baseTriangles) / static_cast<double>(frames) };
+	}
+
+	void reportLods() const
+	{
+		std::optional<std::pair<double, double>> const average = avgLodTriangles();
+		if (!average)
+		{
+			return;
+		}
+		auto const [triangles, baseTriangles] = *average;
+		std::cout << "lod: " << (config.lodEnabled ? "on" : "off") << ", avg " << triangles << " triangles submitted per frame, " << baseTriangles
+				  << " without LODs (" << (baseTriangles > 0.0 ? 100.0 * triangles / baseTriangles : 100.0) << "%)" << std::endl;
+	}
+
+	// Only valid once the device is idle: collects the timestamps and cull counts of the frames still pending in every slot.
+	void resolvePendingFrames()
+	{
+		for (uint32_t slot = 0; slot < config.framesInFlight; slot++)
+		{
+			gpuProfiler.resolve(slot);
+			gpuCuller.collect(slot);
+			shadowTracer.collect(slot);
+			textureStreamer.collect(slot);
+		}
+	}
+
+	static void reportFrameTimes(std::vector<double> frameTimes, double totalSeconds)
+	{
+		if (frameTimes.empty())
+		{
+			return;
+		}
+
+		std::ranges::sort(frameTimes);
+		double sum = 0.0;
+		for (double frameTime : frameTimes)
+		{
+			sum += frameTime;
+		}
+		size_t const p99Index = std::min(frameTimes.size() - 1, frameTimes.size() * 99 / 100);
+
+		std::cout << "frames: " << frameTimes.size() << "\n"
+				  << "fps: " << static_cast<double>(frameTimes.size()) / totalSeconds << "\n"
+				  << "cpu frame time (ms): min " << frameTimes.front()
+				  << " avg " << sum / static_cast<double>(frameTimes.size())
+				  << " p99 " << frameTimes[p99Index]
+				  << " max " << frameTimes.back() << std::endl;
 	}
 
 	void cleanup()
 	{
+		// let background pipeline builds land in the cache before it is written out
+		threadPool.waitIdle();
+		if (!config.pipelineCachePath.empty())
+		{
+			pipelineCache.save();
+		}
+
+		if (config.headless)
+		{
+			return;
+		}
+
 		glfwDestroyWindow(window);
 
 		glfwTerminate();
 	}
 
+	// Replaces the swapchain without waiting for the GPU: the old one is handed to the new one as oldSwapchain,
+	// so the presentation engine can move over without a gap, and retired with its views and semaphores until
+	// the frames already submitted are done with them. The render graph reallocates the attachments that depend
+	// on the extent on its own, the first time a frame asks for the new size. While the window is minimized
+	// there is no extent to create a swapchain for, so it is left out of date and drawing is suspended.
 	void recreateSwapChain()
 	{
 		int width = 0, height = 0;
 		glfwGetFramebufferSize(window, &width, &height);
-		while (width == 0 || height == 0)
+		swapChainSuspended = width == 0 || height == 0;
+		if (swapChainSuspended)
 		{
-			glfwGetFramebufferSize(window, &width, &height);
-			glfwWaitEvents();
+			// the time spent minimized is no hitch; the timer starts over with the recreation that follows it
+			recreateStart.reset();
+			return;
 		}
 
-		device.waitIdle();
+		auto const start = std::chrono::steady_clock::now();
+		if (!recreateStart)
+		{
+			recreateStart = start;
+		}
 
-		cleanupSwapChain();
-		createSwapChain();
+		RetiredSwapChain retired{ .swapChain = std::move(swapChain),
+								  .imageViews = std::move(swapChainImageViews),
+								  .renderFinishedSemaphores = std::move(renderFinishedSemaphores),
+								  .retireValue = framePacer.lastSubmittedValue() };
+		swapChainImageViews.clear();
+		renderFinishedSemaphores.clear();
+		createSwapChain(*retired.swapChain);
+		retiredSwapChains.push_back(std::move(retired));
 		createImageViews();
+		// the image count can change with the present mode, and there is a semaphore per image
+		for (size_t i = 0; i < swapChainImages.size(); i++)
+		{
+			renderFinishedSemaphores.emplace_back(device, vk::SemaphoreCreateInfo());
+		}
+		presentControl.swapchainRecreated();
+
+		double const recreateMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		recreateStats.recreations++;
+		recreateStats.recreateMsTotal += recreateMs;
+		recreateStats.maxRecreateMs = std::max(recreateStats.maxRecreateMs, recreateMs);
+	}
+
+	// Destroys the retired swapchains whose last frames have completed.
+	void releaseRetiredSwapChains(uint64_t completedValue)
+	{
+		while (!retiredSwapChains.empty() && retiredSwapChains.front().retireValue <= completedValue)
+		{
+			retiredSwapChains.pop_front();
+		}
 	}
 
 	void createInstance()
@@ -222,6 +932,14 @@ private:
 		surface = vk::raii::SurfaceKHR(instance, _surface);
 	}
 
+	// Descriptor indexing features BindlessHeap relies on: runtime-sized, partially bound, update-after-bind arrays.
+	static bool supportsBindless(vk::PhysicalDeviceVulkan12Features const& features)
+	{
+		return features.runtimeDescriptorArray && features.descriptorBindingPartiallyBound && features.descriptorBindingSampledImageUpdateAfterBind &&
+			features.descriptorBindingStorageBufferUpdateAfterBind && features.shaderSampledImageArrayNonUniformIndexing &&
+			features.shaderStorageBufferArrayNonUniformIndexing;
+	}
+
 	void pickPhysicalDevice()
 	{
 		std::vector<vk::raii::PhysicalDevice> devices = instance.enumeratePhysicalDevices();
@@ -247,18 +965,91 @@ private:
 
 				auto features = device.template getFeatures2<vk::PhysicalDeviceFeatures2,
 					vk::PhysicalDeviceVulkan11Features,
+					vk::PhysicalDeviceVulkan12Features,
 					vk::PhysicalDeviceVulkan13Features,
 					vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT>();
-				bool supportsRequiredFeatures = features.template get<vk::PhysicalDeviceVulkan11Features>().shaderDrawParameters &&
+				bool supportsRequiredFeatures = features.template get<vk::PhysicalDeviceFeatures2>().features.shaderInt64 &&
+					features.template get<vk::PhysicalDeviceVulkan11Features>().shaderDrawParameters &&
+					features.template get<vk::PhysicalDeviceVulkan12Features>().bufferDeviceAddress &&
+					features.template get<vk::PhysicalDeviceVulkan12Features>().timelineSemaphore &&
+					features.template get<vk::PhysicalDeviceVulkan12Features>().hostQueryReset &&
+					supportsBindless(features.template get<vk::PhysicalDeviceVulkan12Features>()) &&
 					features.template get<vk::PhysicalDeviceVulkan13Features>().synchronization2 &&
 					features.template get<vk::PhysicalDeviceVulkan13Features>().dynamicRendering &&
 					features.template get<vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT>().extendedDynamicState;
 
-				return supportsVulkan1_3 && supportsGraphics && supportsAllRequiredExtensions && supportsRequiredFeatures;
+				// e.g. to pick lavapipe over a GPU
+				bool const nameMatches =
+					config.deviceName.empty() || std::string_view(device.getProperties().deviceName.data()).find(config.deviceName) != std::string_view::npos;
+
+				return supportsVulkan1_3 && supportsGraphics && supportsAllRequiredExtensions && supportsRequiredFeatures && nameMatches;
 			});
 		if (devIter != devices.end())
 		{
 			physicalDevice = *devIter;
+
+			// optional: task/mesh shaders take over meshlet culling and drawing where available
+			auto const availableExtensions = physicalDevice.enumerateDeviceExtensionProperties();
+			bool const hasMeshShaderExtension = std::ranges::any_of(availableExtensions,
+				[](auto const& extension) { return strcmp(extension.extensionName, vk::EXTMeshShaderExtensionName) == 0; });
+			if (hasMeshShaderExtension && config.gpuCulling && config.meshShaders)
+			{
+				auto const meshFeatures = physicalDevice.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceMeshShaderFeaturesEXT>();
+				meshShaderSupported = meshFeatures.get<vk::PhysicalDeviceMeshShaderFeaturesEXT>().taskShader &&
+					meshFeatures.get<vk::PhysicalDeviceMeshShaderFeaturesEXT>().meshShader;
+			}
+			if (meshShaderSupported)
+			{
+				requiredDeviceExtension.push_back(vk::EXTMeshShaderExtensionName);
+			}
+
+			// optional: lets texture streaming stay within what the device-local heap has left
+			memoryBudgetSupported = std::ranges::any_of(availableExtensions,
+				[](auto const& extension) { return strcmp(extension.extensionName, vk::EXTMemoryBudgetExtensionName) == 0; });
+			if (memoryBudgetSupported)
+			{
+				requiredDeviceExtension.push_back(vk::EXTMemoryBudgetExtensionName);
+			}
+
+			// optional: present ids and waiting on them measure when frames reach the display, and bound the present queue
+			bool const hasPresentWaitExtensions = !config.headless &&
+				std::ranges::any_of(availableExtensions, [](auto const& extension) { return strcmp(extension.extensionName, vk::KHRPresentIdExtensionName) == 0; }) &&
+				std::ranges::any_of(availableExtensions, [](auto const& extension) { return strcmp(extension.extensionName, vk::KHRPresentWaitExtensionName) == 0; });
+			if (hasPresentWaitExtensions)
+			{
+				auto const presentFeatures = physicalDevice.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDevicePresentIdFeaturesKHR, vk::PhysicalDevicePresentWaitFeaturesKHR>();
+				presentWaitSupported = presentFeatures.get<vk::PhysicalDevicePresentIdFeaturesKHR>().presentId &&
+					presentFeatures.get<vk::PhysicalDevicePresentWaitFeaturesKHR>().presentWait;
+			}
+			if (presentWaitSupported)
+			{
+				requiredDeviceExtension.push_back(vk::KHRPresentIdExtensionName);
+				requiredDeviceExtension.push_back(vk::KHRPresentWaitExtensionName);
+			}
+
+			// optional: shadow rays are inline ray queries against acceleration structures where available
+			bool const hasRayQueryExtensions = (config.shadows == ShadowMode::eAuto || config.shadows == ShadowMode::eRayQuery) &&
+				std::ranges::all_of(std::array{ vk::KHRAccelerationStructureExtensionName, vk::KHRRayQueryExtensionName, vk::KHRDeferredHostOperationsExtensionName },
+					[&](char const* required) {
+						return std::ranges::any_of(availableExtensions, [required](auto const& extension) { return strcmp(extension.extensionName, required) == 0; });
+					});
+			if (hasRayQueryExtensions)
+			{
+				auto const rayQueryFeatures =
+					physicalDevice.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceAccelerationStructureFeaturesKHR, vk::PhysicalDeviceRayQueryFeaturesKHR>();
+				rayQuerySupported = rayQueryFeatures.get<vk::PhysicalDeviceAccelerationStructureFeaturesKHR>().accelerationStructure &&
+					rayQueryFeatures.get<vk::PhysicalDeviceRayQueryFeaturesKHR>().rayQuery;
+			}
+			if (rayQuerySupported)
+			{
+				requiredDeviceExtension.push_back(vk::KHRAccelerationStructureExtensionName);
+				requiredDeviceExtension.push_back(vk::KHRRayQueryExtensionName);
+				requiredDeviceExtension.push_back(vk::KHRDeferredHostOperationsExtensionName);
+			}
+			else if (config.shadows == ShadowMode::eRayQuery)
+			{
+				std::cerr << "ray queries are not supported by this device, tracing shadows with the compute BVH" << std::endl;
+			}
 		}
 		else
 		{
@@ -271,10 +1062,11 @@ private:
 		std::vector<vk::QueueFamilyProperties> queueFamilyProperties = physicalDevice.getQueueFamilyProperties();
 
 		// get the first index into queueFamilyProperties which supports both graphics and present
+		// (headless mode never presents, so any graphics queue will do)
 		for (uint32_t qfpIndex = 0; qfpIndex < queueFamilyProperties.size(); qfpIndex++)
 		{
 			if ((queueFamilyProperties[qfpIndex].queueFlags & vk::QueueFlagBits::eGraphics) &&
-				physicalDevice.getSurfaceSupportKHR(qfpIndex, *surface))
+				(config.headless || physicalDevice.getSurfaceSupportKHR(qfpIndex, *surface)))
 			{
 				// found a queue family that supports both graphics and present
 				queueIndex = qfpIndex;
@@ -286,38 +1078,144 @@ private:
 			throw std::runtime_error("Could not find a queue for graphics and present -> terminating");
 		}
 
+		// prefer a transfer-only family (usually a DMA engine), then any non-graphics family that can transfer
+		transferQueueIndex = queueIndex;
+		for (vk::QueueFlags excluded : { vk::QueueFlags(vk::QueueFlagBits::eGraphics | vk::QueueFlagBits::eCompute), vk::QueueFlags(vk::QueueFlagBits::eGraphics) })
+		{
+			for (uint32_t qfpIndex = 0; qfpIndex < queueFamilyProperties.size() && transferQueueIndex == queueIndex; qfpIndex++)
+			{
+				if ((queueFamilyProperties[qfpIndex].queueFlags & vk::QueueFlagBits::eTransfer) &&
+					!(queueFamilyProperties[qfpIndex].queueFlags & excluded))
+				{
+					transferQueueIndex = qfpIndex;
+				}
+			}
+		}
+
+		// the GPU-driven path is optional; without these the draws are recorded on the CPU
+		auto const supportedFeatures = physicalDevice.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan12Features>();
+		drawIndirectCountSupported = supportedFeatures.get<vk::PhysicalDeviceFeatures2>().features.multiDrawIndirect &&
+			supportedFeatures.get<vk::PhysicalDeviceFeatures2>().features.drawIndirectFirstInstance &&
+			supportedFeatures.get<vk::PhysicalDeviceVulkan12Features>().drawIndirectCount;
+
+		// The cull dispatch of the indirect path may run on a queue of its own: preferably a compute family without
+		// graphics (another engine), else a second queue of the graphics family. When the compute family is the one
+		// picked for transfers it gets a queue of its own if there are two, and shares the transfer queue otherwise.
+		// Without either, culling stays on the graphics queue. Mesh shading culls in the task shader, so it has no use for it.
+		uint32_t computeQueueSlot = 0;
+		if (config.asyncCompute && config.gpuCulling && drawIndirectCountSupported && !meshShaderSupported)
+		{
+			for (uint32_t qfpIndex = 0; qfpIndex < queueFamilyProperties.size(); qfpIndex++)
+			{
+				if ((queueFamilyProperties[qfpIndex].queueFlags & vk::QueueFlagBits::eCompute) &&
+					!(queueFamilyProperties[qfpIndex].queueFlags & vk::QueueFlagBits::eGraphics) &&
+					(computeQueueIndex == ~0 || computeQueueIndex == transferQueueIndex))
+				{
+					computeQueueIndex = qfpIndex;
+				}
+			}
+			if (computeQueueIndex == transferQueueIndex)
+			{
+				computeQueueSlot = queueFamilyProperties[computeQueueIndex].queueCount > 1 ? 1 : 0;
+			}
+			else if (computeQueueIndex == ~0 && queueFamilyProperties[queueIndex].queueCount > 1)
+			{
+				computeQueueIndex = queueIndex;
+				computeQueueSlot = 1;
+			}
+		}
+		if (computeQueueIndex != ~0 && computeQueueIndex != queueIndex)
+		{
+			sharedQueueFamilies = { queueIndex, computeQueueIndex };
+			if (transferQueueIndex != queueIndex && transferQueueIndex != computeQueueIndex)
+			{
+				sharedQueueFamilies.push_back(transferQueueIndex);
+			}
+		}
+
 		// query for Vulkan 1.3 features
 		vk::StructureChain<vk::PhysicalDeviceFeatures2,
 			vk::PhysicalDeviceVulkan11Features,
+			vk::PhysicalDeviceVulkan12Features,
 			vk::PhysicalDeviceVulkan13Features,
-			vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT>
+			vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT,
+			vk::PhysicalDeviceMeshShaderFeaturesEXT,
+			vk::PhysicalDevicePresentIdFeaturesKHR,
+			vk::PhysicalDevicePresentWaitFeaturesKHR,
+			vk::PhysicalDeviceAccelerationStructureFeaturesKHR,
+			vk::PhysicalDeviceRayQueryFeaturesKHR>
 			featureChain = {
-				{},                                                          // vk::PhysicalDeviceFeatures2
-				{.shaderDrawParameters = true},                              // vk::PhysicalDeviceVulkan11Features
-				{.synchronization2 = true, .dynamicRendering = true},        // vk::PhysicalDeviceVulkan13Features
-				{.extendedDynamicState = true}                               // vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT
+				{.features = {.multiDrawIndirect = drawIndirectCountSupported, .drawIndirectFirstInstance = drawIndirectCountSupported, .shaderInt64 = true}}, // vk::PhysicalDeviceFeatures2
+				{.shaderDrawParameters = true},                                                               // vk::PhysicalDeviceVulkan11Features
+				{.drawIndirectCount = drawIndirectCountSupported,
+				 .shaderSampledImageArrayNonUniformIndexing = true,
+				 .shaderStorageBufferArrayNonUniformIndexing = true,
+				 .descriptorBindingSampledImageUpdateAfterBind = true,
+				 .descriptorBindingStorageBufferUpdateAfterBind = true,
+				 .descriptorBindingPartiallyBound = true,
+				 .runtimeDescriptorArray = true,
+				 .hostQueryReset = true,
+				 .timelineSemaphore = true,
+				 .bufferDeviceAddress = true},                                                                // vk::PhysicalDeviceVulkan12Features
+				{.synchronization2 = true, .dynamicRendering = true},                                         // vk::PhysicalDeviceVulkan13Features
+				{.extendedDynamicState = true},                                                               // vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT
+				{.taskShader = true, .meshShader = true},                                                     // vk::PhysicalDeviceMeshShaderFeaturesEXT
+				{.presentId = true},                                                                          // vk::PhysicalDevicePresentIdFeaturesKHR
+				{.presentWait = true},                                                                        // vk::PhysicalDevicePresentWaitFeaturesKHR
+				{.accelerationStructure = true},                                                              // vk::PhysicalDeviceAccelerationStructureFeaturesKHR
+				{.rayQuery = true}                                                                            // vk::PhysicalDeviceRayQueryFeaturesKHR
 		};
+		if (!meshShaderSupported)
+		{
+			featureChain.unlink<vk::PhysicalDeviceMeshShaderFeaturesEXT>();
+		}
+		if (!presentWaitSupported)
+		{
+			featureChain.unlink<vk::PhysicalDevicePresentIdFeaturesKHR>();
+			featureChain.unlink<vk::PhysicalDevicePresentWaitFeaturesKHR>();
+		}
+		if (!rayQuerySupported)
+		{
+			featureChain.unlink<vk::PhysicalDeviceAccelerationStructureFeaturesKHR>();
+			featureChain.unlink<vk::PhysicalDeviceRayQueryFeaturesKHR>();
+		}
 
 		// create a Device
-		float                     queuePriority = 0.5f;
-		vk::DeviceQueueCreateInfo deviceQueueCreateInfo{ .queueFamilyIndex = queueIndex, .queueCount = 1, .pQueuePriorities = &queuePriority };
-		vk::DeviceCreateInfo      deviceCreateInfo{ .pNext = &featureChain.get<vk::PhysicalDeviceFeatures2>(),
-												   .queueCreateInfoCount = 1,
-												   .pQueueCreateInfos = &deviceQueueCreateInfo,
-												   .enabledExtensionCount = static_cast<uint32_t>(requiredDeviceExtension.size()),
-												   .ppEnabledExtensionNames = requiredDeviceExtension.data() };
+		std::array<float, 2> const             queuePriorities = { 0.5f, 0.5f };
+		auto const                             queueCount = [&](uint32_t family) { return family == computeQueueIndex ? computeQueueSlot + 1 : 1u; };
+		std::vector<vk::DeviceQueueCreateInfo> deviceQueueCreateInfos = {
+			{.queueFamilyIndex = queueIndex, .queueCount = queueCount(queueIndex), .pQueuePriorities = queuePriorities.data()} };
+		if (transferQueueIndex != queueIndex)
+		{
+			deviceQueueCreateInfos.push_back({ .queueFamilyIndex = transferQueueIndex, .queueCount = queueCount(transferQueueIndex), .pQueuePriorities = queuePriorities.data() });
+		}
+		if (computeQueueIndex != ~0 && computeQueueIndex != queueIndex && computeQueueIndex != transferQueueIndex)
+		{
+			deviceQueueCreateInfos.push_back({ .queueFamilyIndex = computeQueueIndex, .queueCount = 1, .pQueuePriorities = queuePriorities.data() });
+		}
+		vk::DeviceCreateInfo deviceCreateInfo{ .pNext = &featureChain.get<vk::PhysicalDeviceFeatures2>(),
+											  .queueCreateInfoCount = static_cast<uint32_t>(deviceQueueCreateInfos.size()),
+											  .pQueueCreateInfos = deviceQueueCreateInfos.data(),
+											  .enabledExtensionCount = static_cast<uint32_t>(requiredDeviceExtension.size()),
+											  .ppEnabledExtensionNames = requiredDeviceExtension.data() };
 
 		device = vk::raii::Device(physicalDevice, deviceCreateInfo);
 		queue = vk::raii::Queue(device, queueIndex, 0);
+		transferQueue = vk::raii::Queue(device, transferQueueIndex, 0);
+		if (computeQueueIndex != ~0)
+		{
+			computeQueue = vk::raii::Queue(device, computeQueueIndex, computeQueueSlot);
+		}
 	}
 
-	void createSwapChain()
+	void createSwapChain(vk::SwapchainKHR oldSwapChain = nullptr)
 	{
 		auto surfaceCapabilities = physicalDevice.getSurfaceCapabilitiesKHR(*surface);
 		swapChainExtent = chooseSwapExtent(surfaceCapabilities);
 		swapChainSurfaceFormat = chooseSwapSurfaceFormat(physicalDevice.getSurfaceFormatsKHR(*surface));
+		vk::PresentModeKHR const   presentMode = presentControl.chooseMode(physicalDevice.getSurfacePresentModesKHR(*surface));
 		vk::SwapchainCreateInfoKHR swapChainCreateInfo{ .surface = *surface,
-													   .minImageCount = chooseSwapMinImageCount(surfaceCapabilities),
+													   .minImageCount = presentControl.chooseImageCount(surfaceCapabilities, config.framesInFlight),
 													   .imageFormat = swapChainSurfaceFormat.format,
 													   .imageColorSpace = swapChainSurfaceFormat.colorSpace,
 													   .imageExtent = swapChainExtent,
@@ -326,11 +1224,37 @@ private:
 													   .imageSharingMode = vk::SharingMode::eExclusive,
 													   .preTransform = surfaceCapabilities.currentTransform,
 													   .compositeAlpha = vk::CompositeAlphaFlagBitsKHR::eOpaque,
-													   .presentMode = chooseSwapPresentMode(physicalDevice.getSurfacePresentModesKHR(*surface)),
-													   .clipped = true };
+													   .presentMode = presentMode,
+													   .clipped = true,
+													   .oldSwapchain = oldSwapChain };
 
 		swapChain = vk::raii::SwapchainKHR(device, swapChainCreateInfo);
 		swapChainImages = swapChain.getImages();
+		std::cout << "swapchain: " << swapChainExtent.width << "x" << swapChainExtent.height << ", " << vk::to_string(presentMode) << ", " << swapChainImages.size()
+				  << " images" << std::endl;
+	}
+
+	void createOffscreenTargets()
+	{
+		swapChainExtent = vk::Extent2D{ WIDTH, HEIGHT };
+		swapChainSurfaceFormat = vk::SurfaceFormatKHR{ .format = vk::Format::eB8G8R8A8Srgb, .colorSpace = vk::ColorSpaceKHR::eSrgbNonlinear };
+
+		// one target per frame in flight, so imageIndex == frameIndex and a target is never reused while the GPU still renders to it
+		for (uint32_t i = 0; i < config.framesInFlight; i++)
+		{
+			vk::ImageCreateInfo imageInfo{ .imageType = vk::ImageType::e2D,
+										  .format = swapChainSurfaceFormat.format,
+										  .extent = {swapChainExtent.width, swapChainExtent.height, 1},
+										  .mipLevels = 1,
+										  .arrayLayers = 1,
+										  .samples = vk::SampleCountFlagBits::e1,
+										  .tiling = vk::ImageTiling::eOptimal,
+										  .usage = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc,
+										  .sharingMode = vk::SharingMode::eExclusive,
+										  .initialLayout = vk::ImageLayout::eUndefined };
+			offscreenImages.emplace_back(allocator, device, imageInfo, vk::MemoryPropertyFlagBits::eDeviceLocal);
+			swapChainImages.push_back(*offscreenImages.back());
+		}
 	}
 
 	void createImageViews()
@@ -345,51 +1269,460 @@ private:
 		}
 	}
 
-	void createGraphicsPipeline()
+	void createPipelineCache()
 	{
-		vk::raii::ShaderModule shaderModule = createShaderModule(readFile("../shaders/slang.spv"));
-
-		vk::PipelineShaderStageCreateInfo vertShaderStageInfo{ .stage = vk::ShaderStageFlagBits::eVertex, .module = shaderModule, .pName = "vertMain" };
-		vk::PipelineShaderStageCreateInfo fragShaderStageInfo{ .stage = vk::ShaderStageFlagBits::eFragment, .module = shaderModule, .pName = "fragMain" };
-		vk::PipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
+		if (!config.pipelineCachePath.empty())
+		{
+			pipelineCache.load(device, physicalDevice, config.pipelineCachePath);
+		}
+	}
 
-		vk::PipelineVertexInputStateCreateInfo   vertexInputInfo;
-		vk::PipelineInputAssemblyStateCreateInfo inputAssembly{ .topology = vk::PrimitiveTopology::eTriangleList };
-		vk::PipelineViewportStateCreateInfo      viewportState{ .viewportCount = 1, .scissorCount = 1 };
+	void createGraphicsPipeline()
+	{
+		std::vector<char> const shaderCode = readFile("../shaders/slang.spv");
+		trianglePipeline.shaderModule = createShaderModule(shaderCode);
 
-		vk::PipelineRasterizationStateCreateInfo rasterizer{ .depthClampEnable = vk::False, .rasterizerDiscardEnable = vk::False, .polygonMode = vk::PolygonMode::eFill, .cullMode = vk::CullModeFlagBits::eBack, .frontFace = vk::FrontFace::eClockwise, .depthBiasEnable = vk::False, .depthBiasSlopeFactor = 1.0f, .lineWidth = 1.0f };
+		vk::DescriptorSetLayout const heapLayout = bindlessHeap.setLayoutHandle();
+		vk::PushConstantRange         pushConstantRange{ .stageFlags = DRAW_CONSTANT_STAGES, .offset = 0, .size = sizeof(DrawConstants) };
+		vk::PipelineLayoutCreateInfo  pipelineLayoutInfo{ .setLayoutCount = 1, .pSetLayouts = &heapLayout, .pushConstantRangeCount = 1, .pPushConstantRanges = &pushConstantRange };
 
-		vk::PipelineMultisampleStateCreateInfo multisampling{ .rasterizationSamples = vk::SampleCountFlagBits::e1, .sampleShadingEnable = vk::False };
+		pipelineLayout = vk::raii::PipelineLayout(device, pipelineLayoutInfo);
 
-		vk::PipelineColorBlendAttachmentState colorBlendAttachment{ .blendEnable = vk::False,
-																   .colorWriteMask = vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA };
+		pipelineManager.init(device, pipelineCache.get(), threadPool);
+
+		// variant 0 of every family is built up front: every frame depends on it and it stands in for the other
+		// variants while they compile
+		auto const pipelineStart = std::chrono::steady_clock::now();
+		trianglePipeline.family.init<ScenePipelineState, SceneShaderFeatures>(pipelineManager,
+			{ .shaderModule = *trianglePipeline.shaderModule,
+			  .shaderHash = StateHasher().addBytes(shaderCode.data(), shaderCode.size()).value(),
+			  .vertexBindings = { VertexLayout::getBindingDescription() },
+			  .vertexAttributes = VertexLayout::getAttributeDescriptions(),
+			  .colorFormat = swapChainSurfaceFormat.format,
+			  .depthFormat = DEPTH_FORMAT,
+			  .layout = *pipelineLayout });
+		if (meshShaderSupported)
+		{
+			createMeshletPipeline();
+		}
+		if (config.shadows != ShadowMode::eOff)
+		{
+			createShadowPipelines();
+		}
+		std::cout << "pipeline creation (" << (pipelineCache.isWarm() ? "warm" : "cold") << " cache): "
+				  << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - pipelineStart).count() << " ms" << std::endl;
+	}
 
-		vk::PipelineColorBlendStateCreateInfo colorBlending{ .logicOpEnable = vk::False, .logicOp = vk::LogicOp::eCopy, .attachmentCount = 1, .pAttachments = &colorBlendAttachment };
+	// Task and mesh shaders read everything through the frame data address pushed by GpuCuller::drawMeshTasks().
+	void createMeshletPipeline()
+	{
+		std::vector<char> const shaderCode = readFile("../shaders/meshlet.spv");
+		meshletPipeline.shaderModule = createShaderModule(shaderCode);
+
+		vk::DescriptorSetLayout const heapLayout = bindlessHeap.setLayoutHandle();
+		vk::PushConstantRange         pushConstantRange{ .stageFlags = GpuCuller::MESH_SHADING_STAGES, .offset = 0, .size = sizeof(vk::DeviceAddress) };
+		vk::PipelineLayoutCreateInfo  pipelineLayoutInfo{ .setLayoutCount = 1, .pSetLayouts = &heapLayout, .pushConstantRangeCount = 1, .pPushConstantRanges = &pushConstantRange };
+		meshletPipelineLayout = vk::raii::PipelineLayout(device, pipelineLayoutInfo);
+		meshletPipeline.family.init<ScenePipelineState, SceneShaderFeatures>(pipelineManager,
+			{ .shaderModule = *meshletPipeline.shaderModule,
+			  .shaderHash = StateHasher().addBytes(shaderCode.data(), shaderCode.size()).value(),
+			  .taskEntry = "taskMain",
+			  .meshEntry = "meshMain",
+			  .colorFormat = swapChainSurfaceFormat.format,
+			  .depthFormat = DEPTH_FORMAT,
+			  .layout = *meshletPipelineLayout });
+	}
 
-		std::vector dynamicStates = {
-			vk::DynamicState::eViewport,
-			vk::DynamicState::eScissor };
-		vk::PipelineDynamicStateCreateInfo dynamicState{ .dynamicStateCount = static_cast<uint32_t>(dynamicStates.size()), .pDynamicStates = dynamicStates.data() };
+	// The shadow trace pipeline of whichever path the device supports, and the composite that blends its mask over
+	// the shaded image. The scene follows in createDrawList().
+	void createShadowPipelines()
+	{
+		ShadowTracer::Mode const mode = rayQuerySupported ? ShadowTracer::Mode::eRayQuery : ShadowTracer::Mode::eComputeBvh;
+		shadowTracer.init(device, physicalDevice, queueIndex, allocator, bindlessHeap, pipelineCache.get(), mode,
+						  readFile(mode == ShadowTracer::Mode::eRayQuery ? "../shaders/shadow_ray_query.spv" : "../shaders/shadow_bvh.spv"), config.framesInFlight);
+
+		std::vector<char> const shaderCode = readFile("../shaders/shadow_composite.spv");
+		shadowCompositeModule = createShaderModule(shaderCode);
+		shadowCompositePipeline = pipelineManager.requestBlocking({ .shaderModule = *shadowCompositeModule,
+																	.shaderHash = StateHasher().addBytes(shaderCode.data(), shaderCode.size()).value(),
+																	.vertexEntry = "compositeVert",
+																	.fragmentEntry = "compositeFrag",
+																	.cullMode = vk::CullModeFlagBits::eNone,
+																	.blendEnable = true,
+																	.colorFormat = swapChainSurfaceFormat.format,
+																	.layout = shadowTracer.compositeLayout() });
+	}
 
-		vk::PipelineLayoutCreateInfo pipelineLayoutInfo{ .setLayoutCount = 0, .pushConstantRangeCount = 0 };
+	// Registers the programs behind the pipelines in use, mirroring the shader commands in CMakeLists.txt.
+	void createShaderReloader()
+	{
+		shaderReloader.init(threadPool, "../shaders", config.shaderCompiler);
+		trianglePipeline.program = shaderReloader.add({ .source = "triangle.slang", .output = "slang.spv", .entries = { "vertMain", "fragMain" } });
+		if (meshShaderSupported)
+		{
+			meshletPipeline.program = shaderReloader.add({ .source = "meshlet.slang", .output = "meshlet.spv", .entries = { "taskMain", "meshMain", "fragMain" } });
+		}
+		if (gpuCuller.enabled())
+		{
+			cullProgram = shaderReloader.add({ .source = "cull.slang", .output = "cull.spv", .entries = { "cullMain", "lodMain" } });
+		}
+	}
 
-		pipelineLayout = vk::raii::PipelineLayout(device, pipelineLayoutInfo);
+	// Runs at a frame boundary: picks up recompiled shaders and swaps in the pipelines rebuilt from them. Nothing
+	// waits for the GPU; replaced pipelines are released with the frames that may still use them.
+	void reloadShaders(uint64_t frameValue)
+	{
+		for (ShaderReloader::ProgramId const program : shaderReloader.poll())
+		{
+			if (program == trianglePipeline.program)
+			{
+				trianglePipeline.stale = true;
+			}
+			else if (program == meshletPipeline.program)
+			{
+				meshletPipeline.stale = true;
+			}
+			else if (program == cullProgram)
+			{
+				gpuCuller.reloadShader(device, pipelineCache.get(), shaderReloader.code(program), frameValue - 1);
+			}
+		}
+		updateHotPipeline(trianglePipeline, frameValue);
+		updateHotPipeline(meshletPipeline, frameValue);
+	}
+
+	// Swaps in a finished rebuild, then starts the next one if the shader was reloaded again. A build that fails
+	// leaves the current pipelines in place.
+	void updateHotPipeline(HotPipeline& pipeline, uint64_t frameValue)
+	{
+		switch (pipeline.family.update(frameValue - 1))
+		{
+		case PipelineFamily::Update::eBuilding:
+			return;
+		case PipelineFamily::Update::eSwapped:
+			pipeline.shaderModule = std::move(pipeline.pendingShaderModule);
+			break;
+		case PipelineFamily::Update::eFailed:
+			pipeline.pendingShaderModule = nullptr;
+			break;
+		case PipelineFamily::Update::eIdle:
+			break;
+		}
+		if (pipeline.stale)
+		{
+			std::vector<char> const& shaderCode = shaderReloader.code(pipeline.program);
+			pipeline.pendingShaderModule = createShaderModule(shaderCode);
+			pipeline.family.reload(*pipeline.pendingShaderModule, StateHasher().addBytes(shaderCode.data(), shaderCode.size()).value());
+			pipeline.stale = false;
+		}
+	}
+
+	// Starts building the variants the scene draws with, so they are ready by the first frames instead of
+	// standing in variant 0 for them.
+	void requestSceneVariants()
+	{
+		uint32_t const allFeatures = SceneShaderFeatures::variantFor(sceneFeatures);
+		trianglePipeline.family.key(allFeatures);
+		if (meshShaderSupported)
+		{
+			meshletPipeline.family.key(allFeatures);
+		}
+		for (DrawItem const& draw : drawList)
+		{
+			trianglePipeline.family.key(draw.variant);
+		}
+	}
+
+	// Sized for the frame's uniforms and culling inputs plus the transform table, which grows with the node count.
+	void createUniformRing()
+	{
+		vk::DeviceSize const transformBytes = sceneGraph.size() * 2 * sizeof(std::array<float, 4>);
+		uniformRing.init(allocator, device, physicalDevice, config.framesInFlight, UniformRing::DEFAULT_PARTITION_SIZE + transformBytes, sharedQueueFamilies);
+	}
+
+	// Copies the scene graph's world transforms, indexed by slot (GpuObject::node), into this frame's partition of the ring.
+	GpuTransformTable writeTransforms()
+	{
+		return { .translationScale = uniformRing.pushArray(sceneGraph.worldTranslationScale()).address, .rotation = uniformRing.pushArray(sceneGraph.worldRotation()).address };
+	}
+
+	// Picks the LOD every CPU-recorded draw uses this frame: the coarsest level whose error, scaled into world
+	// space and projected to the screen at the distance of the object's world bounds, stays under
+	// LOD_PIXEL_ERROR (with LOD_HYSTERESIS). Rewrites the draw list's index ranges in place.
+	void selectLods()
+	{
+		float const pixelsPerUnit = lodPixelsPerUnit();
+		auto const  bounds = sceneGraph.worldBounds();
+		auto const  translationScale = sceneGraph.worldTranslationScale();
+		uint64_t    triangles = 0;
+		uint64_t    baseTriangles = 0;
+		for (DrawItem& draw : drawList)
+		{
+			SceneDraw const&     sceneDraw = sceneDraws[draw.sceneDraw];
+			SceneLodChain const& chain = sceneLods[draw.sceneDraw];
+			uint32_t             lod = 0;
+			if (config.lodEnabled && chain.count > 0)
+			{
+				// the distance to the nearest point of the world bounds, so large objects stay fine near the camera
+				uint32_t const              slot = sceneGraph.slot(objectNodes[draw.firstInstance]);
+				std::array<float, 4> const& sphere = bounds[slot];
+				float const                 distance = std::max(glm::length(glm::vec3(sphere[0], sphere[1], sphere[2]) - camera.position) - sphere[3], 1e-3f);
+				float const                 pixelsPerError = translationScale[slot][3] * pixelsPerUnit / distance;
+				lod = std::min(draw.lod, chain.count);
+				while (lod > 0 && chain.levels[lod - 1].error * pixelsPerError > LOD_PIXEL_ERROR)
+				{
+					lod--;
+				}
+				while (lod < chain.count && chain.levels[lod].error * pixelsPerError < LOD_PIXEL_ERROR * LOD_HYSTERESIS)
+				{
+					lod++;
+				}
+			}
+			draw.lod = lod;
+			draw.firstIndex = lod == 0 ? sceneDraw.firstIndex : chain.levels[lod - 1].firstIndex;
+			draw.indexCount = lod == 0 ? sceneDraw.indexCount : chain.levels[lod - 1].indexCount;
+			triangles += draw.indexCount / 3;
+			baseTriangles += sceneDraw.indexCount / 3;
+		}
+		lodTrianglesTotal += triangles;
+		baseTrianglesTotal += baseTriangles;
+		lodFrames++;
+	}
+
+	// How many pixels one world unit covers at distance one, which projects the LOD errors to the screen.
+	[[nodiscard]] float lodPixelsPerUnit() const
+	{
+		return static_cast<float>(swapChainExtent.height) / (2.0f * std::tan(0.5f * camera.fovY));
+	}
+
+	void checkFrameAllocations() const
+	{
+		FrameArenaStats const& stats = frameArenas.getStats();
+		if (config.checkFrameAllocations && stats.allocatingSteadyFrames > 0)
+		{
+			throw std::runtime_error(std::to_string(stats.allocatingSteadyFrames) + " steady-state frames allocated from the heap!");
+		}
+	}
+
+	// The material table lives in the bindless heap like every other shader resource; draws only carry its index.
+	// Textures are handed to the streamer, which fills in the texture table as they become resident.
+	void createMaterials(std::vector<SceneMaterial> const& sceneMaterials, std::vector<SceneTexture> const& sceneTextures)
+	{
+		vk::SamplerCreateInfo samplerInfo{ .magFilter = vk::Filter::eLinear,
+										   .minFilter = vk::Filter::eLinear,
+										   .mipmapMode = vk::SamplerMipmapMode::eLinear,
+										   .addressModeU = vk::SamplerAddressMode::eRepeat,
+										   .addressModeV = vk::SamplerAddressMode::eRepeat,
+										   .addressModeW = vk::SamplerAddressMode::eRepeat,
+										   .maxLod = vk::LodClampNone };
+		defaultSampler = vk::raii::Sampler(device, samplerInfo);
+		defaultSamplerHandle = bindlessHeap.addSampler(*defaultSampler);
+
+		textureStreamer.load(sceneTextures);
+		drawConstants.textures = textureStreamer.tableHandle();
+
+		// untextured materials show the vertex color; only alpha-masked ones pay for the alpha test
+		materials = { GpuMaterial{ .baseColorSampler = defaultSamplerHandle, .features = shaderFeatureBit(ShaderFeature::eVertexColor) } };
+		for (SceneMaterial const& material : sceneMaterials)
+		{
+			uint32_t features = 0;
+			if (material.alphaCutoff > 0.0f)
+			{
+				features |= shaderFeatureBit(ShaderFeature::eAlphaTest);
+			}
+			if (material.baseColorTexture == SCENE_NONE)
+			{
+				features |= shaderFeatureBit(ShaderFeature::eVertexColor);
+			}
+			materials.push_back(GpuMaterial{ .baseColorFactor = material.baseColorFactor,
+											 .baseColorTexture = material.baseColorTexture,
+											 .baseColorSampler = defaultSamplerHandle,
+											 .alphaCutoff = material.alphaCutoff,
+											 .features = features });
+		}
+		materialBuffer = uploadStorageBuffer(materials.data(), materials.size() * sizeof(GpuMaterial));
+		drawConstants.materials = bindlessHeap.addBuffer(*materialBuffer);
+	}
+
+	// Loads the scene from its mesh cache when there is an up-to-date one, otherwise parses the source, builds
+	// its LODs and bakes both into the cache for next time.
+	void loadScene()
+	{
+		if (config.scenePath.empty())
+		{
+			SceneSource const scene = SceneSource::fromMesh(triangleVertices, triangleIndices);
+			uploadScene(scene, SceneLods::build(scene));
+			return;
+		}
+
+		auto const            loadStart = std::chrono::steady_clock::now();
+		std::filesystem::path cachePath;
+		if (!config.meshCacheDir.empty())
+		{
+			cachePath = MeshCache::pathFor(config.meshCacheDir, config.scenePath, config.importSettings);
+			if (std::optional<MeshCache> const cache = MeshCache::open(cachePath, config.importSettings))
+			{
+				double const openMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - loadStart).count();
+				uploadScene(*cache, cache->lods());
+				reportSceneLoad(*cache, cachePath.string(), loadStart, openMs);
+				return;
+			}
+		}
+
+		SceneSource const scene = SceneSource::load(config.scenePath, config.importSettings);
+		double const      parseMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - loadStart).count();
+		auto const        lodStart = std::chrono::steady_clock::now();
+		SceneLods const   lods = SceneLods::build(scene);
+		std::cout << "lod: " << lods.indexCount() / 3 << " simplified triangles built in "
+				  << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - lodStart).count() << " ms" << std::endl;
+		uploadScene(scene, lods);
+		reportSceneLoad(scene, config.scenePath, loadStart, parseMs);
+		if (!cachePath.empty() && MeshCache::write(cachePath, scene, lods, config.importSettings))
+		{
+			std::cout << "mesh cache: baked " << cachePath.string() << std::endl;
+		}
+	}
+
+	// Builds one merged vertex/index arena for the scene (a SceneSource or a MeshCache). Vertices and indices
+	// are converted straight from the source, usually a memory-mapped file, into the staging ring without an
+	// intermediate copy; the copies land with the first frame's upload batch. The LOD indices follow the scene's.
+	template <typename Scene>
+	void uploadScene(Scene const& scene, SceneLods const& lods)
+	{
+		if (scene.draws().empty())
+		{
+			throw std::runtime_error("scene has no triangles!");
+		}
+
+		// mesh shaders fetch vertices through the buffer's address instead of the vertex input stage; with ray
+		// queries the BLASes are built straight from the vertex and index buffers
+		bool const                    buildsBlases = shadowTracer.enabled() && shadowTracer.getMode() == ShadowTracer::Mode::eRayQuery;
+		vk::BufferUsageFlags const    blasInputUsage = buildsBlases ? vk::BufferUsageFlagBits::eAccelerationStructureBuildInputReadOnlyKHR | vk::BufferUsageFlagBits::eShaderDeviceAddress
+																	: vk::BufferUsageFlags();
+		vk::PipelineStageFlags2 const blasInputStages = buildsBlases ? vk::PipelineStageFlagBits2::eAccelerationStructureBuildKHR : vk::PipelineStageFlags2();
+		vk::AccessFlags2 const        blasInputAccess = buildsBlases ? vk::AccessFlagBits2::eShaderRead : vk::AccessFlags2();
+		vk::DeviceSize const          vertexBytes = scene.vertexCount() * sizeof(SceneVertex);
+		vertexBuffer = GpuBuffer(allocator, device, vertexBytes,
+								 vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eShaderDeviceAddress |
+									 vk::BufferUsageFlagBits::eTransferDst | blasInputUsage,
+								 vk::MemoryPropertyFlagBits::eDeviceLocal);
+		uploads.uploadBufferWith(*vertexBuffer, 0, vertexBytes, sizeof(SceneVertex), vk::PipelineStageFlagBits2::eVertexAttributeInput | sceneShaderStages() | blasInputStages,
+								 vk::AccessFlagBits2::eVertexAttributeRead | vk::AccessFlagBits2::eShaderStorageRead | blasInputAccess,
+								 [&](void* out, vk::DeviceSize offset, vk::DeviceSize size) {
+									 scene.writeVertices(offset / sizeof(SceneVertex), size / sizeof(SceneVertex), static_cast<SceneVertex*>(out));
+								 });
+
+		// the index buffer is uploaded in meshlet order, so every meshlet is also an index range for the indirect path
+		auto const        meshletStart = std::chrono::steady_clock::now();
+		MeshletMesh const meshlets = MeshletMesh::build(scene);
+		double const      meshletMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - meshletStart).count();
+
+		uint64_t const       lodFirstIndex = meshlets.indexCount();
+		vk::DeviceSize const indexBytes = (lodFirstIndex + lods.indexCount()) * sizeof(uint32_t);
+		if (lodFirstIndex + lods.indexCount() > std::numeric_limits<uint32_t>::max())
+		{
+			throw std::runtime_error("scene has too many indices for 32-bit draw ranges!");
+		}
+		// mesh shaders have no index input stage, so they fetch the LOD levels' indices through the buffer's address
+		vk::BufferUsageFlags const    meshIndexUsage = meshShaderSupported ? vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eShaderDeviceAddress
+																		   : vk::BufferUsageFlags();
+		vk::PipelineStageFlags2 const meshIndexStages = meshShaderSupported ? vk::PipelineStageFlagBits2::eMeshShaderEXT : vk::PipelineStageFlags2();
+		vk::AccessFlags2 const        meshIndexAccess = meshShaderSupported ? vk::AccessFlagBits2::eShaderStorageRead : vk::AccessFlags2();
+		indexBuffer = GpuBuffer(allocator, device, indexBytes, vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eTransferDst | blasInputUsage | meshIndexUsage,
+								vk::MemoryPropertyFlagBits::eDeviceLocal);
+		uploads.uploadBufferWith(*indexBuffer, 0, indexBytes, sizeof(uint32_t), vk::PipelineStageFlagBits2::eIndexInput | blasInputStages | meshIndexStages,
+								 vk::AccessFlagBits2::eIndexRead | blasInputAccess | meshIndexAccess,
+								 [&](void* out, vk::DeviceSize offset, vk::DeviceSize size) {
+									 uint64_t const first = offset / sizeof(uint32_t);
+									 uint64_t const count = size / sizeof(uint32_t);
+									 uint64_t const sceneCount = first < lodFirstIndex ? std::min(count, lodFirstIndex - first) : 0;
+									 if (sceneCount > 0)
+									 {
+										 meshlets.writeIndices(first, sceneCount, static_cast<uint32_t*>(out));
+									 }
+									 if (sceneCount < count)
+									 {
+										 lods.writeIndices(first + sceneCount - lodFirstIndex, count - sceneCount, static_cast<uint32_t*>(out) + sceneCount);
+									 }
+								 });
+		sceneLods = lods.chains();
+		for (SceneLodChain& chain : sceneLods)
+		{
+			for (uint32_t level = 0; level < chain.count; level++)
+			{
+				chain.levels[level].firstIndex += static_cast<uint32_t>(lodFirstIndex);
+			}
+		}
+		std::vector<GpuLodChain> gpuLods;
+		gpuLods.reserve(sceneLods.size());
+		for (size_t draw = 0; draw < sceneLods.size(); draw++)
+		{
+			gpuLods.push_back(GpuLodChain{ .levels = sceneLods[draw].levels, .count = sceneLods[draw].count, .vertexOffset = scene.draws()[draw].vertexOffset });
+		}
+		lodBuffer = uploadStorageBuffer(gpuLods.data(), gpuLods.size() * sizeof(GpuLodChain), sharedQueueFamilies);
+		meshletBuffer = uploadStorageBuffer(meshlets.meshlets().data(), meshlets.meshlets().size() * sizeof(Meshlet), sharedQueueFamilies);
+		meshletVertexBuffer = uploadStorageBuffer(meshlets.vertices().data(), meshlets.vertices().size() * sizeof(uint32_t));
+		meshletTriangleBuffer = uploadStorageBuffer(meshlets.triangles().data(), meshlets.triangles().size() * sizeof(uint32_t));
+		sceneMeshlets = meshlets.ranges();
+		std::cout << "meshlets: " << meshlets.meshlets().size() << " (avg " << static_cast<double>(meshlets.vertices().size()) / static_cast<double>(meshlets.meshlets().size())
+				  << " vertices, " << static_cast<double>(meshlets.triangles().size()) / static_cast<double>(meshlets.meshlets().size()) << " triangles) built in "
+				  << meshletMs << " ms" << std::endl;
+
+		// without ray queries the shadow rays walk a tree per scene draw, built on the CPU
+		if (shadowTracer.enabled() && shadowTracer.getMode() == ShadowTracer::Mode::eComputeBvh)
+		{
+			auto const     bvhStart = std::chrono::steady_clock::now();
+			SceneBvh const bvh = SceneBvh::build(scene);
+			bvhBuildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - bvhStart).count();
+			bvhNodeBuffer = uploadStorageBuffer(bvh.nodes().data(), bvh.nodes().size() * sizeof(BvhNode));
+			bvhTriangleBuffer = uploadStorageBuffer(bvh.triangles().data(), bvh.triangles().size() * sizeof(BvhTriangle));
+			bvhMeshBuffer = uploadStorageBuffer(bvh.meshes().data(), bvh.meshes().size() * sizeof(BvhMesh));
+			std::cout << "shadow bvh: " << bvh.nodes().size() << " nodes over " << bvh.triangles().size() << " triangles, depth " << bvh.depth() << ", built in "
+					  << bvhBuildMs << " ms" << std::endl;
+		}
+
+		createMaterials(scene.materials(), scene.textures());
 
-		vk::StructureChain<vk::GraphicsPipelineCreateInfo, vk::PipelineRenderingCreateInfo> pipelineCreateInfoChain = {
-			{.stageCount = 2,
-			 .pStages = shaderStages,
-			 .pVertexInputState = &vertexInputInfo,
-			 .pInputAssemblyState = &inputAssembly,
-			 .pViewportState = &viewportState,
-			 .pRasterizationState = &rasterizer,
-			 .pMultisampleState = &multisampling,
-			 .pColorBlendState = &colorBlending,
-			 .pDynamicState = &dynamicState,
-			 .layout = pipelineLayout,
-			 .renderPass = nullptr},
-			{.colorAttachmentCount = 1, .pColorAttachmentFormats = &swapChainSurfaceFormat.format} };
+		sceneDraws = scene.draws();
+		sceneBoundsMin = scene.getBoundsMin();
+		sceneBoundsMax = scene.getBoundsMax();
+		camera = Camera::framing(sceneBoundsMin, sceneBoundsMax);
+	}
+
+	// A device-local copy of data for shaders that read it through its buffer device address. Culling inputs
+	// pass sharedQueueFamilies, since the async compute queue reads them too.
+	GpuBuffer uploadStorageBuffer(void const* data, vk::DeviceSize size, std::span<uint32_t const> sharedFamilies = {})
+	{
+		GpuBuffer buffer(allocator, device, size,
+						 vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eShaderDeviceAddress | vk::BufferUsageFlagBits::eTransferDst,
+						 vk::MemoryPropertyFlagBits::eDeviceLocal, {}, sharedFamilies);
+		uploads.uploadBuffer(*buffer, 0, data, size, sceneShaderStages(), vk::AccessFlagBits2::eShaderStorageRead, buffer.isConcurrent());
+		return buffer;
+	}
 
-		graphicsPipeline = vk::raii::Pipeline(device, nullptr, pipelineCreateInfoChain.get<vk::GraphicsPipelineCreateInfo>());
+	[[nodiscard]] vk::DeviceAddress bufferAddress(GpuBuffer const& buffer) const
+	{
+		return device.getBufferAddress(vk::BufferDeviceAddressInfo{ .buffer = *buffer });
+	}
+
+	// Every stage that reads scene data from storage buffers, through device addresses or the bindless heap.
+	[[nodiscard]] vk::PipelineStageFlags2 sceneShaderStages() const
+	{
+		vk::PipelineStageFlags2 stages = vk::PipelineStageFlagBits2::eVertexShader | vk::PipelineStageFlagBits2::eFragmentShader | vk::PipelineStageFlagBits2::eComputeShader;
+		if (meshShaderSupported)
+		{
+			stages |= vk::PipelineStageFlagBits2::eTaskShaderEXT | vk::PipelineStageFlagBits2::eMeshShaderEXT;
+		}
+		return stages;
+	}
+
+	template <typename Scene>
+	void reportSceneLoad(Scene const& scene, std::string const& source, std::chrono::steady_clock::time_point loadStart, double parseMs) const
+	{
+		std::cout << "scene: " << source << ", " << sceneDraws.size() << " draws, " << scene.vertexCount() << " vertices, " << scene.indexCount()
+				  << " indices (" << (scene.isMapped() ? "memory-mapped" : "in-memory") << ")\n"
+				  << "scene load: " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - loadStart).count()
+				  << " ms (parse " << parseMs << " ms), peak RSS " << peakResidentBytes() / (1024 * 1024) << " MiB" << std::endl;
 	}
 
 	void createCommandPool()
@@ -402,110 +1735,519 @@ private:
 	void createCommandBuffers()
 	{
 		commandBuffers.clear();
-		vk::CommandBufferAllocateInfo allocInfo{ .commandPool = commandPool, .level = vk::CommandBufferLevel::ePrimary, .commandBufferCount = MAX_FRAMES_IN_FLIGHT };
+		vk::CommandBufferAllocateInfo allocInfo{ .commandPool = commandPool, .level = vk::CommandBufferLevel::ePrimary, .commandBufferCount = config.framesInFlight };
 		commandBuffers = vk::raii::CommandBuffers(device, allocInfo);
+
+		recorder.init(device, queueIndex, config.framesInFlight, config.recordThreads);
 	}
 
-	void recordCommandBuffer(uint32_t imageIndex)
+	// config.drawCount copies of the scene on a square grid in the xz plane, the original in the center cell and
+	// the camera framing it, so the further copies fall outside the view. Every draw is one object, whose meshlets
+	// are split into cluster groups for the GPU-driven paths.
+	void createDrawList()
 	{
-		auto& commandBuffer = commandBuffers[frameIndex];
+		uint32_t side = 1;
+		while (side * side < config.drawCount)
+		{
+			side += 2;
+		}
+		float const spacing = 1.25f * std::max({ sceneBoundsMax[0] - sceneBoundsMin[0], sceneBoundsMax[2] - sceneBoundsMin[2], 1e-3f });
+		float const gridHalfExtent = spacing * static_cast<float>(side / 2);
+		drawBoundsMin = { sceneBoundsMin[0] - gridHalfExtent, sceneBoundsMin[1], sceneBoundsMin[2] - gridHalfExtent };
+		drawBoundsMax = { sceneBoundsMax[0] + gridHalfExtent, sceneBoundsMax[1], sceneBoundsMax[2] + gridHalfExtent };
+
+		drawList.clear();
+		drawList.reserve(static_cast<size_t>(config.drawCount) * sceneDraws.size());
+		sceneFeatures = 0;
+		sceneGraph.clear();
+		sceneGraph.init(config.sceneGraphThreads);
+		objectNodes.clear();
+		std::vector<GpuObject>    objects;
+		std::vector<ClusterGroup> groups;
+		uint32_t                  meshletInstanceCount = 0;
+		objects.reserve(drawList.capacity());
+		for (uint32_t copy = 0; copy < config.drawCount; copy++)
+		{
+			// rotate the cell index so copy 0 lands in the center cell
+			uint32_t const             cell = (copy + side * side / 2) % (side * side);
+			std::array<float, 3> const offset = { spacing * (static_cast<float>(cell % side) - static_cast<float>(side / 2)), 0.0f,
+												  spacing * (static_cast<float>(cell / side) - static_cast<float>(side / 2)) };
+			SceneGraph::Node const     copyNode = sceneGraph.add(SceneGraph::NO_PARENT, { .translation = offset });
+			for (size_t drawIndex = 0; drawIndex < sceneDraws.size(); drawIndex++)
+			{
+				SceneDraw const&     draw = sceneDraws[drawIndex];
+				std::array<float, 4> boundingSphere = { 0.0f, 0.0f, 0.0f, 0.0f }; // object space; the shaders apply the transform
+				for (int axis = 0; axis < 3; axis++)
+				{
+					float const halfExtent = 0.5f * (draw.boundsMax[axis] - draw.boundsMin[axis]);
+					boundingSphere[axis] = draw.boundsMin[axis] + halfExtent;
+					boundingSphere[3] += halfExtent * halfExtent;
+				}
+				boundingSphere[3] = std::sqrt(boundingSphere[3]);
+
+				// material 0 is the default, so scene material i is i + 1
+				uint32_t const material = draw.material == SCENE_NONE ? 0 : draw.material + 1;
+				sceneFeatures |= materials[material].features;
+				drawList.push_back(DrawItem{ .indexCount = draw.indexCount,
+											 .firstIndex = draw.firstIndex,
+											 .vertexOffset = draw.vertexOffset,
+											 .firstInstance = static_cast<uint32_t>(objects.size()),
+											 .variant = SceneShaderFeatures::variantFor(materials[material].features),
+											 .sceneDraw = static_cast<uint32_t>(drawIndex) });
+				MeshletRange const& meshlets = sceneMeshlets[drawIndex];
+				for (uint32_t first = 0; first < meshlets.meshletCount; first += GpuCuller::CLUSTER_GROUP_SIZE)
+				{
+					groups.push_back(ClusterGroup{ .objectIndex = static_cast<uint32_t>(objects.size()),
+												   .firstMeshlet = meshlets.firstMeshlet + first,
+												   .meshletCount = std::min(GpuCuller::CLUSTER_GROUP_SIZE, meshlets.meshletCount - first),
+												   .indexInObject = first / GpuCuller::CLUSTER_GROUP_SIZE });
+				}
+				meshletInstanceCount += meshlets.meshletCount;
+				objects.push_back(GpuObject{ .boundingSphere = boundingSphere, .material = material, .mesh = static_cast<uint32_t>(drawIndex) });
+				objectNodes.push_back(sceneGraph.add(copyNode, {}, boundingSphere));
+			}
+		}
+
+		// lays the graph out by level; objects find their world transform by slot from here on
+		sceneGraph.update();
+		for (size_t object = 0; object < objects.size(); object++)
+		{
+			objects[object].node = sceneGraph.slot(objectNodes[object]);
+		}
+
+		// draws find their object through firstInstance, so reordering them leaves the objects alone
+		std::ranges::stable_sort(drawList, {}, &DrawItem::variant);
+		variantEnds.clear();
+		for (uint32_t i = 1; i <= drawList.size(); i++)
+		{
+			if (i == drawList.size() || drawList[i].variant != drawList[i - 1].variant)
+			{
+				variantEnds.push_back(i);
+			}
+		}
+		requestSceneVariants();
+
+		objectBuffer = uploadStorageBuffer(objects.data(), objects.size() * sizeof(GpuObject), sharedQueueFamilies);
+		clusterGroupBuffer = uploadStorageBuffer(groups.data(), groups.size() * sizeof(ClusterGroup), sharedQueueFamilies);
+		drawConstants.objects = bufferAddress(objectBuffer);
+
+		if (shadowTracer.enabled())
+		{
+			// shadow rays end past the far side of the whole grid
+			float const gridDiagonal = std::hypot(drawBoundsMax[0] - drawBoundsMin[0], drawBoundsMax[1] - drawBoundsMin[1], drawBoundsMax[2] - drawBoundsMin[2]);
+			ShadowTraceScene const shadowScene{ .objects = objects,
+												.objectsAddress = drawConstants.objects,
+												.rayLength = 2.0f * gridDiagonal,
+												.meshes = sceneDraws,
+												.vertices = bufferAddress(vertexBuffer),
+												.indices = shadowTracer.getMode() == ShadowTracer::Mode::eRayQuery ? bufferAddress(indexBuffer) : 0,
+												.bvhNodes = bvhNodeBuffer ? bufferAddress(bvhNodeBuffer) : 0,
+												.bvhTriangles = bvhTriangleBuffer ? bufferAddress(bvhTriangleBuffer) : 0,
+												.bvhMeshes = bvhMeshBuffer ? bufferAddress(bvhMeshBuffer) : 0,
+												.bvhBuildMs = bvhBuildMs };
+			shadowTracer.load(shadowScene, sceneGraph);
+		}
+
+		if (!config.gpuCulling)
+		{
+			return;
+		}
+		GpuCullScene const cullScene{ .objects = drawConstants.objects,
+									  .meshlets = bufferAddress(meshletBuffer),
+									  .groups = bufferAddress(clusterGroupBuffer),
+									  .meshletVertices = bufferAddress(meshletVertexBuffer),
+									  .meshletTriangles = bufferAddress(meshletTriangleBuffer),
+									  .vertices = bufferAddress(vertexBuffer),
+									  .lods = bufferAddress(lodBuffer),
+									  .indices = meshShaderSupported ? bufferAddress(indexBuffer) : 0,
+									  .materials = drawConstants.materials,
+									  .textures = drawConstants.textures,
+									  .objectCount = static_cast<uint32_t>(objects.size()),
+									  .groupCount = static_cast<uint32_t>(groups.size()),
+									  .meshletInstanceCount = meshletInstanceCount };
+		if (meshShaderSupported)
+		{
+			gpuCuller.init(device, allocator, pipelineCache.get(), GpuCuller::Mode::eMeshShader, readFile("../shaders/cull.spv"), config.framesInFlight, cullScene);
+		}
+		else if (drawIndirectCountSupported)
+		{
+			gpuCuller.init(device, allocator, pipelineCache.get(), GpuCuller::Mode::eComputeIndirect, readFile("../shaders/cull.spv"), config.framesInFlight, cullScene,
+						   sharedQueueFamilies);
+		}
+		else
+		{
+			std::cerr << "gpu culling: neither mesh shaders nor drawIndexedIndirectCount are supported, recording draws on the CPU" << std::endl;
+		}
+	}
+
+	// The indirect path's cull dispatch runs on the async compute queue instead of in the frame's render graph.
+	[[nodiscard]] bool cullsOnComputeQueue() const
+	{
+		return computeQueueIndex != ~0 && gpuCuller.enabled() && gpuCuller.getMode() == GpuCuller::Mode::eComputeIndirect;
+	}
+
+	// Everything transient the frame builds on the CPU comes from frameArena.
+	void recordCommandBuffer(uint32_t imageIndex, uint64_t frameValue, FrameArena& frameArena)
+	{
+		auto const recordStart = std::chrono::steady_clock::now();
+		auto&      commandBuffer = commandBuffers[frameIndex];
 		commandBuffer.begin({});
-		// Before starting rendering, transition the swapchain image to COLOR_ATTACHMENT_OPTIMAL
-		transition_image_layout(
-			imageIndex,
-			vk::ImageLayout::eUndefined,
-			vk::ImageLayout::eColorAttachmentOptimal,
-			{},                                                        // srcAccessMask (no need to wait for previous operations)
-			vk::AccessFlagBits2::eColorAttachmentWrite,                // dstAccessMask
-			vk::PipelineStageFlagBits2::eColorAttachmentOutput,        // srcStage
-			vk::PipelineStageFlagBits2::eColorAttachmentOutput         // dstStage
-		);
-		vk::ClearValue              clearColor = vk::ClearColorValue(0.0f, 0.0f, 0.0f, 1.0f);
-		vk::RenderingAttachmentInfo attachmentInfo = {
-			.imageView = swapChainImageViews[imageIndex],
+		framePacer.writeFrameStart(commandBuffer, frameIndex);
+		gpuProfiler.beginFrame(commandBuffer, frameIndex);
+		uint32_t const frameScope = gpuProfiler.beginScope(commandBuffer, "frame");
+
+		// take ownership of everything the transfer queue uploaded for this frame
+		uploads.recordAcquireBarriers(commandBuffer);
+
+		// per-frame data goes through the uniform ring; the shaders only get its address
+		sceneGraph.update();
+		FrameUniforms const frameUniforms{ .viewProjection = camera.viewProjection(static_cast<float>(swapChainExtent.width) / static_cast<float>(swapChainExtent.height)),
+										   .cameraPosition = glm::vec4(camera.position, 1.0f),
+										   .transforms = writeTransforms(),
+										   .textureFeedback = textureStreamer.feedbackAddress(frameIndex) };
+		drawConstants.frame = uniformRing.push(frameUniforms).address;
+		bool const gpuDriven = gpuCuller.enabled();
+		bool const meshShading = gpuDriven && gpuCuller.getMode() == GpuCuller::Mode::eMeshShader;
+		bool const asyncCulling = cullsOnComputeQueue();
+		if (gpuDriven)
+		{
+			gpuCuller.beginFrame(frameIndex, uniformRing, frameUniforms.viewProjection, camera.position, frameUniforms.transforms, frameUniforms.textureFeedback,
+								 config.lodEnabled ? lodPixelsPerUnit() : 0.0f);
+		}
+		else
+		{
+			selectLods();
+		}
+		if (asyncCulling)
+		{
+			// submitted ahead of the graphics work (submitFrame()), which waits for it only at the indirect draw
+			gpuCuller.recordCull(asyncCompute.begin(frameIndex, framePacer.lastFrameInterval()), frameIndex);
+		}
+		bool const shadows = shadowTracer.enabled();
+		bool const rayQueryShadows = shadows && shadowTracer.getMode() == ShadowTracer::Mode::eRayQuery;
+		if (shadows)
+		{
+			shadowTracer.beginFrame(frameIndex, uniformRing, frameUniforms.viewProjection, camera.position,
+									glm::vec3(SHADOW_LIGHT_DIRECTION[0], SHADOW_LIGHT_DIRECTION[1], SHADOW_LIGHT_DIRECTION[2]), swapChainExtent,
+									frameUniforms.transforms, sceneGraph, framePacer.completedValue());
+		}
+
+		renderGraph.begin(frameArena);
+		// offscreen targets go to TRANSFER_SRC for readback instead of being presented
+		RenderGraphImage const color = renderGraph.importImage("swapchain", swapChainImages[imageIndex], *swapChainImageViews[imageIndex],
+			{ .format = swapChainSurfaceFormat.format, .extent = swapChainExtent },
+			{ .stages = vk::PipelineStageFlagBits2::eColorAttachmentOutput }, // ordered after acquire by the submit's wait stage
+			config.headless ? RenderGraphAccesses::TRANSFER_READ : RenderGraphAccesses::PRESENT);
+		RenderGraphImage const depth = renderGraph.createImage("depth", { .format = DEPTH_FORMAT, .extent = swapChainExtent });
+
+		// the streamer synchronizes its own images and buffers, so to the graph its passes are opaque side effects
+		renderGraph.addPass("texture streaming", [&](vk::raii::CommandBuffer const& cb) {
+			textureStreamer.update(cb, frameIndex, frameValue, framePacer.completedValue());
+		}).sideEffects();
+
+		RenderGraphBuffer count;
+		RenderGraphBuffer draws;
+		RenderGraphBuffer lodStates;
+		if (asyncCulling)
+		{
+			// written on the compute queue; the submission's semaphore wait orders them before the draw
+			count = renderGraph.importBuffer("cull count", gpuCuller.countBuffer(frameIndex), {}, RenderGraphAccesses::HOST_READ);
+			draws = renderGraph.importBuffer("cull draws", gpuCuller.drawBuffer(frameIndex));
+		}
+		else if (gpuDriven)
+		{
+			// the count is read back on the host once the frame has retired
+			count = renderGraph.importBuffer("cull count", gpuCuller.countBuffer(frameIndex), {}, RenderGraphAccesses::HOST_READ);
+			renderGraph.addPass("reset cull count", [&](vk::raii::CommandBuffer const& cb) { gpuCuller.resetCount(cb, frameIndex); })
+				.write(count, RenderGraphAccesses::TRANSFER_WRITE);
+			// kept from frame to frame; last read by the previous frame's cull or task shaders
+			RenderGraphAccess const lastUse = meshShading ? RenderGraphAccesses::TASK_STORAGE_READ : RenderGraphAccesses::COMPUTE_STORAGE_READ;
+			lodStates = renderGraph.importBuffer("lod states", gpuCuller.lodStateBuffer(), lastUse);
+			renderGraph.addPass("select lods", [&](vk::raii::CommandBuffer const& cb) { gpuCuller.selectLods(cb, frameIndex); })
+				.write(lodStates, RenderGraphAccesses::COMPUTE_STORAGE_WRITE);
+		}
+		if (gpuDriven && !meshShading && !asyncCulling)
+		{
+			draws = renderGraph.importBuffer("cull draws", gpuCuller.drawBuffer(frameIndex));
+			renderGraph.addPass("cull", [&](vk::raii::CommandBuffer const& cb) { gpuCuller.dispatch(cb, frameIndex); })
+				.read(lodStates, RenderGraphAccesses::COMPUTE_STORAGE_READ)
+				.write(count, RenderGraphAccesses::COMPUTE_STORAGE_WRITE)
+				.write(draws, RenderGraphAccesses::COMPUTE_STORAGE_WRITE);
+		}
+
+		// large CPU-recorded draw lists are split across threads into secondaries; the primary then only executes them
+		bool const useSecondaries = !gpuDriven && recorder.threadCount() > 1 && drawList.size() >= ParallelCommandRecorder::MIN_DRAWS_PER_CHUNK;
+		auto       draw = renderGraph.addPass("rendering", [&](vk::raii::CommandBuffer const& cb) {
+			recordRendering(cb, renderGraph.view(color), renderGraph.view(depth), gpuDriven, meshShading, useSecondaries, shadows);
+		});
+		draw.write(color, RenderGraphAccesses::COLOR_ATTACHMENT_WRITE).write(depth, RenderGraphAccesses::DEPTH_ATTACHMENT_WRITE);
+		if (meshShading)
+		{
+			// the task shaders cull and the mesh shaders draw in the same pass
+			draw.write(count, RenderGraphAccesses::TASK_STORAGE_WRITE).read(lodStates, RenderGraphAccesses::TASK_STORAGE_READ);
+		}
+		else if (gpuDriven)
+		{
+			draw.read(draws, RenderGraphAccesses::INDIRECT_READ).read(count, RenderGraphAccesses::INDIRECT_READ);
+		}
+
+		if (shadows)
+		{
+			// one ray per pixel from the depth attachment towards the light, then the mask darkens the shaded image
+			RenderGraphBuffer const mask = renderGraph.importBuffer("shadow mask", shadowTracer.maskBuffer(frameIndex));
+			RenderGraphBuffer       tlas;
+			if (rayQueryShadows)
+			{
+				tlas = renderGraph.importBuffer("tlas", shadowTracer.accelerationStructureBuffer(frameIndex));
+				renderGraph.addPass("acceleration structures", [&](vk::raii::CommandBuffer const& cb) { shadowTracer.recordBuild(cb, frameIndex, frameValue); })
+					.write(tlas, RenderGraphAccesses::ACCELERATION_STRUCTURE_BUILD);
+			}
+			auto trace = renderGraph.addPass("shadow rays", [&](vk::raii::CommandBuffer const& cb) {
+				shadowTracer.recordTrace(cb, frameIndex, renderGraph.view(depth), frameValue);
+			});
+			trace.read(depth, RenderGraphAccesses::COMPUTE_SAMPLED_READ).write(mask, RenderGraphAccesses::COMPUTE_STORAGE_WRITE);
+			if (rayQueryShadows)
+			{
+				trace.read(tlas, RenderGraphAccesses::COMPUTE_ACCELERATION_STRUCTURE_READ);
+			}
+			renderGraph.addPass("shadow composite", [&](vk::raii::CommandBuffer const& cb) { recordShadowComposite(cb, renderGraph.view(color)); })
+				.read(mask, RenderGraphAccesses::FRAGMENT_STORAGE_READ)
+				.write(color, RenderGraphAccesses::COLOR_ATTACHMENT_BLEND);
+		}
+
+		renderGraph.addPass("texture feedback", [&](vk::raii::CommandBuffer const& cb) { textureStreamer.recordReadback(cb, frameIndex); }).sideEffects();
+
+		renderGraph.execute(commandBuffer, gpuProfiler, frameValue, framePacer.completedValue());
+
+		gpuProfiler.endScope(commandBuffer, frameScope);
+		framePacer.writeFrameEnd(commandBuffer, frameIndex);
+		commandBuffer.end();
+
+		recordMsTotal += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - recordStart).count();
+		recordedFrames++;
+	}
+
+	// The body of the "rendering" pass; the render graph has already put both attachments in their layouts.
+	void recordRendering(vk::raii::CommandBuffer const& commandBuffer, vk::ImageView colorView, vk::ImageView depthView, bool gpuDriven, bool meshShading,
+						 bool useSecondaries, bool storeDepth)
+	{
+		vk::RenderingAttachmentInfo colorAttachment = {
+			.imageView = colorView,
 			.imageLayout = vk::ImageLayout::eColorAttachmentOptimal,
 			.loadOp = vk::AttachmentLoadOp::eClear,
 			.storeOp = vk::AttachmentStoreOp::eStore,
-			.clearValue = clearColor };
+			.clearValue = vk::ClearColorValue(0.0f, 0.0f, 0.0f, 1.0f) };
+		// depth is only stored for the shadow rays to start from
+		vk::RenderingAttachmentInfo depthAttachment = {
+			.imageView = depthView,
+			.imageLayout = vk::ImageLayout::eDepthAttachmentOptimal,
+			.loadOp = vk::AttachmentLoadOp::eClear,
+			.storeOp = storeDepth ? vk::AttachmentStoreOp::eStore : vk::AttachmentStoreOp::eDontCare,
+			.clearValue = vk::ClearDepthStencilValue{ .depth = 1.0f, .stencil = 0 } };
 		vk::RenderingInfo renderingInfo = {
+			.flags = useSecondaries ? vk::RenderingFlagBits::eContentsSecondaryCommandBuffers : vk::RenderingFlags{},
 			.renderArea = {.offset = {0, 0}, .extent = swapChainExtent},
 			.layerCount = 1,
 			.colorAttachmentCount = 1,
-			.pColorAttachments = &attachmentInfo };
+			.pColorAttachments = &colorAttachment,
+			.pDepthAttachment = &depthAttachment };
 		commandBuffer.beginRendering(renderingInfo);
-		commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, *graphicsPipeline);
+		// a null pipeline means neither the variant nor its fallback has finished compiling: skip the draws. The
+		// GPU-driven paths draw every material at once, so they use the variant with all the scene's features.
+		uint32_t const allFeatures = SceneShaderFeatures::variantFor(sceneFeatures);
+		if (meshShading)
+		{
+			if (vk::Pipeline const pipeline = meshletPipeline.family.get(allFeatures))
+			{
+				GpuProfiler::Scope drawScope(gpuProfiler, commandBuffer, "draw mesh tasks");
+				commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);
+				bindlessHeap.bind(commandBuffer, vk::PipelineBindPoint::eGraphics, *meshletPipelineLayout);
+				commandBuffer.setViewport(0, vk::Viewport(0.0f, 0.0f, static_cast<float>(swapChainExtent.width), static_cast<float>(swapChainExtent.height), 0.0f, 1.0f));
+				commandBuffer.setScissor(0, vk::Rect2D(vk::Offset2D(0, 0), swapChainExtent));
+				gpuCuller.drawMeshTasks(commandBuffer, frameIndex, *meshletPipelineLayout);
+			}
+		}
+		else if (gpuDriven)
+		{
+			if (vk::Pipeline const pipeline = trianglePipeline.family.get(allFeatures))
+			{
+				GpuProfiler::Scope drawScope(gpuProfiler, commandBuffer, "draw indirect");
+				bindDrawState(commandBuffer, pipeline);
+				gpuCuller.drawIndirect(commandBuffer, frameIndex);
+			}
+		}
+		else
+		{
+			// resolved here since the pipeline manager is not to be touched by the recording threads
+			ScenePipelines pipelines = {};
+			for (uint32_t variant = 0; variant < pipelines.size(); variant++)
+			{
+				if (usesVariant(variant))
+				{
+					pipelines[variant] = trianglePipeline.family.get(variant);
+				}
+			}
+			if (useSecondaries)
+			{
+				vk::CommandBufferInheritanceRenderingInfo inheritanceRenderingInfo{ .colorAttachmentCount = 1,
+																					.pColorAttachmentFormats = &swapChainSurfaceFormat.format,
+																					.depthAttachmentFormat = DEPTH_FORMAT,
+																					.rasterizationSamples = vk::SampleCountFlagBits::e1 };
+				auto const& secondaries = recorder.record(frameIndex, variantEnds, inheritanceRenderingInfo,
+					[&](vk::raii::CommandBuffer const& secondary, uint32_t first, uint32_t last) { recordDraws(secondary, pipelines, first, last, nullptr); });
+				// each variant's secondaries under its own scope, the same ones recordDraws() opens on the primary
+				uint32_t first = 0;
+				for (size_t run = 0; run < variantEnds.size(); run++)
+				{
+					uint32_t const variant = drawList[first].variant;
+					if (pipelines[variant])
+					{
+						GpuProfiler::Scope variantScope(gpuProfiler, commandBuffer, trianglePipeline.family.name(variant));
+						commandBuffer.executeCommands(vk::ArrayProxy<vk::CommandBuffer const>(static_cast<uint32_t>(secondaries[run].size()), secondaries[run].data()));
+					}
+					first = variantEnds[run];
+				}
+			}
+			else
+			{
+				recordDraws(commandBuffer, pipelines, 0, static_cast<uint32_t>(drawList.size()), &gpuProfiler);
+			}
+		}
+		commandBuffer.endRendering();
+	}
+
+	// The body of the "shadow composite" pass: blends the shadow mask over what "rendering" drew, loading the
+	// color attachment instead of clearing it. Skipped while the composite pipeline is not available.
+	void recordShadowComposite(vk::raii::CommandBuffer const& commandBuffer, vk::ImageView colorView)
+	{
+		vk::Pipeline const pipeline = pipelineManager.get(shadowCompositePipeline);
+		if (!pipeline)
+		{
+			return;
+		}
+		vk::RenderingAttachmentInfo colorAttachment = {
+			.imageView = colorView,
+			.imageLayout = vk::ImageLayout::eColorAttachmentOptimal,
+			.loadOp = vk::AttachmentLoadOp::eLoad,
+			.storeOp = vk::AttachmentStoreOp::eStore };
+		vk::RenderingInfo renderingInfo = {
+			.renderArea = {.offset = {0, 0}, .extent = swapChainExtent},
+			.layerCount = 1,
+			.colorAttachmentCount = 1,
+			.pColorAttachments = &colorAttachment };
+		commandBuffer.beginRendering(renderingInfo);
+		shadowTracer.recordComposite(commandBuffer, frameIndex, pipeline);
+		commandBuffer.endRendering();
+	}
+
+	// Binds everything a draw from the scene arena needs, for the CPU and GPU-driven paths alike.
+	void bindDrawState(vk::raii::CommandBuffer const& commandBuffer, vk::Pipeline pipeline) const
+	{
+		commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);
 		commandBuffer.setViewport(0, vk::Viewport(0.0f, 0.0f, static_cast<float>(swapChainExtent.width), static_cast<float>(swapChainExtent.height), 0.0f, 1.0f));
 		commandBuffer.setScissor(0, vk::Rect2D(vk::Offset2D(0, 0), swapChainExtent));
-		commandBuffer.draw(3, 1, 0, 0);
-		commandBuffer.endRendering();
-		// After rendering, transition the swapchain image to PRESENT_SRC
-		transition_image_layout(
-			imageIndex,
-			vk::ImageLayout::eColorAttachmentOptimal,
-			vk::ImageLayout::ePresentSrcKHR,
-			vk::AccessFlagBits2::eColorAttachmentWrite,                // srcAccessMask
-			{},                                                        // dstAccessMask
-			vk::PipelineStageFlagBits2::eColorAttachmentOutput,        // srcStage
-			vk::PipelineStageFlagBits2::eBottomOfPipe                  // dstStage
-		);
-		commandBuffer.end();
+		commandBuffer.bindVertexBuffers(0, *vertexBuffer, { 0 });
+		commandBuffer.bindIndexBuffer(*indexBuffer, 0, vk::IndexType::eUint32);
+		// one bind per command buffer: materials are switched by index, never by binding descriptor sets
+		bindlessHeap.bind(commandBuffer, vk::PipelineBindPoint::eGraphics, *pipelineLayout);
+		commandBuffer.pushConstants<DrawConstants>(*pipelineLayout, DRAW_CONSTANT_STAGES, 0, drawConstants);
 	}
 
-	void transition_image_layout(
-		uint32_t                imageIndex,
-		vk::ImageLayout         old_layout,
-		vk::ImageLayout         new_layout,
-		vk::AccessFlags2        src_access_mask,
-		vk::AccessFlags2        dst_access_mask,
-		vk::PipelineStageFlags2 src_stage_mask,
-		vk::PipelineStageFlags2 dst_stage_mask)
-	{
-		vk::ImageMemoryBarrier2 barrier = {
-			.srcStageMask = src_stage_mask,
-			.srcAccessMask = src_access_mask,
-			.dstStageMask = dst_stage_mask,
-			.dstAccessMask = dst_access_mask,
-			.oldLayout = old_layout,
-			.newLayout = new_layout,
-			.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-			.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-			.image = swapChainImages[imageIndex],
-			.subresourceRange = {
-				   .aspectMask = vk::ImageAspectFlagBits::eColor,
-				   .baseMipLevel = 0,
-				   .levelCount = 1,
-				   .baseArrayLayer = 0,
-				   .layerCount = 1} };
-		vk::DependencyInfo dependency_info = {
-			.dependencyFlags = {},
-			.imageMemoryBarrierCount = 1,
-			.pImageMemoryBarriers = &barrier };
-		commandBuffers[frameIndex].pipelineBarrier2(dependency_info);
+	[[nodiscard]] bool usesVariant(uint32_t variant) const
+	{
+		return std::ranges::binary_search(drawList, variant, {}, &DrawItem::variant);
+	}
+
+	// Records drawList[first, last) with all the state it needs; called concurrently for secondaries, which
+	// pass no profiler since GpuProfiler scopes are recorded by the owning thread only. Draws come sorted by
+	// variant, so the pipeline changes once per variant; each run of a variant is one profiler scope, which is
+	// what it costs on the GPU. The secondaries are split by variant instead, and recordRendering() wraps each
+	// variant's in the same scope.
+	void recordDraws(vk::raii::CommandBuffer const& commandBuffer, ScenePipelines const& pipelines, uint32_t first, uint32_t last, GpuProfiler* profiler) const
+	{
+		vk::Pipeline bound = nullptr;
+		uint32_t     scope = GpuProfiler::INVALID_SCOPE;
+		uint32_t     scopeVariant = ~0u;
+		for (uint32_t i = first; i < last; i++)
+		{
+			DrawItem const&    draw = drawList[i];
+			vk::Pipeline const pipeline = pipelines[draw.variant];
+			if (!pipeline)
+			{
+				continue;
+			}
+			if (!bound)
+			{
+				bindDrawState(commandBuffer, pipeline);
+			}
+			else if (pipeline != bound)
+			{
+				commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);
+			}
+			bound = pipeline;
+			if (profiler && draw.variant != scopeVariant)
+			{
+				profiler->endScope(commandBuffer, scope);
+				scope = profiler->beginScope(commandBuffer, trianglePipeline.family.name(draw.variant));
+				scopeVariant = draw.variant;
+			}
+			commandBuffer.drawIndexed(draw.indexCount, 1, draw.firstIndex, draw.vertexOffset, draw.firstInstance);
+		}
+		if (profiler)
+		{
+			profiler->endScope(commandBuffer, scope);
+		}
 	}
 
 	void createSyncObjects()
 	{
-		assert(presentCompleteSemaphores.empty() && renderFinishedSemaphores.empty() && inFlightFences.empty());
+		assert(presentCompleteSemaphores.empty() && renderFinishedSemaphores.empty());
 
 		for (size_t i = 0; i < swapChainImages.size(); i++)
 		{
 			renderFinishedSemaphores.emplace_back(device, vk::SemaphoreCreateInfo());
 		}
 
-		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+		for (size_t i = 0; i < config.framesInFlight; i++)
 		{
 			presentCompleteSemaphores.emplace_back(device, vk::SemaphoreCreateInfo());
-			inFlightFences.emplace_back(device, vk::FenceCreateInfo{ .flags = vk::FenceCreateFlagBits::eSignaled });
 		}
+
+		framePacer.init(device, physicalDevice, queueIndex, config.framesInFlight);
+		if (computeQueueIndex != ~0)
+		{
+			asyncCompute.init(device, physicalDevice, computeQueue, computeQueueIndex, queueIndex, config.framesInFlight);
+		}
+		frameArenas.init(config.framesInFlight);
 	}
 
 	void drawFrame()
 	{
-		// Note: inFlightFences, presentCompleteSemaphores, and commandBuffers are indexed by frameIndex,
+		// Note: presentCompleteSemaphores and commandBuffers are indexed by frameIndex,
 		//       while renderFinishedSemaphores is indexed by imageIndex
-		while (vk::Result::eTimeout == device.waitForFences(*inFlightFences[frameIndex], vk::True, UINT64_MAX))
-			;
-		device.resetFences(*inFlightFences[frameIndex]);
+		// The only CPU block per frame: waiting for the frame that last used this slot, framesInFlight frames
+		// back, so everything after it (uploads, recording) overlaps the GPU executing the frames in between.
+		uint64_t const frameValue = framePacer.waitForSlot(frameIndex);
+		FrameArena&    frameArena = frameArenas.begin(frameIndex);
+		uniformRing.beginFrame(frameIndex);
+		gpuProfiler.resolve(frameIndex);
+		gpuCuller.collect(frameIndex);
+		shadowTracer.collect(frameIndex);
+		textureStreamer.collect(frameIndex);
+		uploads.reclaim();
+		bindlessHeap.recycle(framePacer.completedValue());
+		pipelineManager.recycle(framePacer.completedValue());
+		gpuCuller.recycle(framePacer.completedValue());
+		shadowTracer.recycle(framePacer.completedValue());
+		reloadShaders(frameValue);
+		releaseRetiredSwapChains(framePacer.completedValue());
+
+		if (config.headless)
+		{
+			drawOffscreenFrame(frameValue, frameArena);
+			return;
+		}
+		presentControl.beginFrame(swapChain);
 
 		auto [result, imageIndex] = swapChain.acquireNextImage(UINT64_MAX, *presentCompleteSemaphores[frameIndex], nullptr);
 
@@ -519,23 +2261,18 @@ private:
 			throw std::runtime_error("failed to acquire swap chain image!");
 		}
 
-		device.resetFences(*inFlightFences[frameIndex]);
+		uint64_t const uploadValue = uploads.flush();
 		commandBuffers[frameIndex].reset();
-		recordCommandBuffer(imageIndex);
-
-		vk::PipelineStageFlags waitDestinationStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput);
-		const vk::SubmitInfo   submitInfo{ .waitSemaphoreCount = 1,
-										  .pWaitSemaphores = &*presentCompleteSemaphores[frameIndex],
-										  .pWaitDstStageMask = &waitDestinationStageMask,
-										  .commandBufferCount = 1,
-										  .pCommandBuffers = &*commandBuffers[frameIndex],
-										  .signalSemaphoreCount = 1,
-										  .pSignalSemaphores = &*renderFinishedSemaphores[imageIndex] };
-		queue.submit(submitInfo, *inFlightFences[frameIndex]);
+		recordCommandBuffer(imageIndex, frameValue, frameArena);
+
+		submitFrame(*presentCompleteSemaphores[frameIndex], *renderFinishedSemaphores[imageIndex], uploadValue, frameValue);
 
 		try
 		{
-			const vk::PresentInfoKHR presentInfoKHR{ .waitSemaphoreCount = 1,
+			uint64_t const           presentId = presentControl.beginPresent();
+			vk::PresentIdKHR const   presentIdInfo{ .swapchainCount = 1, .pPresentIds = &presentId };
+			const vk::PresentInfoKHR presentInfoKHR{ .pNext = presentControl.waitsForPresents() ? &presentIdInfo : nullptr,
+													.waitSemaphoreCount = 1,
 													.pWaitSemaphores = &*renderFinishedSemaphores[imageIndex],
 													.swapchainCount = 1,
 													.pSwapchains = &*swapChain,
@@ -550,38 +2287,90 @@ private:
 			{
 				throw std::runtime_error("failed to present swap chain image!");
 			}
+			else if (recreateStart)
+			{
+				double const hitchMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - *recreateStart).count();
+				recreateStats.hitches++;
+				recreateStats.hitchMsTotal += hitchMs;
+				recreateStats.maxHitchMs = std::max(recreateStats.maxHitchMs, hitchMs);
+				recreateStart.reset();
+			}
 		}
 		catch (const vk::SystemError& e)
 		{
 			if (e.code().value() == static_cast<int>(vk::Result::eErrorOutOfDateKHR))
 			{
+				// the frame was submitted, so it moves on to the next slot like any other
 				recreateSwapChain();
-				return;
 			}
 			else
 			{
 				throw;
 			}
 		}
-		frameIndex = (frameIndex + 1) % MAX_FRAMES_IN_FLIGHT;
+		frameIndex = (frameIndex + 1) % config.framesInFlight;
+		frameArenas.end();
 	}
 
-	[[nodiscard]] vk::raii::ShaderModule createShaderModule(const std::vector<char>& code) const
+	void drawOffscreenFrame(uint64_t frameValue, FrameArena& frameArena)
 	{
-		vk::ShaderModuleCreateInfo createInfo{ .codeSize = code.size() * sizeof(char), .pCode = reinterpret_cast<const uint32_t*>(code.data()) };
-		vk::raii::ShaderModule     shaderModule{ device, createInfo };
+		// offscreen targets are indexed by frameIndex, and nothing waits on acquire or signals for present
+		uint32_t const imageIndex = frameIndex;
 
-		return shaderModule;
+		uint64_t const uploadValue = uploads.flush();
+		commandBuffers[frameIndex].reset();
+		recordCommandBuffer(imageIndex, frameValue, frameArena);
+
+		submitFrame(nullptr, nullptr, uploadValue, frameValue);
+
+		frameIndex = (frameIndex + 1) % config.framesInFlight;
+		frameArenas.end();
 	}
 
-	static uint32_t chooseSwapMinImageCount(vk::SurfaceCapabilitiesKHR const& surfaceCapabilities)
+	// Submits commandBuffers[frameIndex], optionally waiting for an acquired image and this frame's uploads,
+	// and signals frameValue on the frame timeline plus, when presenting, a semaphore for present. The frame's
+	// cull goes to the async compute queue first, and the graphics work waits for it at the indirect draw only.
+	void submitFrame(vk::Semaphore imageAvailable, vk::Semaphore renderFinished, uint64_t uploadValue, uint64_t frameValue)
 	{
-		auto minImageCount = std::max(3u, surfaceCapabilities.minImageCount);
-		if ((0 < surfaceCapabilities.maxImageCount) && (surfaceCapabilities.maxImageCount < minImageCount))
+		std::array<vk::SemaphoreSubmitInfo, 3> waitInfos;
+		uint32_t                               waitCount = 0;
+		if (imageAvailable)
+		{
+			waitInfos[waitCount++] = { .semaphore = imageAvailable, .stageMask = vk::PipelineStageFlagBits2::eColorAttachmentOutput };
+		}
+		if (uploadValue != 0)
 		{
-			minImageCount = surfaceCapabilities.maxImageCount;
+			waitInfos[waitCount++] = { .semaphore = uploads.timeline(), .value = uploadValue, .stageMask = vk::PipelineStageFlagBits2::eAllCommands };
 		}
-		return minImageCount;
+		if (cullsOnComputeQueue())
+		{
+			asyncCompute.submit(frameIndex, uploads.timeline(), uploadValue, frameValue);
+			waitInfos[waitCount++] = { .semaphore = asyncCompute.semaphore(), .value = frameValue, .stageMask = vk::PipelineStageFlagBits2::eDrawIndirect };
+		}
+		std::array<vk::SemaphoreSubmitInfo, 2> signalInfos;
+		uint32_t                               signalCount = 0;
+		signalInfos[signalCount++] = { .semaphore = framePacer.semaphore(), .value = frameValue, .stageMask = vk::PipelineStageFlagBits2::eAllCommands };
+		if (renderFinished)
+		{
+			signalInfos[signalCount++] = { .semaphore = renderFinished, .stageMask = vk::PipelineStageFlagBits2::eAllCommands };
+		}
+		vk::CommandBufferSubmitInfo commandBufferInfo{ .commandBuffer = *commandBuffers[frameIndex] };
+		vk::SubmitInfo2             submitInfo{ .waitSemaphoreInfoCount = waitCount,
+												.pWaitSemaphoreInfos = waitInfos.data(),
+												.commandBufferInfoCount = 1,
+												.pCommandBufferInfos = &commandBufferInfo,
+												.signalSemaphoreInfoCount = signalCount,
+												.pSignalSemaphoreInfos = signalInfos.data() };
+		queue.submit2(submitInfo);
+		framePacer.frameSubmitted(frameIndex, frameValue);
+	}
+
+	[[nodiscard]] vk::raii::ShaderModule createShaderModule(const std::vector<char>& code) const
+	{
+		vk::ShaderModuleCreateInfo createInfo{ .codeSize = code.size() * sizeof(char), .pCode = reinterpret_cast<const uint32_t*>(code.data()) };
+		vk::raii::ShaderModule     shaderModule{ device, createInfo };
+
+		return shaderModule;
 	}
 
 	static vk::SurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<vk::SurfaceFormatKHR>& availableFormats)
@@ -593,15 +2382,6 @@ private:
 		return formatIt != availableFormats.end() ? *formatIt : availableFormats[0];
 	}
 
-	static vk::PresentModeKHR chooseSwapPresentMode(const std::vector<vk::PresentModeKHR>& availablePresentModes)
-	{
-		assert(std::ranges::any_of(availablePresentModes, [](auto presentMode) { return presentMode == vk::PresentModeKHR::eFifo; }));
-		return std::ranges::any_of(availablePresentModes,
-			[](const vk::PresentModeKHR value) { return vk::PresentModeKHR::eMailbox == value; }) ?
-			vk::PresentModeKHR::eMailbox :
-			vk::PresentModeKHR::eFifo;
-	}
-
 	vk::Extent2D chooseSwapExtent(const vk::SurfaceCapabilitiesKHR& capabilities)
 	{
 		if (capabilities.currentExtent.width != 0xFFFFFFFF)
@@ -618,10 +2398,14 @@ private:
 
 	std::vector<const char*> getRequiredExtensions()
 	{
-		uint32_t glfwExtensionCount = 0;
-		auto     glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-
-		std::vector extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+		// headless mode never creates a surface, so it skips GLFW's VK_KHR_surface and platform surface extensions
+		std::vector<const char*> extensions;
+		if (!config.headless)
+		{
+			uint32_t glfwExtensionCount = 0;
+			auto     glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+			extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+		}
 		if (enableValidationLayers)
 		{
 			extensions.push_back(vk::EXTDebugUtilsExtensionName);
@@ -655,11 +2439,182 @@ private:
 	}
 };
 
-int main()
+static AppConfig parseArguments(int argc, char** argv)
+{
+	AppConfig config;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string const arg = argv[i];
+		if (arg == "--headless")
+		{
+			config.headless = true;
+		}
+		else if (arg == "--frames" && i + 1 < argc)
+		{
+			config.frameCount = static_cast<uint32_t>(std::stoul(argv[++i]));
+		}
+		else if (arg == "--profile")
+		{
+			config.profileGpu = true;
+		}
+		else if (arg == "--pipeline-cache" && i + 1 < argc)
+		{
+			config.pipelineCachePath = argv[++i];
+		}
+		else if (arg == "--no-pipeline-cache")
+		{
+			config.pipelineCachePath.clear();
+		}
+		else if (arg == "--no-shader-reload")
+		{
+			config.shaderCompiler.clear();
+		}
+		else if (arg == "--check-allocations")
+		{
+			config.checkFrameAllocations = true;
+		}
+		else if (arg == "--draws" && i + 1 < argc)
+		{
+			config.drawCount = static_cast<uint32_t>(std::stoul(argv[++i]));
+		}
+		else if (arg == "--cpu-draws")
+		{
+			config.gpuCulling = false;
+		}
+		else if (arg == "--no-mesh-shaders")
+		{
+			config.meshShaders = false;
+		}
+		else if (arg == "--record-threads" && i + 1 < argc)
+		{
+			config.recordThreads = std::max(1u, static_cast<uint32_t>(std::stoul(argv[++i])));
+		}
+		else if (arg == "--present-mode" && i + 1 < argc)
+		{
+			config.presentSettings.mode = parsePresentMode(argv[++i]);
+			if (!config.presentSettings.mode)
+			{
+				throw std::runtime_error("unknown present mode: " + std::string(argv[i]) + " (immediate, mailbox, fifo or fifo-relaxed)");
+			}
+		}
+		else if (arg == "--max-fps" && i + 1 < argc)
+		{
+			config.presentSettings.maxFrameRate = std::stod(argv[++i]);
+		}
+		else if (arg == "--max-queued-presents" && i + 1 < argc)
+		{
+			config.presentSettings.maxQueuedPresents = static_cast<uint32_t>(std::stoul(argv[++i]));
+		}
+		else if (arg == "--no-lod")
+		{
+			config.lodEnabled = false;
+		}
+		else if (arg == "--scene-graph-threads" && i + 1 < argc)
+		{
+			config.sceneGraphThreads = std::max(1u, static_cast<uint32_t>(std::stoul(argv[++i])));
+		}
+		else if (arg == "--no-async-compute")
+		{
+			config.asyncCompute = false;
+		}
+		else if (arg == "--shadows" && i + 1 < argc)
+		{
+			std::string const mode = argv[++i];
+			if (mode == "auto")
+			{
+				config.shadows = ShadowMode::eAuto;
+			}
+			else if (mode == "ray-query")
+			{
+				config.shadows = ShadowMode::eRayQuery;
+			}
+			else if (mode == "bvh")
+			{
+				config.shadows = ShadowMode::eBvh;
+			}
+			else if (mode == "off")
+			{
+				config.shadows = ShadowMode::eOff;
+			}
+			else
+			{
+				throw std::runtime_error("unknown shadow mode: " + mode + " (auto, ray-query, bvh or off)");
+			}
+		}
+		else if (arg == "--camera-path" && i + 1 < argc)
+		{
+			std::string const path = argv[++i];
+			if (path == "fixed")
+			{
+				config.cameraPath = CameraPath::eFixed;
+			}
+			else if (path == "orbit")
+			{
+				config.cameraPath = CameraPath::eOrbit;
+			}
+			else if (path == "orbit-all")
+			{
+				config.cameraPath = CameraPath::eOrbitAll;
+			}
+			else
+			{
+				throw std::runtime_error("unknown camera path: " + path + " (fixed, orbit or orbit-all)");
+			}
+		}
+		else if (arg == "--bench-json" && i + 1 < argc)
+		{
+			config.benchmarkJsonPath = argv[++i];
+		}
+		else if (arg == "--device" && i + 1 < argc)
+		{
+			config.deviceName = argv[++i];
+		}
+		else if (arg == "--scene" && i + 1 < argc)
+		{
+			config.scenePath = argv[++i];
+		}
+		else if (arg == "--scene-scale" && i + 1 < argc)
+		{
+			config.importSettings.scale = std::stof(argv[++i]);
+		}
+		else if (arg == "--mesh-cache" && i + 1 < argc)
+		{
+			config.meshCacheDir = argv[++i];
+		}
+		else if (arg == "--no-mesh-cache")
+		{
+			config.meshCacheDir.clear();
+		}
+		else if (arg == "--frames-in-flight" && i + 1 < argc)
+		{
+			config.framesInFlight = std::max(1u, static_cast<uint32_t>(std::stoul(argv[++i])));
+		}
+		else if (arg == "--texture-budget" && i + 1 < argc)
+		{
+			config.textureSettings.budgetBytes = std::stoull(argv[++i]) * 1024 * 1024;
+		}
+		else if (arg == "--texture-upload" && i + 1 < argc)
+		{
+			config.textureSettings.uploadBytesPerFrame = std::stoull(argv[++i]) * 1024 * 1024;
+		}
+		else
+		{
+			throw std::runtime_error("unknown argument: " + arg + "\nusage: rstd [--headless] [--frames N] [--profile] [--check-allocations] [--pipeline-cache PATH | --no-pipeline-cache]\n"
+									 "            [--no-shader-reload] [--draws N] [--cpu-draws] [--no-mesh-shaders] [--record-threads N] [--frames-in-flight N]\n"
+									 "            [--present-mode immediate|mailbox|fifo|fifo-relaxed] [--max-fps N] [--max-queued-presents N]\n"
+									 "            [--no-lod] [--scene-graph-threads N] [--no-async-compute] [--scene PATH] [--scene-scale S]\n"
+									 "            [--mesh-cache DIR | --no-mesh-cache] [--texture-budget MiB] [--texture-upload MiB]\n"
+									 "            [--shadows auto|ray-query|bvh|off] [--camera-path fixed|orbit|orbit-all] [--bench-json PATH] [--device NAME]");
+		}
+	}
+	return config;
+}
+
+int main(int argc, char** argv)
 {
 	try
 	{
-		HelloTriangleApplication app;
+		HelloTriangleApplication app(parseArguments(argc, argv));
 		app.run();
 	}
 	catch (const std::exception& e)
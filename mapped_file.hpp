@@ -0,0 +1,169 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#ifdef _WIN32
+#	ifndef NOMINMAX
+#		define NOMINMAX
+#	endif
+#	include <windows.h>
+#	include <psapi.h>
+#else
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#	include <sys/resource.h>
+#	include <sys/stat.h>
+#	include <unistd.h>
+#endif
+
+// Read-only memory mapping of a whole file. Pages are faulted in on first touch, so parsers can walk large
+// files without reading them into an intermediate buffer first; the mapping lives as long as the object.
+class MappedFile
+{
+public:
+	MappedFile() = default;
+
+	explicit MappedFile(std::string const& path)
+	{
+#ifdef _WIN32
+		file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			throw std::runtime_error("failed to open file: " + path);
+		}
+		LARGE_INTEGER fileSize;
+		GetFileSizeEx(file, &fileSize);
+		length = static_cast<size_t>(fileSize.QuadPart);
+		if (length > 0)
+		{
+			mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			bytes = mapping ? static_cast<std::byte const*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+			if (!bytes)
+			{
+				release();
+				throw std::runtime_error("failed to map file: " + path);
+			}
+		}
+#else
+		int const fd = open(path.c_str(), O_RDONLY);
+		if (fd < 0)
+		{
+			throw std::runtime_error("failed to open file: " + path);
+		}
+		struct stat fileStat = {};
+		if (fstat(fd, &fileStat) != 0)
+		{
+			close(fd);
+			throw std::runtime_error("failed to stat file: " + path);
+		}
+		length = static_cast<size_t>(fileStat.st_size);
+		if (length > 0)
+		{
+			void* const address = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (address == MAP_FAILED)
+			{
+				close(fd);
+				throw std::runtime_error("failed to map file: " + path);
+			}
+			// parsers walk the file front to back; let the kernel read ahead aggressively
+			madvise(address, length, MADV_SEQUENTIAL);
+			bytes = static_cast<std::byte const*>(address);
+		}
+		close(fd);
+#endif
+	}
+
+	MappedFile(MappedFile&& other) noexcept :
+		bytes(std::exchange(other.bytes, nullptr)), length(std::exchange(other.length, 0))
+#ifdef _WIN32
+		, file(std::exchange(other.file, INVALID_HANDLE_VALUE)), mapping(std::exchange(other.mapping, nullptr))
+#endif
+	{}
+
+	MappedFile& operator=(MappedFile&& other) noexcept
+	{
+		if (this != &other)
+		{
+			release();
+			bytes = std::exchange(other.bytes, nullptr);
+			length = std::exchange(other.length, 0);
+#ifdef _WIN32
+			file = std::exchange(other.file, INVALID_HANDLE_VALUE);
+			mapping = std::exchange(other.mapping, nullptr);
+#endif
+		}
+		return *this;
+	}
+
+	~MappedFile()
+	{
+		release();
+	}
+
+	[[nodiscard]] std::byte const* data() const
+	{
+		return bytes;
+	}
+
+	[[nodiscard]] size_t size() const
+	{
+		return length;
+	}
+
+private:
+	std::byte const* bytes = nullptr;
+	size_t           length = 0;
+#ifdef _WIN32
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = nullptr;
+#endif
+
+	void release()
+	{
+#ifdef _WIN32
+		if (bytes)
+		{
+			UnmapViewOfFile(bytes);
+		}
+		if (mapping)
+		{
+			CloseHandle(mapping);
+		}
+		if (file != INVALID_HANDLE_VALUE)
+		{
+			CloseHandle(file);
+		}
+		file = INVALID_HANDLE_VALUE;
+		mapping = nullptr;
+#else
+		if (bytes)
+		{
+			munmap(const_cast<std::byte*>(bytes), length);
+		}
+#endif
+		bytes = nullptr;
+		length = 0;
+	}
+};
+
+// Peak resident set size of the process so far, in bytes.
+inline uint64_t peakResidentBytes()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters = {};
+	GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+	return counters.PeakWorkingSetSize;
+#else
+	struct rusage usage = {};
+	getrusage(RUSAGE_SELF, &usage);
+#	ifdef __APPLE__
+	return static_cast<uint64_t>(usage.ru_maxrss);
+#	else
+	return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+#	endif
+#endif
+}
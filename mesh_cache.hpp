@@ -0,0 +1,520 @@
+#pragma once
+
+#include "lod_builder.hpp"
+#include "mapped_file.hpp"
+#include "scene_loader.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+enum class MeshCacheSectionType : uint32_t
+{
+	eSources = 1,   // files the cache was baked from, for invalidation (variable-size records, elementSize 1)
+	eDraws = 2,     // SceneDraw: arena ranges and world-space bounds
+	eVertices = 3,  // SceneVertex, interleaved
+	eIndices = 4,   // uint32_t, local to each draw
+	eMaterials = 5, // SceneMaterial
+	eTextures = 6,  // MeshCacheTexture records (variable-size records, elementSize 1)
+	eLodChains = 7, // SceneLodChain, one per draw
+	eLodIndices = 8 // uint32_t, the simplified levels' indices, local to each draw
+};
+
+struct MeshCacheHeader
+{
+	uint32_t             magic = 0;
+	uint32_t             version = 0;
+	uint64_t             settingsHash = 0;
+	uint32_t             sectionCount = 0;
+	uint32_t             vertexSize = 0;
+	std::array<float, 3> boundsMin = {};
+	std::array<float, 3> boundsMax = {};
+};
+
+struct MeshCacheSection
+{
+	MeshCacheSectionType type = MeshCacheSectionType::eSources;
+	uint32_t             elementSize = 0;
+	uint64_t             offset = 0; // from the start of the file, SECTION_ALIGNMENT aligned
+	uint64_t             count = 0;
+};
+
+// Followed by pathLength bytes of path, padded to 8 bytes.
+struct MeshCacheSource
+{
+	uint64_t size = 0;
+	int64_t  modified = 0;
+	uint64_t contentHash = 0;
+	uint32_t pathLength = 0;
+	uint32_t reserved = 0;
+};
+
+// A SceneTexture, followed by pathLength bytes of path, padded to 8 bytes. Only the reference is cached: images
+// are decoded from their own files when streamed.
+struct MeshCacheTexture
+{
+	uint64_t offset = 0;
+	uint64_t size = 0;
+	uint32_t pathLength = 0;
+	uint32_t reserved = 0;
+};
+
+// A scene baked into one file: a versioned header, a section table and aligned sections holding exactly what
+// the GPU consumes, LOD chains included, so loading is a single mmap and the vertex and index sections are
+// copied into the staging ring as-is. A cache is keyed by its import settings and by the size, modification
+// time and content hash of every source file; when a size or time changed the content is rehashed, so touching
+// a file does not force a rebake. Files are written in host byte order, to a temporary file that is renamed into place. The reader
+// offers the same interface as SceneSource.
+class MeshCache
+{
+public:
+	static constexpr uint32_t MAGIC = 0x48534D52; // "RMSH"
+	static constexpr uint32_t VERSION = 4;
+	static constexpr uint64_t SECTION_ALIGNMENT = 64;
+
+	// One cache file per (source path, import settings) pair under cacheDirectory.
+	static std::filesystem::path pathFor(std::filesystem::path const& cacheDirectory, std::string const& sourcePath, SceneImportSettings const& settings)
+	{
+		std::string const absolute = std::filesystem::absolute(sourcePath).lexically_normal().string();
+		uint64_t const    key = hashBytes(reinterpret_cast<std::byte const*>(absolute.data()), absolute.size()) ^ settings.hash();
+		char              name[17];
+		snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(key));
+		return cacheDirectory / (std::filesystem::path(sourcePath).stem().string() + "-" + name + ".rmesh");
+	}
+
+	// Maps cachePath and checks it against the settings and the sources it was baked from. Returns nullopt
+	// when there is no cache or it is stale.
+	static std::optional<MeshCache> open(std::filesystem::path const& cachePath, SceneImportSettings const& settings)
+	{
+		std::error_code error;
+		if (!std::filesystem::exists(cachePath, error))
+		{
+			return std::nullopt;
+		}
+
+		MeshCache cache;
+		cache.file = MappedFile(cachePath.string());
+		if (!cache.parse(settings))
+		{
+			std::cerr << "mesh cache: " << cachePath << " is invalid or was baked with other settings, rebuilding it" << std::endl;
+			return std::nullopt;
+		}
+		if (!cache.sourcesUnchanged(cachePath))
+		{
+			std::cerr << "mesh cache: sources of " << cachePath << " changed, rebuilding it" << std::endl;
+			return std::nullopt;
+		}
+		return cache;
+	}
+
+	// Bakes scene and its LOD chains into cachePath. Failures are reported and leave any previous cache in place.
+	static bool write(std::filesystem::path const& cachePath, SceneSource const& scene, SceneLods const& lods, SceneImportSettings const& settings)
+	{
+		std::vector<std::byte> sources;
+		for (std::string const& sourcePath : scene.sourceFiles())
+		{
+			std::string const absolute = std::filesystem::absolute(sourcePath).lexically_normal().string();
+			MappedFile const  sourceFile(absolute);
+			MeshCacheSource   record{ .size = sourceFile.size(),
+									  .modified = modificationTime(absolute),
+									  .contentHash = hashBytes(sourceFile.data(), sourceFile.size()),
+									  .pathLength = static_cast<uint32_t>(absolute.size()) };
+			appendBytes(sources, &record, sizeof(record));
+			appendBytes(sources, absolute.data(), absolute.size());
+			sources.resize(alignUp(sources.size(), 8));
+		}
+
+		std::vector<std::byte> textures;
+		for (SceneTexture const& texture : scene.textures())
+		{
+			MeshCacheTexture const record{ .offset = texture.offset, .size = texture.size, .pathLength = static_cast<uint32_t>(texture.path.size()) };
+			appendBytes(textures, &record, sizeof(record));
+			appendBytes(textures, texture.path.data(), texture.path.size());
+			textures.resize(alignUp(textures.size(), 8));
+		}
+
+		std::array<MeshCacheSection, 8> sections = { {
+			{ .type = MeshCacheSectionType::eSources, .elementSize = 1, .count = sources.size() },
+			{ .type = MeshCacheSectionType::eDraws, .elementSize = sizeof(SceneDraw), .count = scene.draws().size() },
+			{ .type = MeshCacheSectionType::eVertices, .elementSize = sizeof(SceneVertex), .count = scene.vertexCount() },
+			{ .type = MeshCacheSectionType::eIndices, .elementSize = sizeof(uint32_t), .count = scene.indexCount() },
+			{ .type = MeshCacheSectionType::eMaterials, .elementSize = sizeof(SceneMaterial), .count = scene.materials().size() },
+			{ .type = MeshCacheSectionType::eTextures, .elementSize = 1, .count = textures.size() },
+			{ .type = MeshCacheSectionType::eLodChains, .elementSize = sizeof(SceneLodChain), .count = lods.chains().size() },
+			{ .type = MeshCacheSectionType::eLodIndices, .elementSize = sizeof(uint32_t), .count = lods.indexCount() },
+		} };
+		uint64_t offset = alignUp(sizeof(MeshCacheHeader) + sizeof(sections), SECTION_ALIGNMENT);
+		for (auto& section : sections)
+		{
+			section.offset = offset;
+			offset = alignUp(offset + section.elementSize * section.count, SECTION_ALIGNMENT);
+		}
+		MeshCacheHeader const header{ .magic = MAGIC,
+									  .version = VERSION,
+									  .settingsHash = settings.hash(),
+									  .sectionCount = static_cast<uint32_t>(sections.size()),
+									  .vertexSize = sizeof(SceneVertex),
+									  .boundsMin = scene.getBoundsMin(),
+									  .boundsMax = scene.getBoundsMax() };
+
+		std::error_code error;
+		std::filesystem::create_directories(cachePath.parent_path(), error);
+		std::filesystem::path const tempPath = cachePath.string() + ".tmp";
+		{
+			std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+			auto          put = [&](void const* data, uint64_t size) { out.write(static_cast<char const*>(data), static_cast<std::streamsize>(size)); };
+			auto          pad = [&](uint64_t to) {
+				static constexpr char zeros[SECTION_ALIGNMENT] = {};
+				put(zeros, to - static_cast<uint64_t>(out.tellp()));
+			};
+
+			put(&header, sizeof(header));
+			put(sections.data(), sizeof(sections));
+			pad(sections[0].offset);
+			put(sources.data(), sources.size());
+			pad(sections[1].offset);
+			put(scene.draws().data(), scene.draws().size() * sizeof(SceneDraw));
+
+			// vertices and indices are converted in bounded chunks rather than materialized whole
+			std::vector<SceneVertex> vertexChunk(std::min<uint64_t>(scene.vertexCount(), CHUNK_ELEMENTS));
+			pad(sections[2].offset);
+			for (uint64_t first = 0; first < scene.vertexCount(); first += vertexChunk.size())
+			{
+				uint64_t const count = std::min<uint64_t>(vertexChunk.size(), scene.vertexCount() - first);
+				scene.writeVertices(first, count, vertexChunk.data());
+				put(vertexChunk.data(), count * sizeof(SceneVertex));
+			}
+			std::vector<uint32_t> indexChunk(std::min<uint64_t>(scene.indexCount(), CHUNK_ELEMENTS));
+			pad(sections[3].offset);
+			for (uint64_t first = 0; first < scene.indexCount(); first += indexChunk.size())
+			{
+				uint64_t const count = std::min<uint64_t>(indexChunk.size(), scene.indexCount() - first);
+				scene.writeIndices(first, count, indexChunk.data());
+				put(indexChunk.data(), count * sizeof(uint32_t));
+			}
+			pad(sections[4].offset);
+			put(scene.materials().data(), scene.materials().size() * sizeof(SceneMaterial));
+			pad(sections[5].offset);
+			put(textures.data(), textures.size());
+			pad(sections[6].offset);
+			put(lods.chains().data(), lods.chains().size() * sizeof(SceneLodChain));
+			pad(sections[7].offset);
+			put(lods.indices().data(), lods.indexCount() * sizeof(uint32_t));
+
+			if (!out)
+			{
+				std::cerr << "mesh cache: failed to write " << tempPath << std::endl;
+				out.close();
+				std::filesystem::remove(tempPath, error);
+				return false;
+			}
+		}
+
+		std::filesystem::rename(tempPath, cachePath, error);
+		if (error)
+		{
+			std::cerr << "mesh cache: failed to replace " << cachePath << ": " << error.message() << std::endl;
+			std::filesystem::remove(tempPath, error);
+			return false;
+		}
+		return true;
+	}
+
+	[[nodiscard]] uint64_t vertexCount() const
+	{
+		return vertices.count;
+	}
+
+	[[nodiscard]] uint64_t indexCount() const
+	{
+		return indices.count;
+	}
+
+	[[nodiscard]] std::vector<SceneDraw> const& draws() const
+	{
+		return drawList;
+	}
+
+	[[nodiscard]] std::vector<SceneMaterial> const& materials() const
+	{
+		return materialList;
+	}
+
+	[[nodiscard]] std::vector<SceneTexture> const& textures() const
+	{
+		return textureList;
+	}
+
+	[[nodiscard]] SceneLods const& lods() const
+	{
+		return lodList;
+	}
+
+	[[nodiscard]] std::array<float, 3> const& getBoundsMin() const
+	{
+		return header.boundsMin;
+	}
+
+	[[nodiscard]] std::array<float, 3> const& getBoundsMax() const
+	{
+		return header.boundsMax;
+	}
+
+	[[nodiscard]] bool isMapped() const
+	{
+		return true;
+	}
+
+	void writeVertices(uint64_t first, uint64_t count, SceneVertex* out) const
+	{
+		memcpy(out, file.data() + vertices.offset + first * sizeof(SceneVertex), count * sizeof(SceneVertex));
+	}
+
+	void writeIndices(uint64_t first, uint64_t count, uint32_t* out) const
+	{
+		memcpy(out, file.data() + indices.offset + first * sizeof(uint32_t), count * sizeof(uint32_t));
+	}
+
+private:
+	static constexpr uint64_t CHUNK_ELEMENTS = 64 * 1024;
+
+	static_assert(std::is_trivially_copyable_v<SceneVertex> && std::is_trivially_copyable_v<SceneDraw> && std::is_trivially_copyable_v<SceneMaterial> &&
+				  std::is_trivially_copyable_v<SceneLodChain>);
+
+	MappedFile                 file;
+	MeshCacheHeader            header;
+	MeshCacheSection           sources;
+	MeshCacheSection           vertices;
+	MeshCacheSection           indices;
+	std::vector<SceneDraw>     drawList;
+	std::vector<SceneMaterial> materialList;
+	std::vector<SceneTexture>  textureList;
+	SceneLods                  lodList;
+
+	bool parse(SceneImportSettings const& settings)
+	{
+		if (file.size() < sizeof(MeshCacheHeader))
+		{
+			return false;
+		}
+		memcpy(&header, file.data(), sizeof(header));
+		if (header.magic != MAGIC || header.version != VERSION || header.settingsHash != settings.hash() || header.vertexSize != sizeof(SceneVertex) ||
+			sizeof(MeshCacheHeader) + uint64_t(header.sectionCount) * sizeof(MeshCacheSection) > file.size())
+		{
+			return false;
+		}
+
+		std::optional<MeshCacheSection> draws;
+		std::optional<MeshCacheSection> materials;
+		std::optional<MeshCacheSection> textures;
+		std::optional<MeshCacheSection> lodChains;
+		std::optional<MeshCacheSection> lodIndices;
+		for (uint32_t i = 0; i < header.sectionCount; i++)
+		{
+			MeshCacheSection section;
+			memcpy(&section, file.data() + sizeof(MeshCacheHeader) + i * sizeof(MeshCacheSection), sizeof(section));
+			if (section.elementSize == 0 || section.count > file.size() / section.elementSize || section.offset > file.size() - section.count * section.elementSize)
+			{
+				return false;
+			}
+			// unknown sections are skipped, so later versions can add data without breaking older readers' layout
+			switch (section.type)
+			{
+			case MeshCacheSectionType::eSources:
+				sources = section;
+				break;
+			case MeshCacheSectionType::eDraws:
+				draws = section;
+				break;
+			case MeshCacheSectionType::eVertices:
+				vertices = section;
+				break;
+			case MeshCacheSectionType::eIndices:
+				indices = section;
+				break;
+			case MeshCacheSectionType::eMaterials:
+				materials = section;
+				break;
+			case MeshCacheSectionType::eTextures:
+				textures = section;
+				break;
+			case MeshCacheSectionType::eLodChains:
+				lodChains = section;
+				break;
+			case MeshCacheSectionType::eLodIndices:
+				lodIndices = section;
+				break;
+			}
+		}
+		if (!draws || draws->elementSize != sizeof(SceneDraw) || vertices.elementSize != sizeof(SceneVertex) || indices.elementSize != sizeof(uint32_t) ||
+			!materials || materials->elementSize != sizeof(SceneMaterial) || !textures || !lodChains || lodChains->elementSize != sizeof(SceneLodChain) ||
+			!lodIndices || lodIndices->elementSize != sizeof(uint32_t) || sources.count == 0)
+		{
+			return false;
+		}
+
+		uint64_t offset = 0;
+		while (offset + sizeof(MeshCacheTexture) <= textures->count)
+		{
+			MeshCacheTexture record;
+			memcpy(&record, file.data() + textures->offset + offset, sizeof(record));
+			offset += sizeof(record);
+			if (record.pathLength > textures->count - offset)
+			{
+				return false;
+			}
+			textureList.push_back({ .path = std::string(reinterpret_cast<char const*>(file.data() + textures->offset + offset), record.pathLength),
+									.offset = record.offset,
+									.size = record.size });
+			offset = alignUp(offset + record.pathLength, 8);
+		}
+		materialList.resize(materials->count);
+		memcpy(materialList.data(), file.data() + materials->offset, materials->count * sizeof(SceneMaterial));
+		for (SceneMaterial const& material : materialList)
+		{
+			if (material.baseColorTexture != SCENE_NONE && material.baseColorTexture >= textureList.size())
+			{
+				return false;
+			}
+		}
+
+		drawList.resize(draws->count);
+		memcpy(drawList.data(), file.data() + draws->offset, draws->count * sizeof(SceneDraw));
+		for (SceneDraw const& draw : drawList)
+		{
+			if (uint64_t(draw.firstIndex) + draw.indexCount > indices.count || draw.vertexOffset < 0 || uint64_t(draw.vertexOffset) + draw.vertexCount > vertices.count ||
+				(draw.material != SCENE_NONE && draw.material >= materialList.size()))
+			{
+				return false;
+			}
+		}
+
+		std::vector<SceneLodChain> chains(lodChains->count);
+		memcpy(chains.data(), file.data() + lodChains->offset, lodChains->count * sizeof(SceneLodChain));
+		if (chains.size() != drawList.size())
+		{
+			return false;
+		}
+		for (SceneLodChain const& chain : chains)
+		{
+			if (chain.count > MAX_SCENE_LODS)
+			{
+				return false;
+			}
+			for (uint32_t level = 0; level < chain.count; level++)
+			{
+				if (uint64_t(chain.levels[level].firstIndex) + chain.levels[level].indexCount > lodIndices->count)
+				{
+					return false;
+				}
+			}
+		}
+		std::vector<uint32_t> lodIndexData(lodIndices->count);
+		memcpy(lodIndexData.data(), file.data() + lodIndices->offset, lodIndices->count * sizeof(uint32_t));
+		lodList = SceneLods::fromData(std::move(chains), std::move(lodIndexData));
+		return true;
+	}
+
+	// A source whose modification time changed but whose content did not gets its new time written back into
+	// cachePath, so it is not rehashed on every load. Missing or unreadable sources make the cache stale.
+	bool sourcesUnchanged(std::filesystem::path const& cachePath) const
+	{
+		std::vector<std::pair<uint64_t, int64_t>> touched; // file offset of MeshCacheSource::modified, new time
+		uint64_t                                  offset = 0;
+		while (offset + sizeof(MeshCacheSource) <= sources.count)
+		{
+			MeshCacheSource record;
+			uint64_t const  recordOffset = sources.offset + offset;
+			memcpy(&record, file.data() + recordOffset, sizeof(record));
+			offset += sizeof(record);
+			if (record.pathLength > sources.count - offset)
+			{
+				return false;
+			}
+			std::string const path(reinterpret_cast<char const*>(file.data() + sources.offset + offset), record.pathLength);
+			offset = alignUp(offset + record.pathLength, 8);
+
+			std::error_code error;
+			uint64_t const  size = std::filesystem::file_size(path, error);
+			if (error || size != record.size)
+			{
+				return false;
+			}
+			if (int64_t const modified = modificationTime(path); modified != record.modified)
+			{
+				try
+				{
+					MappedFile const sourceFile(path);
+					if (hashBytes(sourceFile.data(), sourceFile.size()) != record.contentHash)
+					{
+						return false;
+					}
+				}
+				catch (std::exception const&)
+				{
+					return false;
+				}
+				touched.emplace_back(recordOffset + offsetof(MeshCacheSource, modified), modified);
+			}
+		}
+		if (!touched.empty())
+		{
+			// best effort: a cache that cannot be updated in place is only rehashed again next time
+			std::fstream cacheFile(cachePath, std::ios::in | std::ios::out | std::ios::binary);
+			for (auto const& [fileOffset, modified] : touched)
+			{
+				cacheFile.seekp(static_cast<std::streamoff>(fileOffset));
+				cacheFile.write(reinterpret_cast<char const*>(&modified), sizeof(modified));
+			}
+		}
+		return true;
+	}
+
+	static int64_t modificationTime(std::string const& path)
+	{
+		std::error_code error;
+		auto const      time = std::filesystem::last_write_time(path, error);
+		return error ? 0 : static_cast<int64_t>(time.time_since_epoch().count());
+	}
+
+	// 64-bit hash, eight bytes per step; only used to tell whether a file changed.
+	static uint64_t hashBytes(std::byte const* data, size_t size)
+	{
+		uint64_t hash = 0xcbf29ce484222325ull ^ size;
+		size_t   i = 0;
+		for (; i + 8 <= size; i += 8)
+		{
+			uint64_t word;
+			memcpy(&word, data + i, sizeof(word));
+			hash = (hash ^ word) * 0x100000001b3ull;
+			hash ^= hash >> 29;
+		}
+		for (; i < size; i++)
+		{
+			hash = (hash ^ static_cast<uint8_t>(data[i])) * 0x100000001b3ull;
+		}
+		return hash;
+	}
+
+	static uint64_t alignUp(uint64_t value, uint64_t alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	static void appendBytes(std::vector<std::byte>& out, void const* data, size_t size)
+	{
+		auto const* bytes = static_cast<std::byte const*>(data);
+		out.insert(out.end(), bytes, bytes + size);
+	}
+};
@@ -0,0 +1,282 @@
+#pragma once
+
+#include "scene_loader.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+// A cluster of at most MeshletMesh::MAX_VERTICES vertices and MAX_TRIANGLES triangles of one draw, padded to a
+// 64-byte cache line so a culling thread touches exactly one line per meshlet. Bounds are in scene space.
+struct Meshlet
+{
+	std::array<float, 3>    center = {};       // bounding sphere
+	float                   radius = 0.0f;
+	std::array<float, 3>    coneAxis = {};     // average facing of the triangles
+	float                   coneCutoff = 1.0f; // sine of the normal cone's half angle; 1 disables the backface test
+	uint32_t                firstVertex = 0;   // into MeshletMesh::vertices()
+	uint32_t                firstTriangle = 0; // into MeshletMesh::triangles(); also firstIndex / 3 of the reordered index buffer
+	uint32_t                vertexCount = 0;
+	uint32_t                triangleCount = 0;
+	int32_t                 baseVertex = 0;    // the draw's vertexOffset
+	std::array<uint32_t, 3> padding = {};
+};
+static_assert(sizeof(Meshlet) == 64);
+
+// The meshlets of one SceneDraw.
+struct MeshletRange
+{
+	uint32_t firstMeshlet = 0;
+	uint32_t meshletCount = 0;
+};
+
+// Splits every draw of a scene into meshlets by scanning its triangles in index order, which keeps the vertex
+// reuse an index optimizer already baked into the order, and closing a meshlet whenever the next triangle would
+// exceed either limit. Everything is laid out in meshlet order: the draw-local vertex indices of a meshlet are
+// contiguous, its triangles are packed as three 8-bit corners per uint32, and the index buffer is rewritten in
+// the same order, so a meshlet is also a plain index range and each draw keeps its original range.
+class MeshletMesh
+{
+public:
+	static constexpr uint32_t MAX_VERTICES = 64;
+	static constexpr uint32_t MAX_TRIANGLES = 124;
+
+	// Scene is a SceneSource or a MeshCache.
+	template <typename Scene>
+	static MeshletMesh build(Scene const& scene)
+	{
+		MeshletMesh mesh;
+		mesh.indices.resize(scene.indexCount());
+		mesh.packedTriangles.resize(scene.indexCount() / 3);
+
+		std::vector<uint32_t>    sourceIndices;
+		std::vector<SceneVertex> sourceVertices;
+		std::vector<uint32_t>    localIndex;
+		for (SceneDraw const& draw : scene.draws())
+		{
+			if (draw.firstIndex % 3 != 0)
+			{
+				throw std::runtime_error("meshlet builder: draw does not start on a triangle!");
+			}
+			sourceIndices.resize(draw.indexCount);
+			scene.writeIndices(draw.firstIndex, draw.indexCount, sourceIndices.data());
+			sourceVertices.resize(draw.vertexCount);
+			scene.writeVertices(static_cast<uint64_t>(draw.vertexOffset), draw.vertexCount, sourceVertices.data());
+			localIndex.assign(draw.vertexCount, INVALID);
+
+			MeshletRange range{ .firstMeshlet = static_cast<uint32_t>(mesh.meshletList.size()) };
+			Builder      builder{ .mesh = mesh, .positions = sourceVertices, .localIndex = localIndex, .draw = draw, .nextTriangle = draw.firstIndex / 3 };
+			for (uint32_t triangle = 0; triangle < draw.indexCount / 3; triangle++)
+			{
+				std::array<uint32_t, 3> const corners = { sourceIndices[3 * triangle], sourceIndices[3 * triangle + 1], sourceIndices[3 * triangle + 2] };
+				uint32_t                      newVertices = 0;
+				for (uint32_t i = 0; i < 3; i++)
+				{
+					if (corners[i] >= draw.vertexCount)
+					{
+						throw std::runtime_error("meshlet builder: index out of range!");
+					}
+					// a corner repeated within the triangle only counts once
+					bool const repeated = (i > 0 && corners[i] == corners[0]) || (i > 1 && corners[i] == corners[1]);
+					newVertices += localIndex[corners[i]] == INVALID && !repeated;
+				}
+				if (builder.vertices.size() + newVertices > MAX_VERTICES || builder.triangles.size() == MAX_TRIANGLES)
+				{
+					builder.flush();
+				}
+				builder.add(corners);
+			}
+			builder.flush();
+			range.meshletCount = static_cast<uint32_t>(mesh.meshletList.size()) - range.firstMeshlet;
+			mesh.rangeList.push_back(range);
+		}
+		return mesh;
+	}
+
+	[[nodiscard]] std::vector<Meshlet> const& meshlets() const
+	{
+		return meshletList;
+	}
+
+	// Draw-local vertex indices; meshlet m uses [m.firstVertex, m.firstVertex + m.vertexCount).
+	[[nodiscard]] std::vector<uint32_t> const& vertices() const
+	{
+		return vertexList;
+	}
+
+	// One triangle per element, corners in bits 0-7, 8-15 and 16-23, indexing the meshlet's vertices.
+	[[nodiscard]] std::vector<uint32_t> const& triangles() const
+	{
+		return packedTriangles;
+	}
+
+	// One range per scene draw, in the same order.
+	[[nodiscard]] std::vector<MeshletRange> const& ranges() const
+	{
+		return rangeList;
+	}
+
+	[[nodiscard]] uint64_t indexCount() const
+	{
+		return indices.size();
+	}
+
+	// The scene's index buffer, reordered meshlet by meshlet.
+	void writeIndices(uint64_t first, uint64_t count, uint32_t* out) const
+	{
+		memcpy(out, indices.data() + first, count * sizeof(uint32_t));
+	}
+
+private:
+	static constexpr uint32_t INVALID = ~0u;
+
+	std::vector<Meshlet>      meshletList;
+	std::vector<uint32_t>     vertexList;
+	std::vector<uint32_t>     packedTriangles;
+	std::vector<uint32_t>     indices;
+	std::vector<MeshletRange> rangeList;
+
+	// The meshlet being filled for one draw.
+	struct Builder
+	{
+		MeshletMesh&                         mesh;
+		std::vector<SceneVertex> const&      positions;
+		std::vector<uint32_t>&               localIndex; // draw-local vertex -> index in vertices, INVALID when absent
+		SceneDraw const&                     draw;
+		uint32_t                             nextTriangle = 0;
+		std::vector<uint32_t>                vertices = {};
+		std::vector<std::array<uint8_t, 3>> triangles = {};
+
+		void add(std::array<uint32_t, 3> const& corners)
+		{
+			std::array<uint8_t, 3> triangle;
+			for (uint32_t i = 0; i < 3; i++)
+			{
+				if (localIndex[corners[i]] == INVALID)
+				{
+					localIndex[corners[i]] = static_cast<uint32_t>(vertices.size());
+					vertices.push_back(corners[i]);
+				}
+				triangle[i] = static_cast<uint8_t>(localIndex[corners[i]]);
+			}
+			triangles.push_back(triangle);
+		}
+
+		void flush()
+		{
+			if (triangles.empty())
+			{
+				return;
+			}
+
+			Meshlet meshlet{ .firstVertex = static_cast<uint32_t>(mesh.vertexList.size()),
+							 .firstTriangle = nextTriangle,
+							 .vertexCount = static_cast<uint32_t>(vertices.size()),
+							 .triangleCount = static_cast<uint32_t>(triangles.size()),
+							 .baseVertex = draw.vertexOffset };
+			computeBounds(meshlet);
+
+			for (size_t i = 0; i < triangles.size(); i++)
+			{
+				auto const&    triangle = triangles[i];
+				uint32_t const globalTriangle = nextTriangle + static_cast<uint32_t>(i);
+				mesh.packedTriangles[globalTriangle] = triangle[0] | (triangle[1] << 8) | (triangle[2] << 16);
+				for (uint32_t corner = 0; corner < 3; corner++)
+				{
+					mesh.indices[3 * static_cast<size_t>(globalTriangle) + corner] = vertices[triangle[corner]];
+				}
+			}
+			mesh.vertexList.insert(mesh.vertexList.end(), vertices.begin(), vertices.end());
+			mesh.meshletList.push_back(meshlet);
+
+			nextTriangle += static_cast<uint32_t>(triangles.size());
+			for (uint32_t vertex : vertices)
+			{
+				localIndex[vertex] = INVALID;
+			}
+			vertices.clear();
+			triangles.clear();
+		}
+
+		void computeBounds(Meshlet& meshlet) const
+		{
+			std::array<float, 3> lo = { std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max() };
+			std::array<float, 3> hi = { std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest() };
+			for (uint32_t vertex : vertices)
+			{
+				for (int axis = 0; axis < 3; axis++)
+				{
+					lo[axis] = std::min(lo[axis], positions[vertex].position[axis]);
+					hi[axis] = std::max(hi[axis], positions[vertex].position[axis]);
+				}
+			}
+			float radiusSquared = 0.0f;
+			for (int axis = 0; axis < 3; axis++)
+			{
+				meshlet.center[axis] = 0.5f * (lo[axis] + hi[axis]);
+			}
+			for (uint32_t vertex : vertices)
+			{
+				radiusSquared = std::max(radiusSquared, distanceSquared(positions[vertex].position, meshlet.center));
+			}
+			meshlet.radius = std::sqrt(radiusSquared);
+
+			// the area-weighted average normal is the cone axis; the widest deviation from it sets the cutoff
+			std::vector<std::array<float, 3>> normals;
+			normals.reserve(triangles.size());
+			std::array<float, 3> axis = {};
+			for (auto const& triangle : triangles)
+			{
+				std::array<float, 3> const normal = triangleNormal(triangle);
+				for (int i = 0; i < 3; i++)
+				{
+					axis[i] += normal[i];
+				}
+				normals.push_back(normal);
+			}
+			float const axisLength = length(axis);
+			if (axisLength <= 0.0f)
+			{
+				return;
+			}
+			float minDot = 1.0f;
+			for (auto const& normal : normals)
+			{
+				float const normalLength = length(normal);
+				if (normalLength > 0.0f)
+				{
+					minDot = std::min(minDot, (normal[0] * axis[0] + normal[1] * axis[1] + normal[2] * axis[2]) / (normalLength * axisLength));
+				}
+			}
+			meshlet.coneAxis = { axis[0] / axisLength, axis[1] / axisLength, axis[2] / axisLength };
+			// normals spread over more than a hemisphere: some triangle always faces the camera
+			meshlet.coneCutoff = minDot <= 0.0f ? 1.0f : std::sqrt(1.0f - minDot * minDot);
+		}
+
+		// Counter-clockwise front faces, so the normal is cross(b - a, c - a); its length is twice the area.
+		[[nodiscard]] std::array<float, 3> triangleNormal(std::array<uint8_t, 3> const& triangle) const
+		{
+			auto const& a = positions[vertices[triangle[0]]].position;
+			auto const& b = positions[vertices[triangle[1]]].position;
+			auto const& c = positions[vertices[triangle[2]]].position;
+			std::array<float, 3> const ab = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+			std::array<float, 3> const ac = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+			return { ab[1] * ac[2] - ab[2] * ac[1], ab[2] * ac[0] - ab[0] * ac[2], ab[0] * ac[1] - ab[1] * ac[0] };
+		}
+
+		static float length(std::array<float, 3> const& v)
+		{
+			return std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+		}
+
+		static float distanceSquared(std::array<float, 3> const& a, std::array<float, 3> const& b)
+		{
+			return (a[0] - b[0]) * (a[0] - b[0]) + (a[1] - b[1]) * (a[1] - b[1]) + (a[2] - b[2]) * (a[2] - b[2]);
+		}
+	};
+};
@@ -0,0 +1,108 @@
+#pragma once
+
+#ifndef VULKAN_HPP_NO_STRUCT_CONSTRUCTORS
+#	define VULKAN_HPP_NO_STRUCT_CONSTRUCTORS
+#endif
+#include <vulkan/vulkan_raii.hpp>
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// VkPipelineCache backed by a file. The blob is only handed to the driver when its header matches this
+// device's vendorID, deviceID and pipelineCacheUUID; otherwise the cache starts cold. save() writes to a
+// temporary file and renames it over the old one, so a crash mid-write never leaves a truncated cache.
+class PersistentPipelineCache
+{
+public:
+	void load(vk::raii::Device const& device, vk::raii::PhysicalDevice const& physicalDevice, std::filesystem::path path)
+	{
+		filePath = std::move(path);
+
+		std::vector<char> initialData = readFile(filePath);
+		if (!initialData.empty() && !isCompatible(initialData, physicalDevice.getProperties()))
+		{
+			std::cerr << "pipeline cache: " << filePath << " was written by another device or driver, ignoring it" << std::endl;
+			initialData.clear();
+		}
+		warm = !initialData.empty();
+
+		vk::PipelineCacheCreateInfo cacheInfo{ .initialDataSize = initialData.size(), .pInitialData = initialData.data() };
+		cache = vk::raii::PipelineCache(device, cacheInfo);
+	}
+
+	void save() const
+	{
+		if (!*cache)
+		{
+			return;
+		}
+
+		std::vector<uint8_t> const data = cache.getData();
+		std::filesystem::path const tempPath = filePath.string() + ".tmp";
+		{
+			std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+			if (!file.write(reinterpret_cast<char const*>(data.data()), static_cast<std::streamsize>(data.size())))
+			{
+				std::cerr << "pipeline cache: failed to write " << tempPath << std::endl;
+				return;
+			}
+		}
+
+		std::error_code error;
+		std::filesystem::rename(tempPath, filePath, error);
+		if (error)
+		{
+			std::cerr << "pipeline cache: failed to replace " << filePath << ": " << error.message() << std::endl;
+			std::filesystem::remove(tempPath, error);
+		}
+	}
+
+	[[nodiscard]] vk::raii::PipelineCache const& get() const
+	{
+		return cache;
+	}
+
+	// True when the cache was seeded from a compatible file on disk.
+	[[nodiscard]] bool isWarm() const
+	{
+		return warm;
+	}
+
+private:
+	vk::raii::PipelineCache cache = nullptr;
+	std::filesystem::path   filePath;
+	bool                    warm = false;
+
+	static bool isCompatible(std::vector<char> const& data, vk::PhysicalDeviceProperties const& properties)
+	{
+		vk::PipelineCacheHeaderVersionOne header;
+		if (data.size() < sizeof(header))
+		{
+			return false;
+		}
+		std::memcpy(&header, data.data(), sizeof(header));
+
+		return header.headerSize >= sizeof(header) &&
+			header.headerVersion == vk::PipelineCacheHeaderVersion::eOne &&
+			header.vendorID == properties.vendorID &&
+			header.deviceID == properties.deviceID &&
+			std::memcmp(header.pipelineCacheUUID.data(), properties.pipelineCacheUUID.data(), VK_UUID_SIZE) == 0;
+	}
+
+	static std::vector<char> readFile(std::filesystem::path const& path)
+	{
+		std::ifstream file(path, std::ios::ate | std::ios::binary);
+		if (!file.is_open())
+		{
+			return {};
+		}
+		std::vector<char> buffer(file.tellg());
+		file.seekg(0, std::ios::beg);
+		file.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+		return buffer;
+	}
+};
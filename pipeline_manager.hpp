@@ -0,0 +1,399 @@
+#pragma once
+
+#ifndef VULKAN_HPP_NO_STRUCT_CONSTRUCTORS
+#	define VULKAN_HPP_NO_STRUCT_CONSTRUCTORS
+#endif
+#include <vulkan/vulkan_raii.hpp>
+
+#include "thread_pool.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+// FNV-1a over the raw bytes of trivially copyable values; used to build pipeline keys.
+class StateHasher
+{
+public:
+	template <typename T>
+	StateHasher& add(T const& value)
+	{
+		static_assert(std::is_trivially_copyable_v<T>);
+		return addBytes(&value, sizeof(T));
+	}
+
+	StateHasher& add(std::string const& value)
+	{
+		add(value.size());
+		return addBytes(value.data(), value.size());
+	}
+
+	template <typename T>
+	StateHasher& add(std::vector<T> const& values)
+	{
+		add(values.size());
+		return addBytes(values.data(), values.size() * sizeof(T));
+	}
+
+	StateHasher& addBytes(void const* data, size_t size)
+	{
+		auto const* bytes = static_cast<uint8_t const*>(data);
+		for (size_t i = 0; i < size; i++)
+		{
+			hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+		}
+		return *this;
+	}
+
+	[[nodiscard]] uint64_t value() const
+	{
+		return hash;
+	}
+
+private:
+	uint64_t hash = 0xcbf29ce484222325ull;
+};
+
+// Everything that distinguishes one graphics pipeline from another. Viewport and scissor are always dynamic.
+// A non-empty meshEntry makes it a mesh shading pipeline: vertexEntry and the vertex input state are ignored.
+struct GraphicsPipelineDesc
+{
+	vk::ShaderModule shaderModule;
+	uint64_t         shaderHash = 0; // hash of the SPIR-V behind shaderModule
+	std::string      vertexEntry = "vertMain";
+	std::string      fragmentEntry = "fragMain";
+	std::string      taskEntry;      // optional, mesh shading only
+	std::string      meshEntry;
+
+	std::vector<vk::VertexInputBindingDescription>   vertexBindings;
+	std::vector<vk::VertexInputAttributeDescription> vertexAttributes;
+
+	vk::PrimitiveTopology   topology = vk::PrimitiveTopology::eTriangleList;
+	vk::PolygonMode         polygonMode = vk::PolygonMode::eFill;
+	vk::CullModeFlags       cullMode = vk::CullModeFlagBits::eBack;
+	vk::FrontFace           frontFace = vk::FrontFace::eClockwise;
+	vk::SampleCountFlagBits samples = vk::SampleCountFlagBits::e1;
+	bool                    blendEnable = false;
+
+	vk::Format         colorFormat = vk::Format::eUndefined;
+	vk::Format         depthFormat = vk::Format::eUndefined;
+	vk::PipelineLayout layout;
+
+	// shared by every stage; the map entries and data must outlive the build (see ShaderFeatureSet)
+	vk::SpecializationInfo specialization;
+
+	[[nodiscard]] uint64_t key() const
+	{
+		StateHasher hasher;
+		hasher.add(shaderHash).add(vertexEntry).add(fragmentEntry).add(taskEntry).add(meshEntry);
+		hasher.add(vertexBindings).add(vertexAttributes);
+		hasher.add(topology).add(polygonMode).add(static_cast<VkCullModeFlags>(cullMode)).add(frontFace).add(samples).add(blendEnable);
+		hasher.add(colorFormat).add(depthFormat).add(static_cast<VkPipelineLayout>(layout));
+		hasher.add(specialization.mapEntryCount).addBytes(specialization.pMapEntries, specialization.mapEntryCount * sizeof(vk::SpecializationMapEntry));
+		hasher.add(specialization.dataSize).addBytes(specialization.pData, specialization.dataSize);
+		return hasher.value();
+	}
+};
+
+struct PipelineManagerStats
+{
+	uint32_t requested = 0;     // distinct pipeline keys seen
+	uint32_t deduplicated = 0;  // requests answered by an existing key
+	uint32_t compiled = 0;      // pipelines finished so far
+	uint32_t pending = 0;       // pipelines still compiling
+	uint32_t stalls = 0;        // lookups that hit a pipeline which was not ready yet
+	uint32_t released = 0;      // pipelines replaced, e.g. by a shader reload
+	double   compileMsTotal = 0.0;
+};
+
+// Owns every graphics pipeline, keyed by GraphicsPipelineDesc::key(), so a given state combination is built
+// once. request() queues the build on the thread pool and returns immediately; get() never waits, it hands
+// back the fallback pipeline (or a null handle, meaning "skip the draw") until the build has finished.
+// The map is only touched by the render thread; workers publish results through Entry::ready.
+class PipelineManager
+{
+public:
+	using Key = uint64_t;
+
+	void init(vk::raii::Device const& device, vk::raii::PipelineCache const& pipelineCache, ThreadPool& threadPool)
+	{
+		this->device = &device;
+		this->pipelineCache = &pipelineCache;
+		this->threadPool = &threadPool;
+	}
+
+	// Queues an asynchronous build unless the key is already known. fallback is returned by get() meanwhile.
+	Key request(GraphicsPipelineDesc const& desc, Key fallback = 0)
+	{
+		Key const key = desc.key();
+		auto [it, inserted] = entries.try_emplace(key, nullptr);
+		if (!inserted)
+		{
+			counters.deduplicated++;
+			return key;
+		}
+		it->second = std::make_unique<Entry>();
+		it->second->fallback = fallback;
+		counters.requested++;
+		pendingCount.fetch_add(1, std::memory_order_relaxed);
+
+		Entry* entry = it->second.get();
+		threadPool->submit([this, entry, desc] { build(*entry, desc); });
+		return key;
+	}
+
+	// Builds on the calling thread; for the pipelines every frame depends on, typically the fallbacks.
+	Key requestBlocking(GraphicsPipelineDesc const& desc)
+	{
+		Key const key = desc.key();
+		auto [it, inserted] = entries.try_emplace(key, nullptr);
+		if (!inserted)
+		{
+			counters.deduplicated++;
+			waitFor(*it->second);
+			return key;
+		}
+		it->second = std::make_unique<Entry>();
+		counters.requested++;
+		pendingCount.fetch_add(1, std::memory_order_relaxed);
+		build(*it->second, desc);
+		if (it->second->failed.load(std::memory_order_relaxed))
+		{
+			throw std::runtime_error("failed to create graphics pipeline!");
+		}
+		return key;
+	}
+
+	[[nodiscard]] vk::Pipeline get(Key key)
+	{
+		auto it = entries.find(key);
+		if (it == entries.end())
+		{
+			return nullptr;
+		}
+		if (it->second->ready.load(std::memory_order_acquire))
+		{
+			return *it->second->pipeline;
+		}
+
+		counters.stalls++;
+		Key const fallback = it->second->fallback;
+		if (fallback != 0 && fallback != key)
+		{
+			auto fallbackIt = entries.find(fallback);
+			if (fallbackIt != entries.end() && fallbackIt->second->ready.load(std::memory_order_acquire))
+			{
+				return *fallbackIt->second->pipeline;
+			}
+		}
+		return nullptr;
+	}
+
+	[[nodiscard]] bool isReady(Key key) const
+	{
+		auto it = entries.find(key);
+		return it != entries.end() && it->second->ready.load(std::memory_order_acquire);
+	}
+
+	[[nodiscard]] bool hasFailed(Key key) const
+	{
+		auto it = entries.find(key);
+		return it != entries.end() && it->second->failed.load(std::memory_order_acquire);
+	}
+
+	// Forgets a pipeline that frames up to retireValue may still use; recycle() destroys it once they completed.
+	// Requesting the same key again builds a new pipeline.
+	void release(Key key, uint64_t retireValue)
+	{
+		auto it = entries.find(key);
+		if (it == entries.end())
+		{
+			return;
+		}
+		counters.released++;
+		retiring.push_back({ .entry = std::move(it->second), .retireValue = retireValue });
+		entries.erase(it);
+	}
+
+	void recycle(uint64_t completedValue)
+	{
+		// an entry released while still building is kept until its worker is done with it
+		while (!retiring.empty() && retiring.front().retireValue <= completedValue && finished(*retiring.front().entry))
+		{
+			retiring.pop_front();
+		}
+	}
+
+	[[nodiscard]] PipelineManagerStats stats() const
+	{
+		PipelineManagerStats s = counters;
+		s.pending = pendingCount.load(std::memory_order_relaxed);
+		s.compiled = s.requested - s.pending;
+		for (auto const& [key, entry] : entries)
+		{
+			if (entry->ready.load(std::memory_order_acquire))
+			{
+				s.compileMsTotal += entry->compileMs;
+			}
+		}
+		return s;
+	}
+
+	void report(std::ostream& out) const
+	{
+		PipelineManagerStats const s = stats();
+		out << "pipelines: " << s.compiled << " compiled, " << s.pending << " pending, " << s.deduplicated << " deduplicated, "
+			<< s.released << " replaced, " << s.stalls << " stalls, " << s.compileMsTotal << " ms compiling" << std::endl;
+	}
+
+	// Waits for in-flight builds; must run before the device, cache or any referenced shader module is destroyed.
+	void clear()
+	{
+		if (threadPool)
+		{
+			threadPool->waitIdle();
+		}
+		entries.clear();
+		retiring.clear();
+	}
+
+	~PipelineManager()
+	{
+		clear();
+	}
+
+private:
+	struct Entry
+	{
+		vk::raii::Pipeline pipeline = nullptr;
+		double             compileMs = 0.0;
+		Key                fallback = 0;
+		std::atomic<bool>  ready = false;
+		std::atomic<bool>  failed = false;
+	};
+
+	struct Retiring
+	{
+		std::unique_ptr<Entry> entry;
+		uint64_t               retireValue = 0;
+	};
+
+	vk::raii::Device const*        device = nullptr;
+	vk::raii::PipelineCache const* pipelineCache = nullptr;
+	ThreadPool*                    threadPool = nullptr;
+
+	std::unordered_map<Key, std::unique_ptr<Entry>> entries;
+	std::deque<Retiring>                            retiring; // in release order, so retire values only grow
+	PipelineManagerStats                            counters;
+	std::atomic<uint32_t>                           pendingCount = 0;
+
+	static bool finished(Entry const& entry)
+	{
+		return entry.ready.load(std::memory_order_acquire) || entry.failed.load(std::memory_order_acquire);
+	}
+
+	void waitFor(Entry const& entry) const
+	{
+		while (!finished(entry))
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	void build(Entry& entry, GraphicsPipelineDesc const& desc)
+	{
+		auto const start = std::chrono::steady_clock::now();
+		try
+		{
+			entry.pipeline = createPipeline(desc);
+			entry.compileMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			entry.ready.store(true, std::memory_order_release);
+		}
+		catch (std::exception const& e)
+		{
+			std::cerr << "pipeline manager: build failed: " << e.what() << std::endl;
+			entry.failed.store(true, std::memory_order_release);
+		}
+		pendingCount.fetch_sub(1, std::memory_order_relaxed);
+	}
+
+	[[nodiscard]] vk::raii::Pipeline createPipeline(GraphicsPipelineDesc const& desc) const
+	{
+		bool const                                     meshShading = !desc.meshEntry.empty();
+		vk::SpecializationInfo const* const            specialization = desc.specialization.mapEntryCount > 0 ? &desc.specialization : nullptr;
+		std::vector<vk::PipelineShaderStageCreateInfo> shaderStages;
+		if (meshShading)
+		{
+			if (!desc.taskEntry.empty())
+			{
+				shaderStages.push_back({ .stage = vk::ShaderStageFlagBits::eTaskEXT, .module = desc.shaderModule, .pName = desc.taskEntry.c_str(), .pSpecializationInfo = specialization });
+			}
+			shaderStages.push_back({ .stage = vk::ShaderStageFlagBits::eMeshEXT, .module = desc.shaderModule, .pName = desc.meshEntry.c_str(), .pSpecializationInfo = specialization });
+		}
+		else
+		{
+			shaderStages.push_back({ .stage = vk::ShaderStageFlagBits::eVertex, .module = desc.shaderModule, .pName = desc.vertexEntry.c_str(), .pSpecializationInfo = specialization });
+		}
+		shaderStages.push_back({ .stage = vk::ShaderStageFlagBits::eFragment, .module = desc.shaderModule, .pName = desc.fragmentEntry.c_str(), .pSpecializationInfo = specialization });
+
+		vk::PipelineVertexInputStateCreateInfo   vertexInputInfo{ .vertexBindingDescriptionCount = static_cast<uint32_t>(desc.vertexBindings.size()),
+																	  .pVertexBindingDescriptions = desc.vertexBindings.data(),
+																	  .vertexAttributeDescriptionCount = static_cast<uint32_t>(desc.vertexAttributes.size()),
+																	  .pVertexAttributeDescriptions = desc.vertexAttributes.data() };
+		vk::PipelineInputAssemblyStateCreateInfo inputAssembly{ .topology = desc.topology };
+		vk::PipelineViewportStateCreateInfo      viewportState{ .viewportCount = 1, .scissorCount = 1 };
+
+		vk::PipelineRasterizationStateCreateInfo rasterizer{ .depthClampEnable = vk::False, .rasterizerDiscardEnable = vk::False, .polygonMode = desc.polygonMode, .cullMode = desc.cullMode, .frontFace = desc.frontFace, .depthBiasEnable = vk::False, .depthBiasSlopeFactor = 1.0f, .lineWidth = 1.0f };
+
+		vk::PipelineMultisampleStateCreateInfo multisampling{ .rasterizationSamples = desc.samples, .sampleShadingEnable = vk::False };
+
+		vk::PipelineColorBlendAttachmentState colorBlendAttachment{ .blendEnable = desc.blendEnable,
+																   .srcColorBlendFactor = vk::BlendFactor::eSrcAlpha,
+																   .dstColorBlendFactor = vk::BlendFactor::eOneMinusSrcAlpha,
+																   .colorBlendOp = vk::BlendOp::eAdd,
+																   .srcAlphaBlendFactor = vk::BlendFactor::eOne,
+																   .dstAlphaBlendFactor = vk::BlendFactor::eZero,
+																   .alphaBlendOp = vk::BlendOp::eAdd,
+																   .colorWriteMask = vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA };
+
+		vk::PipelineColorBlendStateCreateInfo colorBlending{ .logicOpEnable = vk::False, .logicOp = vk::LogicOp::eCopy, .attachmentCount = 1, .pAttachments = &colorBlendAttachment };
+
+		vk::PipelineDepthStencilStateCreateInfo depthStencil{ .depthTestEnable = desc.depthFormat != vk::Format::eUndefined,
+															 .depthWriteEnable = desc.depthFormat != vk::Format::eUndefined,
+															 .depthCompareOp = vk::CompareOp::eLess };
+
+		std::vector dynamicStates = {
+			vk::DynamicState::eViewport,
+			vk::DynamicState::eScissor };
+		vk::PipelineDynamicStateCreateInfo dynamicState{ .dynamicStateCount = static_cast<uint32_t>(dynamicStates.size()), .pDynamicStates = dynamicStates.data() };
+
+		vk::StructureChain<vk::GraphicsPipelineCreateInfo, vk::PipelineRenderingCreateInfo> pipelineCreateInfoChain = {
+			{.stageCount = static_cast<uint32_t>(shaderStages.size()),
+			 .pStages = shaderStages.data(),
+			 // mesh shaders assemble their own primitives
+			 .pVertexInputState = meshShading ? nullptr : &vertexInputInfo,
+			 .pInputAssemblyState = meshShading ? nullptr : &inputAssembly,
+			 .pViewportState = &viewportState,
+			 .pRasterizationState = &rasterizer,
+			 .pMultisampleState = &multisampling,
+			 .pDepthStencilState = &depthStencil,
+			 .pColorBlendState = &colorBlending,
+			 .pDynamicState = &dynamicState,
+			 .layout = desc.layout,
+			 .renderPass = nullptr},
+			{.colorAttachmentCount = 1,
+			 .pColorAttachmentFormats = &desc.colorFormat,
+			 .depthAttachmentFormat = desc.depthFormat} };
+
+		return vk::raii::Pipeline(*device, *pipelineCache, pipelineCreateInfoChain.get<vk::GraphicsPipelineCreateInfo>());
+	}
+};
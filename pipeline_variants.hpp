@@ -0,0 +1,305 @@
+#pragma once
+
+#ifndef VULKAN_HPP_NO_STRUCT_CONSTRUCTORS
+#	define VULKAN_HPP_NO_STRUCT_CONSTRUCTORS
+#endif
+#include <vulkan/vulkan_raii.hpp>
+
+#include "pipeline_manager.hpp"
+
+#include <array>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Fixed-function state of a pipeline family, fixed at compile time. Anything not listed here (shaders, vertex
+// input, formats, layout) comes from the base description handed to PipelineFamily::init().
+template <vk::PrimitiveTopology   TOPOLOGY = vk::PrimitiveTopology::eTriangleList,
+		  vk::CullModeFlagBits    CULL_MODE = vk::CullModeFlagBits::eBack,
+		  vk::FrontFace           FRONT_FACE = vk::FrontFace::eCounterClockwise,
+		  bool                    BLEND = false,
+		  vk::SampleCountFlagBits SAMPLES = vk::SampleCountFlagBits::e1,
+		  vk::PolygonMode         POLYGON_MODE = vk::PolygonMode::eFill>
+struct StaticPipelineState
+{
+	static constexpr vk::PrimitiveTopology   topology = TOPOLOGY;
+	static constexpr vk::CullModeFlagBits    cullMode = CULL_MODE;
+	static constexpr vk::FrontFace           frontFace = FRONT_FACE;
+	static constexpr bool                    blendEnable = BLEND;
+	static constexpr vk::SampleCountFlagBits samples = SAMPLES;
+	static constexpr vk::PolygonMode         polygonMode = POLYGON_MODE;
+
+	static void apply(GraphicsPipelineDesc& desc)
+	{
+		desc.topology = topology;
+		desc.cullMode = cullMode;
+		desc.frontFace = frontFace;
+		desc.blendEnable = blendEnable;
+		desc.samples = samples;
+		desc.polygonMode = polygonMode;
+	}
+};
+
+// Shader branches resolved when the pipeline is built. Each feature is a bool specialization constant whose
+// constant_id is its value (shaders/features.slang); as a mask, bit N stands for constant_id N.
+enum class ShaderFeature : uint32_t
+{
+	eAlphaTest = 0,   // discard fragments below the material's alpha cutoff
+	eVertexColor = 1, // tint untextured materials with the interpolated vertex color
+};
+
+constexpr uint32_t shaderFeatureBit(ShaderFeature feature)
+{
+	return 1u << static_cast<uint32_t>(feature);
+}
+
+constexpr char const* shaderFeatureName(ShaderFeature feature)
+{
+	switch (feature)
+	{
+	case ShaderFeature::eAlphaTest:
+		return "alpha test";
+	case ShaderFeature::eVertexColor:
+		return "vertex color";
+	}
+	return "?";
+}
+
+// The features a pipeline family specializes on. Every combination is a variant, numbered by the mask whose bit
+// i enables FEATURES[i]; the specialization data of all of them is generated at compile time, so a
+// vk::SpecializationInfo only points into static tables and can be copied to build threads freely.
+template <ShaderFeature... FEATURES>
+struct ShaderFeatureSet
+{
+	static constexpr uint32_t                           COUNT = sizeof...(FEATURES);
+	static constexpr uint32_t                           VARIANT_COUNT = 1u << COUNT;
+	static constexpr std::array<ShaderFeature, COUNT>   features = { FEATURES... };
+
+	static constexpr std::array<vk::SpecializationMapEntry, COUNT> mapEntries = [] {
+		std::array<vk::SpecializationMapEntry, COUNT> entries{};
+		for (uint32_t i = 0; i < COUNT; i++)
+		{
+			entries[i] = { .constantID = static_cast<uint32_t>(features[i]), .offset = i * static_cast<uint32_t>(sizeof(vk::Bool32)), .size = sizeof(vk::Bool32) };
+		}
+		return entries;
+	}();
+
+	static constexpr std::array<std::array<vk::Bool32, COUNT>, VARIANT_COUNT> values = [] {
+		std::array<std::array<vk::Bool32, COUNT>, VARIANT_COUNT> table{};
+		for (uint32_t variant = 0; variant < VARIANT_COUNT; variant++)
+		{
+			for (uint32_t i = 0; i < COUNT; i++)
+			{
+				table[variant][i] = (variant >> i) & 1u;
+			}
+		}
+		return table;
+	}();
+
+	// The variant implementing a mask of shaderFeatureBit()s; features outside the set are ignored.
+	static constexpr uint32_t variantFor(uint32_t featureMask)
+	{
+		uint32_t variant = 0;
+		for (uint32_t i = 0; i < COUNT; i++)
+		{
+			if (featureMask & shaderFeatureBit(features[i]))
+			{
+				variant |= 1u << i;
+			}
+		}
+		return variant;
+	}
+
+	static vk::SpecializationInfo specializationInfo(uint32_t variant)
+	{
+		return { .mapEntryCount = COUNT,
+				 .pMapEntries = mapEntries.data(),
+				 .dataSize = sizeof(values[variant]),
+				 .pData = values[variant].data() };
+	}
+
+	// "base" or the enabled features joined with '+'; stable for the program's lifetime, so usable as a GPU
+	// profiler scope name.
+	static char const* variantName(uint32_t variant)
+	{
+		static std::array<std::string, VARIANT_COUNT> const names = [] {
+			std::array<std::string, VARIANT_COUNT> table;
+			for (uint32_t v = 0; v < VARIANT_COUNT; v++)
+			{
+				for (uint32_t i = 0; i < COUNT; i++)
+				{
+					if ((v >> i) & 1u)
+					{
+						table[v] += (table[v].empty() ? "" : "+") + std::string(shaderFeatureName(features[i]));
+					}
+				}
+				table[v] = "variant " + (table[v].empty() ? std::string("base") : table[v]);
+			}
+			return table;
+		}();
+		return names[variant].c_str();
+	}
+};
+
+// Every variant of one pipeline: the static state and the feature set are compile-time parameters of init(),
+// the variants are built on demand. Variant 0 (no features) is built up front and stands in for the others
+// while they compile. A reload rebuilds all variants in use against a new shader module and swaps the whole
+// set in at once, so a frame never mixes shader versions.
+class PipelineFamily
+{
+public:
+	enum class Update
+	{
+		eIdle,     // nothing pending
+		eBuilding, // a reload is still compiling
+		eSwapped,  // the reloaded set replaced the old one
+		eFailed    // the reload failed and was dropped; the old set stays
+	};
+
+	template <typename State, typename Features>
+	void init(PipelineManager& manager, GraphicsPipelineDesc base)
+	{
+		State::apply(base);
+		this->manager = &manager;
+		this->base = base;
+		specializationInfo = &Features::specializationInfo;
+		variantName = &Features::variantName;
+		featureCount = Features::COUNT;
+		keys.assign(Features::VARIANT_COUNT, 0);
+		pendingKeys.clear();
+		keys[0] = manager.requestBlocking(describe(base, 0));
+	}
+
+	[[nodiscard]] uint32_t variantCount() const
+	{
+		return static_cast<uint32_t>(keys.size());
+	}
+
+	[[nodiscard]] char const* name(uint32_t variant) const
+	{
+		return variantName(variant);
+	}
+
+	// Render thread only. The first call for a variant queues its build.
+	PipelineManager::Key key(uint32_t variant)
+	{
+		if (keys[variant] == 0)
+		{
+			keys[variant] = manager->request(describe(base, variant), keys[0]);
+		}
+		return keys[variant];
+	}
+
+	[[nodiscard]] vk::Pipeline get(uint32_t variant)
+	{
+		return manager->get(key(variant));
+	}
+
+	[[nodiscard]] bool reloading() const
+	{
+		return !pendingKeys.empty();
+	}
+
+	// Rebuilds the variants requested so far from shaderModule, which has to stay alive until update() reports
+	// the reload done.
+	void reload(vk::ShaderModule shaderModule, uint64_t shaderHash)
+	{
+		pendingBase = base;
+		pendingBase.shaderModule = shaderModule;
+		pendingBase.shaderHash = shaderHash;
+		pendingKeys.assign(keys.size(), 0);
+		for (uint32_t variant = 0; variant < keys.size(); variant++)
+		{
+			if (keys[variant] != 0)
+			{
+				pendingKeys[variant] = manager->request(describe(pendingBase, variant), keys[variant]);
+			}
+		}
+	}
+
+	// Once every reloaded variant is built, swaps them in and releases the old ones with the frames up to
+	// retireValue that may still use them.
+	Update update(uint64_t retireValue)
+	{
+		if (!reloading())
+		{
+			return Update::eIdle;
+		}
+		// every build has to finish, the old set's included: the caller frees a shader module once this is done
+		auto const finished = [&](PipelineManager::Key key) { return key == 0 || manager->isReady(key) || manager->hasFailed(key); };
+		bool       failed = false;
+		for (uint32_t variant = 0; variant < keys.size(); variant++)
+		{
+			if (!finished(keys[variant]) || !finished(pendingKeys[variant]))
+			{
+				return Update::eBuilding;
+			}
+			failed = failed || (pendingKeys[variant] != 0 && manager->hasFailed(pendingKeys[variant]));
+		}
+
+		// the old set goes on success, the new one on failure
+		for (uint32_t variant = 0; variant < keys.size(); variant++)
+		{
+			PipelineManager::Key const current = keys[variant];
+			PipelineManager::Key const reloaded = pendingKeys[variant];
+			if (current == reloaded)
+			{
+				continue;
+			}
+			if (reloaded == 0)
+			{
+				// first requested during the reload, from the old shaders: rebuilt on its next use
+				if (!failed)
+				{
+					manager->release(current, retireValue);
+				}
+				continue;
+			}
+			manager->release(failed ? reloaded : current, retireValue);
+		}
+		if (!failed)
+		{
+			keys = pendingKeys;
+			base = pendingBase;
+		}
+		pendingKeys.clear();
+		return failed ? Update::eFailed : Update::eSwapped;
+	}
+
+	// How many of the possible variants were built, i.e. how far the feature combinations have exploded.
+	void report(std::ostream& out, char const* familyName) const
+	{
+		uint32_t built = 0;
+		for (PipelineManager::Key const key : keys)
+		{
+			built += key != 0 && manager->isReady(key);
+		}
+		out << "pipeline variants: " << familyName << " " << built << " of " << keys.size() << " built (" << featureCount << " specialized features)";
+		for (uint32_t variant = 0; variant < keys.size(); variant++)
+		{
+			if (keys[variant] != 0)
+			{
+				out << ", " << variantName(variant);
+			}
+		}
+		out << std::endl;
+	}
+
+private:
+	PipelineManager*                  manager = nullptr;
+	GraphicsPipelineDesc              base;
+	GraphicsPipelineDesc              pendingBase;
+	vk::SpecializationInfo            (*specializationInfo)(uint32_t) = nullptr;
+	char const*                       (*variantName)(uint32_t) = nullptr;
+	uint32_t                          featureCount = 0;
+	std::vector<PipelineManager::Key> keys;        // per variant, 0 until first requested
+	std::vector<PipelineManager::Key> pendingKeys; // per variant while a reload is building
+
+	[[nodiscard]] GraphicsPipelineDesc describe(GraphicsPipelineDesc const& desc, uint32_t variant) const
+	{
+		GraphicsPipelineDesc specialized = desc;
+		specialized.specialization = specializationInfo(variant);
+		return specialized;
+	}
+};
@@ -0,0 +1,371 @@
+#pragma once
+
+#ifndef VULKAN_HPP_NO_STRUCT_CONSTRUCTORS
+#	define VULKAN_HPP_NO_STRUCT_CONSTRUCTORS
+#endif
+#include <vulkan/vulkan_raii.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <iostream>
+#include <optional>
+#include <span>
+#include <string>
+#include <thread>
+
+struct PresentSettings
+{
+	// Swapchain present mode; empty picks mailbox where available, otherwise FIFO.
+	std::optional<vk::PresentModeKHR> mode;
+	// Frames started per second at most, 0 for no limit.
+	double   maxFrameRate = 0.0;
+	// With VK_KHR_present_wait, presents that may wait for the display before the next frame starts; 0 never waits.
+	uint32_t maxQueuedPresents = 0;
+};
+
+// "immediate", "mailbox", "fifo" or "fifo-relaxed", as given on the command line.
+inline std::optional<vk::PresentModeKHR> parsePresentMode(std::string const& name)
+{
+	if (name == "immediate")
+	{
+		return vk::PresentModeKHR::eImmediate;
+	}
+	if (name == "mailbox")
+	{
+		return vk::PresentModeKHR::eMailbox;
+	}
+	if (name == "fifo")
+	{
+		return vk::PresentModeKHR::eFifo;
+	}
+	if (name == "fifo-relaxed")
+	{
+		return vk::PresentModeKHR::eFifoRelaxed;
+	}
+	return std::nullopt;
+}
+
+struct FrameLimiterStats
+{
+	uint64_t frames = 0;      // that had a deadline to wait for
+	uint64_t lateFrames = 0;  // that reached it more than a period late and restarted the schedule
+	double   sleepMsTotal = 0.0;
+	double   spinMsTotal = 0.0;
+	double   maxOvershootMs = 0.0; // past the deadline when the wait returned
+	double   overshootMsTotal = 0.0;
+};
+
+// Caps the frame rate by starting every frame one period after the previous one was scheduled to start. The
+// OS sleep only gets close to a deadline, and can overshoot by a scheduler tick, so the limiter sleeps until a
+// margin before it and spins the rest. The margin follows the worst oversleep recently seen, decaying slowly
+// so one hiccup does not turn every later frame into a long spin.
+class FrameLimiter
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	static constexpr double MIN_SPIN_MARGIN_MS = 0.25;
+	static constexpr double MAX_SPIN_MARGIN_MS = 4.0;
+
+	void setMaxFrameRate(double framesPerSecond)
+	{
+		period = framesPerSecond > 0.0 ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / framesPerSecond)) : Clock::duration::zero();
+		nextStart = {};
+	}
+
+	[[nodiscard]] bool enabled() const
+	{
+		return period != Clock::duration::zero();
+	}
+
+	// Blocks until the next frame may start.
+	void wait()
+	{
+		if (!enabled())
+		{
+			return;
+		}
+		Clock::time_point now = Clock::now();
+		if (nextStart == Clock::time_point{} || now > nextStart + period)
+		{
+			// the first frame, or one that fell a whole period behind: catching up would only burst frames
+			stats.lateFrames += nextStart != Clock::time_point{} ? 1 : 0;
+			nextStart = now + period;
+			return;
+		}
+
+		Clock::time_point const sleepUntil = nextStart - std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(spinMarginMs));
+		if (now < sleepUntil)
+		{
+			std::this_thread::sleep_until(sleepUntil);
+			Clock::time_point const woken = Clock::now();
+			double const            oversleepMs = std::chrono::duration<double, std::milli>(woken - sleepUntil).count();
+			spinMarginMs = std::clamp(std::max(spinMarginMs * 0.99, 1.25 * oversleepMs), MIN_SPIN_MARGIN_MS, MAX_SPIN_MARGIN_MS);
+			stats.sleepMsTotal += std::chrono::duration<double, std::milli>(woken - now).count();
+			now = woken;
+		}
+		Clock::time_point const spinStart = now;
+		while (now < nextStart)
+		{
+			std::this_thread::yield();
+			now = Clock::now();
+		}
+		stats.spinMsTotal += std::chrono::duration<double, std::milli>(now - spinStart).count();
+
+		double const overshootMs = std::chrono::duration<double, std::milli>(now - nextStart).count();
+		stats.maxOvershootMs = std::max(stats.maxOvershootMs, overshootMs);
+		stats.overshootMsTotal += overshootMs;
+		stats.frames++;
+		nextStart += period;
+	}
+
+	[[nodiscard]] FrameLimiterStats const& getStats() const
+	{
+		return stats;
+	}
+
+	void report(std::ostream& out) const
+	{
+		if (!enabled() || stats.frames == 0)
+		{
+			return;
+		}
+		double const frames = static_cast<double>(stats.frames);
+		out << "frame limiter: " << 1.0 / std::chrono::duration<double>(period).count() << " fps cap, avg sleep " << stats.sleepMsTotal / frames << " ms, spin "
+			<< stats.spinMsTotal / frames << " ms, overshoot avg " << stats.overshootMsTotal / frames << " max " << stats.maxOvershootMs << " ms, "
+			<< stats.lateFrames << " late frames" << std::endl;
+	}
+
+private:
+	Clock::duration   period = Clock::duration::zero();
+	Clock::time_point nextStart;
+	double            spinMarginMs = 1.0;
+	FrameLimiterStats stats;
+};
+
+struct PresentStats
+{
+	uint64_t presents = 0;
+	uint64_t latencySamples = 0;
+	double   lastLatencyMs = 0.0; // from the present call until the image was on screen
+	double   maxLatencyMs = 0.0;
+	double   latencyMsTotal = 0.0;
+	uint64_t waits = 0; // frames that blocked on a present because of maxQueuedPresents
+	double   waitMsTotal = 0.0;
+	uint64_t droppedSamples = 0; // presents given up on: the swapchain was recreated or too many were pending
+};
+
+// Owns the latency side of presenting: which present mode the swapchain uses and how many images go with it,
+// the frame rate limiter, and, with VK_KHR_present_id and VK_KHR_present_wait, when presented images actually
+// reach the display. Every present gets an id; at the start of each frame the ids that have been displayed
+// since are collected without blocking, so a latency sample is accurate to within one frame. With
+// maxQueuedPresents the frame instead blocks until at most that many presents are still waiting for the
+// display, which both bounds the latency and measures it exactly.
+class PresentControl
+{
+public:
+	static constexpr uint32_t   MAX_PENDING_PRESENTS = 16;
+	static constexpr uint64_t   MAX_PRESENT_WAIT_NS = 100'000'000; // a window that stopped presenting must not hang the frame
+	static constexpr std::array MODE_ORDER = { vk::PresentModeKHR::eFifo, vk::PresentModeKHR::eFifoRelaxed, vk::PresentModeKHR::eMailbox, vk::PresentModeKHR::eImmediate };
+
+	void init(PresentSettings const& settings, bool presentWaitSupported)
+	{
+		this->settings = settings;
+		this->presentWaitSupported = presentWaitSupported;
+		limiter.setMaxFrameRate(settings.maxFrameRate);
+		if (settings.maxQueuedPresents != 0 && !presentWaitSupported)
+		{
+			std::cerr << "present: VK_KHR_present_wait is not supported, presents are not waited for" << std::endl;
+		}
+	}
+
+	// The requested mode when the surface supports it, otherwise FIFO, which every surface does.
+	vk::PresentModeKHR chooseMode(std::span<vk::PresentModeKHR const> availableModes)
+	{
+		auto const available = [&](vk::PresentModeKHR mode) { return std::ranges::find(availableModes, mode) != availableModes.end(); };
+		vk::PresentModeKHR const requested = settings.mode.value_or(available(vk::PresentModeKHR::eMailbox) ? vk::PresentModeKHR::eMailbox : vk::PresentModeKHR::eFifo);
+		currentMode = available(requested) ? requested : vk::PresentModeKHR::eFifo;
+		if (currentMode != requested)
+		{
+			std::cerr << "present: " << vk::to_string(requested) << " is not supported by the surface, using " << vk::to_string(*currentMode) << std::endl;
+		}
+		return *currentMode;
+	}
+
+	// Images for the mode chooseMode() picked. Immediate tears instead of waiting, so two are enough. Mailbox
+	// needs a third for the renderer to draw into while one image is on screen and one queued. FIFO queues
+	// every frame, so each image beyond the one on screen adds a frame of latency: one per frame in flight,
+	// but at most three in all.
+	[[nodiscard]] uint32_t chooseImageCount(vk::SurfaceCapabilitiesKHR const& capabilities, uint32_t framesInFlight) const
+	{
+		uint32_t imageCount = 3;
+		switch (currentMode.value_or(vk::PresentModeKHR::eFifo))
+		{
+		case vk::PresentModeKHR::eImmediate:
+			imageCount = 2;
+			break;
+		case vk::PresentModeKHR::eMailbox:
+			imageCount = 3;
+			break;
+		default:
+			imageCount = std::clamp(framesInFlight + 1, 2u, 3u);
+			break;
+		}
+		imageCount = std::max(imageCount, capabilities.minImageCount);
+		if (capabilities.maxImageCount != 0)
+		{
+			imageCount = std::min(imageCount, capabilities.maxImageCount);
+		}
+		return imageCount;
+	}
+
+	// Requests the next supported mode in MODE_ORDER; takes effect when the swapchain is recreated.
+	void cycleMode(std::span<vk::PresentModeKHR const> availableModes)
+	{
+		size_t const current = std::ranges::find(MODE_ORDER, currentMode.value_or(vk::PresentModeKHR::eFifo)) - MODE_ORDER.begin();
+		for (size_t i = 1; i <= MODE_ORDER.size(); i++)
+		{
+			vk::PresentModeKHR const mode = MODE_ORDER[(current + i) % MODE_ORDER.size()];
+			if (std::ranges::find(availableModes, mode) != availableModes.end())
+			{
+				settings.mode = mode;
+				return;
+			}
+		}
+	}
+
+	// Call before the frame samples its input.
+	void limitFrameRate()
+	{
+		limiter.wait();
+	}
+
+	// Collects the presents that have been displayed, blocking first when more than maxQueuedPresents are still pending.
+	void beginFrame(vk::raii::SwapchainKHR const& swapChain)
+	{
+		if (!presentWaitSupported || pendingCount == 0)
+		{
+			return;
+		}
+		try
+		{
+			if (settings.maxQueuedPresents != 0 && pendingCount >= settings.maxQueuedPresents)
+			{
+				auto const     waitStart = std::chrono::steady_clock::now();
+				uint64_t const id = pending[(pendingHead + pendingCount - settings.maxQueuedPresents) % MAX_PENDING_PRESENTS].id;
+				if (swapChain.waitForPresent(id, MAX_PRESENT_WAIT_NS) != vk::Result::eTimeout)
+				{
+					collect(id);
+				}
+				stats.waits++;
+				stats.waitMsTotal += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - waitStart).count();
+			}
+			while (pendingCount != 0 && swapChain.waitForPresent(pending[pendingHead].id, 0) != vk::Result::eTimeout)
+			{
+				collect(pending[pendingHead].id);
+			}
+		}
+		catch (vk::OutOfDateKHRError const&)
+		{
+			// the frame's acquire recreates the swapchain, which starts over
+			swapchainRecreated();
+		}
+	}
+
+	// The id to chain into this frame's vk::PresentIdKHR, or 0 without present wait. Call right before presenting.
+	uint64_t beginPresent()
+	{
+		stats.presents++;
+		if (!presentWaitSupported)
+		{
+			return 0;
+		}
+		if (pendingCount == MAX_PENDING_PRESENTS)
+		{
+			pendingHead = (pendingHead + 1) % MAX_PENDING_PRESENTS;
+			pendingCount--;
+			stats.droppedSamples++;
+		}
+		pending[(pendingHead + pendingCount) % MAX_PENDING_PRESENTS] = { .id = ++lastPresentId, .presentTime = std::chrono::steady_clock::now() };
+		pendingCount++;
+		return lastPresentId;
+	}
+
+	// Ids belong to a swapchain; the presents queued to the old one are not waited for.
+	void swapchainRecreated()
+	{
+		stats.droppedSamples += pendingCount;
+		pendingHead = 0;
+		pendingCount = 0;
+	}
+
+	[[nodiscard]] bool waitsForPresents() const
+	{
+		return presentWaitSupported;
+	}
+
+	[[nodiscard]] PresentStats const& getStats() const
+	{
+		return stats;
+	}
+
+	void report(std::ostream& out) const
+	{
+		limiter.report(out);
+		if (!currentMode)
+		{
+			return;
+		}
+		out << "present: " << vk::to_string(*currentMode) << ", " << stats.presents << " presents";
+		if (stats.latencySamples != 0)
+		{
+			out << ", present to display avg " << stats.latencyMsTotal / static_cast<double>(stats.latencySamples) << " max " << stats.maxLatencyMs << " ms over "
+				<< stats.latencySamples << " presents";
+		}
+		else if (!presentWaitSupported)
+		{
+			out << ", no display latency without VK_KHR_present_wait";
+		}
+		if (stats.waits != 0)
+		{
+			out << ", blocked avg " << stats.waitMsTotal / static_cast<double>(stats.waits) << " ms on " << stats.waits << " frames to keep "
+				<< settings.maxQueuedPresents << " queued";
+		}
+		out << std::endl;
+	}
+
+private:
+	struct PendingPresent
+	{
+		uint64_t                              id = 0;
+		std::chrono::steady_clock::time_point presentTime;
+	};
+
+	PresentSettings                   settings;
+	bool                              presentWaitSupported = false;
+	std::optional<vk::PresentModeKHR> currentMode; // of the current swapchain
+	FrameLimiter                      limiter;
+
+	// a ring rather than a deque: this runs every frame and should not allocate
+	std::array<PendingPresent, MAX_PENDING_PRESENTS> pending;
+	uint32_t                                         pendingHead = 0;
+	uint32_t                                         pendingCount = 0;
+	uint64_t                                         lastPresentId = 0;
+	PresentStats                                     stats;
+
+	// A displayed id implies every earlier one is done too; the ones that were skipped count as shown with it.
+	void collect(uint64_t displayedId)
+	{
+		auto const now = std::chrono::steady_clock::now();
+		while (pendingCount != 0 && pending[pendingHead].id <= displayedId)
+		{
+			stats.lastLatencyMs = std::chrono::duration<double, std::milli>(now - pending[pendingHead].presentTime).count();
+			stats.maxLatencyMs = std::max(stats.maxLatencyMs, stats.lastLatencyMs);
+			stats.latencyMsTotal += stats.lastLatencyMs;
+			stats.latencySamples++;
+			pendingHead = (pendingHead + 1) % MAX_PENDING_PRESENTS;
+			pendingCount--;
+		}
+	}
+};
@@ -0,0 +1,880 @@
+#pragma once
+
+#ifndef VULKAN_HPP_NO_STRUCT_CONSTRUCTORS
+#	define VULKAN_HPP_NO_STRUCT_CONSTRUCTORS
+#endif
+#include <vulkan/vulkan_raii.hpp>
+
+#include "frame_arena.hpp"
+#include "gpu_allocator.hpp"
+#include "gpu_profiler.hpp"
+#include "pipeline_manager.hpp"
+
+#include <algorithm>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// How a pass touches a resource: the stages and access types involved and, for images, the layout they need.
+struct RenderGraphAccess
+{
+	vk::PipelineStageFlags2 stages;
+	vk::AccessFlags2        access;
+	vk::ImageLayout         layout = vk::ImageLayout::eUndefined;
+};
+
+namespace RenderGraphAccesses
+{
+constexpr RenderGraphAccess COLOR_ATTACHMENT_WRITE{ .stages = vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+												   .access = vk::AccessFlagBits2::eColorAttachmentWrite,
+												   .layout = vk::ImageLayout::eColorAttachmentOptimal };
+constexpr RenderGraphAccess DEPTH_ATTACHMENT_WRITE{ .stages = vk::PipelineStageFlagBits2::eEarlyFragmentTests | vk::PipelineStageFlagBits2::eLateFragmentTests,
+												   .access = vk::AccessFlagBits2::eDepthStencilAttachmentRead | vk::AccessFlagBits2::eDepthStencilAttachmentWrite,
+												   .layout = vk::ImageLayout::eDepthAttachmentOptimal };
+constexpr RenderGraphAccess FRAGMENT_SAMPLED_READ{ .stages = vk::PipelineStageFlagBits2::eFragmentShader,
+												  .access = vk::AccessFlagBits2::eShaderSampledRead,
+												  .layout = vk::ImageLayout::eShaderReadOnlyOptimal };
+constexpr RenderGraphAccess COMPUTE_SAMPLED_READ{ .stages = vk::PipelineStageFlagBits2::eComputeShader,
+												 .access = vk::AccessFlagBits2::eShaderSampledRead,
+												 .layout = vk::ImageLayout::eShaderReadOnlyOptimal };
+constexpr RenderGraphAccess COMPUTE_STORAGE_READ{ .stages = vk::PipelineStageFlagBits2::eComputeShader,
+												 .access = vk::AccessFlagBits2::eShaderStorageRead,
+												 .layout = vk::ImageLayout::eGeneral };
+constexpr RenderGraphAccess COMPUTE_STORAGE_WRITE{ .stages = vk::PipelineStageFlagBits2::eComputeShader,
+												  .access = vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite,
+												  .layout = vk::ImageLayout::eGeneral };
+constexpr RenderGraphAccess FRAGMENT_STORAGE_READ{ .stages = vk::PipelineStageFlagBits2::eFragmentShader,
+												  .access = vk::AccessFlagBits2::eShaderStorageRead,
+												  .layout = vk::ImageLayout::eGeneral };
+// blending over what an earlier pass drew
+constexpr RenderGraphAccess COLOR_ATTACHMENT_BLEND{ .stages = vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+												   .access = vk::AccessFlagBits2::eColorAttachmentRead | vk::AccessFlagBits2::eColorAttachmentWrite,
+												   .layout = vk::ImageLayout::eColorAttachmentOptimal };
+// buffers backing acceleration structures
+constexpr RenderGraphAccess ACCELERATION_STRUCTURE_BUILD{ .stages = vk::PipelineStageFlagBits2::eAccelerationStructureBuildKHR,
+														 .access = vk::AccessFlagBits2::eAccelerationStructureReadKHR | vk::AccessFlagBits2::eAccelerationStructureWriteKHR };
+constexpr RenderGraphAccess COMPUTE_ACCELERATION_STRUCTURE_READ{ .stages = vk::PipelineStageFlagBits2::eComputeShader,
+																.access = vk::AccessFlagBits2::eAccelerationStructureReadKHR };
+constexpr RenderGraphAccess TASK_STORAGE_READ{ .stages = vk::PipelineStageFlagBits2::eTaskShaderEXT,
+											  .access = vk::AccessFlagBits2::eShaderStorageRead,
+											  .layout = vk::ImageLayout::eGeneral };
+constexpr RenderGraphAccess TASK_STORAGE_WRITE{ .stages = vk::PipelineStageFlagBits2::eTaskShaderEXT,
+											   .access = vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite,
+											   .layout = vk::ImageLayout::eGeneral };
+constexpr RenderGraphAccess INDIRECT_READ{ .stages = vk::PipelineStageFlagBits2::eDrawIndirect, .access = vk::AccessFlagBits2::eIndirectCommandRead };
+constexpr RenderGraphAccess TRANSFER_READ{ .stages = vk::PipelineStageFlagBits2::eTransfer,
+										  .access = vk::AccessFlagBits2::eTransferRead,
+										  .layout = vk::ImageLayout::eTransferSrcOptimal };
+constexpr RenderGraphAccess TRANSFER_WRITE{ .stages = vk::PipelineStageFlagBits2::eTransfer,
+										   .access = vk::AccessFlagBits2::eTransferWrite,
+										   .layout = vk::ImageLayout::eTransferDstOptimal };
+constexpr RenderGraphAccess HOST_READ{ .stages = vk::PipelineStageFlagBits2::eHost, .access = vk::AccessFlagBits2::eHostRead };
+// final state of a swapchain image; the present semaphore takes care of the rest
+constexpr RenderGraphAccess PRESENT{ .stages = vk::PipelineStageFlagBits2::eBottomOfPipe, .layout = vk::ImageLayout::ePresentSrcKHR };
+} // namespace RenderGraphAccesses
+
+struct RenderGraphImage
+{
+	uint32_t index = ~0u;
+};
+
+struct RenderGraphBuffer
+{
+	uint32_t index = ~0u;
+};
+
+struct RenderGraphStats
+{
+	uint32_t       lastPasses = 0;
+	uint32_t       lastCulledPasses = 0;
+	uint32_t       lastBarriers = 0;        // image and buffer barriers
+	uint32_t       lastBarrierBatches = 0;  // pipelineBarrier2 calls
+	uint64_t       barriersTotal = 0;
+	uint64_t       barrierBatchesTotal = 0;
+	uint64_t       frames = 0;
+	uint32_t       transientImages = 0;
+	vk::DeviceSize transientRequestedBytes = 0; // what the transient images would take without aliasing
+	vk::DeviceSize transientAllocatedBytes = 0;
+	uint32_t       transientReallocations = 0;
+};
+
+// A frame's passes and the resources they use, rebuilt every frame. Passes declare how they access images and
+// buffers; execute() then orders them topologically (declaration order breaks ties), culls passes whose
+// results nothing uses, and records each pass behind a single pipelineBarrier2 holding every image and buffer
+// barrier it needs. Imported resources (swapchain images, persistent buffers) are owned elsewhere and count as
+// outputs; transient images are owned by the graph and share one device memory allocation, placed so that
+// images whose lifetimes do not overlap alias the same bytes. Their memory is reused across frames and only
+// reallocated when the set of transients changes, the old allocation retiring with the frames that use it.
+// Resources synchronized by their owners (the bindless heap, streamed textures) stay out of the graph.
+// Everything declared for a frame, pass callbacks included, lives in the FrameArena handed to begin(), so
+// building and executing the graph allocates nothing from the heap once the transients are settled.
+class RenderGraph
+{
+	// one declared access of a pass to an image or buffer
+	struct Use
+	{
+		uint32_t          pass = 0;
+		RenderGraphAccess access;
+		bool              write = false;
+	};
+
+public:
+	using RecordFunction = FrameFunction<void(vk::raii::CommandBuffer const&)>;
+
+	struct ImageDesc
+	{
+		vk::Format   format = vk::Format::eUndefined;
+		vk::Extent2D extent;
+	};
+
+	// Declares a pass's accesses; returned by addPass().
+	class PassBuilder
+	{
+	public:
+		PassBuilder(RenderGraph& graph, uint32_t pass) : graph(graph), pass(pass) {}
+
+		PassBuilder& read(RenderGraphImage image, RenderGraphAccess const& access)
+		{
+			return use(graph.images[image.index].uses, access);
+		}
+
+		PassBuilder& write(RenderGraphImage image, RenderGraphAccess const& access)
+		{
+			return use(graph.images[image.index].uses, access, true);
+		}
+
+		PassBuilder& read(RenderGraphBuffer buffer, RenderGraphAccess const& access)
+		{
+			return use(graph.buffers[buffer.index].uses, access);
+		}
+
+		PassBuilder& write(RenderGraphBuffer buffer, RenderGraphAccess const& access)
+		{
+			return use(graph.buffers[buffer.index].uses, access, true);
+		}
+
+		// Never culled, for passes whose effects the graph cannot see.
+		PassBuilder& sideEffects()
+		{
+			graph.passes[pass].sideEffects = true;
+			return *this;
+		}
+
+	private:
+		RenderGraph& graph;
+		uint32_t     pass;
+
+		PassBuilder& use(ArenaVector<Use>& uses, RenderGraphAccess const& access, bool write = false)
+		{
+			uses.push_back({ .pass = pass, .access = access, .write = write });
+			return *this;
+		}
+	};
+
+	void init(vk::raii::Device const& device, GpuAllocator& allocator)
+	{
+		this->device = &device;
+		this->allocator = &allocator;
+	}
+
+	// Starts declaring a frame; arena has to stay untouched until execute() returns.
+	void begin(FrameArena& arena)
+	{
+		this->arena = &arena;
+		passes = ArenaVector<Pass>(arena);
+		images = ArenaVector<Image>(arena);
+		buffers = ArenaVector<Buffer>(arena);
+	}
+
+	// initial is the last access before this frame (eUndefined layout discards an image's contents); final, if
+	// any, is the state the image is left in for whoever uses it after the graph.
+	RenderGraphImage importImage(char const* name, vk::Image image, vk::ImageView view, ImageDesc const& desc, RenderGraphAccess const& initial,
+								 std::optional<RenderGraphAccess> const& final = std::nullopt)
+	{
+		images.push_back({ .name = name, .desc = desc, .image = image, .view = view, .initial = initial, .final = final, .uses = ArenaVector<Use>(frameArena()) });
+		return { static_cast<uint32_t>(images.size() - 1) };
+	}
+
+	RenderGraphImage createImage(char const* name, ImageDesc const& desc)
+	{
+		images.push_back({ .name = name, .desc = desc, .transient = true, .uses = ArenaVector<Use>(frameArena()) });
+		return { static_cast<uint32_t>(images.size() - 1) };
+	}
+
+	RenderGraphBuffer importBuffer(char const* name, vk::Buffer buffer, RenderGraphAccess const& initial = {},
+								   std::optional<RenderGraphAccess> const& final = std::nullopt)
+	{
+		buffers.push_back({ .name = name, .buffer = buffer, .initial = initial, .final = final, .uses = ArenaVector<Use>(frameArena()) });
+		return { static_cast<uint32_t>(buffers.size() - 1) };
+	}
+
+	// name must outlive the frame (a string literal in practice), since it doubles as the GPU profiler scope.
+	// record is copied into the frame arena, so it may only capture references and trivially destructible values.
+	template <typename Record>
+	PassBuilder addPass(char const* name, Record&& record)
+	{
+		passes.push_back({ .name = name, .record = RecordFunction(frameArena(), std::forward<Record>(record)) });
+		return PassBuilder(*this, static_cast<uint32_t>(passes.size() - 1));
+	}
+
+	// Only valid while the graph executes.
+	[[nodiscard]] vk::Image image(RenderGraphImage image) const
+	{
+		return images[image.index].image;
+	}
+
+	[[nodiscard]] vk::ImageView view(RenderGraphImage image) const
+	{
+		return images[image.index].view;
+	}
+
+	// Records every live pass and clears the graph for the next frame. frameValue is the frame-pacing timeline
+	// value of this frame; completedValue frees transient memory that earlier frames have stopped using.
+	void execute(vk::raii::CommandBuffer const& commandBuffer, GpuProfiler& profiler, uint64_t frameValue, uint64_t completedValue)
+	{
+		while (!retiredHeaps.empty() && retiredHeaps.front().retireValue <= completedValue)
+		{
+			retiredHeaps.pop_front();
+		}
+
+		stats.lastBarriers = 0;
+		stats.lastBarrierBatches = 0;
+		ArenaVector<uint32_t> const order = compile();
+		allocateTransients(frameValue);
+
+		ArenaVector<ResourceState> imageStates(images.size(), *arena);
+		ArenaVector<ResourceState> bufferStates(buffers.size(), *arena);
+		for (size_t i = 0; i < images.size(); i++)
+		{
+			imageStates[i] = initialState(static_cast<uint32_t>(i));
+		}
+		for (size_t i = 0; i < buffers.size(); i++)
+		{
+			bufferStates[i] = ResourceState::after(buffers[i].initial);
+		}
+
+		BarrierBatch batch{ .images = ArenaVector<vk::ImageMemoryBarrier2>(*arena), .buffers = ArenaVector<vk::BufferMemoryBarrier2>(*arena) };
+		for (uint32_t const pass : order)
+		{
+			for (size_t i = 0; i < images.size(); i++)
+			{
+				for (Use const& use : images[i].uses)
+				{
+					if (use.pass == pass)
+					{
+						transition(batch, imageStates[i], use.access, use.write, &images[i], nullptr);
+					}
+				}
+			}
+			for (size_t i = 0; i < buffers.size(); i++)
+			{
+				for (Use const& use : buffers[i].uses)
+				{
+					if (use.pass == pass)
+					{
+						transition(batch, bufferStates[i], use.access, use.write, nullptr, &buffers[i]);
+					}
+				}
+			}
+			flush(commandBuffer, batch);
+
+			GpuProfiler::Scope scope(profiler, commandBuffer, passes[pass].name);
+			passes[pass].record(commandBuffer);
+		}
+
+		// hand imported resources over in the state their next user expects
+		for (size_t i = 0; i < images.size(); i++)
+		{
+			if (images[i].final)
+			{
+				transition(batch, imageStates[i], *images[i].final, false, &images[i], nullptr);
+			}
+		}
+		for (size_t i = 0; i < buffers.size(); i++)
+		{
+			if (buffers[i].final)
+			{
+				transition(batch, bufferStates[i], *buffers[i].final, false, nullptr, &buffers[i]);
+			}
+		}
+		flush(commandBuffer, batch);
+
+		stats.lastPasses = static_cast<uint32_t>(order.size());
+		stats.lastCulledPasses = static_cast<uint32_t>(passes.size() - order.size());
+		stats.barriersTotal += stats.lastBarriers;
+		stats.barrierBatchesTotal += stats.lastBarrierBatches;
+		stats.frames++;
+
+		// the containers point into the arena, which the caller may reset from here on
+		passes = ArenaVector<Pass>();
+		images = ArenaVector<Image>();
+		buffers = ArenaVector<Buffer>();
+		arena = nullptr;
+	}
+
+	[[nodiscard]] RenderGraphStats const& getStats() const
+	{
+		return stats;
+	}
+
+	void report(std::ostream& out) const
+	{
+		if (stats.frames == 0)
+		{
+			return;
+		}
+		auto const frames = static_cast<double>(stats.frames);
+		out << "render graph: " << stats.lastPasses << " passes (" << stats.lastCulledPasses << " culled), "
+			<< static_cast<double>(stats.barriersTotal) / frames << " barriers in " << static_cast<double>(stats.barrierBatchesTotal) / frames
+			<< " pipelineBarrier2 calls per frame, " << stats.transientImages << " transient images in " << stats.transientAllocatedBytes / 1024 << " / "
+			<< stats.transientRequestedBytes / 1024 << " KiB (" << (stats.transientRequestedBytes - stats.transientAllocatedBytes) / 1024
+			<< " KiB saved by aliasing), " << stats.transientReallocations << " reallocations" << std::endl;
+	}
+
+private:
+	static constexpr vk::AccessFlags2 WRITE_ACCESS = vk::AccessFlagBits2::eShaderWrite | vk::AccessFlagBits2::eShaderStorageWrite |
+		vk::AccessFlagBits2::eColorAttachmentWrite | vk::AccessFlagBits2::eDepthStencilAttachmentWrite | vk::AccessFlagBits2::eTransferWrite |
+		vk::AccessFlagBits2::eHostWrite | vk::AccessFlagBits2::eMemoryWrite | vk::AccessFlagBits2::eAccelerationStructureWriteKHR;
+
+	struct Pass
+	{
+		char const*    name = nullptr;
+		RecordFunction record;
+		bool           sideEffects = false;
+	};
+
+	struct Image
+	{
+		char const*                      name = nullptr;
+		ImageDesc                        desc;
+		vk::Image                        image;
+		vk::ImageView                    view;
+		RenderGraphAccess                initial;
+		std::optional<RenderGraphAccess> final;
+		bool                             transient = false;
+		ArenaVector<Use>                 uses;
+		// transient images only, filled in by compile()
+		uint32_t                         first = ~0u; // position of the first and last live pass using it
+		uint32_t                         last = 0;
+		RenderGraphAccess                lastAccess;  // everything the last pass does with it
+	};
+
+	struct Buffer
+	{
+		char const*                      name = nullptr;
+		vk::Buffer                       buffer;
+		RenderGraphAccess                initial;
+		std::optional<RenderGraphAccess> final;
+		ArenaVector<Use>                 uses;
+	};
+
+	// What the GPU may still be doing to a resource, as far as barriers are concerned.
+	struct ResourceState
+	{
+		vk::ImageLayout         layout = vk::ImageLayout::eUndefined;
+		vk::PipelineStageFlags2 writeStages;   // of the last write
+		vk::AccessFlags2        writeAccess;
+		vk::PipelineStageFlags2 readStages;    // reads since the last write, which a write has to wait for
+		vk::PipelineStageFlags2 visibleStages; // stages the last write has been made visible to
+
+		static ResourceState after(RenderGraphAccess const& access)
+		{
+			return { .layout = access.layout, .writeStages = access.stages, .writeAccess = access.access & WRITE_ACCESS };
+		}
+	};
+
+	struct BarrierBatch
+	{
+		ArenaVector<vk::ImageMemoryBarrier2>  images;
+		ArenaVector<vk::BufferMemoryBarrier2> buffers;
+	};
+
+	// Transient images bound into one allocation; views and images go before the memory.
+	struct TransientHeap
+	{
+		GpuAllocator*                    allocator = nullptr;
+		GpuAllocation                    allocation;
+		std::vector<vk::raii::Image>     images;
+		std::vector<vk::raii::ImageView> views;
+		std::vector<vk::DeviceSize>      offsets;
+		std::vector<vk::DeviceSize>      sizes;
+		uint64_t                         key = 0;
+
+		TransientHeap() = default;
+		TransientHeap(TransientHeap const&) = delete;
+		TransientHeap& operator=(TransientHeap const&) = delete;
+
+		~TransientHeap()
+		{
+			views.clear();
+			images.clear();
+			if (allocator)
+			{
+				allocator->free(allocation);
+			}
+		}
+	};
+
+	struct RetiredHeap
+	{
+		std::unique_ptr<TransientHeap> heap;
+		uint64_t                       retireValue = 0;
+	};
+
+	vk::raii::Device const*        device = nullptr;
+	GpuAllocator*                  allocator = nullptr;
+	FrameArena*                    arena = nullptr; // between begin() and the end of execute()
+	ArenaVector<Pass>              passes;
+	ArenaVector<Image>             images;
+	ArenaVector<Buffer>            buffers;
+	std::vector<uint32_t>          transients;  // indices into images of this frame's live transients
+	std::unique_ptr<TransientHeap> heap;
+	std::deque<RetiredHeap>        retiredHeaps; // in retire order
+	RenderGraphStats               stats;
+
+	FrameArena& frameArena() const
+	{
+		if (!arena)
+		{
+			throw std::runtime_error("render graph: resources and passes have to be declared after begin()!");
+		}
+		return *arena;
+	}
+
+	// Builds the dependency graph from the declared uses, drops passes that do not contribute to an import or a
+	// side effect, and returns the live passes in topological order.
+	ArenaVector<uint32_t> compile()
+	{
+		uint32_t const                     passCount = static_cast<uint32_t>(passes.size());
+		ArenaVector<uint32_t> const        noPasses(*arena);
+		ArenaVector<ArenaVector<uint32_t>> producers(passCount, noPasses, *arena); // passes whose writes a pass depends on
+		ArenaVector<ArenaVector<uint32_t>> successors(passCount, noPasses, *arena);
+		ArenaVector<uint32_t>              predecessorCount(passCount, 0, *arena);
+		ArenaVector<bool>                  live(passCount, false, *arena);
+
+		auto addEdge = [&](uint32_t from, uint32_t to, bool producer) {
+			if (from == to || std::ranges::find(successors[from], to) != successors[from].end())
+			{
+				return;
+			}
+			successors[from].push_back(to);
+			predecessorCount[to]++;
+			if (producer)
+			{
+				producers[to].push_back(from);
+			}
+		};
+		// uses are recorded in declaration order, so walking them replays each resource's history
+		auto addResourceEdges = [&](ArenaVector<Use> const& uses, bool imported) {
+			uint32_t              lastWriter = ~0u;
+			ArenaVector<uint32_t> readers(*arena);
+			for (Use const& use : uses)
+			{
+				if (lastWriter != ~0u)
+				{
+					addEdge(lastWriter, use.pass, true);
+				}
+				if (use.write)
+				{
+					for (uint32_t reader : readers)
+					{
+						addEdge(reader, use.pass, false);
+					}
+					readers.clear();
+					lastWriter = use.pass;
+					live[use.pass] = live[use.pass] || imported;
+				}
+				else
+				{
+					readers.push_back(use.pass);
+				}
+			}
+		};
+		for (Image const& image : images)
+		{
+			addResourceEdges(image.uses, !image.transient);
+		}
+		for (Buffer const& buffer : buffers)
+		{
+			addResourceEdges(buffer.uses, true);
+		}
+
+		ArenaVector<uint32_t> pending(*arena);
+		for (uint32_t pass = 0; pass < passCount; pass++)
+		{
+			live[pass] = live[pass] || passes[pass].sideEffects;
+			if (live[pass])
+			{
+				pending.push_back(pass);
+			}
+		}
+		while (!pending.empty())
+		{
+			uint32_t const pass = pending.back();
+			pending.pop_back();
+			for (uint32_t producer : producers[pass])
+			{
+				if (!live[producer])
+				{
+					live[producer] = true;
+					pending.push_back(producer);
+				}
+			}
+		}
+
+		// Kahn's algorithm, always taking the earliest declared ready pass
+		ArenaVector<uint32_t> order(*arena);
+		ArenaVector<uint32_t> ready(*arena);
+		for (uint32_t pass = 0; pass < passCount; pass++)
+		{
+			if (predecessorCount[pass] == 0)
+			{
+				ready.push_back(pass);
+			}
+		}
+		while (!ready.empty())
+		{
+			auto const     next = std::ranges::min_element(ready);
+			uint32_t const pass = *next;
+			ready.erase(next);
+			if (live[pass])
+			{
+				order.push_back(pass);
+			}
+			for (uint32_t successor : successors[pass])
+			{
+				if (--predecessorCount[successor] == 0)
+				{
+					ready.push_back(successor);
+				}
+			}
+		}
+
+		// lifetimes of the transient images, in positions of the ordered live passes
+		ArenaVector<uint32_t> position(passCount, ~0u, *arena);
+		for (uint32_t i = 0; i < order.size(); i++)
+		{
+			position[order[i]] = i;
+		}
+		transients.clear();
+		for (uint32_t index = 0; index < images.size(); index++)
+		{
+			Image& image = images[index];
+			if (!image.transient)
+			{
+				continue;
+			}
+			for (Use const& use : image.uses)
+			{
+				if (uint32_t const at = position[use.pass]; at != ~0u)
+				{
+					image.first = std::min(image.first, at);
+					image.last = std::max(image.last, at);
+				}
+			}
+			for (Use const& use : image.uses)
+			{
+				if (image.first != ~0u && position[use.pass] == image.last)
+				{
+					image.lastAccess.stages |= use.access.stages;
+					image.lastAccess.access |= use.access.access;
+				}
+			}
+			if (image.first != ~0u)
+			{
+				transients.push_back(index);
+			}
+		}
+		return order;
+	}
+
+	// Creates the transient images when their set changed since the last frame and binds them into one
+	// allocation: largest first, each at the lowest offset not used by an image whose lifetime overlaps.
+	void allocateTransients(uint64_t frameValue)
+	{
+		StateHasher hasher;
+		for (uint32_t index : transients)
+		{
+			Image const& image = images[index];
+			hasher.add(image.desc.format).add(image.desc.extent.width).add(image.desc.extent.height).add(usageFlags(image)).add(image.first).add(image.last);
+		}
+		uint64_t const key = hasher.value();
+
+		if (!heap || heap->key != key)
+		{
+			if (heap)
+			{
+				retiredHeaps.push_back({ .heap = std::move(heap), .retireValue = frameValue - 1 });
+			}
+			heap = std::make_unique<TransientHeap>();
+			heap->key = key;
+			stats.transientReallocations++;
+
+			std::vector<vk::MemoryRequirements> requirements;
+			for (uint32_t index : transients)
+			{
+				Image const&        image = images[index];
+				vk::ImageCreateInfo imageInfo{ .imageType = vk::ImageType::e2D,
+											   .format = image.desc.format,
+											   .extent = {image.desc.extent.width, image.desc.extent.height, 1},
+											   .mipLevels = 1,
+											   .arrayLayers = 1,
+											   .samples = vk::SampleCountFlagBits::e1,
+											   .tiling = vk::ImageTiling::eOptimal,
+											   .usage = usageFlags(image),
+											   .sharingMode = vk::SharingMode::eExclusive,
+											   .initialLayout = vk::ImageLayout::eUndefined };
+				heap->images.emplace_back(*device, imageInfo);
+				requirements.push_back(heap->images.back().getMemoryRequirements());
+			}
+
+			vk::MemoryRequirements combined{ .size = 0, .alignment = 1, .memoryTypeBits = ~0u };
+			heap->offsets = placeTransients(requirements);
+			stats.transientRequestedBytes = 0;
+			for (size_t i = 0; i < requirements.size(); i++)
+			{
+				combined.size = std::max(combined.size, heap->offsets[i] + requirements[i].size);
+				combined.alignment = std::max(combined.alignment, requirements[i].alignment);
+				combined.memoryTypeBits &= requirements[i].memoryTypeBits;
+				heap->sizes.push_back(requirements[i].size);
+				stats.transientRequestedBytes += requirements[i].size;
+			}
+			stats.transientImages = static_cast<uint32_t>(transients.size());
+			stats.transientAllocatedBytes = combined.size;
+			if (!transients.empty())
+			{
+				if (combined.memoryTypeBits == 0)
+				{
+					throw std::runtime_error("render graph: transient images have no memory type in common!");
+				}
+				heap->allocator = allocator;
+				heap->allocation = allocator->allocate(combined, vk::MemoryPropertyFlagBits::eDeviceLocal, {}, GpuAllocator::ResourceKind::eOptimal);
+			}
+			for (size_t i = 0; i < transients.size(); i++)
+			{
+				Image const& image = images[transients[i]];
+				heap->images[i].bindMemory(heap->allocation.memory, heap->allocation.offset + heap->offsets[i]);
+				vk::ImageViewCreateInfo viewInfo{ .image = *heap->images[i],
+												  .viewType = vk::ImageViewType::e2D,
+												  .format = image.desc.format,
+												  .subresourceRange = {aspectFlags(image.desc.format), 0, 1, 0, 1} };
+				heap->views.emplace_back(*device, viewInfo);
+			}
+		}
+
+		for (size_t i = 0; i < transients.size(); i++)
+		{
+			images[transients[i]].image = *heap->images[i];
+			images[transients[i]].view = *heap->views[i];
+		}
+	}
+
+	// Offsets for each transient, in the same order. The allocation's base alignment is the largest of them.
+	std::vector<vk::DeviceSize> placeTransients(std::vector<vk::MemoryRequirements> const& requirements) const
+	{
+		std::vector<size_t> bySize(transients.size());
+		for (size_t i = 0; i < bySize.size(); i++)
+		{
+			bySize[i] = i;
+		}
+		std::ranges::stable_sort(bySize, [&](size_t a, size_t b) { return requirements[a].size > requirements[b].size; });
+
+		std::vector<vk::DeviceSize> offsets(transients.size(), 0);
+		std::vector<size_t>         placed;
+		for (size_t i : bySize)
+		{
+			Image const&   image = images[transients[i]];
+			vk::DeviceSize offset = 0;
+			for (bool moved = true; moved;)
+			{
+				moved = false;
+				for (size_t other : placed)
+				{
+					Image const& otherImage = images[transients[other]];
+					bool const   overlapsInTime = image.first <= otherImage.last && otherImage.first <= image.last;
+					bool const   overlapsInMemory = offset < offsets[other] + requirements[other].size && offsets[other] < offset + requirements[i].size;
+					if (overlapsInTime && overlapsInMemory)
+					{
+						vk::DeviceSize const alignment = requirements[i].alignment;
+						offset = (offsets[other] + requirements[other].size + alignment - 1) / alignment * alignment;
+						moved = true;
+					}
+				}
+			}
+			offsets[i] = offset;
+			placed.push_back(i);
+		}
+		return offsets;
+	}
+
+	// A transient's first use has to wait for whatever last used its memory: the image before it in the same
+	// bytes, or, for the first one, the last image there in the previous frame.
+	ResourceState initialState(uint32_t index) const
+	{
+		Image const& image = images[index];
+		if (!image.transient)
+		{
+			return ResourceState::after(image.initial);
+		}
+		auto const slot = std::ranges::find(transients, index);
+		if (slot == transients.end())
+		{
+			return {};
+		}
+		size_t const i = static_cast<size_t>(slot - transients.begin());
+
+		Image const* previous = nullptr;
+		Image const* wrapAround = nullptr;
+		for (size_t j = 0; j < transients.size(); j++)
+		{
+			bool const overlapsInMemory = heap->offsets[i] < heap->offsets[j] + heap->sizes[j] && heap->offsets[j] < heap->offsets[i] + heap->sizes[i];
+			if (!overlapsInMemory)
+			{
+				continue;
+			}
+			Image const& other = images[transients[j]];
+			if (other.last < image.first && (!previous || other.last > previous->last))
+			{
+				previous = &other;
+			}
+			if (!wrapAround || other.last > wrapAround->last)
+			{
+				wrapAround = &other;
+			}
+		}
+		Image const* const   before = previous ? previous : wrapAround;
+		RenderGraphAccess const last = before->lastAccess;
+		return { .writeStages = last.stages, .writeAccess = last.access & WRITE_ACCESS, .readStages = last.stages };
+	}
+
+	// Adds the barrier, if any, that makes state ready for access and updates state to match.
+	void transition(BarrierBatch& batch, ResourceState& state, RenderGraphAccess const& access, bool write, Image const* image, Buffer const* buffer)
+	{
+		bool const layoutChange = image && access.layout != state.layout;
+		bool const writes = write || (access.access & WRITE_ACCESS);
+		vk::PipelineStageFlags2 srcStages;
+		vk::AccessFlags2        srcAccess;
+		if (writes || layoutChange)
+		{
+			// waits for the last write and, write after read, for every read since
+			srcStages = state.writeStages | state.readStages;
+			srcAccess = state.writeAccess;
+			if (srcStages || layoutChange)
+			{
+				addBarrier(batch, srcStages, srcAccess, access, state.layout, image, buffer);
+			}
+			state = writes ? ResourceState{ .layout = access.layout, .writeStages = access.stages, .writeAccess = access.access & WRITE_ACCESS }
+						   : ResourceState{ .layout = access.layout, .writeStages = access.stages, .readStages = access.stages, .visibleStages = access.stages };
+			return;
+		}
+
+		// read after write, unless an earlier barrier already made the write visible to these stages
+		if (state.writeStages && (access.stages & ~state.visibleStages))
+		{
+			addBarrier(batch, state.writeStages, state.writeAccess, access, state.layout, image, buffer);
+			state.visibleStages |= access.stages;
+		}
+		state.readStages |= access.stages;
+	}
+
+	static void addBarrier(BarrierBatch& batch, vk::PipelineStageFlags2 srcStages, vk::AccessFlags2 srcAccess, RenderGraphAccess const& access,
+						   vk::ImageLayout oldLayout, Image const* image, Buffer const* buffer)
+	{
+		if (image)
+		{
+			batch.images.push_back({ .srcStageMask = srcStages,
+									 .srcAccessMask = srcAccess,
+									 .dstStageMask = access.stages,
+									 .dstAccessMask = access.access,
+									 .oldLayout = oldLayout,
+									 .newLayout = access.layout,
+									 .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+									 .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+									 .image = image->image,
+									 .subresourceRange = {aspectFlags(image->desc.format), 0, 1, 0, 1} });
+		}
+		else
+		{
+			batch.buffers.push_back({ .srcStageMask = srcStages,
+									  .srcAccessMask = srcAccess,
+									  .dstStageMask = access.stages,
+									  .dstAccessMask = access.access,
+									  .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+									  .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+									  .buffer = buffer->buffer,
+									  .offset = 0,
+									  .size = vk::WholeSize });
+		}
+	}
+
+	void flush(vk::raii::CommandBuffer const& commandBuffer, BarrierBatch& batch)
+	{
+		if (batch.images.empty() && batch.buffers.empty())
+		{
+			return;
+		}
+		commandBuffer.pipelineBarrier2(vk::DependencyInfo{ .bufferMemoryBarrierCount = static_cast<uint32_t>(batch.buffers.size()),
+														   .pBufferMemoryBarriers = batch.buffers.data(),
+														   .imageMemoryBarrierCount = static_cast<uint32_t>(batch.images.size()),
+														   .pImageMemoryBarriers = batch.images.data() });
+		stats.lastBarriers += static_cast<uint32_t>(batch.images.size() + batch.buffers.size());
+		stats.lastBarrierBatches++;
+		batch.images.clear();
+		batch.buffers.clear();
+	}
+
+	static vk::ImageUsageFlags usageFlags(Image const& image)
+	{
+		vk::ImageUsageFlags usage;
+		for (Use const& use : image.uses)
+		{
+			vk::AccessFlags2 const access = use.access.access;
+			if (access & (vk::AccessFlagBits2::eColorAttachmentRead | vk::AccessFlagBits2::eColorAttachmentWrite))
+			{
+				usage |= vk::ImageUsageFlagBits::eColorAttachment;
+			}
+			if (access & (vk::AccessFlagBits2::eDepthStencilAttachmentRead | vk::AccessFlagBits2::eDepthStencilAttachmentWrite))
+			{
+				usage |= vk::ImageUsageFlagBits::eDepthStencilAttachment;
+			}
+			if (access & vk::AccessFlagBits2::eShaderSampledRead)
+			{
+				usage |= vk::ImageUsageFlagBits::eSampled;
+			}
+			if (access & (vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite))
+			{
+				usage |= vk::ImageUsageFlagBits::eStorage;
+			}
+			if (access & vk::AccessFlagBits2::eTransferRead)
+			{
+				usage |= vk::ImageUsageFlagBits::eTransferSrc;
+			}
+			if (access & vk::AccessFlagBits2::eTransferWrite)
+			{
+				usage |= vk::ImageUsageFlagBits::eTransferDst;
+			}
+		}
+		return usage;
+	}
+
+	static vk::ImageAspectFlags aspectFlags(vk::Format format)
+	{
+		switch (format)
+		{
+		case vk::Format::eD16Unorm:
+		case vk::Format::eD32Sfloat:
+		case vk::Format::eX8D24UnormPack32:
+			return vk::ImageAspectFlagBits::eDepth;
+		case vk::Format::eD16UnormS8Uint:
+		case vk::Format::eD24UnormS8Uint:
+		case vk::Format::eD32SfloatS8Uint:
+			return vk::ImageAspectFlagBits::eDepth | vk::ImageAspectFlagBits::eStencil;
+		default:
+			return vk::ImageAspectFlagBits::eColor;
+		}
+	}
+};
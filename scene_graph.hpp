@@ -0,0 +1,617 @@
+#pragma once
+
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#	include <xmmintrin.h>
+#	define RSTD_SCENE_GRAPH_SSE 1
+#endif
+
+// A node's placement relative to its parent: uniform scale, then rotation, then translation. This is the
+// similarity transform the shaders' TransformTable holds, so world transforms need no conversion.
+struct NodeTransform
+{
+	std::array<float, 3> translation = { 0.0f, 0.0f, 0.0f };
+	float                scale = 1.0f;
+	std::array<float, 4> rotation = { 0.0f, 0.0f, 0.0f, 1.0f }; // unit quaternion, vector part in xyz
+};
+
+struct SceneGraphStats
+{
+	uint32_t nodes = 0;
+	uint32_t levels = 0;
+	uint64_t updates = 0;        // that had something to recompute
+	uint64_t lastDirtyNodes = 0; // recomputed by the last of them, subtrees included
+	double   lastUpdateMs = 0.0;
+	double   updateMsTotal = 0.0;
+};
+
+// Node hierarchy whose world transforms and bounds are only recomputed where something moved. Nodes are stored
+// sorted by depth, so every level is one contiguous range whose parents all lie in earlier levels. Local
+// transforms are kept as one array per component; world transforms and bounds as float4 arrays in the layout of
+// the shaders' TransformTable, so a frame copies them as they are. update() recomputes the subtrees below every
+// setLocal() level by level. A few moved nodes are followed through their children, so the cost is that of the
+// subtrees; past SPARSE_LIMIT it scans every level instead, passing the flags down and recomputing four nodes at
+// a time with SSE. Levels large enough are split across worker threads private to the graph, so an update never
+// queues behind long-running jobs.
+class SceneGraph
+{
+public:
+	using Node = uint32_t;
+
+	static constexpr Node     NO_PARENT = ~0u;
+	static constexpr uint32_t MIN_NODES_PER_CHUNK = 16 * 1024; // smaller levels are not worth waking the workers for
+	static constexpr uint32_t SPARSE_LIMIT = 128;              // with more than 1/128 of the nodes moved, scanning beats chasing children
+
+	SceneGraph() = default;
+	SceneGraph(SceneGraph const&) = delete;
+	SceneGraph& operator=(SceneGraph const&) = delete;
+
+	// threadCount includes the thread calling update(); 1 updates everything on it.
+	void init(uint32_t threadCount)
+	{
+		chunkCount = std::max(1u, threadCount);
+		workers = chunkCount > 1 ? std::make_unique<ThreadPool>(chunkCount - 1) : nullptr;
+		chunkDirtyNodes.assign(chunkCount, 0);
+	}
+
+	void clear()
+	{
+		parents.clear();
+		slots.clear();
+		pendingLocal.clear();
+		pendingBounds.clear();
+		parentSlots.clear();
+		levelStarts.clear();
+		local = {};
+		localBounds.clear();
+		translationScale.clear();
+		rotation.clear();
+		bounds.clear();
+		childStarts.clear();
+		childSlots.clear();
+		dirty.clear();
+		movedSlots.clear();
+		fullUpdate = false;
+		stats = {};
+	}
+
+	// The parent has to be added before its children. nodeBounds is a bounding sphere (center, radius) in the
+	// node's own space; a radius of 0 means the node has no extent of its own.
+	Node add(Node parent, NodeTransform const& transform, std::array<float, 4> const& nodeBounds = {})
+	{
+		Node const node = static_cast<Node>(parents.size());
+		if (parent != NO_PARENT && parent >= node)
+		{
+			throw std::runtime_error("scene graph: a parent has to be added before its children!");
+		}
+		parents.push_back(parent);
+		pendingLocal.push_back(transform);
+		pendingBounds.push_back(nodeBounds);
+		return node;
+	}
+
+	void setLocal(Node node, NodeTransform const& transform)
+	{
+		if (node >= slots.size())
+		{
+			pendingLocal[node - slots.size()] = transform;
+			return;
+		}
+		uint32_t const slot = slots[node];
+		writeLocal(local, slot, transform);
+		if (!dirty[slot])
+		{
+			dirty[slot] = 1;
+			movedSlots.push_back(slot);
+		}
+	}
+
+	[[nodiscard]] NodeTransform getLocal(Node node) const
+	{
+		return node >= slots.size() ? pendingLocal[node - slots.size()] : readLocal(local, slots[node]);
+	}
+
+	[[nodiscard]] uint32_t size() const
+	{
+		return static_cast<uint32_t>(parents.size());
+	}
+
+	// Where the node's world transform and bounds are; valid from the update() after the node was added.
+	[[nodiscard]] uint32_t slot(Node node) const
+	{
+		return slots[node];
+	}
+
+	// By slot: xyz translation, w uniform scale.
+	[[nodiscard]] std::span<std::array<float, 4> const> worldTranslationScale() const
+	{
+		return translationScale;
+	}
+
+	// By slot: unit quaternion, vector part in xyz.
+	[[nodiscard]] std::span<std::array<float, 4> const> worldRotation() const
+	{
+		return rotation;
+	}
+
+	// By slot: world-space bounding sphere (center, radius).
+	[[nodiscard]] std::span<std::array<float, 4> const> worldBounds() const
+	{
+		return bounds;
+	}
+
+	// Lays out nodes added since the last call and recomputes everything below a setLocal().
+	void update()
+	{
+		if (!pendingLocal.empty())
+		{
+			layout();
+		}
+		if (!fullUpdate && movedSlots.empty())
+		{
+			return;
+		}
+
+		auto const     start = std::chrono::steady_clock::now();
+		uint64_t const dirtyNodes = fullUpdate || movedSlots.size() > size() / SPARSE_LIMIT ? updateAll() : updateMoved();
+		movedSlots.clear();
+		fullUpdate = false;
+
+		stats.updates++;
+		stats.lastDirtyNodes = dirtyNodes;
+		stats.lastUpdateMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		stats.updateMsTotal += stats.lastUpdateMs;
+	}
+
+	[[nodiscard]] SceneGraphStats const& getStats() const
+	{
+		return stats;
+	}
+
+	void report(std::ostream& out) const
+	{
+		if (stats.updates == 0)
+		{
+			return;
+		}
+		out << "scene graph: " << stats.nodes << " nodes in " << stats.levels << " levels, " << stats.updates << " updates, last " << stats.lastDirtyNodes
+			<< " dirty nodes in " << stats.lastUpdateMs << " ms, " << chunkCount << " threads" << std::endl;
+	}
+
+private:
+	// One array per component, by slot.
+	struct LocalTransforms
+	{
+		std::vector<float> x, y, z, scale;
+		std::vector<float> qx, qy, qz, qw;
+	};
+
+	// The same transform, each component a scalar or four lanes of nodes.
+	template <typename F>
+	struct Similarity
+	{
+		F x, y, z, scale;
+		F qx, qy, qz, qw;
+	};
+
+#if RSTD_SCENE_GRAPH_SSE
+	struct Lanes
+	{
+		__m128 v;
+
+		friend Lanes operator+(Lanes a, Lanes b)
+		{
+			return { _mm_add_ps(a.v, b.v) };
+		}
+
+		friend Lanes operator-(Lanes a, Lanes b)
+		{
+			return { _mm_sub_ps(a.v, b.v) };
+		}
+
+		friend Lanes operator*(Lanes a, Lanes b)
+		{
+			return { _mm_mul_ps(a.v, b.v) };
+		}
+	};
+#endif
+
+	// by node
+	std::vector<Node>                 parents;
+	std::vector<uint32_t>             slots;         // of the nodes laid out so far
+	std::vector<NodeTransform>        pendingLocal;  // nodes added since, in node order
+	std::vector<std::array<float, 4>> pendingBounds;
+
+	// by slot
+	std::vector<uint32_t>             parentSlots;   // roots are their own parent
+	std::vector<uint32_t>             childStarts;   // children of slot s are childSlots[childStarts[s], childStarts[s + 1])
+	std::vector<uint32_t>             childSlots;
+	std::vector<uint32_t>             levelStarts;   // first slot of every level, then the node count
+	LocalTransforms                   local;
+	std::vector<std::array<float, 4>> localBounds;
+	std::vector<std::array<float, 4>> translationScale;
+	std::vector<std::array<float, 4>> rotation;
+	std::vector<std::array<float, 4>> bounds;
+	std::vector<uint8_t>              dirty;         // moved, or below a moved node
+	std::vector<uint32_t>             movedSlots;    // flagged by setLocal() since the last update
+	std::vector<uint32_t>             frontier;      // the level updateMoved() is on
+	std::vector<uint32_t>             nextFrontier;
+	bool                              fullUpdate = false;
+
+	uint32_t                    chunkCount = 1;
+	std::unique_ptr<ThreadPool> workers;
+	std::vector<uint64_t>       chunkDirtyNodes = { 0 };
+	SceneGraphStats             stats;
+
+	static void writeLocal(LocalTransforms& transforms, uint32_t slot, NodeTransform const& transform)
+	{
+		transforms.x[slot] = transform.translation[0];
+		transforms.y[slot] = transform.translation[1];
+		transforms.z[slot] = transform.translation[2];
+		transforms.scale[slot] = transform.scale;
+		transforms.qx[slot] = transform.rotation[0];
+		transforms.qy[slot] = transform.rotation[1];
+		transforms.qz[slot] = transform.rotation[2];
+		transforms.qw[slot] = transform.rotation[3];
+	}
+
+	static NodeTransform readLocal(LocalTransforms const& transforms, uint32_t slot)
+	{
+		return { .translation = { transforms.x[slot], transforms.y[slot], transforms.z[slot] },
+				 .scale = transforms.scale[slot],
+				 .rotation = { transforms.qx[slot], transforms.qy[slot], transforms.qz[slot], transforms.qw[slot] } };
+	}
+
+	// Sorts every node, old and new, by depth. Siblings keep their order, so nodes added together stay together.
+	void layout()
+	{
+		uint32_t const count = size();
+		uint32_t const laidOut = static_cast<uint32_t>(slots.size());
+
+		std::vector<uint32_t> depth(count);
+		uint32_t              levelCount = 0;
+		for (Node node = 0; node < count; node++)
+		{
+			depth[node] = parents[node] == NO_PARENT ? 0 : depth[parents[node]] + 1;
+			levelCount = std::max(levelCount, depth[node] + 1);
+		}
+		std::vector<uint32_t> starts(levelCount + 1, 0);
+		for (Node node = 0; node < count; node++)
+		{
+			starts[depth[node] + 1]++;
+		}
+		for (uint32_t level = 0; level < levelCount; level++)
+		{
+			starts[level + 1] += starts[level];
+		}
+		std::vector<uint32_t> newSlots(count);
+		std::vector<uint32_t> cursor(starts.begin(), starts.end() - 1);
+		for (Node node = 0; node < count; node++)
+		{
+			newSlots[node] = cursor[depth[node]]++;
+		}
+
+		LocalTransforms newLocal;
+		for (std::vector<float>* component : { &newLocal.x, &newLocal.y, &newLocal.z, &newLocal.scale, &newLocal.qx, &newLocal.qy, &newLocal.qz, &newLocal.qw })
+		{
+			component->resize(count);
+		}
+		std::vector<std::array<float, 4>> newLocalBounds(count);
+		parentSlots.resize(count);
+		for (Node node = 0; node < count; node++)
+		{
+			uint32_t const slot = newSlots[node];
+			bool const     old = node < laidOut;
+			writeLocal(newLocal, slot, old ? readLocal(local, slots[node]) : pendingLocal[node - laidOut]);
+			newLocalBounds[slot] = old ? localBounds[slots[node]] : pendingBounds[node - laidOut];
+			parentSlots[slot] = parents[node] == NO_PARENT ? slot : newSlots[parents[node]];
+		}
+
+		local = std::move(newLocal);
+		localBounds = std::move(newLocalBounds);
+		slots = std::move(newSlots);
+		levelStarts = std::move(starts);
+		pendingLocal.clear();
+		pendingBounds.clear();
+		childStarts.assign(count + 1, 0);
+		for (uint32_t slot = 0; slot < count; slot++)
+		{
+			childStarts[parentSlots[slot] + 1] += parentSlots[slot] != slot;
+		}
+		for (uint32_t slot = 0; slot < count; slot++)
+		{
+			childStarts[slot + 1] += childStarts[slot];
+		}
+		childSlots.resize(count);
+		cursor.assign(childStarts.begin(), childStarts.end() - 1);
+		for (uint32_t slot = 0; slot < count; slot++)
+		{
+			if (parentSlots[slot] != slot)
+			{
+				childSlots[cursor[parentSlots[slot]]++] = slot;
+			}
+		}
+
+		translationScale.resize(count);
+		rotation.resize(count);
+		bounds.resize(count);
+		// slots moved, so every world transform is recomputed
+		dirty.assign(count, 1);
+		movedSlots.clear();
+		fullUpdate = true;
+		stats.nodes = count;
+		stats.levels = levelCount;
+	}
+
+	// Scans every level, passing the flags down; returns how many nodes were recomputed.
+	uint64_t updateAll()
+	{
+		uint64_t dirtyNodes = 0;
+		for (uint32_t level = 0; level + 1 < levelStarts.size(); level++)
+		{
+			uint32_t const begin = levelStarts[level];
+			// whole groups of four per chunk, the SSE path's lanes
+			dirtyNodes += forEachChunk(levelStarts[level + 1] - begin, 4, [&](uint32_t first, uint32_t last) {
+				return level == 0 ? updateRoots(begin + first, begin + last) : updateNodes(begin + first, begin + last);
+			});
+		}
+		std::ranges::fill(dirty, uint8_t(0));
+		return dirtyNodes;
+	}
+
+	// Follows the moved nodes through their children, level by level. A child is flagged when it is queued, so a
+	// node that moved along with an ancestor is recomputed once.
+	uint64_t updateMoved()
+	{
+		std::ranges::sort(movedSlots);
+		uint64_t dirtyNodes = 0;
+		size_t   moved = 0;
+		frontier.clear();
+		for (uint32_t level = 0; level + 1 < levelStarts.size() && (moved < movedSlots.size() || !frontier.empty()); level++)
+		{
+			// the children queued by the level above, then the nodes moved on this one
+			for (; moved < movedSlots.size() && movedSlots[moved] < levelStarts[level + 1]; moved++)
+			{
+				frontier.push_back(movedSlots[moved]);
+			}
+			dirtyNodes += forEachChunk(static_cast<uint32_t>(frontier.size()), 1, [&](uint32_t first, uint32_t last) {
+				for (uint32_t i = first; i < last; i++)
+				{
+					recompute(frontier[i]);
+				}
+				return uint64_t(last - first);
+			});
+
+			nextFrontier.clear();
+			for (uint32_t const slot : frontier)
+			{
+				dirty[slot] = 0;
+				for (uint32_t child = childStarts[slot]; child < childStarts[slot + 1]; child++)
+				{
+					uint32_t const childSlot = childSlots[child];
+					if (!dirty[childSlot])
+					{
+						dirty[childSlot] = 1;
+						nextFrontier.push_back(childSlot);
+					}
+				}
+			}
+			// in slot order, so the next level is walked forward through memory
+			std::ranges::sort(nextFrontier);
+			std::swap(frontier, nextFrontier);
+		}
+		return dirtyNodes;
+	}
+
+	// Splits [0, count) into chunks of whole groups of granularity for the workers and this thread, and returns
+	// the sum of what update(first, last) returned for them.
+	template <typename Update>
+	uint64_t forEachChunk(uint32_t count, uint32_t granularity, Update&& update)
+	{
+		uint32_t const chunks = std::clamp(count / MIN_NODES_PER_CHUNK, 1u, chunkCount);
+		uint32_t const nodesPerChunk = ((count + chunks - 1) / chunks + granularity - 1) / granularity * granularity;
+
+		auto updateChunk = [&](uint32_t chunk) {
+			uint32_t const first = std::min(chunk * nodesPerChunk, count);
+			uint32_t const last = std::min(first + nodesPerChunk, count);
+			chunkDirtyNodes[chunk] = update(first, last);
+		};
+
+		parallelFor(workers.get(), chunks, updateChunk);
+
+		uint64_t dirtyNodes = 0;
+		for (uint32_t chunk = 0; chunk < chunks; chunk++)
+		{
+			dirtyNodes += chunkDirtyNodes[chunk];
+		}
+		return dirtyNodes;
+	}
+
+	uint64_t updateRoots(uint32_t first, uint32_t last)
+	{
+		uint64_t dirtyNodes = 0;
+		for (uint32_t slot = first; slot < last; slot++)
+		{
+			if (dirty[slot])
+			{
+				dirtyNodes++;
+				recompute(slot);
+			}
+		}
+		return dirtyNodes;
+	}
+
+	uint64_t updateNodes(uint32_t first, uint32_t last)
+	{
+		uint64_t dirtyNodes = 0;
+		uint32_t slot = first;
+#if RSTD_SCENE_GRAPH_SSE
+		for (; slot + 4 <= last; slot += 4)
+		{
+			std::array<uint32_t, 4> const parent = { parentSlots[slot], parentSlots[slot + 1], parentSlots[slot + 2], parentSlots[slot + 3] };
+			uint32_t                      lanes = 0;
+			for (uint32_t lane = 0; lane < 4; lane++)
+			{
+				dirty[slot + lane] |= dirty[parent[lane]];
+				lanes += dirty[slot + lane];
+			}
+			if (lanes == 0)
+			{
+				continue;
+			}
+			// recomputing the clean lanes as well gives the same result they already have
+			dirtyNodes += lanes;
+			updateLanes(slot, parent);
+		}
+#endif
+		for (; slot < last; slot++)
+		{
+			dirty[slot] |= dirty[parentSlots[slot]];
+			if (dirty[slot])
+			{
+				dirtyNodes++;
+				recompute(slot);
+			}
+		}
+		return dirtyNodes;
+	}
+
+	// One node from its parent's world transform, which has to be up to date.
+	void recompute(uint32_t slot)
+	{
+		uint32_t const    parent = parentSlots[slot];
+		Similarity<float> world = localAt<float>(slot);
+		if (parent != slot)
+		{
+			Similarity<float> const parentWorld = { translationScale[parent][0], translationScale[parent][1], translationScale[parent][2], translationScale[parent][3],
+													rotation[parent][0],         rotation[parent][1],         rotation[parent][2],         rotation[parent][3] };
+			world = compose(parentWorld, world);
+		}
+		store(slot, world, transformSphere(world, localBounds[slot]));
+	}
+
+#if RSTD_SCENE_GRAPH_SSE
+	// Slots [slot, slot + 4), all of one level, from their parents' world transforms.
+	void updateLanes(uint32_t slot, std::array<uint32_t, 4> const& parent)
+	{
+		Similarity<Lanes> parentWorld;
+		loadTransposed({ &translationScale[parent[0]], &translationScale[parent[1]], &translationScale[parent[2]], &translationScale[parent[3]] }, parentWorld.x,
+					   parentWorld.y, parentWorld.z, parentWorld.scale);
+		loadTransposed({ &rotation[parent[0]], &rotation[parent[1]], &rotation[parent[2]], &rotation[parent[3]] }, parentWorld.qx, parentWorld.qy, parentWorld.qz,
+					   parentWorld.qw);
+		Similarity<Lanes> const world = compose(parentWorld, localAt<Lanes>(slot));
+
+		std::array<Lanes, 4> sphere;
+		loadTransposed({ &localBounds[slot], &localBounds[slot + 1], &localBounds[slot + 2], &localBounds[slot + 3] }, sphere[0], sphere[1], sphere[2], sphere[3]);
+		sphere = transformSphere(world, sphere);
+
+		storeTransposed(&translationScale[slot], world.x, world.y, world.z, world.scale);
+		storeTransposed(&rotation[slot], world.qx, world.qy, world.qz, world.qw);
+		storeTransposed(&bounds[slot], sphere[0], sphere[1], sphere[2], sphere[3]);
+	}
+
+	static void loadTransposed(std::array<std::array<float, 4> const*, 4> const& rows, Lanes& a, Lanes& b, Lanes& c, Lanes& d)
+	{
+		__m128 row0 = _mm_loadu_ps(rows[0]->data());
+		__m128 row1 = _mm_loadu_ps(rows[1]->data());
+		__m128 row2 = _mm_loadu_ps(rows[2]->data());
+		__m128 row3 = _mm_loadu_ps(rows[3]->data());
+		_MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+		a = { row0 };
+		b = { row1 };
+		c = { row2 };
+		d = { row3 };
+	}
+
+	// Writes four consecutive rows.
+	static void storeTransposed(std::array<float, 4>* rows, Lanes a, Lanes b, Lanes c, Lanes d)
+	{
+		_MM_TRANSPOSE4_PS(a.v, b.v, c.v, d.v);
+		_mm_storeu_ps(rows[0].data(), a.v);
+		_mm_storeu_ps(rows[1].data(), b.v);
+		_mm_storeu_ps(rows[2].data(), c.v);
+		_mm_storeu_ps(rows[3].data(), d.v);
+	}
+#endif
+
+	template <typename F>
+	[[nodiscard]] Similarity<F> localAt(uint32_t slot) const
+	{
+		auto const load = [slot](std::vector<float> const& component) {
+			if constexpr (std::is_same_v<F, float>)
+			{
+				return component[slot];
+			}
+#if RSTD_SCENE_GRAPH_SSE
+			else
+			{
+				return Lanes{ _mm_loadu_ps(component.data() + slot) };
+			}
+#endif
+		};
+		return { load(local.x), load(local.y), load(local.z), load(local.scale), load(local.qx), load(local.qy), load(local.qz), load(local.qw) };
+	}
+
+	void store(uint32_t slot, Similarity<float> const& world, std::array<float, 4> const& sphere)
+	{
+		translationScale[slot] = { world.x, world.y, world.z, world.scale };
+		rotation[slot] = { world.qx, world.qy, world.qz, world.qw };
+		bounds[slot] = sphere;
+	}
+
+	// v rotated by the unit quaternion q: v + 2w (q.xyz x v) + q.xyz x (2 q.xyz x v).
+	template <typename F>
+	static void rotate(F qx, F qy, F qz, F qw, F& x, F& y, F& z)
+	{
+		F tx = qy * z - qz * y;
+		F ty = qz * x - qx * z;
+		F tz = qx * y - qy * x;
+		tx = tx + tx;
+		ty = ty + ty;
+		tz = tz + tz;
+		x = x + qw * tx + (qy * tz - qz * ty);
+		y = y + qw * ty + (qz * tx - qx * tz);
+		z = z + qw * tz + (qx * ty - qy * tx);
+	}
+
+	template <typename F>
+	static Similarity<F> compose(Similarity<F> const& parent, Similarity<F> const& child)
+	{
+		Similarity<F> world;
+		world.x = child.x * parent.scale;
+		world.y = child.y * parent.scale;
+		world.z = child.z * parent.scale;
+		rotate(parent.qx, parent.qy, parent.qz, parent.qw, world.x, world.y, world.z);
+		world.x = world.x + parent.x;
+		world.y = world.y + parent.y;
+		world.z = world.z + parent.z;
+		world.scale = parent.scale * child.scale;
+		world.qx = parent.qw * child.qx + parent.qx * child.qw + parent.qy * child.qz - parent.qz * child.qy;
+		world.qy = parent.qw * child.qy - parent.qx * child.qz + parent.qy * child.qw + parent.qz * child.qx;
+		world.qz = parent.qw * child.qz + parent.qx * child.qy - parent.qy * child.qx + parent.qz * child.qw;
+		world.qw = parent.qw * child.qw - parent.qx * child.qx - parent.qy * child.qy - parent.qz * child.qz;
+		return world;
+	}
+
+	template <typename F>
+	static std::array<F, 4> transformSphere(Similarity<F> const& world, std::array<F, 4> sphere)
+	{
+		sphere[0] = sphere[0] * world.scale;
+		sphere[1] = sphere[1] * world.scale;
+		sphere[2] = sphere[2] * world.scale;
+		rotate(world.qx, world.qy, world.qz, world.qw, sphere[0], sphere[1], sphere[2]);
+		return { sphere[0] + world.x, sphere[1] + world.y, sphere[2] + world.z, sphere[3] * world.scale };
+	}
+};
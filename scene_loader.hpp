@@ -0,0 +1,1042 @@
+#pragma once
+
+#include "mapped_file.hpp"
+
+#include "json.hpp" // nlohmann::json, bundled with tinygltf
+#include "tiny_obj_loader.h"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// The one vertex format every scene is converted to on load.
+struct SceneVertex
+{
+	std::array<float, 3> position;
+	std::array<float, 3> normal;
+	std::array<float, 2> uv;
+};
+
+// Options that change what a load produces; part of the mesh cache key.
+struct SceneImportSettings
+{
+	float scale = 1.0f; // uniform scale applied on import, e.g. 0.01 for assets authored in centimeters
+
+	[[nodiscard]] uint64_t hash() const
+	{
+		uint64_t hash = 0xcbf29ce484222325ull;
+		auto     add = [&](auto const& value) {
+			auto const* bytes = reinterpret_cast<uint8_t const*>(&value);
+			for (size_t i = 0; i < sizeof(value); i++)
+			{
+				hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+			}
+		};
+		add(scale);
+		return hash;
+	}
+};
+
+constexpr uint32_t SCENE_NONE = ~0u; // no material, no texture
+
+// One primitive of the merged arena, ready for drawIndexed: indices are local to the primitive.
+struct SceneDraw
+{
+	uint32_t             indexCount = 0;
+	uint32_t             firstIndex = 0;
+	int32_t              vertexOffset = 0;
+	uint32_t             vertexCount = 0;
+	std::array<float, 3> boundsMin = {}; // world space
+	std::array<float, 3> boundsMax = {};
+	uint32_t             material = SCENE_NONE; // index into the scene's materials
+};
+
+// The base color of a glTF metallic-roughness material, or the diffuse term of an OBJ material.
+struct SceneMaterial
+{
+	std::array<float, 4> baseColorFactor = { 1.0f, 1.0f, 1.0f, 1.0f };
+	uint32_t             baseColorTexture = SCENE_NONE; // index into the scene's textures
+	float                alphaCutoff = 0.0f;            // glTF alphaMode MASK; 0 draws the material opaque
+};
+
+// An encoded image file, or a byte range of a file when the image is embedded in a .glb or a .bin buffer.
+// Textures are only referenced here; they are decoded when streamed.
+struct SceneTexture
+{
+	std::string path;
+	uint64_t    offset = 0;
+	uint64_t    size = 0; // 0: up to the end of the file
+};
+
+// A typed, strided window onto accessor data wherever it lives: a mapped file, a decoded buffer or an owned array.
+struct AccessorView
+{
+	static constexpr uint32_t BYTE = 5120;
+	static constexpr uint32_t UNSIGNED_BYTE = 5121;
+	static constexpr uint32_t SHORT = 5122;
+	static constexpr uint32_t UNSIGNED_SHORT = 5123;
+	static constexpr uint32_t UNSIGNED_INT = 5125;
+	static constexpr uint32_t FLOAT = 5126;
+
+	std::byte const* data = nullptr;
+	uint64_t         count = 0;
+	uint32_t         stride = 0;
+	uint32_t         componentType = FLOAT;
+	uint32_t         components = 0;
+	bool             normalized = false;
+
+	explicit operator bool() const
+	{
+		return data != nullptr;
+	}
+
+	[[nodiscard]] float component(uint64_t element, uint32_t c) const
+	{
+		std::byte const* const p = data + element * stride;
+		switch (componentType)
+		{
+		case FLOAT:
+			return load<float>(p, c);
+		case UNSIGNED_BYTE:
+			return normalized ? load<uint8_t>(p, c) / 255.0f : load<uint8_t>(p, c);
+		case BYTE:
+			return normalized ? std::max(load<int8_t>(p, c) / 127.0f, -1.0f) : load<int8_t>(p, c);
+		case UNSIGNED_SHORT:
+			return normalized ? load<uint16_t>(p, c) / 65535.0f : load<uint16_t>(p, c);
+		case SHORT:
+			return normalized ? std::max(load<int16_t>(p, c) / 32767.0f, -1.0f) : load<int16_t>(p, c);
+		case UNSIGNED_INT:
+			return static_cast<float>(load<uint32_t>(p, c));
+		default:
+			return 0.0f;
+		}
+	}
+
+	template <size_t N>
+	[[nodiscard]] std::array<float, N> read(uint64_t element) const
+	{
+		std::array<float, N> result;
+		if (componentType == FLOAT)
+		{
+			memcpy(result.data(), data + element * stride, N * sizeof(float));
+		}
+		else
+		{
+			for (uint32_t c = 0; c < N; c++)
+			{
+				result[c] = component(element, c);
+			}
+		}
+		return result;
+	}
+
+	[[nodiscard]] uint32_t index(uint64_t element) const
+	{
+		std::byte const* const p = data + element * stride;
+		switch (componentType)
+		{
+		case UNSIGNED_BYTE:
+			return load<uint8_t>(p, 0);
+		case UNSIGNED_SHORT:
+			return load<uint16_t>(p, 0);
+		default:
+			return load<uint32_t>(p, 0);
+		}
+	}
+
+	static uint32_t componentSize(uint32_t componentType)
+	{
+		switch (componentType)
+		{
+		case BYTE:
+		case UNSIGNED_BYTE:
+			return 1;
+		case SHORT:
+		case UNSIGNED_SHORT:
+			return 2;
+		case UNSIGNED_INT:
+		case FLOAT:
+			return 4;
+		default:
+			throw std::runtime_error("invalid accessor component type!");
+		}
+	}
+
+private:
+	template <typename T>
+	static T load(std::byte const* p, uint32_t c)
+	{
+		T value;
+		memcpy(&value, p + c * sizeof(T), sizeof(T));
+		return value;
+	}
+};
+
+// A scene flattened into one vertex/index arena. Loading only parses structure: accessor data stays where it
+// is (for .glb and external .bin buffers, in the memory-mapped file) and is converted to SceneVertex straight
+// into the caller's memory by writeVertices()/writeIndices(), so it can be streamed into a staging buffer
+// without an intermediate copy. Node transforms are baked into the vertices, one arena range per instance.
+class SceneSource
+{
+public:
+	// Loads .glb, .gltf or .obj, picked by extension.
+	static SceneSource load(std::string const& path, SceneImportSettings const& settings = {})
+	{
+		std::string extension = std::filesystem::path(path).extension().string();
+		std::ranges::transform(extension, extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+		if (extension == ".glb" || extension == ".gltf")
+		{
+			return loadGltf(path, settings);
+		}
+		if (extension == ".obj")
+		{
+			return loadObj(path, settings);
+		}
+		throw std::runtime_error("unsupported scene format: " + path);
+	}
+
+	static SceneSource fromMesh(std::vector<SceneVertex> vertices, std::vector<uint32_t> indices)
+	{
+		SceneSource scene;
+		scene.ownedVertices = std::move(vertices);
+		scene.ownedIndices = std::move(indices);
+		scene.addOwnedPrimitive(0, scene.ownedVertices.size(), 0, scene.ownedIndices.size());
+		scene.finalize();
+		return scene;
+	}
+
+	[[nodiscard]] uint64_t vertexCount() const
+	{
+		return totalVertices;
+	}
+
+	[[nodiscard]] uint64_t indexCount() const
+	{
+		return totalIndices;
+	}
+
+	[[nodiscard]] std::vector<SceneDraw> const& draws() const
+	{
+		return drawList;
+	}
+
+	[[nodiscard]] std::array<float, 3> const& getBoundsMin() const
+	{
+		return boundsMin;
+	}
+
+	[[nodiscard]] std::array<float, 3> const& getBoundsMax() const
+	{
+		return boundsMax;
+	}
+
+	[[nodiscard]] std::vector<SceneMaterial> const& materials() const
+	{
+		return materialList;
+	}
+
+	[[nodiscard]] std::vector<SceneTexture> const& textures() const
+	{
+		return textureList;
+	}
+
+	// Every file the scene was read from, starting with the one passed to load().
+	[[nodiscard]] std::vector<std::string> const& sourceFiles() const
+	{
+		return sources;
+	}
+
+	// True when vertex data is read straight out of memory-mapped files.
+	[[nodiscard]] bool isMapped() const
+	{
+		return mapped;
+	}
+
+	// Converts arena vertices [first, first + count) into out.
+	void writeVertices(uint64_t first, uint64_t count, SceneVertex* out) const
+	{
+		while (count > 0)
+		{
+			Primitive const& primitive = primitiveAt(first, &Primitive::firstVertex);
+			uint64_t const   begin = first - primitive.firstVertex;
+			uint64_t const   end = std::min<uint64_t>(primitive.vertexCount, begin + count);
+			for (uint64_t v = begin; v < end; v++)
+			{
+				SceneVertex vertex;
+				vertex.position = primitive.identity ? primitive.positions.read<3>(v) : transformPoint(primitive.transform, primitive.positions.read<3>(v));
+				// primitives without normals face +Y, so the debug shading still shows them
+				vertex.normal = primitive.normals ? primitive.normals.read<3>(v) : std::array<float, 3>{ 0.0f, 1.0f, 0.0f };
+				if (!primitive.identity && primitive.normals)
+				{
+					vertex.normal = transformNormal(primitive.transform, vertex.normal);
+				}
+				vertex.uv = primitive.uvs ? primitive.uvs.read<2>(v) : std::array<float, 2>{ 0.0f, 0.0f };
+				*out++ = vertex;
+			}
+			first += end - begin;
+			count -= end - begin;
+		}
+	}
+
+	// Converts arena indices [first, first + count) into out; indices stay local to their primitive.
+	void writeIndices(uint64_t first, uint64_t count, uint32_t* out) const
+	{
+		while (count > 0)
+		{
+			Primitive const& primitive = primitiveAt(first, &Primitive::firstIndex);
+			uint64_t const   begin = first - primitive.firstIndex;
+			uint64_t const   end = std::min<uint64_t>(primitive.indexCount, begin + count);
+			for (uint64_t i = begin; i < end; i++)
+			{
+				// mirroring transforms flip the winding; swap the last two corners of every triangle back
+				uint64_t source = i;
+				if (primitive.flipWinding && i % 3 != 0)
+				{
+					source = i % 3 == 1 ? i + 1 : i - 1;
+				}
+				*out++ = primitive.indices ? primitive.indices.index(source) : static_cast<uint32_t>(source);
+			}
+			first += end - begin;
+			count -= end - begin;
+		}
+	}
+
+private:
+	using Matrix4 = std::array<float, 16>; // column-major, as glTF stores it
+
+	static constexpr Matrix4  IDENTITY = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+	static constexpr uint32_t GLB_MAGIC = 0x46546C67; // "glTF"
+	static constexpr uint32_t GLB_CHUNK_JSON = 0x4E4F534A;
+	static constexpr uint32_t GLB_CHUNK_BIN = 0x004E4942;
+
+	struct Primitive
+	{
+		AccessorView         positions;
+		AccessorView         normals;
+		AccessorView         uvs;
+		AccessorView         indices; // empty for non-indexed primitives
+		Matrix4              transform = IDENTITY;
+		bool                 identity = true;
+		bool                 flipWinding = false;
+		uint64_t             vertexCount = 0;
+		uint64_t             indexCount = 0;
+		uint64_t             firstVertex = 0;
+		uint64_t             firstIndex = 0;
+		uint32_t             material = SCENE_NONE;
+		bool                 hasLocalBounds = false; // from the POSITION accessor's min/max
+		std::array<float, 3> localMin = {};
+		std::array<float, 3> localMax = {};
+	};
+
+	MappedFile                          file;
+	std::vector<MappedFile>             externalFiles; // .bin buffers referenced by a .gltf
+	std::vector<std::vector<std::byte>> decodedBuffers; // base64 data: URIs and accessors without a buffer view
+	std::vector<SceneVertex>            ownedVertices;  // .obj and in-memory meshes
+	std::vector<uint32_t>               ownedIndices;
+	std::vector<std::string>            sources;
+	bool                                mapped = false;
+
+	std::vector<Primitive>     primitives;
+	std::vector<SceneDraw>     drawList;
+	std::vector<SceneMaterial> materialList;
+	std::vector<SceneTexture>  textureList;
+	uint64_t               totalVertices = 0;
+	uint64_t               totalIndices = 0;
+	std::array<float, 3>   boundsMin = {};
+	std::array<float, 3>   boundsMax = {};
+
+	// Finds the primitive whose arena range (by firstVertex or firstIndex) contains position.
+	Primitive const& primitiveAt(uint64_t position, uint64_t Primitive::* first) const
+	{
+		auto it = std::ranges::upper_bound(primitives, position, {}, first);
+		if (it == primitives.begin())
+		{
+			throw std::out_of_range("scene arena range out of bounds");
+		}
+		return *--it;
+	}
+
+	static uint32_t readU32(std::byte const* p)
+	{
+		uint32_t value;
+		memcpy(&value, p, sizeof(value));
+		return value;
+	}
+
+	static nlohmann::json const& arrayOf(nlohmann::json const& object, char const* key)
+	{
+		static nlohmann::json const empty = nlohmann::json::array();
+		auto const it = object.find(key);
+		return it != object.end() ? *it : empty;
+	}
+
+	static SceneSource loadGltf(std::string const& path, SceneImportSettings const& settings)
+	{
+		SceneSource scene;
+		scene.file = MappedFile(path);
+		scene.sources.push_back(path);
+		std::byte const* const bytes = scene.file.data();
+		size_t const           size = scene.file.size();
+
+		std::string_view           jsonText(reinterpret_cast<char const*>(bytes), size);
+		std::span<std::byte const> binChunk;
+		if (size >= 12 && readU32(bytes) == GLB_MAGIC)
+		{
+			if (readU32(bytes + 4) != 2 || readU32(bytes + 8) > size || size < 20 || readU32(bytes + 16) != GLB_CHUNK_JSON)
+			{
+				throw std::runtime_error("invalid glb header: " + path);
+			}
+			size_t const length = readU32(bytes + 8);
+			size_t const jsonLength = readU32(bytes + 12);
+			if (20 + jsonLength > length)
+			{
+				throw std::runtime_error("invalid glb json chunk: " + path);
+			}
+			jsonText = std::string_view(reinterpret_cast<char const*>(bytes + 20), jsonLength);
+
+			size_t const binHeader = 20 + ((jsonLength + 3) & ~size_t(3));
+			if (binHeader + 8 <= length && readU32(bytes + binHeader + 4) == GLB_CHUNK_BIN)
+			{
+				size_t const binLength = readU32(bytes + binHeader);
+				if (binHeader + 8 + binLength > length)
+				{
+					throw std::runtime_error("invalid glb bin chunk: " + path);
+				}
+				binChunk = std::span<std::byte const>(bytes + binHeader + 8, binLength);
+			}
+		}
+
+		nlohmann::json const document = nlohmann::json::parse(jsonText.begin(), jsonText.end());
+		for (auto const& extension : arrayOf(document, "extensionsRequired"))
+		{
+			if (extension == "KHR_draco_mesh_compression" || extension == "EXT_meshopt_compression")
+			{
+				throw std::runtime_error("unsupported glTF extension: " + extension.get<std::string>());
+			}
+		}
+
+		std::filesystem::path const             directory = std::filesystem::path(path).parent_path();
+		std::vector<std::span<std::byte const>> buffers;
+		std::vector<SceneTexture>               bufferFiles; // where each buffer lives on disk, for embedded images; empty path for data: URIs
+		scene.mapped = true;
+		for (auto const& buffer : arrayOf(document, "buffers"))
+		{
+			uint64_t const             byteLength = buffer.at("byteLength").get<uint64_t>();
+			std::span<std::byte const> data;
+			if (!buffer.contains("uri"))
+			{
+				if (!buffers.empty() || binChunk.empty())
+				{
+					throw std::runtime_error("glTF buffer without uri outside a glb: " + path);
+				}
+				data = binChunk;
+				bufferFiles.push_back({ .path = path, .offset = static_cast<uint64_t>(binChunk.data() - bytes) });
+			}
+			else if (std::string const uri = buffer["uri"].get<std::string>(); uri.starts_with("data:"))
+			{
+				size_t const comma = uri.find(',');
+				if (comma == std::string::npos || comma < 12 || uri.compare(comma - 7, 7, ";base64") != 0)
+				{
+					throw std::runtime_error("unsupported glTF data uri in: " + path);
+				}
+				scene.decodedBuffers.push_back(decodeBase64(std::string_view(uri).substr(comma + 1)));
+				data = scene.decodedBuffers.back();
+				scene.mapped = false;
+				bufferFiles.emplace_back();
+			}
+			else
+			{
+				scene.sources.push_back((directory / decodeUri(uri)).string());
+				scene.externalFiles.emplace_back(scene.sources.back());
+				data = std::span<std::byte const>(scene.externalFiles.back().data(), scene.externalFiles.back().size());
+				bufferFiles.push_back({ .path = scene.sources.back() });
+			}
+			if (data.size() < byteLength)
+			{
+				throw std::runtime_error("glTF buffer is shorter than its byteLength: " + path);
+			}
+			buffers.push_back(data.first(byteLength));
+		}
+
+		auto const accessorView = [&](size_t index, uint32_t minComponents) {
+			nlohmann::json const& accessor = document.at("accessors").at(index);
+			if (accessor.contains("sparse"))
+			{
+				throw std::runtime_error("sparse glTF accessors are not supported: " + path);
+			}
+
+			AccessorView result{ .count = accessor.at("count").get<uint64_t>(),
+								 .componentType = accessor.at("componentType").get<uint32_t>(),
+								 .components = componentCount(accessor.at("type").get<std::string>()),
+								 .normalized = accessor.value("normalized", false) };
+			uint32_t const elementSize = AccessorView::componentSize(result.componentType) * result.components;
+			if (result.components < minComponents)
+			{
+				throw std::runtime_error("invalid glTF accessor in: " + path);
+			}
+
+			// an accessor without a buffer view reads as zeros
+			if (!accessor.contains("bufferView"))
+			{
+				scene.decodedBuffers.emplace_back(result.count * elementSize);
+				scene.mapped = false;
+				result.stride = elementSize;
+				result.data = scene.decodedBuffers.back().data();
+				return result;
+			}
+
+			nlohmann::json const& view = document.at("bufferViews").at(accessor["bufferView"].get<size_t>());
+			auto const&           buffer = buffers.at(view.at("buffer").get<size_t>());
+			result.stride = view.value("byteStride", elementSize);
+
+			uint64_t const viewOffset = view.value("byteOffset", uint64_t(0));
+			uint64_t const viewLength = view.at("byteLength").get<uint64_t>();
+			uint64_t const offset = accessor.value("byteOffset", uint64_t(0));
+			if (viewOffset + viewLength > buffer.size() ||
+				(result.count > 0 && offset + result.stride * (result.count - 1) + elementSize > viewLength))
+			{
+				throw std::runtime_error("invalid glTF accessor in: " + path);
+			}
+			result.data = buffer.data() + viewOffset + offset;
+			return result;
+		};
+
+		scene.loadGltfMaterials(document, directory, bufferFiles);
+
+		// walk the node hierarchy of the default scene, or every root node when there is none
+		nlohmann::json const&                   nodes = arrayOf(document, "nodes");
+		Matrix4 const                           root = { settings.scale, 0, 0, 0, 0, settings.scale, 0, 0, 0, 0, settings.scale, 0, 0, 0, 0, 1 };
+		std::vector<std::pair<size_t, Matrix4>> stack;
+		if (auto const& scenes = arrayOf(document, "scenes"); !scenes.empty())
+		{
+			for (auto const& node : arrayOf(scenes.at(document.value("scene", size_t(0))), "nodes"))
+			{
+				stack.emplace_back(node.get<size_t>(), root);
+			}
+		}
+		else
+		{
+			std::vector<bool> isChild(nodes.size());
+			for (auto const& node : nodes)
+			{
+				for (auto const& child : arrayOf(node, "children"))
+				{
+					isChild.at(child.get<size_t>()) = true;
+				}
+			}
+			for (size_t node = 0; node < nodes.size(); node++)
+			{
+				if (!isChild[node])
+				{
+					stack.emplace_back(node, root);
+				}
+			}
+		}
+
+		size_t visited = 0;
+		while (!stack.empty())
+		{
+			auto const [nodeIndex, parent] = stack.back();
+			stack.pop_back();
+			// glTF node hierarchies are disjoint trees, so no node can be reached twice
+			if (++visited > nodes.size())
+			{
+				throw std::runtime_error("glTF node hierarchy has a cycle: " + path);
+			}
+
+			nlohmann::json const& node = nodes.at(nodeIndex);
+			Matrix4 const         world = multiply(parent, localTransform(node));
+			for (auto const& child : arrayOf(node, "children"))
+			{
+				stack.emplace_back(child.get<size_t>(), world);
+			}
+			if (!node.contains("mesh"))
+			{
+				continue;
+			}
+
+			nlohmann::json const& mesh = document.at("meshes").at(node["mesh"].get<size_t>());
+			for (auto const& source : arrayOf(mesh, "primitives"))
+			{
+				nlohmann::json const& attributes = source.at("attributes");
+				if (source.value("mode", 4) != 4 || !attributes.contains("POSITION"))
+				{
+					continue; // only triangle lists are drawn
+				}
+
+				Primitive primitive;
+				primitive.positions = accessorView(attributes["POSITION"].get<size_t>(), 3);
+				if (attributes.contains("NORMAL"))
+				{
+					primitive.normals = accessorView(attributes["NORMAL"].get<size_t>(), 3);
+				}
+				if (attributes.contains("TEXCOORD_0"))
+				{
+					primitive.uvs = accessorView(attributes["TEXCOORD_0"].get<size_t>(), 2);
+				}
+				if (source.contains("indices"))
+				{
+					primitive.indices = accessorView(source["indices"].get<size_t>(), 1);
+				}
+				primitive.vertexCount = primitive.positions.count;
+				primitive.indexCount = primitive.indices ? primitive.indices.count : primitive.vertexCount;
+				primitive.indexCount -= primitive.indexCount % 3;
+				if (primitive.indexCount == 0 || primitive.vertexCount == 0)
+				{
+					continue;
+				}
+				if ((primitive.normals && primitive.normals.count < primitive.vertexCount) || (primitive.uvs && primitive.uvs.count < primitive.vertexCount))
+				{
+					throw std::runtime_error("glTF attribute count mismatch in: " + path);
+				}
+
+				nlohmann::json const& position = document["accessors"][attributes["POSITION"].get<size_t>()];
+				if (position.contains("min") && position.contains("max"))
+				{
+					for (uint32_t c = 0; c < 3; c++)
+					{
+						primitive.localMin[c] = position["min"].at(c).get<float>();
+						primitive.localMax[c] = position["max"].at(c).get<float>();
+					}
+					primitive.hasLocalBounds = true;
+				}
+				primitive.material = source.value("material", SCENE_NONE);
+				if (primitive.material != SCENE_NONE && primitive.material >= scene.materialList.size())
+				{
+					throw std::runtime_error("invalid glTF material index in: " + path);
+				}
+				primitive.transform = world;
+				primitive.identity = world == IDENTITY;
+				primitive.flipWinding = determinant3(world) < 0.0f;
+				scene.primitives.push_back(primitive);
+			}
+		}
+
+		scene.finalize();
+		return scene;
+	}
+
+	// Base color factors and textures of every glTF material. An image embedded in a buffer view becomes a byte
+	// range of the file holding the buffer; data: URI images are not streamed and leave the material untextured.
+	void loadGltfMaterials(nlohmann::json const& document, std::filesystem::path const& directory, std::vector<SceneTexture> const& bufferFiles)
+	{
+		nlohmann::json const&                images = arrayOf(document, "images");
+		nlohmann::json const&                textures = arrayOf(document, "textures");
+		std::unordered_map<size_t, uint32_t> imageTextures; // several glTF textures may share one image
+		auto const                           textureFor = [&](size_t textureIndex) {
+			nlohmann::json const& texture = textures.at(textureIndex);
+			if (!texture.contains("source"))
+			{
+				return SCENE_NONE; // only an extension's source, e.g. KTX2 or WebP
+			}
+			size_t const imageIndex = texture["source"].get<size_t>();
+			if (auto const it = imageTextures.find(imageIndex); it != imageTextures.end())
+			{
+				return it->second;
+			}
+
+			nlohmann::json const& image = images.at(imageIndex);
+			SceneTexture          sceneTexture;
+			if (image.contains("bufferView"))
+			{
+				nlohmann::json const& view = document.at("bufferViews").at(image["bufferView"].get<size_t>());
+				SceneTexture const&   buffer = bufferFiles.at(view.at("buffer").get<size_t>());
+				if (!buffer.path.empty())
+				{
+					sceneTexture = { .path = buffer.path, .offset = buffer.offset + view.value("byteOffset", uint64_t(0)), .size = view.at("byteLength").get<uint64_t>() };
+				}
+			}
+			else if (std::string const uri = image.value("uri", std::string()); !uri.empty() && !uri.starts_with("data:"))
+			{
+				sceneTexture.path = (directory / decodeUri(uri)).string();
+			}
+
+			uint32_t index = SCENE_NONE;
+			if (!sceneTexture.path.empty())
+			{
+				index = static_cast<uint32_t>(textureList.size());
+				textureList.push_back(sceneTexture);
+			}
+			imageTextures.emplace(imageIndex, index);
+			return index;
+		};
+
+		for (auto const& material : arrayOf(document, "materials"))
+		{
+			SceneMaterial sceneMaterial;
+			if (auto const pbr = material.find("pbrMetallicRoughness"); pbr != material.end())
+			{
+				sceneMaterial.baseColorFactor = pbr->value("baseColorFactor", sceneMaterial.baseColorFactor);
+				if (pbr->contains("baseColorTexture"))
+				{
+					sceneMaterial.baseColorTexture = textureFor((*pbr)["baseColorTexture"].at("index").get<size_t>());
+				}
+			}
+			// BLEND is drawn opaque like OPAQUE, there being no transparent pass
+			if (material.value("alphaMode", std::string("OPAQUE")) == "MASK")
+			{
+				sceneMaterial.alphaCutoff = material.value("alphaCutoff", 0.5f);
+			}
+			materialList.push_back(sceneMaterial);
+		}
+	}
+
+	// The .mtl files the OBJ's mtllib statements name that exist under searchPath, which is where tinyobj looks
+	// for them. Their materials end up in the scene, so they are sources of it as much as the OBJ itself.
+	static std::vector<std::string> objMaterialLibraries(std::string const& path, std::string const& searchPath)
+	{
+		MappedFile const           file(path);
+		std::string_view const     text(reinterpret_cast<char const*>(file.data()), file.size());
+		std::vector<std::string>   libraries;
+		constexpr std::string_view KEYWORD = "mtllib";
+		for (size_t lineStart = 0; lineStart < text.size();)
+		{
+			size_t const     lineEnd = std::min(text.find('\n', lineStart), text.size());
+			std::string_view line = text.substr(lineStart, lineEnd - lineStart);
+			lineStart = lineEnd + 1;
+			while (!line.empty() && std::isspace(static_cast<unsigned char>(line.front())))
+			{
+				line.remove_prefix(1);
+			}
+			if (!line.starts_with(KEYWORD) || line.size() == KEYWORD.size() || !std::isspace(static_cast<unsigned char>(line[KEYWORD.size()])))
+			{
+				continue;
+			}
+			line.remove_prefix(KEYWORD.size());
+			// one or more whitespace-separated file names
+			while (!line.empty())
+			{
+				size_t const nameStart = std::min(line.find_first_not_of(" \t\r"), line.size());
+				size_t const nameEnd = std::min(line.find_first_of(" \t\r", nameStart), line.size());
+				if (nameEnd > nameStart)
+				{
+					std::filesystem::path const library = std::filesystem::path(searchPath) / line.substr(nameStart, nameEnd - nameStart);
+					std::error_code             error;
+					if (std::filesystem::is_regular_file(library, error) &&
+						std::ranges::find(libraries, library.string()) == libraries.end())
+					{
+						libraries.push_back(library.string());
+					}
+				}
+				line.remove_prefix(nameEnd);
+			}
+		}
+		return libraries;
+	}
+
+	static SceneSource loadObj(std::string const& path, SceneImportSettings const& settings)
+	{
+		tinyobj::ObjReaderConfig readerConfig;
+		readerConfig.triangulate = true;
+		readerConfig.vertex_color = false;
+		readerConfig.mtl_search_path = std::filesystem::path(path).parent_path().string();
+
+		tinyobj::ObjReader reader;
+		if (!reader.ParseFromFile(path, readerConfig))
+		{
+			throw std::runtime_error("failed to load OBJ: " + reader.Error());
+		}
+		tinyobj::attrib_t const& attrib = reader.GetAttrib();
+
+		struct IndexHash
+		{
+			size_t operator()(tinyobj::index_t const& index) const
+			{
+				return std::hash<uint64_t>()((uint64_t(uint32_t(index.vertex_index)) << 32) ^ (uint64_t(uint32_t(index.normal_index)) << 16) ^
+											 uint32_t(index.texcoord_index));
+			}
+		};
+		struct IndexEqual
+		{
+			bool operator()(tinyobj::index_t const& a, tinyobj::index_t const& b) const
+			{
+				return a.vertex_index == b.vertex_index && a.normal_index == b.normal_index && a.texcoord_index == b.texcoord_index;
+			}
+		};
+
+		// one primitive per shape, with vertices deduplicated on their (position, normal, uv) index triple
+		SceneSource                        scene;
+		std::vector<std::array<size_t, 4>> ranges;
+		std::vector<uint32_t>              rangeMaterials;
+		scene.sources.push_back(path);
+		for (std::string& library : objMaterialLibraries(path, readerConfig.mtl_search_path))
+		{
+			scene.sources.push_back(std::move(library));
+		}
+
+		// OBJ has no base color texture; map_Kd and Kd are the closest equivalent
+		std::unordered_map<std::string, uint32_t> textureIndices;
+		for (tinyobj::material_t const& material : reader.GetMaterials())
+		{
+			SceneMaterial sceneMaterial{ .baseColorFactor = { material.diffuse[0], material.diffuse[1], material.diffuse[2], material.dissolve } };
+			if (!material.diffuse_texname.empty())
+			{
+				std::string const texturePath = (std::filesystem::path(readerConfig.mtl_search_path) / material.diffuse_texname).string();
+				auto [it, inserted] = textureIndices.try_emplace(texturePath, static_cast<uint32_t>(scene.textureList.size()));
+				if (inserted)
+				{
+					scene.textureList.push_back({ .path = texturePath });
+				}
+				sceneMaterial.baseColorTexture = it->second;
+			}
+			scene.materialList.push_back(sceneMaterial);
+		}
+		for (tinyobj::shape_t const& shape : reader.GetShapes())
+		{
+			size_t const firstVertex = scene.ownedVertices.size();
+			size_t const firstIndex = scene.ownedIndices.size();
+			std::unordered_map<tinyobj::index_t, uint32_t, IndexHash, IndexEqual> unique;
+			for (tinyobj::index_t const& index : shape.mesh.indices)
+			{
+				auto [it, inserted] = unique.try_emplace(index, static_cast<uint32_t>(scene.ownedVertices.size() - firstVertex));
+				if (inserted)
+				{
+					SceneVertex vertex{ .position = { attrib.vertices[3 * index.vertex_index + 0] * settings.scale, attrib.vertices[3 * index.vertex_index + 1] * settings.scale,
+													  attrib.vertices[3 * index.vertex_index + 2] * settings.scale },
+										.normal = { 0.0f, 1.0f, 0.0f },
+										.uv = { 0.0f, 0.0f } };
+					if (index.normal_index >= 0)
+					{
+						vertex.normal = { attrib.normals[3 * index.normal_index + 0], attrib.normals[3 * index.normal_index + 1], attrib.normals[3 * index.normal_index + 2] };
+					}
+					if (index.texcoord_index >= 0)
+					{
+						// OBJ puts the texture origin at the bottom left
+						vertex.uv = { attrib.texcoords[2 * index.texcoord_index + 0], 1.0f - attrib.texcoords[2 * index.texcoord_index + 1] };
+					}
+					scene.ownedVertices.push_back(vertex);
+				}
+				scene.ownedIndices.push_back(it->second);
+			}
+			if (scene.ownedIndices.size() > firstIndex)
+			{
+				ranges.push_back({ firstVertex, scene.ownedVertices.size() - firstVertex, firstIndex, scene.ownedIndices.size() - firstIndex });
+				// one draw per shape, so the shape takes the material of its first face
+				int const material = shape.mesh.material_ids.empty() ? -1 : shape.mesh.material_ids.front();
+				rangeMaterials.push_back(material >= 0 && static_cast<size_t>(material) < scene.materialList.size() ? static_cast<uint32_t>(material) : SCENE_NONE);
+			}
+		}
+
+		// views into the owned arrays are only taken once they have stopped growing
+		for (size_t i = 0; i < ranges.size(); i++)
+		{
+			auto const& [firstVertex, vertexCount, firstIndex, indexCount] = ranges[i];
+			scene.addOwnedPrimitive(firstVertex, vertexCount, firstIndex, indexCount);
+			scene.primitives.back().material = rangeMaterials[i];
+		}
+		scene.finalize();
+		return scene;
+	}
+
+	void addOwnedPrimitive(size_t firstVertex, size_t vertexCount, size_t firstIndex, size_t indexCount)
+	{
+		auto const* vertices = reinterpret_cast<std::byte const*>(ownedVertices.data() + firstVertex);
+		Primitive   primitive;
+		primitive.positions = { .data = vertices + offsetof(SceneVertex, position), .count = vertexCount, .stride = sizeof(SceneVertex), .components = 3 };
+		primitive.normals = { .data = vertices + offsetof(SceneVertex, normal), .count = vertexCount, .stride = sizeof(SceneVertex), .components = 3 };
+		primitive.uvs = { .data = vertices + offsetof(SceneVertex, uv), .count = vertexCount, .stride = sizeof(SceneVertex), .components = 2 };
+		primitive.indices = { .data = reinterpret_cast<std::byte const*>(ownedIndices.data() + firstIndex),
+							  .count = indexCount,
+							  .stride = sizeof(uint32_t),
+							  .componentType = AccessorView::UNSIGNED_INT,
+							  .components = 1 };
+		primitive.vertexCount = vertexCount;
+		primitive.indexCount = indexCount;
+		primitives.push_back(primitive);
+	}
+
+	// Lays the primitives out back to back in the arena and computes their world-space bounds.
+	void finalize()
+	{
+		boundsMin = { std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max() };
+		boundsMax = { std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest() };
+		for (Primitive& primitive : primitives)
+		{
+			primitive.firstVertex = totalVertices;
+			primitive.firstIndex = totalIndices;
+			totalVertices += primitive.vertexCount;
+			totalIndices += primitive.indexCount;
+			if (totalVertices > uint64_t(std::numeric_limits<int32_t>::max()) || totalIndices > std::numeric_limits<uint32_t>::max())
+			{
+				throw std::runtime_error("scene exceeds the 32-bit vertex/index range!");
+			}
+
+			SceneDraw draw{ .indexCount = static_cast<uint32_t>(primitive.indexCount),
+							.firstIndex = static_cast<uint32_t>(primitive.firstIndex),
+							.vertexOffset = static_cast<int32_t>(primitive.firstVertex),
+							.vertexCount = static_cast<uint32_t>(primitive.vertexCount),
+							.boundsMin = { std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max() },
+							.boundsMax = { std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest() },
+							.material = primitive.material };
+			auto const grow = [&](std::array<float, 3> const& point) {
+				for (uint32_t c = 0; c < 3; c++)
+				{
+					draw.boundsMin[c] = std::min(draw.boundsMin[c], point[c]);
+					draw.boundsMax[c] = std::max(draw.boundsMax[c], point[c]);
+				}
+			};
+			if (primitive.hasLocalBounds)
+			{
+				for (uint32_t corner = 0; corner < 8; corner++)
+				{
+					std::array<float, 3> const point = { corner & 1 ? primitive.localMax[0] : primitive.localMin[0], corner & 2 ? primitive.localMax[1] : primitive.localMin[1],
+														 corner & 4 ? primitive.localMax[2] : primitive.localMin[2] };
+					grow(transformPoint(primitive.transform, point));
+				}
+			}
+			else
+			{
+				for (uint64_t v = 0; v < primitive.vertexCount; v++)
+				{
+					grow(transformPoint(primitive.transform, primitive.positions.read<3>(v)));
+				}
+			}
+			for (uint32_t c = 0; c < 3; c++)
+			{
+				boundsMin[c] = std::min(boundsMin[c], draw.boundsMin[c]);
+				boundsMax[c] = std::max(boundsMax[c], draw.boundsMax[c]);
+			}
+			drawList.push_back(draw);
+		}
+	}
+
+	static uint32_t componentCount(std::string const& type)
+	{
+		static std::unordered_map<std::string, uint32_t> const counts = { { "SCALAR", 1 }, { "VEC2", 2 }, { "VEC3", 3 }, { "VEC4", 4 }, { "MAT2", 4 }, { "MAT3", 9 }, { "MAT4", 16 } };
+		auto const it = counts.find(type);
+		if (it == counts.end())
+		{
+			throw std::runtime_error("invalid glTF accessor type: " + type);
+		}
+		return it->second;
+	}
+
+	static Matrix4 localTransform(nlohmann::json const& node)
+	{
+		if (node.contains("matrix"))
+		{
+			Matrix4 matrix;
+			for (uint32_t i = 0; i < 16; i++)
+			{
+				matrix[i] = node["matrix"].at(i).get<float>();
+			}
+			return matrix;
+		}
+
+		std::array<float, 3> const t = node.value("translation", std::array<float, 3>{ 0.0f, 0.0f, 0.0f });
+		std::array<float, 4> const r = node.value("rotation", std::array<float, 4>{ 0.0f, 0.0f, 0.0f, 1.0f });
+		std::array<float, 3> const s = node.value("scale", std::array<float, 3>{ 1.0f, 1.0f, 1.0f });
+		float const x = r[0], y = r[1], z = r[2], w = r[3];
+		return { (1 - 2 * (y * y + z * z)) * s[0], (2 * (x * y + z * w)) * s[0], (2 * (x * z - y * w)) * s[0], 0,
+				 (2 * (x * y - z * w)) * s[1], (1 - 2 * (x * x + z * z)) * s[1], (2 * (y * z + x * w)) * s[1], 0,
+				 (2 * (x * z + y * w)) * s[2], (2 * (y * z - x * w)) * s[2], (1 - 2 * (x * x + y * y)) * s[2], 0,
+				 t[0], t[1], t[2], 1 };
+	}
+
+	static Matrix4 multiply(Matrix4 const& a, Matrix4 const& b)
+	{
+		Matrix4 result = {};
+		for (uint32_t column = 0; column < 4; column++)
+		{
+			for (uint32_t row = 0; row < 4; row++)
+			{
+				for (uint32_t k = 0; k < 4; k++)
+				{
+					result[column * 4 + row] += a[k * 4 + row] * b[column * 4 + k];
+				}
+			}
+		}
+		return result;
+	}
+
+	static std::array<float, 3> transformPoint(Matrix4 const& m, std::array<float, 3> const& p)
+	{
+		return { m[0] * p[0] + m[4] * p[1] + m[8] * p[2] + m[12], m[1] * p[0] + m[5] * p[1] + m[9] * p[2] + m[13],
+				 m[2] * p[0] + m[6] * p[1] + m[10] * p[2] + m[14] };
+	}
+
+	static std::array<float, 3> cross(float const* a, float const* b)
+	{
+		return { a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0] };
+	}
+
+	static float determinant3(Matrix4 const& m)
+	{
+		std::array<float, 3> const c = cross(&m[4], &m[8]);
+		return m[0] * c[0] + m[1] * c[1] + m[2] * c[2];
+	}
+
+	// Transforms by the cofactor matrix of the upper 3x3, which is the inverse transpose up to scale and
+	// stays correct under non-uniform scaling.
+	static std::array<float, 3> transformNormal(Matrix4 const& m, std::array<float, 3> const& n)
+	{
+		std::array<float, 3> const c0 = cross(&m[4], &m[8]);
+		std::array<float, 3> const c1 = cross(&m[8], &m[0]);
+		std::array<float, 3> const c2 = cross(&m[0], &m[4]);
+		std::array<float, 3>       result = { n[0] * c0[0] + n[1] * c1[0] + n[2] * c2[0], n[0] * c0[1] + n[1] * c1[1] + n[2] * c2[1],
+											  n[0] * c0[2] + n[1] * c1[2] + n[2] * c2[2] };
+		float const length = std::sqrt(result[0] * result[0] + result[1] * result[1] + result[2] * result[2]);
+		float const scale = length > 0.0f ? (determinant3(m) < 0.0f ? -1.0f : 1.0f) / length : 0.0f;
+		return { result[0] * scale, result[1] * scale, result[2] * scale };
+	}
+
+	static std::vector<std::byte> decodeBase64(std::string_view text)
+	{
+		std::vector<std::byte> result;
+		result.reserve(text.size() * 3 / 4);
+		uint32_t accumulator = 0;
+		int      bits = 0;
+		for (char const c : text)
+		{
+			int value;
+			if (c >= 'A' && c <= 'Z')
+				value = c - 'A';
+			else if (c >= 'a' && c <= 'z')
+				value = c - 'a' + 26;
+			else if (c >= '0' && c <= '9')
+				value = c - '0' + 52;
+			else if (c == '+' || c == '-')
+				value = 62;
+			else if (c == '/' || c == '_')
+				value = 63;
+			else
+				break; // padding
+			accumulator = (accumulator << 6) | static_cast<uint32_t>(value);
+			bits += 6;
+			if (bits >= 8)
+			{
+				bits -= 8;
+				result.push_back(static_cast<std::byte>((accumulator >> bits) & 0xFF));
+			}
+		}
+		return result;
+	}
+
+	static std::string decodeUri(std::string const& uri)
+	{
+		std::string result;
+		for (size_t i = 0; i < uri.size(); i++)
+		{
+			if (uri[i] == '%' && i + 2 < uri.size() && std::isxdigit(static_cast<unsigned char>(uri[i + 1])) && std::isxdigit(static_cast<unsigned char>(uri[i + 2])))
+			{
+				result.push_back(static_cast<char>(std::stoi(uri.substr(i + 1, 2), nullptr, 16)));
+				i += 2;
+			}
+			else
+			{
+				result.push_back(uri[i]);
+			}
+		}
+		return result;
+	}
+};
@@ -0,0 +1,367 @@
+#pragma once
+
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+#	include <sys/inotify.h>
+#	include <unistd.h>
+#endif
+
+// One SPIR-V binary compiled from a Slang source, like the add_custom_command()s in CMakeLists.txt produce.
+// Paths are relative to the watched shader directory.
+struct ShaderProgramDesc
+{
+	std::string              source;  // e.g. "triangle.slang"
+	std::string              output;  // the .spv the program is loaded from, rewritten after every successful reload
+	std::vector<std::string> entries; // entry point names
+};
+
+struct ShaderReloaderStats
+{
+	uint32_t compiles = 0;
+	uint32_t failures = 0;
+	double   lastCompileMs = 0.0;
+	double   compileMsTotal = 0.0;
+};
+
+// Recompiles shaders while the application runs. The shader directory is watched with inotify (other platforms
+// poll modification times); a changed file recompiles every program whose source includes or imports it, on the
+// thread pool through slangc. poll() runs on the render thread at a frame boundary and returns the programs with
+// fresh SPIR-V, leaving it to the owner to rebuild just the pipelines that use them. A failed compile prints
+// slangc's diagnostics and keeps the previous binary.
+class ShaderReloader
+{
+public:
+	using ProgramId = uint32_t;
+
+	static constexpr ProgramId INVALID_PROGRAM = ~0u;
+
+	ShaderReloader() = default;
+	ShaderReloader(ShaderReloader const&) = delete;
+	ShaderReloader& operator=(ShaderReloader const&) = delete;
+
+	~ShaderReloader()
+	{
+		// compile jobs report back into this object
+		if (threadPool)
+		{
+			threadPool->waitIdle();
+		}
+#if defined(__linux__)
+		if (watch >= 0)
+		{
+			close(watch);
+		}
+#endif
+	}
+
+	void init(ThreadPool& threadPool, std::filesystem::path const& directory, std::string const& compiler)
+	{
+		this->threadPool = &threadPool;
+		this->directory = directory;
+		this->compiler = compiler;
+#if defined(__linux__)
+		// editors either rewrite a file in place or write a temporary and rename it over the original
+		watch = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (watch < 0 || inotify_add_watch(watch, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+		{
+			std::cerr << "shader reload: cannot watch " << directory << ", polling instead" << std::endl;
+			if (watch >= 0)
+			{
+				close(watch);
+				watch = -1;
+			}
+		}
+#endif
+	}
+
+	[[nodiscard]] bool enabled() const
+	{
+		return threadPool != nullptr;
+	}
+
+	ProgramId add(ShaderProgramDesc const& desc)
+	{
+		programs.push_back({ .desc = desc, .files = {}, .code = {}, .dirty = false, .compiling = false });
+		updateDependencies(programs.back());
+		return static_cast<ProgramId>(programs.size() - 1);
+	}
+
+	// The SPIR-V of the program's most recent successful reload; empty before the first one.
+	[[nodiscard]] std::vector<char> const& code(ProgramId program) const
+	{
+		return programs[program].code;
+	}
+
+	// Starts compiles for the files changed since the last call and returns the programs whose compile finished
+	// successfully since then. A program edited while it compiles is compiled once more afterwards.
+	std::vector<ProgramId> poll()
+	{
+		if (!enabled())
+		{
+			return {};
+		}
+
+		std::vector<ProgramId> reloaded;
+		std::vector<Result>    finished;
+		{
+			std::lock_guard lock(mutex);
+			finished.swap(results);
+		}
+		for (Result& result : finished)
+		{
+			Program& program = programs[result.program];
+			program.compiling = false;
+			stats.compiles++;
+			stats.lastCompileMs = result.compileMs;
+			stats.compileMsTotal += result.compileMs;
+			if (result.succeeded)
+			{
+				program.code = std::move(result.code);
+				// the edit may have added or removed includes
+				updateDependencies(program);
+				reloaded.push_back(result.program);
+				std::cout << "shader reload: " << program.desc.source << " compiled in " << result.compileMs << " ms" << std::endl;
+			}
+			else
+			{
+				stats.failures++;
+				std::cerr << "shader reload: " << program.desc.source << " failed, keeping the previous binary\n" << result.log << std::endl;
+			}
+		}
+
+		std::set<std::string> const changed = changedFiles();
+		for (ProgramId id = 0; id < programs.size(); id++)
+		{
+			Program& program = programs[id];
+			for (std::string const& file : program.files)
+			{
+				program.dirty = program.dirty || changed.contains(file);
+			}
+			if (program.dirty && !program.compiling)
+			{
+				program.dirty = false;
+				program.compiling = true;
+				threadPool->submit([this, id, desc = program.desc] { compile(id, desc); });
+			}
+		}
+		return reloaded;
+	}
+
+	[[nodiscard]] ShaderReloaderStats const& getStats() const
+	{
+		return stats;
+	}
+
+	void report(std::ostream& out) const
+	{
+		if (stats.compiles == 0)
+		{
+			return;
+		}
+		out << "shader reload: " << stats.compiles << " compiles (" << stats.failures << " failed), " << stats.compileMsTotal << " ms compiling, last "
+			<< stats.lastCompileMs << " ms" << std::endl;
+	}
+
+private:
+	// matches the options of the add_custom_command()s in CMakeLists.txt
+	static constexpr char const* COMPILE_OPTIONS = " -target spirv -profile spirv_1_4 -emit-spirv-directly -fvk-use-entrypoint-name -matrix-layout-column-major";
+	static constexpr auto        POLL_INTERVAL = std::chrono::milliseconds(250); // without inotify
+
+	struct Program
+	{
+		ShaderProgramDesc        desc;
+		std::vector<std::string> files; // the source and everything it includes or imports
+		std::vector<char>        code;
+		bool                     dirty = false;
+		bool                     compiling = false;
+	};
+
+	struct Result
+	{
+		ProgramId         program = INVALID_PROGRAM;
+		bool              succeeded = false;
+		std::vector<char> code;
+		std::string       log;
+		double            compileMs = 0.0;
+	};
+
+	ThreadPool*                                            threadPool = nullptr;
+	std::filesystem::path                                  directory;
+	std::string                                            compiler;
+	std::vector<Program>                                   programs; // render thread only
+	std::map<std::string, std::filesystem::file_time_type> modified; // polling fallback
+	std::chrono::steady_clock::time_point                  lastPoll;
+	std::mutex                                             mutex;    // guards results
+	std::vector<Result>                                    results;
+	ShaderReloaderStats                                    stats;
+#if defined(__linux__)
+	int watch = -1;
+#endif
+
+	std::set<std::string> changedFiles()
+	{
+		std::set<std::string> changed;
+#if defined(__linux__)
+		if (watch >= 0)
+		{
+			alignas(inotify_event) char buffer[4096];
+			for (;;)
+			{
+				ssize_t const size = read(watch, buffer, sizeof(buffer));
+				if (size <= 0)
+				{
+					break;
+				}
+				for (ssize_t offset = 0; offset < size;)
+				{
+					auto const* event = reinterpret_cast<inotify_event const*>(buffer + offset);
+					if (event->len > 0)
+					{
+						changed.insert(event->name);
+					}
+					offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+				}
+			}
+			return changed;
+		}
+#endif
+		auto const now = std::chrono::steady_clock::now();
+		if (now - lastPoll < POLL_INTERVAL)
+		{
+			return changed;
+		}
+		lastPoll = now;
+		for (auto& [file, time] : modified)
+		{
+			auto const current = lastWriteTime(file);
+			if (current != time)
+			{
+				time = current;
+				changed.insert(file);
+			}
+		}
+		return changed;
+	}
+
+	void updateDependencies(Program& program)
+	{
+		program.files = dependencies(program.desc.source);
+		for (std::string const& file : program.files)
+		{
+			modified.try_emplace(file, lastWriteTime(file));
+		}
+	}
+
+	[[nodiscard]] std::filesystem::file_time_type lastWriteTime(std::string const& file) const
+	{
+		std::error_code error;
+		return std::filesystem::last_write_time(directory / file, error);
+	}
+
+	// The source plus, transitively, every file it pulls in with #include "x" or import x;
+	[[nodiscard]] std::vector<std::string> dependencies(std::string const& source) const
+	{
+		std::vector<std::string> files = { source };
+		for (size_t i = 0; i < files.size(); i++)
+		{
+			std::ifstream file(directory / files[i]);
+			std::string   line;
+			while (std::getline(file, line))
+			{
+				std::string dependency;
+				size_t const start = line.find_first_not_of(" \t");
+				if (start == std::string::npos)
+				{
+					continue;
+				}
+				if (line.compare(start, 8, "#include") == 0)
+				{
+					size_t const open = line.find('"', start);
+					size_t const close = open == std::string::npos ? open : line.find('"', open + 1);
+					if (close != std::string::npos)
+					{
+						dependency = line.substr(open + 1, close - open - 1);
+					}
+				}
+				else if (line.compare(start, 7, "import ") == 0)
+				{
+					size_t const end = line.find(';', start);
+					if (end != std::string::npos)
+					{
+						dependency = line.substr(start + 7, end - start - 7) + ".slang";
+					}
+				}
+				if (!dependency.empty() && std::ranges::find(files, dependency) == files.end())
+				{
+					files.push_back(dependency);
+				}
+			}
+		}
+		return files;
+	}
+
+	// Worker thread: runs slangc into a temporary file so a failed compile never clobbers the last good binary.
+	void compile(ProgramId program, ShaderProgramDesc const& desc)
+	{
+		auto const                  start = std::chrono::steady_clock::now();
+		std::filesystem::path const temp = std::filesystem::temp_directory_path();
+		std::string const           stem = "rstd_reload_" + std::to_string(program);
+		std::filesystem::path const spirv = temp / (stem + ".spv");
+		std::filesystem::path const log = temp / (stem + ".log");
+
+		std::string command = quote(compiler) + " " + quote((directory / desc.source).string()) + COMPILE_OPTIONS;
+		for (std::string const& entry : desc.entries)
+		{
+			command += " -entry " + entry;
+		}
+		command += " -o " + quote(spirv.string()) + " 2> " + quote(log.string());
+#if defined(_WIN32)
+		// cmd.exe strips the outermost pair of quotes
+		command = "\"" + command + "\"";
+#endif
+
+		Result result{ .program = program, .succeeded = std::system(command.c_str()) == 0, .code = {}, .log = {}, .compileMs = 0.0 };
+		if (result.succeeded)
+		{
+			result.code = readAll(spirv);
+			result.succeeded = !result.code.empty();
+			std::error_code error;
+			std::filesystem::copy_file(spirv, directory / desc.output, std::filesystem::copy_options::overwrite_existing, error);
+		}
+		else
+		{
+			std::vector<char> const text = readAll(log);
+			result.log.assign(text.begin(), text.end());
+		}
+		result.compileMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		std::lock_guard lock(mutex);
+		results.push_back(std::move(result));
+	}
+
+	static std::vector<char> readAll(std::filesystem::path const& path)
+	{
+		std::ifstream file(path, std::ios::binary);
+		return { std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+	}
+
+	static std::string quote(std::string const& text)
+	{
+		return "\"" + text + "\"";
+	}
+};
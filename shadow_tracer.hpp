@@ -0,0 +1,786 @@
+#pragma once
+
+#ifndef VULKAN_HPP_NO_STRUCT_CONSTRUCTORS
+#	define VULKAN_HPP_NO_STRUCT_CONSTRUCTORS
+#endif
+#include <vulkan/vulkan_raii.hpp>
+
+#include "bindless_heap.hpp"
+#include "bvh_builder.hpp"
+#include "camera.hpp"
+#include "gpu_allocator.hpp"
+#include "gpu_culler.hpp"
+#include "scene_graph.hpp"
+#include "scene_loader.hpp"
+#include "uniform_ring.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <span>
+#include <utility>
+#include <vector>
+
+// What the shadow rays trace, as uploaded by the caller. Objects are the GpuObjects of the draw list; each is a
+// copy of the scene draw GpuObject::mesh, placed by its scene graph node. The spans are only read by load().
+struct ShadowTraceScene
+{
+	std::span<GpuObject const> objects;
+	vk::DeviceAddress          objectsAddress = 0;
+	float                      rayLength = 0.0f; // longer than any shadow ray has to be, e.g. the scene's diagonal
+
+	// ray query: one BLAS per scene draw, built straight from the draw's range of the vertex and index buffers
+	std::span<SceneDraw const> meshes;
+	vk::DeviceAddress          vertices = 0;
+	vk::DeviceAddress          indices = 0;
+
+	// software: SceneBvh::nodes(), triangles() and meshes()
+	vk::DeviceAddress bvhNodes = 0;
+	vk::DeviceAddress bvhTriangles = 0;
+	vk::DeviceAddress bvhMeshes = 0;
+	double            bvhBuildMs = 0.0; // CPU time SceneBvh::build() took, for the report
+};
+
+struct ShadowTracerStats
+{
+	double         buildMs = 0.0;            // software: the CPU trees; ray query: the BLAS builds on the GPU
+	vk::DeviceSize blasBytes = 0;            // ray query: before compaction
+	vk::DeviceSize compactedBlasBytes = 0;   // ray query: after compaction, 0 until it happened
+	double         topLevelCpuMsTotal = 0.0; // writing the TLAS instances, or refitting the object tree
+	double         topLevelGpuMsTotal = 0.0; // ray query: TLAS builds and refits
+	uint64_t       topLevelGpuSamples = 0;
+	uint64_t       topLevelRebuilds = 0;     // full TLAS builds; every other frame refits
+	uint64_t       frames = 0;
+	double         traceGpuMsTotal = 0.0;
+	uint64_t       traceGpuSamples = 0;
+	uint64_t       raysTotal = 0;
+	uint64_t       timedRaysTotal = 0; // of the frames with a trace timing
+	uint32_t       lastRays = 0;
+
+	[[nodiscard]] double raysPerSecond() const
+	{
+		return traceGpuMsTotal > 0.0 ? static_cast<double>(timedRaysTotal) / (traceGpuMsTotal * 1e-3) : 0.0;
+	}
+};
+
+// Shadows from one directional light, traced per pixel: a compute pass reconstructs every pixel's world position
+// from the depth attachment and casts one ray towards the light, writing a visibility mask that a fullscreen pass
+// then blends over the shaded image.
+//
+// With VK_KHR_ray_query the rays are inline ray queries against a TLAS over one BLAS per scene draw. The BLASes
+// are built once, on the first frame, and compacted as soon as that frame has completed and their compacted sizes
+// can be read back; the TLAS of every frame-in-flight slot is then rebuilt once against the compacted BLASes and
+// refit from the scene graph's transforms every frame after. Without it (lavapipe, older GPUs) the same pass walks
+// CPU-built SAH trees (SceneBvh) in a compute shader, under a tree over the objects' world bounds that the CPU
+// refits every frame. Per-frame inputs go into the UniformRing; the mask, ray counter and top level live in
+// buffers owned by each frame-in-flight slot, so a slot is only rewritten once its previous frame has retired.
+class ShadowTracer
+{
+public:
+	static constexpr uint32_t GROUP_SIZE = 8; // SHADOW_GROUP_SIZE of the trace shaders, in both dimensions
+
+	enum class Mode
+	{
+		eRayQuery,
+		eComputeBvh
+	};
+
+	// traceShaderCode holds traceMain of shaders/shadow_ray_query.slang or shaders/shadow_bvh.slang, by mode.
+	// The scene follows with load().
+	void init(vk::raii::Device const& device, vk::raii::PhysicalDevice const& physicalDevice, uint32_t queueFamilyIndex, GpuAllocator& allocator, BindlessHeap& heap,
+			  vk::raii::PipelineCache const& pipelineCache, Mode mode, std::vector<char> const& traceShaderCode, uint32_t framesInFlight)
+	{
+		this->device = &device;
+		this->allocator = &allocator;
+		this->heap = &heap;
+		this->mode = mode;
+		stats = {};
+
+		vk::DescriptorSetLayout const heapLayout = heap.setLayoutHandle();
+		vk::PushConstantRange         traceRange{ .stageFlags = vk::ShaderStageFlagBits::eCompute, .offset = 0, .size = sizeof(TraceConstants) };
+		vk::PipelineLayoutCreateInfo  traceLayoutInfo{ .setLayoutCount = 1, .pSetLayouts = &heapLayout, .pushConstantRangeCount = 1, .pPushConstantRanges = &traceRange };
+		traceLayout = vk::raii::PipelineLayout(device, traceLayoutInfo);
+
+		vk::ShaderModuleCreateInfo    shaderInfo{ .codeSize = traceShaderCode.size(), .pCode = reinterpret_cast<uint32_t const*>(traceShaderCode.data()) };
+		vk::raii::ShaderModule        shaderModule(device, shaderInfo);
+		vk::ComputePipelineCreateInfo pipelineInfo{ .stage = {.stage = vk::ShaderStageFlagBits::eCompute, .module = *shaderModule, .pName = "traceMain"},
+													.layout = *traceLayout };
+		tracePipeline = vk::raii::Pipeline(device, pipelineCache, pipelineInfo);
+
+		vk::PushConstantRange        compositeRange{ .stageFlags = vk::ShaderStageFlagBits::eFragment, .offset = 0, .size = sizeof(CompositeConstants) };
+		vk::PipelineLayoutCreateInfo compositeLayoutInfo{ .pushConstantRangeCount = 1, .pPushConstantRanges = &compositeRange };
+		compositePipelineLayout = vk::raii::PipelineLayout(device, compositeLayoutInfo);
+
+		if (mode == Mode::eRayQuery)
+		{
+			auto const properties = physicalDevice.getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceAccelerationStructurePropertiesKHR>();
+			scratchAlignment = properties.get<vk::PhysicalDeviceAccelerationStructurePropertiesKHR>().minAccelerationStructureScratchOffsetAlignment;
+		}
+
+		// a build and a trace timestamp pair per slot, on the graphics queue like the passes they time
+		uint32_t const timestampBits = physicalDevice.getQueueFamilyProperties()[queueFamilyIndex].timestampValidBits;
+		if (timestampBits != 0)
+		{
+			timestampMask = timestampBits >= 64 ? ~0ull : ((1ull << timestampBits) - 1);
+			timestampPeriod = physicalDevice.getProperties().limits.timestampPeriod;
+			vk::QueryPoolCreateInfo queryPoolInfo{ .queryType = vk::QueryType::eTimestamp, .queryCount = QUERIES_PER_SLOT * framesInFlight };
+			timestamps = vk::raii::QueryPool(device, queryPoolInfo);
+			timestamps.reset(0, QUERIES_PER_SLOT * framesInFlight);
+		}
+
+		slots.clear();
+		slots.resize(framesInFlight);
+		for (Slot& slot : slots)
+		{
+			slot.rays = GpuBuffer(allocator, device, sizeof(uint32_t), vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eShaderDeviceAddress,
+								  vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+			slot.raysAddress = bufferAddress(slot.rays);
+		}
+	}
+
+	// Builds what does not change from frame to frame: the tree over the objects, or the BLASes and the slots'
+	// TLASes, whose builds are recorded by the first frames' recordBuild().
+	void load(ShadowTraceScene const& scene, SceneGraph const& sceneGraph)
+	{
+		this->scene = scene;
+		objectNodes.clear();
+		objectMeshes.clear();
+		for (GpuObject const& object : scene.objects)
+		{
+			objectNodes.push_back(object.node);
+			objectMeshes.push_back(object.mesh);
+		}
+		objectBounds.resize(objectNodes.size());
+		writeObjectBounds(sceneGraph);
+
+		if (mode == Mode::eComputeBvh)
+		{
+			auto const treeStart = std::chrono::steady_clock::now();
+			objectTree = Bvh::build(objectBounds, 1);
+			stats.buildMs = scene.bvhBuildMs + std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - treeStart).count();
+			objectOrder = GpuBuffer(*allocator, *device, std::max<size_t>(objectTree.order().size(), 1) * sizeof(uint32_t),
+									vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eShaderDeviceAddress,
+									vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+			memcpy(objectOrder.mapped(), objectTree.order().data(), objectTree.order().size() * sizeof(uint32_t));
+			objectOrderAddress = bufferAddress(objectOrder);
+			for (Slot& slot : slots)
+			{
+				slot.objectNodes = GpuBuffer(*allocator, *device, objectTree.nodes().size() * sizeof(BvhNode),
+											 vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eShaderDeviceAddress,
+											 vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+				slot.objectNodesAddress = bufferAddress(slot.objectNodes);
+			}
+			return;
+		}
+		createBlases();
+		createTlases();
+	}
+
+	[[nodiscard]] bool enabled() const
+	{
+		return !slots.empty();
+	}
+
+	[[nodiscard]] Mode getMode() const
+	{
+		return mode;
+	}
+
+	// Reads the ray count and timings of the frame that last used slot. Only valid once that frame has completed.
+	void collect(uint32_t slot)
+	{
+		if (!enabled() || !slots[slot].pending)
+		{
+			return;
+		}
+		slots[slot].pending = false;
+		memcpy(&stats.lastRays, slots[slot].rays.mapped(), sizeof(uint32_t));
+		stats.raysTotal += stats.lastRays;
+		stats.frames++;
+		if (!*timestamps)
+		{
+			return;
+		}
+
+		// the software path has no build pass, so only its trace pair was written
+		uint32_t const first = QUERIES_PER_SLOT * slot;
+		uint32_t const skipped = mode == Mode::eRayQuery ? 0 : 2;
+		auto [result, ticks] = timestamps.getResult<std::array<uint64_t, QUERIES_PER_SLOT>>(first + skipped, QUERIES_PER_SLOT - skipped, sizeof(uint64_t),
+																							  vk::QueryResultFlagBits::e64);
+		timestamps.reset(first, QUERIES_PER_SLOT);
+		if (result != vk::Result::eSuccess)
+		{
+			return;
+		}
+		double const traceMs = elapsedMs(ticks[2 - skipped], ticks[3 - skipped]);
+		stats.traceGpuMsTotal += traceMs;
+		stats.timedRaysTotal += stats.lastRays;
+		stats.traceGpuSamples++;
+		if (mode == Mode::eRayQuery)
+		{
+			double const buildMs = elapsedMs(ticks[0], ticks[1]);
+			if (slots[slot].builtBlases)
+			{
+				// the TLAS build of that frame is in there as well, but small next to the BLASes
+				stats.buildMs = buildMs;
+				slots[slot].builtBlases = false;
+			}
+			else
+			{
+				stats.topLevelGpuMsTotal += buildMs;
+				stats.topLevelGpuSamples++;
+			}
+		}
+	}
+
+	// Destroys what the compaction replaced once the frames that used it completed.
+	void recycle(uint64_t completedValue)
+	{
+		while (!retired.empty() && retired.front().retireValue <= completedValue)
+		{
+			retired.pop_front();
+		}
+	}
+
+	// Writes this frame's top level (the TLAS instances or the refit object tree) and trace inputs for slot, whose
+	// previous frame must have completed. viewProjection is the one the depth attachment was rendered with.
+	void beginFrame(uint32_t slot, UniformRing& ring, glm::mat4 const& viewProjection, glm::vec3 const& cameraPosition, glm::vec3 const& lightDirection,
+					vk::Extent2D extent, GpuTransformTable const& transforms, SceneGraph const& sceneGraph, uint64_t completedValue)
+	{
+		Slot& current = slots[slot];
+		if (current.extent != extent)
+		{
+			current.mask = GpuBuffer(*allocator, *device, std::max<vk::DeviceSize>(static_cast<vk::DeviceSize>(extent.width) * extent.height, 1) * sizeof(uint32_t),
+									 vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eShaderDeviceAddress, vk::MemoryPropertyFlagBits::eDeviceLocal);
+			current.maskAddress = bufferAddress(current.mask);
+			current.extent = extent;
+		}
+		memset(current.rays.mapped(), 0, sizeof(uint32_t));
+
+		auto const topLevelStart = std::chrono::steady_clock::now();
+		if (mode == Mode::eRayQuery)
+		{
+			if (blasState == BlasState::eBuilt && completedValue >= blasBuildValue)
+			{
+				createCompactedBlases();
+			}
+			writeInstances(current, sceneGraph);
+		}
+		else
+		{
+			writeObjectBounds(sceneGraph);
+			objectTree.refit(objectBounds);
+			writeObjectTree(current);
+		}
+		stats.topLevelCpuMsTotal += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - topLevelStart).count();
+
+		FrameData const frameData{ .inverseViewProjection = glm::inverse(viewProjection),
+								   .cameraPosition = glm::vec4(cameraPosition, 1.0f),
+								   .lightDirection = glm::vec4(glm::normalize(lightDirection), scene.rayLength),
+								   .transforms = transforms,
+								   .objects = scene.objectsAddress,
+								   .accelerationStructure = current.tlasAddress,
+								   .objectNodes = current.objectNodesAddress,
+								   .objectOrder = objectOrderAddress,
+								   .meshNodes = scene.bvhNodes,
+								   .triangles = scene.bvhTriangles,
+								   .meshes = scene.bvhMeshes,
+								   .mask = current.maskAddress,
+								   .rays = current.raysAddress,
+								   .width = extent.width,
+								   .height = extent.height };
+		current.frameDataAddress = ring.push(frameData).address;
+		current.pending = true;
+	}
+
+	// Ray query: the body of the pass that builds or compacts the BLASes when due and then builds or refits slot's
+	// TLAS, which the trace reads afterwards (accelerationStructureBuffer()). Orders its own steps.
+	void recordBuild(vk::raii::CommandBuffer const& commandBuffer, uint32_t slot, uint64_t frameValue)
+	{
+		Slot& current = slots[slot];
+		writeTimestamp(commandBuffer, slot, 0);
+		if (blasState == BlasState::eUnbuilt)
+		{
+			commandBuffer.buildAccelerationStructuresKHR(blasBuilds, blasRangePointers);
+			accelerationStructureBarrier(commandBuffer);
+			commandBuffer.writeAccelerationStructuresPropertiesKHR(blasHandles, vk::QueryType::eAccelerationStructureCompactedSizeKHR, *compactedSizes, 0);
+			blasState = BlasState::eBuilt;
+			blasBuildValue = frameValue;
+			current.builtBlases = true;
+		}
+		else if (blasState == BlasState::eCompacting)
+		{
+			for (size_t i = 0; i < blases.size(); i++)
+			{
+				commandBuffer.copyAccelerationStructureKHR(vk::CopyAccelerationStructureInfoKHR{
+					.src = *retired.back().blases[i].structure, .dst = *blases[i].structure, .mode = vk::CopyAccelerationStructureModeKHR::eCompact });
+			}
+			accelerationStructureBarrier(commandBuffer);
+			retired.back().retireValue = frameValue;
+			blasState = BlasState::eCompacted;
+		}
+
+		// a TLAS built against BLASes that were replaced since is rebuilt, otherwise refit in place
+		bool const refit = current.tlasGeneration == blasGeneration;
+		vk::AccelerationStructureGeometryKHR geometry = instanceGeometry(current);
+		vk::AccelerationStructureBuildGeometryInfoKHR const buildInfo{ .type = vk::AccelerationStructureTypeKHR::eTopLevel,
+																	   .flags = TLAS_FLAGS,
+																	   .mode = refit ? vk::BuildAccelerationStructureModeKHR::eUpdate : vk::BuildAccelerationStructureModeKHR::eBuild,
+																	   .srcAccelerationStructure = refit ? *current.tlas : nullptr,
+																	   .dstAccelerationStructure = *current.tlas,
+																	   .geometryCount = 1,
+																	   .pGeometries = &geometry,
+																	   .scratchData = deviceAddress(current.scratchAddress) };
+		vk::AccelerationStructureBuildRangeInfoKHR const        range{ .primitiveCount = static_cast<uint32_t>(objectNodes.size()) };
+		vk::AccelerationStructureBuildRangeInfoKHR const* const rangePointer = &range;
+		commandBuffer.buildAccelerationStructuresKHR(buildInfo, rangePointer);
+		current.tlasGeneration = blasGeneration;
+		if (!refit)
+		{
+			stats.topLevelRebuilds++;
+		}
+		writeTimestamp(commandBuffer, slot, 1);
+	}
+
+	// The body of the trace pass: reads depthView, the depth attachment in SHADER_READ_ONLY_OPTIMAL, and writes
+	// slot's mask. The view gets a bindless handle of its own, replaced whenever the render graph's view changes.
+	void recordTrace(vk::raii::CommandBuffer const& commandBuffer, uint32_t slot, vk::ImageView depthView, uint64_t frameValue)
+	{
+		if (depthView != this->depthView)
+		{
+			heap->release(BindlessHeap::Kind::eSampledImage, depthHandle, frameValue - 1);
+			depthHandle = heap->addImage(depthView, vk::ImageLayout::eShaderReadOnlyOptimal);
+			this->depthView = depthView;
+		}
+
+		Slot const& current = slots[slot];
+		writeTimestamp(commandBuffer, slot, 2);
+		commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, *tracePipeline);
+		heap->bind(commandBuffer, vk::PipelineBindPoint::eCompute, *traceLayout);
+		commandBuffer.pushConstants<TraceConstants>(*traceLayout, vk::ShaderStageFlagBits::eCompute, 0,
+													TraceConstants{ .frame = current.frameDataAddress, .depth = depthHandle });
+		commandBuffer.dispatch((current.extent.width + GROUP_SIZE - 1) / GROUP_SIZE, (current.extent.height + GROUP_SIZE - 1) / GROUP_SIZE, 1);
+		writeTimestamp(commandBuffer, slot, 3);
+	}
+
+	// Draws the fullscreen triangle that blends the mask over the color attachment, inside the caller's rendering
+	// and with pipeline, a compositeVert/compositeFrag pipeline of shaders/shadow_composite.slang with compositeLayout().
+	void recordComposite(vk::raii::CommandBuffer const& commandBuffer, uint32_t slot, vk::Pipeline pipeline) const
+	{
+		Slot const& current = slots[slot];
+		commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);
+		commandBuffer.setViewport(0, vk::Viewport(0.0f, 0.0f, static_cast<float>(current.extent.width), static_cast<float>(current.extent.height), 0.0f, 1.0f));
+		commandBuffer.setScissor(0, vk::Rect2D(vk::Offset2D(0, 0), current.extent));
+		commandBuffer.pushConstants<CompositeConstants>(*compositePipelineLayout, vk::ShaderStageFlagBits::eFragment, 0,
+														CompositeConstants{ .mask = current.maskAddress, .width = current.extent.width });
+		commandBuffer.draw(3, 1, 0, 0);
+	}
+
+	[[nodiscard]] vk::PipelineLayout compositeLayout() const
+	{
+		return *compositePipelineLayout;
+	}
+
+	[[nodiscard]] vk::Buffer maskBuffer(uint32_t slot) const
+	{
+		return *slots[slot].mask;
+	}
+
+	// Ray query: the buffer behind slot's TLAS, for the render graph to order the build before the trace.
+	[[nodiscard]] vk::Buffer accelerationStructureBuffer(uint32_t slot) const
+	{
+		return *slots[slot].tlasBuffer;
+	}
+
+	[[nodiscard]] ShadowTracerStats const& getStats() const
+	{
+		return stats;
+	}
+
+	void report(std::ostream& out) const
+	{
+		if (!enabled())
+		{
+			return;
+		}
+		double const frames = static_cast<double>(std::max<uint64_t>(stats.frames, 1));
+		if (mode == Mode::eRayQuery)
+		{
+			out << "shadows (ray query): " << blases.size() << " BLAS built in " << stats.buildMs << " ms on the GPU, " << stats.blasBytes / 1024 << " KiB";
+			if (stats.compactedBlasBytes != 0)
+			{
+				out << " compacted to " << stats.compactedBlasBytes / 1024 << " KiB";
+			}
+			out << "; TLAS of " << objectNodes.size() << " instances, " << stats.topLevelRebuilds << " full builds, refit avg "
+				<< (stats.topLevelGpuSamples ? stats.topLevelGpuMsTotal / static_cast<double>(stats.topLevelGpuSamples) : 0.0) << " ms GPU, "
+				<< stats.topLevelCpuMsTotal / frames << " ms CPU";
+		}
+		else
+		{
+			out << "shadows (compute BVH): trees built in " << stats.buildMs << " ms on the CPU; object tree of " << objectTree.nodes().size() << " nodes refit avg "
+				<< stats.topLevelCpuMsTotal / frames << " ms CPU";
+		}
+		out << "; rays avg " << static_cast<double>(stats.raysTotal) / frames << " per frame";
+		if (stats.traceGpuSamples != 0)
+		{
+			out << ", trace avg " << stats.traceGpuMsTotal / static_cast<double>(stats.traceGpuSamples) << " ms, " << stats.raysPerSecond() * 1e-6 << " Mrays/s";
+		}
+		out << std::endl;
+	}
+
+private:
+	static constexpr uint32_t QUERIES_PER_SLOT = 4; // build start, end, trace start, end
+	static constexpr vk::BuildAccelerationStructureFlagsKHR TLAS_FLAGS =
+		vk::BuildAccelerationStructureFlagBitsKHR::eAllowUpdate | vk::BuildAccelerationStructureFlagBitsKHR::ePreferFastTrace;
+
+	// ShadowFrame in shaders/shadow_data.slang
+	struct FrameData
+	{
+		glm::mat4         inverseViewProjection;
+		glm::vec4         cameraPosition;
+		glm::vec4         lightDirection; // w: ray length
+		GpuTransformTable transforms;
+		vk::DeviceAddress objects = 0;
+		vk::DeviceAddress accelerationStructure = 0;
+		vk::DeviceAddress objectNodes = 0;
+		vk::DeviceAddress objectOrder = 0;
+		vk::DeviceAddress meshNodes = 0;
+		vk::DeviceAddress triangles = 0;
+		vk::DeviceAddress meshes = 0;
+		vk::DeviceAddress mask = 0;
+		vk::DeviceAddress rays = 0;
+		uint32_t          width = 0;
+		uint32_t          height = 0;
+	};
+	static_assert(offsetof(FrameData, transforms) == 96 && offsetof(FrameData, width) == 184);
+
+	// ShadowTraceConstants in shaders/shadow_data.slang
+	struct TraceConstants
+	{
+		vk::DeviceAddress frame = 0;
+		BindlessHandle    depth = INVALID_BINDLESS_HANDLE;
+	};
+
+	// CompositeConstants in shaders/shadow_composite.slang
+	struct CompositeConstants
+	{
+		vk::DeviceAddress mask = 0;
+		uint32_t          width = 0;
+	};
+
+	struct AccelerationStructure
+	{
+		GpuBuffer                          buffer;
+		vk::raii::AccelerationStructureKHR structure = nullptr; // declared after its buffer, so destroyed first
+		vk::DeviceAddress                  address = 0;
+	};
+
+	// BLASes the compaction replaced, with the scratch memory of their build
+	struct Retired
+	{
+		std::vector<AccelerationStructure> blases;
+		GpuBuffer                          scratch;
+		uint64_t                           retireValue = ~0ull; // set once the copies are recorded
+	};
+
+	enum class BlasState
+	{
+		eUnbuilt,    // the next recordBuild() builds them
+		eBuilt,      // waiting for the build's frame to complete
+		eCompacting, // compacted copies created, the next recordBuild() copies into them
+		eCompacted
+	};
+
+	struct Slot
+	{
+		GpuBuffer         mask;
+		GpuBuffer         rays;
+		vk::Extent2D      extent;
+		vk::DeviceAddress maskAddress = 0;
+		vk::DeviceAddress raysAddress = 0;
+		vk::DeviceAddress frameDataAddress = 0; // in the uniform ring, rewritten by beginFrame()
+		bool              pending = false;      // a frame was recorded whose results have not been collected yet
+
+		// software
+		GpuBuffer         objectNodes; // host visible, refit by the CPU every frame
+		vk::DeviceAddress objectNodesAddress = 0;
+
+		// ray query
+		GpuBuffer                          instances; // host visible, rewritten by the CPU every frame
+		GpuBuffer                          tlasBuffer;
+		vk::raii::AccelerationStructureKHR tlas = nullptr;
+		GpuBuffer                          scratch;
+		vk::DeviceAddress                  instancesAddress = 0;
+		vk::DeviceAddress                  tlasAddress = 0;
+		vk::DeviceAddress                  scratchAddress = 0; // aligned for builds
+		uint32_t                           tlasGeneration = 0; // blasGeneration the TLAS was last built against
+		bool                               builtBlases = false; // its pending frame built the BLASes as well
+	};
+
+	vk::raii::Device const*  device = nullptr;
+	GpuAllocator*            allocator = nullptr;
+	BindlessHeap*            heap = nullptr;
+	Mode                     mode = Mode::eComputeBvh;
+	ShadowTraceScene         scene;
+	vk::raii::PipelineLayout traceLayout = nullptr;
+	vk::raii::Pipeline       tracePipeline = nullptr;
+	vk::raii::PipelineLayout compositePipelineLayout = nullptr;
+	std::vector<Slot>        slots;
+	std::vector<uint32_t>    objectNodes;  // scene graph slot by object
+	std::vector<uint32_t>    objectMeshes; // scene draw by object
+	std::vector<BvhBounds>   objectBounds; // world bounds by object, this frame
+	ShadowTracerStats        stats;
+
+	vk::ImageView  depthView = nullptr;
+	BindlessHandle depthHandle = INVALID_BINDLESS_HANDLE;
+
+	vk::raii::QueryPool timestamps = nullptr;
+	uint64_t            timestampMask = 0;
+	float               timestampPeriod = 1.0f;
+
+	// software
+	Bvh               objectTree;
+	GpuBuffer         objectOrder; // host visible, objectTree.order(); refits keep the topology, so written once
+	vk::DeviceAddress objectOrderAddress = 0;
+
+	// ray query
+	vk::DeviceSize                                             scratchAlignment = 1;
+	std::vector<AccelerationStructure>                         blases; // by scene draw
+	std::vector<vk::AccelerationStructureGeometryKHR>          blasGeometries;
+	std::vector<vk::AccelerationStructureBuildGeometryInfoKHR> blasBuilds;
+	std::vector<vk::AccelerationStructureBuildRangeInfoKHR>    blasRanges;
+	std::vector<vk::AccelerationStructureBuildRangeInfoKHR const*> blasRangePointers;
+	std::vector<vk::AccelerationStructureKHR>                  blasHandles;
+	GpuBuffer                                                  blasScratch;
+	vk::raii::QueryPool                                        compactedSizes = nullptr;
+	BlasState                                                  blasState = BlasState::eUnbuilt;
+	uint64_t                                                   blasBuildValue = 0;
+	uint32_t                                                   blasGeneration = 1; // bumped by the compaction
+	std::deque<Retired>                                        retired;
+
+	[[nodiscard]] vk::DeviceAddress bufferAddress(GpuBuffer const& buffer) const
+	{
+		return device->getBufferAddress(vk::BufferDeviceAddressInfo{ .buffer = *buffer });
+	}
+
+	[[nodiscard]] vk::DeviceAddress alignScratch(vk::DeviceAddress address) const
+	{
+		return (address + scratchAlignment - 1) / scratchAlignment * scratchAlignment;
+	}
+
+	static vk::DeviceOrHostAddressConstKHR constAddress(vk::DeviceAddress address)
+	{
+		vk::DeviceOrHostAddressConstKHR result;
+		result.deviceAddress = address;
+		return result;
+	}
+
+	static vk::DeviceOrHostAddressKHR deviceAddress(vk::DeviceAddress address)
+	{
+		vk::DeviceOrHostAddressKHR result;
+		result.deviceAddress = address;
+		return result;
+	}
+
+	[[nodiscard]] double elapsedMs(uint64_t start, uint64_t end) const
+	{
+		return static_cast<double>(((end & timestampMask) - (start & timestampMask)) & timestampMask) * timestampPeriod * 1e-6;
+	}
+
+	void writeTimestamp(vk::raii::CommandBuffer const& commandBuffer, uint32_t slot, uint32_t query) const
+	{
+		if (*timestamps)
+		{
+			commandBuffer.writeTimestamp2(vk::PipelineStageFlagBits2::eAllCommands, *timestamps, QUERIES_PER_SLOT * slot + query);
+		}
+	}
+
+	// Makes acceleration structure builds and copies visible to the builds and traces after them.
+	static void accelerationStructureBarrier(vk::raii::CommandBuffer const& commandBuffer)
+	{
+		vk::MemoryBarrier2 const built{ .srcStageMask = vk::PipelineStageFlagBits2::eAccelerationStructureBuildKHR,
+										.srcAccessMask = vk::AccessFlagBits2::eAccelerationStructureWriteKHR,
+										.dstStageMask = vk::PipelineStageFlagBits2::eAccelerationStructureBuildKHR | vk::PipelineStageFlagBits2::eComputeShader,
+										.dstAccessMask = vk::AccessFlagBits2::eAccelerationStructureReadKHR };
+		commandBuffer.pipelineBarrier2(vk::DependencyInfo{ .memoryBarrierCount = 1, .pMemoryBarriers = &built });
+	}
+
+	// Bounding boxes of the objects' world bounding spheres, which the scene graph keeps up to date.
+	void writeObjectBounds(SceneGraph const& sceneGraph)
+	{
+		std::span<std::array<float, 4> const> const spheres = sceneGraph.worldBounds();
+		for (size_t object = 0; object < objectNodes.size(); object++)
+		{
+			std::array<float, 4> const& sphere = spheres[objectNodes[object]];
+			objectBounds[object] = { .min = { sphere[0] - sphere[3], sphere[1] - sphere[3], sphere[2] - sphere[3] },
+									 .max = { sphere[0] + sphere[3], sphere[1] + sphere[3], sphere[2] + sphere[3] } };
+		}
+	}
+
+	// The refit tree into slot's buffer. Leaves keep their primitive slots, which the shader maps to objects
+	// through objectOrder: one per leaf as built, more where Bvh::MAX_DEPTH forced a leaf.
+	void writeObjectTree(Slot& slot) const
+	{
+		memcpy(slot.objectNodes.mapped(), objectTree.nodes().data(), objectTree.nodes().size() * sizeof(BvhNode));
+	}
+
+	// One instance per object, with its scene graph world transform as a 3x4 row-major matrix.
+	void writeInstances(Slot& slot, SceneGraph const& sceneGraph) const
+	{
+		std::span<std::array<float, 4> const> const translationScale = sceneGraph.worldTranslationScale();
+		std::span<std::array<float, 4> const> const rotation = sceneGraph.worldRotation();
+		auto* out = static_cast<vk::AccelerationStructureInstanceKHR*>(slot.instances.mapped());
+		for (size_t object = 0; object < objectNodes.size(); object++)
+		{
+			std::array<float, 4> const& t = translationScale[objectNodes[object]];
+			std::array<float, 4> const& q = rotation[objectNodes[object]];
+			float const x = q[0], y = q[1], z = q[2], w = q[3], s = t[3];
+			std::array<std::array<float, 4>, 3> const rows = { { { s * (1.0f - 2.0f * (y * y + z * z)), s * 2.0f * (x * y - z * w), s * 2.0f * (x * z + y * w), t[0] },
+																 { s * 2.0f * (x * y + z * w), s * (1.0f - 2.0f * (x * x + z * z)), s * 2.0f * (y * z - x * w), t[1] },
+																 { s * 2.0f * (x * z - y * w), s * 2.0f * (y * z + x * w), s * (1.0f - 2.0f * (x * x + y * y)), t[2] } } };
+			// the bit-fields are assigned one by one, brace initialization would narrow into them
+			vk::AccelerationStructureInstanceKHR instance{};
+			instance.transform.matrix = rows;
+			instance.instanceCustomIndex = static_cast<uint32_t>(object);
+			instance.mask = 0xff;
+			instance.instanceShaderBindingTableRecordOffset = 0;
+			instance.flags = static_cast<VkGeometryInstanceFlagsKHR>(vk::GeometryInstanceFlagBitsKHR::eTriangleFacingCullDisable | vk::GeometryInstanceFlagBitsKHR::eForceOpaque);
+			instance.accelerationStructureReference = blases[objectMeshes[object]].address;
+			out[object] = instance;
+		}
+	}
+
+	[[nodiscard]] static vk::AccelerationStructureGeometryKHR instanceGeometry(Slot const& slot)
+	{
+		vk::AccelerationStructureGeometryDataKHR data;
+		data.instances = vk::AccelerationStructureGeometryInstancesDataKHR{ .arrayOfPointers = false, .data = constAddress(slot.instancesAddress) };
+		return { .geometryType = vk::GeometryTypeKHR::eInstances, .geometry = data, .flags = vk::GeometryFlagBitsKHR::eOpaque };
+	}
+
+	[[nodiscard]] AccelerationStructure createAccelerationStructure(vk::AccelerationStructureTypeKHR type, vk::DeviceSize size) const
+	{
+		AccelerationStructure result;
+		result.buffer = GpuBuffer(*allocator, *device, size, vk::BufferUsageFlagBits::eAccelerationStructureStorageKHR | vk::BufferUsageFlagBits::eShaderDeviceAddress,
+								  vk::MemoryPropertyFlagBits::eDeviceLocal);
+		result.structure = vk::raii::AccelerationStructureKHR(*device, vk::AccelerationStructureCreateInfoKHR{ .buffer = *result.buffer, .size = size, .type = type });
+		result.address = device->getAccelerationStructureAddressKHR(vk::AccelerationStructureDeviceAddressInfoKHR{ .accelerationStructure = *result.structure });
+		return result;
+	}
+
+	// One BLAS per scene draw, all built by a single command with compaction allowed, into one scratch buffer.
+	void createBlases()
+	{
+		size_t const meshCount = scene.meshes.size();
+		blases.clear();
+		blasGeometries.resize(meshCount);
+		blasBuilds.resize(meshCount);
+		blasRanges.resize(meshCount);
+		blasRangePointers.resize(meshCount);
+		blasHandles.resize(meshCount);
+
+		std::vector<vk::DeviceSize> scratchOffsets(meshCount);
+		vk::DeviceSize              scratchSize = 0;
+		for (size_t i = 0; i < meshCount; i++)
+		{
+			SceneDraw const& draw = scene.meshes[i];
+			vk::AccelerationStructureGeometryDataKHR data;
+			data.triangles = vk::AccelerationStructureGeometryTrianglesDataKHR{ .vertexFormat = vk::Format::eR32G32B32Sfloat,
+																			   .vertexData = constAddress(scene.vertices),
+																			   .vertexStride = sizeof(SceneVertex),
+																			   .maxVertex = std::max(draw.vertexCount, 1u) - 1,
+																			   .indexType = vk::IndexType::eUint32,
+																			   .indexData = constAddress(scene.indices) };
+			blasGeometries[i] = { .geometryType = vk::GeometryTypeKHR::eTriangles, .geometry = data, .flags = vk::GeometryFlagBitsKHR::eOpaque };
+			blasRanges[i] = { .primitiveCount = draw.indexCount / 3,
+							  .primitiveOffset = draw.firstIndex * static_cast<uint32_t>(sizeof(uint32_t)),
+							  .firstVertex = static_cast<uint32_t>(draw.vertexOffset) };
+			blasRangePointers[i] = &blasRanges[i];
+			blasBuilds[i] = { .type = vk::AccelerationStructureTypeKHR::eBottomLevel,
+							  .flags = vk::BuildAccelerationStructureFlagBitsKHR::ePreferFastTrace | vk::BuildAccelerationStructureFlagBitsKHR::eAllowCompaction,
+							  .mode = vk::BuildAccelerationStructureModeKHR::eBuild,
+							  .geometryCount = 1,
+							  .pGeometries = &blasGeometries[i] };
+
+			vk::AccelerationStructureBuildSizesInfoKHR const sizes =
+				device->getAccelerationStructureBuildSizesKHR(vk::AccelerationStructureBuildTypeKHR::eDevice, blasBuilds[i], blasRanges[i].primitiveCount);
+			blases.push_back(createAccelerationStructure(vk::AccelerationStructureTypeKHR::eBottomLevel, sizes.accelerationStructureSize));
+			blasBuilds[i].dstAccelerationStructure = *blases[i].structure;
+			blasHandles[i] = *blases[i].structure;
+			stats.blasBytes += sizes.accelerationStructureSize;
+			scratchOffsets[i] = scratchSize;
+			scratchSize += (sizes.buildScratchSize + scratchAlignment - 1) / scratchAlignment * scratchAlignment;
+		}
+
+		blasScratch = GpuBuffer(*allocator, *device, scratchSize + scratchAlignment, vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eShaderDeviceAddress,
+								vk::MemoryPropertyFlagBits::eDeviceLocal);
+		vk::DeviceAddress const scratchBase = alignScratch(bufferAddress(blasScratch));
+		for (size_t i = 0; i < meshCount; i++)
+		{
+			blasBuilds[i].scratchData = deviceAddress(scratchBase + scratchOffsets[i]);
+		}
+
+		vk::QueryPoolCreateInfo queryPoolInfo{ .queryType = vk::QueryType::eAccelerationStructureCompactedSizeKHR, .queryCount = static_cast<uint32_t>(meshCount) };
+		compactedSizes = vk::raii::QueryPool(*device, queryPoolInfo);
+		compactedSizes.reset(0, static_cast<uint32_t>(meshCount));
+		blasState = BlasState::eUnbuilt;
+		blasGeneration = 1;
+	}
+
+	// A TLAS per slot, sized for every object, with scratch memory for both a build and a refit.
+	void createTlases()
+	{
+		uint32_t const objectCount = static_cast<uint32_t>(objectNodes.size());
+		for (Slot& slot : slots)
+		{
+			slot.instances = GpuBuffer(*allocator, *device, std::max<vk::DeviceSize>(objectCount, 1) * sizeof(vk::AccelerationStructureInstanceKHR),
+									   vk::BufferUsageFlagBits::eAccelerationStructureBuildInputReadOnlyKHR | vk::BufferUsageFlagBits::eShaderDeviceAddress,
+									   vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+			slot.instancesAddress = bufferAddress(slot.instances);
+
+			vk::AccelerationStructureGeometryKHR const          geometry = instanceGeometry(slot);
+			vk::AccelerationStructureBuildGeometryInfoKHR const buildInfo{ .type = vk::AccelerationStructureTypeKHR::eTopLevel,
+																		   .flags = TLAS_FLAGS,
+																		   .mode = vk::BuildAccelerationStructureModeKHR::eBuild,
+																		   .geometryCount = 1,
+																		   .pGeometries = &geometry };
+			vk::AccelerationStructureBuildSizesInfoKHR const sizes =
+				device->getAccelerationStructureBuildSizesKHR(vk::AccelerationStructureBuildTypeKHR::eDevice, buildInfo, objectCount);
+			AccelerationStructure tlas = createAccelerationStructure(vk::AccelerationStructureTypeKHR::eTopLevel, sizes.accelerationStructureSize);
+			slot.tlasBuffer = std::move(tlas.buffer);
+			slot.tlas = std::move(tlas.structure);
+			slot.tlasAddress = tlas.address;
+			slot.tlasGeneration = 0;
+
+			vk::DeviceSize const scratchSize = std::max(sizes.buildScratchSize, sizes.updateScratchSize);
+			slot.scratch = GpuBuffer(*allocator, *device, scratchSize + scratchAlignment, vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eShaderDeviceAddress,
+									 vk::MemoryPropertyFlagBits::eDeviceLocal);
+			slot.scratchAddress = alignScratch(bufferAddress(slot.scratch));
+		}
+	}
+
+	// Reads back the compacted sizes of the first frame's BLAS builds and creates the BLASes to copy them into.
+	// The originals retire with the frame that records the copies; every TLAS is rebuilt against the copies.
+	void createCompactedBlases()
+	{
+		auto [result, sizes] = compactedSizes.getResults<vk::DeviceSize>(0, static_cast<uint32_t>(blases.size()), blases.size() * sizeof(vk::DeviceSize),
+																		 sizeof(vk::DeviceSize), vk::QueryResultFlagBits::e64);
+		if (result != vk::Result::eSuccess)
+		{
+			return;
+		}
+		retired.push_back({ .blases = std::move(blases), .scratch = std::move(blasScratch) });
+		blases.clear();
+		stats.compactedBlasBytes = 0;
+		for (vk::DeviceSize size : sizes)
+		{
+			blases.push_back(createAccelerationStructure(vk::AccelerationStructureTypeKHR::eBottomLevel, size));
+			stats.compactedBlasBytes += size;
+		}
+		blasState = BlasState::eCompacting;
+		blasGeneration++;
+	}
+};
@@ -0,0 +1,167 @@
+#pragma once
+
+#include "mapped_file.hpp"
+#include "scene_loader.hpp"
+
+#include "stb_image.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// One level of a DecodedTexture: tightly packed RGBA8 rows at offset into DecodedTexture::texels().
+struct TextureMip
+{
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint64_t offset = 0;
+	uint64_t size = 0;
+};
+
+// An image decoded to sRGB RGBA8 with its full mip chain down to 1x1. Mips are box filtered in linear space, so
+// they do not darken the way averaging sRGB values would; alpha is averaged as is. Decoding is independent of
+// Vulkan and meant to run on worker threads.
+class DecodedTexture
+{
+public:
+	static DecodedTexture decode(SceneTexture const& source)
+	{
+		MappedFile const file(source.path);
+		if (source.offset > file.size() || (source.size != 0 && source.size > file.size() - source.offset))
+		{
+			throw std::runtime_error("texture decoder: range outside of " + source.path);
+		}
+		uint64_t const size = source.size != 0 ? source.size : file.size() - source.offset;
+
+		int            width = 0, height = 0, channels = 0;
+		stbi_uc* const pixels = stbi_load_from_memory(reinterpret_cast<stbi_uc const*>(file.data() + source.offset), static_cast<int>(size), &width,
+													  &height, &channels, 4);
+		if (!pixels)
+		{
+			throw std::runtime_error("texture decoder: " + source.path + ": " + stbi_failure_reason());
+		}
+
+		DecodedTexture texture;
+		uint32_t       levelWidth = static_cast<uint32_t>(width);
+		uint32_t       levelHeight = static_cast<uint32_t>(height);
+		uint64_t       offset = 0;
+		for (;;)
+		{
+			uint64_t const levelSize = 4ull * levelWidth * levelHeight;
+			texture.levels.push_back({ .width = levelWidth, .height = levelHeight, .offset = offset, .size = levelSize });
+			offset += levelSize;
+			if (levelWidth == 1 && levelHeight == 1)
+			{
+				break;
+			}
+			levelWidth = std::max(1u, levelWidth / 2);
+			levelHeight = std::max(1u, levelHeight / 2);
+		}
+		texture.data.resize(offset);
+		std::copy_n(pixels, texture.levels[0].size, texture.data.begin());
+		stbi_image_free(pixels);
+
+		for (size_t level = 1; level < texture.levels.size(); level++)
+		{
+			texture.downsample(texture.levels[level - 1], texture.levels[level]);
+		}
+		return texture;
+	}
+
+	[[nodiscard]] std::vector<TextureMip> const& mips() const
+	{
+		return levels;
+	}
+
+	[[nodiscard]] std::vector<uint8_t> const& texels() const
+	{
+		return data;
+	}
+
+	[[nodiscard]] uint32_t getWidth() const
+	{
+		return levels.front().width;
+	}
+
+	[[nodiscard]] uint32_t getHeight() const
+	{
+		return levels.front().height;
+	}
+
+private:
+	static constexpr uint32_t LINEAR_STEPS = 4096; // resolution of the linear -> sRGB table
+
+	std::vector<TextureMip> levels;
+	std::vector<uint8_t>    data;
+
+	// Each destination texel averages the 2x2 source texels it covers; an odd last row or column is folded into
+	// its neighbour by clamping.
+	void downsample(TextureMip const& source, TextureMip const& target)
+	{
+		auto const& toLinear = srgbToLinear();
+		auto const& toSrgb = linearToSrgb();
+
+		uint8_t const* const in = data.data() + source.offset;
+		uint8_t* const       out = data.data() + target.offset;
+		for (uint32_t y = 0; y < target.height; y++)
+		{
+			std::array<uint32_t, 2> const rows = { std::min(2 * y, source.height - 1), std::min(2 * y + 1, source.height - 1) };
+			for (uint32_t x = 0; x < target.width; x++)
+			{
+				std::array<uint32_t, 2> const columns = { std::min(2 * x, source.width - 1), std::min(2 * x + 1, source.width - 1) };
+				std::array<float, 4>          sum = {};
+				for (uint32_t row : rows)
+				{
+					for (uint32_t column : columns)
+					{
+						uint8_t const* const texel = in + 4 * (static_cast<size_t>(row) * source.width + column);
+						for (int channel = 0; channel < 3; channel++)
+						{
+							sum[channel] += toLinear[texel[channel]];
+						}
+						sum[3] += texel[3];
+					}
+				}
+				uint8_t* const texel = out + 4 * (static_cast<size_t>(y) * target.width + x);
+				for (int channel = 0; channel < 3; channel++)
+				{
+					texel[channel] = toSrgb[std::min(LINEAR_STEPS - 1, static_cast<uint32_t>(0.25f * sum[channel] * (LINEAR_STEPS - 1) + 0.5f))];
+				}
+				texel[3] = static_cast<uint8_t>(0.25f * sum[3] + 0.5f);
+			}
+		}
+	}
+
+	static std::array<float, 256> const& srgbToLinear()
+	{
+		static std::array<float, 256> const table = [] {
+			std::array<float, 256> values;
+			for (uint32_t i = 0; i < 256; i++)
+			{
+				float const c = static_cast<float>(i) / 255.0f;
+				values[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+			}
+			return values;
+		}();
+		return table;
+	}
+
+	static std::array<uint8_t, LINEAR_STEPS> const& linearToSrgb()
+	{
+		static std::array<uint8_t, LINEAR_STEPS> const table = [] {
+			std::array<uint8_t, LINEAR_STEPS> values;
+			for (uint32_t i = 0; i < LINEAR_STEPS; i++)
+			{
+				float const c = static_cast<float>(i) / static_cast<float>(LINEAR_STEPS - 1);
+				float const s = c <= 0.0031308f ? 12.92f * c : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+				values[i] = static_cast<uint8_t>(std::clamp(s, 0.0f, 1.0f) * 255.0f + 0.5f);
+			}
+			return values;
+		}();
+		return table;
+	}
+};
@@ -0,0 +1,669 @@
+#pragma once
+
+#ifndef VULKAN_HPP_NO_STRUCT_CONSTRUCTORS
+#	define VULKAN_HPP_NO_STRUCT_CONSTRUCTORS
+#endif
+#include <vulkan/vulkan_raii.hpp>
+
+#include "bindless_heap.hpp"
+#include "gpu_allocator.hpp"
+#include "scene_loader.hpp"
+#include "texture_decoder.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct TextureStreamerSettings
+{
+	// Device memory streamed textures may occupy. With VK_EXT_memory_budget the limit also shrinks to what the
+	// device-local heap has left, so other applications and the rest of the renderer keep their share.
+	vk::DeviceSize budgetBytes = 256ull * 1024 * 1024;
+	// Mip data copied from the host per frame; a single level larger than this still goes in one frame.
+	vk::DeviceSize uploadBytesPerFrame = 16ull * 1024 * 1024;
+	bool           memoryBudgetSupported = false;
+};
+
+struct TextureStreamerStats
+{
+	uint32_t       textures = 0;
+	uint32_t       decoded = 0;
+	uint32_t       failed = 0;
+	uint32_t       residentLevels = 0;
+	uint32_t       totalLevels = 0;            // of the decoded textures
+	vk::DeviceSize residentBytes = 0;          // images in use by the current frame
+	vk::DeviceSize retiringBytes = 0;          // replaced images still read by frames in flight
+	vk::DeviceSize peakBytes = 0;              // resident + retiring
+	vk::DeviceSize budgetBytes = 0;
+	vk::DeviceSize lastFrameUploadBytes = 0;
+	vk::DeviceSize peakFrameUploadBytes = 0;
+	vk::DeviceSize uploadBytesTotal = 0;
+	uint64_t       levelsStreamed = 0;
+	uint64_t       levelsEvicted = 0;
+	uint64_t       frames = 0;
+};
+
+// Streams the scene's textures into device memory on demand. Images are decoded with their full mip chain on
+// worker threads and kept in host memory; on the device every texture holds its mip tail (the levels no larger
+// than MIP_TAIL_SIZE) plus as many finer levels as the screen asks for. Fragment shaders report the finest level
+// each texture would sample into a per-frame feedback buffer, which is read back once the frame has retired.
+// Textures asking for finer levels than they hold grow, within the per-frame upload limit; when the budget runs
+// out, the least recently used textures give up their finest levels. A residency change replaces the image with
+// one holding the new level range, filled by copying the shared levels on the device, so views and descriptors
+// never change under a frame in flight; the old image and its bindless slot are retired with the frame.
+// Shaders reach textures through a table indexed by texture id (shaders/bindless.slang). Render thread only.
+class TextureStreamer
+{
+public:
+	static constexpr uint32_t MIP_TAIL_SIZE = 64;
+	static constexpr uint32_t NO_REQUEST = ~0u; // feedback of a texture no pixel sampled
+
+	~TextureStreamer()
+	{
+		// decode jobs write into the entries
+		if (threadPool)
+		{
+			threadPool->waitIdle();
+		}
+	}
+
+	void init(vk::raii::Device const& device, vk::raii::PhysicalDevice const& physicalDevice, GpuAllocator& allocator, BindlessHeap& heap, ThreadPool& threadPool,
+			  uint32_t framesInFlight, TextureStreamerSettings const& settings)
+	{
+		this->device = &device;
+		this->physicalDevice = &physicalDevice;
+		this->allocator = &allocator;
+		this->heap = &heap;
+		this->threadPool = &threadPool;
+		this->settings = settings;
+		slots.resize(framesInFlight);
+		stats.budgetBytes = settings.budgetBytes;
+
+		// the budget is tracked against the largest device-local heap, where the images land
+		auto const memoryProperties = physicalDevice.getMemoryProperties();
+		for (uint32_t heapIndex = 0; heapIndex < memoryProperties.memoryHeapCount; heapIndex++)
+		{
+			if ((memoryProperties.memoryHeaps[heapIndex].flags & vk::MemoryHeapFlagBits::eDeviceLocal) &&
+				(deviceHeap == ~0u || memoryProperties.memoryHeaps[heapIndex].size > memoryProperties.memoryHeaps[deviceHeap].size))
+			{
+				deviceHeap = heapIndex;
+			}
+		}
+	}
+
+	// Registers the scene's textures, texture i getting id i, and starts decoding them in the background.
+	void load(std::vector<SceneTexture> const& textures)
+	{
+		vk::DeviceSize const tableBytes = std::max<size_t>(textures.size(), 1) * sizeof(GpuTexture);
+		table = GpuBuffer(*allocator, *device, tableBytes, vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+						  vk::MemoryPropertyFlagBits::eDeviceLocal);
+		tableBufferHandle = heap->addBuffer(*table);
+		tableInitialized = false;
+
+		vk::DeviceSize const feedbackBytes = std::max<size_t>(textures.size(), 1) * sizeof(uint32_t);
+		for (Slot& slot : slots)
+		{
+			slot.feedback = GpuBuffer(*allocator, *device, feedbackBytes,
+									  vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eShaderDeviceAddress | vk::BufferUsageFlagBits::eTransferSrc |
+										  vk::BufferUsageFlagBits::eTransferDst,
+									  vk::MemoryPropertyFlagBits::eDeviceLocal);
+			slot.readback = GpuBuffer(*allocator, *device, feedbackBytes, vk::BufferUsageFlagBits::eTransferDst,
+									  vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, vk::MemoryPropertyFlagBits::eHostCached);
+			slot.feedbackAddress = device->getBufferAddress(vk::BufferDeviceAddressInfo{ .buffer = *slot.feedback });
+		}
+
+		entries.reserve(textures.size());
+		for (SceneTexture const& texture : textures)
+		{
+			entries.push_back(std::make_unique<Entry>());
+			Entry* const entry = entries.back().get();
+			entry->source = texture;
+			entry->id = static_cast<uint32_t>(entries.size() - 1);
+			threadPool->submit([entry] {
+				try
+				{
+					entry->texture = DecodedTexture::decode(entry->source);
+					entry->state.store(DecodeState::eDecoded, std::memory_order_release);
+				}
+				catch (std::exception const& e)
+				{
+					entry->error = e.what();
+					entry->state.store(DecodeState::eFailed, std::memory_order_release);
+				}
+			});
+		}
+		stats.textures = static_cast<uint32_t>(entries.size());
+	}
+
+	// Reads the requests of the frame that last used slot. Only valid once that frame has completed.
+	void collect(uint32_t slot)
+	{
+		if (!slots[slot].pending)
+		{
+			return;
+		}
+		auto const* const requests = static_cast<uint32_t const*>(slots[slot].readback.mapped());
+		for (size_t id = 0; id < entries.size(); id++)
+		{
+			// a texture nobody sampled keeps its last request; it only loses its recency
+			if (requests[id] != NO_REQUEST)
+			{
+				entries[id]->requestedMip = requests[id];
+				entries[id]->lastUsedFrame = slots[slot].frame;
+			}
+		}
+		slots[slot].pending = false;
+	}
+
+	// Records this frame's residency changes and clears the slot's feedback, before any pass that samples
+	// textures. slot's previous frame must have completed; completedValue frees the images it retired.
+	void update(vk::raii::CommandBuffer const& commandBuffer, uint32_t slot, uint64_t frameValue, uint64_t completedValue)
+	{
+		frame++;
+		retire(completedValue);
+		refreshBudget();
+
+		Plan plan{ .liveBytes = stats.residentBytes, .allocatedBytes = stats.residentBytes + stats.retiringBytes };
+		planTails(plan);
+		if (plan.liveBytes > stats.budgetBytes)
+		{
+			// over budget, e.g. because the heap budget dropped: shed the least recently used levels
+			planEvictions(plan, plan.liveBytes - stats.budgetBytes, frame);
+		}
+		planGrowth(plan);
+		record(commandBuffer, slot, plan, frameValue);
+
+		commandBuffer.fillBuffer(*slots[slot].feedback, 0, vk::WholeSize, NO_REQUEST);
+		bufferBarrier(commandBuffer, *slots[slot].feedback, vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite,
+					  vk::PipelineStageFlagBits2::eFragmentShader, vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite);
+		slots[slot].frame = frame;
+
+		stats.lastFrameUploadBytes = plan.uploadBytes;
+		stats.peakFrameUploadBytes = std::max(stats.peakFrameUploadBytes, plan.uploadBytes);
+		stats.uploadBytesTotal += plan.uploadBytes;
+		stats.peakBytes = std::max(stats.peakBytes, stats.residentBytes + stats.retiringBytes);
+		stats.frames++;
+	}
+
+	// Copies the slot's feedback to the host, after the last pass that samples textures.
+	void recordReadback(vk::raii::CommandBuffer const& commandBuffer, uint32_t slot)
+	{
+		bufferBarrier(commandBuffer, *slots[slot].feedback, vk::PipelineStageFlagBits2::eFragmentShader, vk::AccessFlagBits2::eShaderStorageWrite,
+					  vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferRead);
+		commandBuffer.copyBuffer(*slots[slot].feedback, *slots[slot].readback, vk::BufferCopy{ .size = slots[slot].feedback.getSize() });
+		bufferBarrier(commandBuffer, *slots[slot].readback, vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite,
+					  vk::PipelineStageFlagBits2::eHost, vk::AccessFlagBits2::eHostRead);
+		slots[slot].pending = true;
+	}
+
+	// Bindless storage buffer handle of the texture table.
+	[[nodiscard]] BindlessHandle tableHandle() const
+	{
+		return tableBufferHandle;
+	}
+
+	// Where this frame's fragment shaders report the finest level they would sample, one uint per texture.
+	[[nodiscard]] vk::DeviceAddress feedbackAddress(uint32_t slot) const
+	{
+		return slots[slot].feedbackAddress;
+	}
+
+	[[nodiscard]] TextureStreamerStats getStats() const
+	{
+		TextureStreamerStats s = stats;
+		for (auto const& entry : entries)
+		{
+			DecodeState const state = entry->state.load(std::memory_order_acquire);
+			s.decoded += state == DecodeState::eDecoded;
+			s.failed += state == DecodeState::eFailed;
+			if (entry->mipCount != 0)
+			{
+				s.residentLevels += entry->mipCount - entry->residentMip;
+				s.totalLevels += entry->mipCount;
+			}
+		}
+		return s;
+	}
+
+	void report(std::ostream& out) const
+	{
+		if (entries.empty())
+		{
+			return;
+		}
+		constexpr double            MIB = 1024.0 * 1024.0;
+		TextureStreamerStats const s = getStats();
+		out << "texture streaming: " << s.textures << " textures (" << s.decoded << " decoded, " << s.failed << " failed), " << s.residentLevels << "/"
+			<< s.totalLevels << " levels resident, " << static_cast<double>(s.residentBytes) / MIB << " MiB resident (peak "
+			<< static_cast<double>(s.peakBytes) / MIB << ") of a " << static_cast<double>(s.budgetBytes) / MIB << " MiB budget\n"
+			<< "texture uploads: " << static_cast<double>(s.uploadBytesTotal) / MIB << " MiB total, avg "
+			<< (s.frames ? static_cast<double>(s.uploadBytesTotal) / MIB / static_cast<double>(s.frames) : 0.0) << " MiB/frame, peak "
+			<< static_cast<double>(s.peakFrameUploadBytes) / MIB << " MiB/frame, " << s.levelsStreamed << " levels streamed, " << s.levelsEvicted
+			<< " evicted" << std::endl;
+	}
+
+private:
+	static constexpr vk::Format FORMAT = vk::Format::eR8G8B8A8Srgb;
+
+	// One entry of the texture table; StreamedTexture in shaders/bindless.slang.
+	struct GpuTexture
+	{
+		BindlessHandle image = INVALID_BINDLESS_HANDLE; // INVALID_BINDLESS_HANDLE until the mip tail is resident
+		uint32_t       width = 0;                       // of level 0, resident or not
+		uint32_t       height = 0;
+		uint32_t       residentMip = 0;                 // finest level the image holds
+	};
+	static_assert(sizeof(GpuTexture) == 16);
+
+	enum class DecodeState : uint8_t
+	{
+		eDecoding,
+		eDecoded,
+		eFailed
+	};
+
+	struct Entry
+	{
+		SceneTexture             source;
+		uint32_t                 id = 0;
+		std::atomic<DecodeState> state = DecodeState::eDecoding;
+		DecodedTexture           texture;              // written by the decode job, read once state is eDecoded
+		std::string              error;
+		bool                     errorReported = false;
+		uint32_t                 mipCount = 0;         // 0 until the mip tail has been scheduled
+		uint32_t                 tailMip = 0;
+		uint32_t                 residentMip = 0;      // the image holds [residentMip, mipCount)
+		GpuImage                 image;
+		vk::raii::ImageView      view = nullptr;
+		BindlessHandle           handle = INVALID_BINDLESS_HANDLE;
+		uint32_t                 requestedMip = NO_REQUEST;
+		uint64_t                 lastUsedFrame = 0;
+		uint64_t                 resizedFrame = 0;     // at most one resize per frame
+	};
+
+	// Replaces entry's image with one holding [firstMip, mipCount).
+	struct Resize
+	{
+		Entry*         entry = nullptr;
+		uint32_t       firstMip = 0;
+		vk::DeviceSize stagingOffset = 0; // of the levels [firstMip, old residentMip) the host uploads
+	};
+
+	// This frame's resizes and the memory they leave allocated.
+	struct Plan
+	{
+		std::vector<Resize> resizes;
+		vk::DeviceSize      liveBytes = 0;      // every texture's current image, after the resizes
+		vk::DeviceSize      allocatedBytes = 0; // live plus retiring images, the peak the device sees
+		vk::DeviceSize      uploadBytes = 0;
+
+		void add(Entry& entry, uint32_t firstMip, uint64_t frame)
+		{
+			vk::DeviceSize const imageBytes = levelBytes(entry, firstMip, entry.mipCount);
+			liveBytes = liveBytes + imageBytes - levelBytes(entry, entry.residentMip, entry.mipCount);
+			allocatedBytes += imageBytes;
+			uploadBytes += levelBytes(entry, firstMip, entry.residentMip);
+			resizes.push_back({ .entry = &entry, .firstMip = firstMip });
+			entry.resizedFrame = frame;
+		}
+	};
+
+	struct Retired
+	{
+		GpuImage            image;
+		vk::raii::ImageView view = nullptr;
+		vk::DeviceSize      bytes = 0;
+		uint64_t            retireValue = 0;
+	};
+
+	struct Slot
+	{
+		GpuBuffer         feedback;
+		GpuBuffer         readback;
+		GpuBuffer         staging;
+		vk::DeviceAddress feedbackAddress = 0;
+		uint64_t          frame = 0;       // streamer frame whose feedback the slot holds
+		bool              pending = false; // feedback was copied out but has not been collected yet
+	};
+
+	vk::raii::Device const*             device = nullptr;
+	vk::raii::PhysicalDevice const*     physicalDevice = nullptr;
+	GpuAllocator*                       allocator = nullptr;
+	BindlessHeap*                       heap = nullptr;
+	ThreadPool*                         threadPool = nullptr;
+	TextureStreamerSettings             settings;
+	uint32_t                            deviceHeap = ~0u;
+	GpuBuffer                           table;
+	BindlessHandle                      tableBufferHandle = INVALID_BINDLESS_HANDLE;
+	bool                                tableInitialized = false; // the first update fills the table with empty entries
+	std::vector<std::unique_ptr<Entry>> entries;                  // by texture id
+	std::vector<Slot>                   slots;
+	std::deque<Retired>                 retired;                  // in retire order
+	uint64_t                            frame = 0;
+	TextureStreamerStats                stats;
+
+	void retire(uint64_t completedValue)
+	{
+		while (!retired.empty() && retired.front().retireValue <= completedValue)
+		{
+			stats.retiringBytes -= retired.front().bytes;
+			retired.pop_front();
+		}
+	}
+
+	void refreshBudget()
+	{
+		stats.budgetBytes = settings.budgetBytes;
+		if (!settings.memoryBudgetSupported || deviceHeap == ~0u)
+		{
+			return;
+		}
+		auto const  properties = physicalDevice->getMemoryProperties2<vk::PhysicalDeviceMemoryProperties2, vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+		auto const& budget = properties.get<vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+		// the heap usage already includes our images; leave a tenth of what is left to everything else
+		vk::DeviceSize const headroom = budget.heapBudget[deviceHeap] > budget.heapUsage[deviceHeap] ? budget.heapBudget[deviceHeap] - budget.heapUsage[deviceHeap] : 0;
+		stats.budgetBytes = std::min(settings.budgetBytes, stats.residentBytes + stats.retiringBytes + headroom - headroom / 10);
+	}
+
+	[[nodiscard]] static vk::DeviceSize levelBytes(Entry const& entry, uint32_t firstMip, uint32_t lastMip)
+	{
+		auto const& mips = entry.texture.mips();
+		return firstMip >= lastMip ? 0 : mips[lastMip - 1].offset + mips[lastMip - 1].size - mips[firstMip].offset;
+	}
+
+	// Newly decoded textures get their mip tail, even over budget: it is the floor every texture keeps.
+	void planTails(Plan& plan)
+	{
+		for (auto& entryPointer : entries)
+		{
+			Entry&            entry = *entryPointer;
+			DecodeState const state = entry.state.load(std::memory_order_acquire);
+			if (state == DecodeState::eFailed && !entry.errorReported)
+			{
+				std::cerr << "texture streaming: " << entry.error << std::endl;
+				entry.errorReported = true;
+			}
+			if (state != DecodeState::eDecoded || entry.mipCount != 0)
+			{
+				continue;
+			}
+
+			auto const&    mips = entry.texture.mips();
+			uint32_t const mipCount = static_cast<uint32_t>(mips.size());
+			uint32_t       tailMip = 0;
+			while (mips[tailMip].width > MIP_TAIL_SIZE || mips[tailMip].height > MIP_TAIL_SIZE)
+			{
+				tailMip++;
+			}
+			vk::DeviceSize const bytes = levelBytes(entry, tailMip, mipCount);
+			if (plan.uploadBytes != 0 && plan.uploadBytes + bytes > settings.uploadBytesPerFrame)
+			{
+				return;
+			}
+			entry.mipCount = mipCount;
+			entry.tailMip = tailMip;
+			entry.residentMip = mipCount;
+			plan.add(entry, tailMip, frame);
+		}
+	}
+
+	// Textures sampled at a finer level than they hold grow towards it, the largest shortfall first, as far as
+	// the upload limit and the budget allow. When the budget is the limit, older textures are shrunk to make
+	// room, which frees their memory once this frame retires; the request is retried then.
+	void planGrowth(Plan& plan)
+	{
+		std::vector<Entry*> requests;
+		for (auto& entry : entries)
+		{
+			if (entry->mipCount != 0 && entry->resizedFrame != frame && entry->requestedMip < entry->residentMip)
+			{
+				requests.push_back(entry.get());
+			}
+		}
+		std::ranges::sort(requests, [](Entry const* a, Entry const* b) {
+			uint32_t const shortfallA = a->residentMip - a->requestedMip;
+			uint32_t const shortfallB = b->residentMip - b->requestedMip;
+			return shortfallA != shortfallB ? shortfallA > shortfallB : a->lastUsedFrame > b->lastUsedFrame;
+		});
+
+		for (Entry* entry : requests)
+		{
+			if (plan.uploadBytes >= settings.uploadBytesPerFrame)
+			{
+				return;
+			}
+			// the finest requested level that fits the rest of this frame's uploads, but always at least one level
+			uint32_t firstMip = entry->residentMip - 1;
+			while (firstMip > entry->requestedMip && plan.uploadBytes + levelBytes(*entry, firstMip - 1, entry->residentMip) <= settings.uploadBytesPerFrame)
+			{
+				firstMip--;
+			}
+			vk::DeviceSize const imageBytes = levelBytes(*entry, firstMip, entry->mipCount);
+			if (plan.allocatedBytes + imageBytes > stats.budgetBytes)
+			{
+				// only evict for memory still held by live images; retiring images free themselves
+				vk::DeviceSize const liveBytes = plan.liveBytes + imageBytes - levelBytes(*entry, entry->residentMip, entry->mipCount);
+				if (liveBytes > stats.budgetBytes)
+				{
+					planEvictions(plan, liveBytes - stats.budgetBytes, entry->lastUsedFrame);
+				}
+				return;
+			}
+			plan.add(*entry, firstMip, frame);
+		}
+	}
+
+	// Frees at least deficit bytes, least recently used textures first, from textures last sampled before
+	// usedBefore or holding finer levels than they asked for. Textures with more than they need drop to their
+	// request; the rest lose their finest level.
+	void planEvictions(Plan& plan, vk::DeviceSize deficit, uint64_t usedBefore)
+	{
+		std::vector<Entry*> victims;
+		for (auto& entry : entries)
+		{
+			if (entry->mipCount != 0 && entry->resizedFrame != frame && entry->residentMip < entry->tailMip &&
+				(entry->lastUsedFrame < usedBefore || entry->requestedMip > entry->residentMip))
+			{
+				victims.push_back(entry.get());
+			}
+		}
+		std::ranges::sort(victims, [](Entry const* a, Entry const* b) { return a->lastUsedFrame < b->lastUsedFrame; });
+
+		vk::DeviceSize const targetLiveBytes = plan.liveBytes - std::min(plan.liveBytes, deficit);
+		for (Entry* entry : victims)
+		{
+			if (plan.liveBytes <= targetLiveBytes)
+			{
+				return;
+			}
+			plan.add(*entry, entry->requestedMip > entry->residentMip ? std::min(entry->requestedMip, entry->tailMip) : entry->residentMip + 1, frame);
+		}
+	}
+
+	void record(vk::raii::CommandBuffer const& commandBuffer, uint32_t slot, Plan& plan, uint64_t frameValue)
+	{
+		std::vector<Resize>& resizes = plan.resizes;
+		if (resizes.empty() && tableInitialized)
+		{
+			return;
+		}
+
+		// gather the host uploads of every growing image into the slot's staging buffer
+		Slot& frameSlot = slots[slot];
+		if (plan.uploadBytes > frameSlot.staging.getSize())
+		{
+			frameSlot.staging = GpuBuffer(*allocator, *device, std::max(plan.uploadBytes, settings.uploadBytesPerFrame), vk::BufferUsageFlagBits::eTransferSrc,
+										  vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+		}
+		vk::DeviceSize stagingOffset = 0;
+		for (Resize& resize : resizes)
+		{
+			Entry const&         entry = *resize.entry;
+			vk::DeviceSize const bytes = levelBytes(entry, resize.firstMip, entry.residentMip);
+			if (bytes != 0)
+			{
+				resize.stagingOffset = stagingOffset;
+				memcpy(static_cast<char*>(frameSlot.staging.mapped()) + stagingOffset, entry.texture.texels().data() + entry.texture.mips()[resize.firstMip].offset, bytes);
+				stagingOffset += bytes;
+			}
+		}
+
+		std::vector<GpuImage>                images;
+		std::vector<vk::ImageMemoryBarrier2> barriers;
+		images.reserve(resizes.size());
+		for (Resize const& resize : resizes)
+		{
+			Entry const&      entry = *resize.entry;
+			TextureMip const& top = entry.texture.mips()[resize.firstMip];
+			vk::ImageCreateInfo imageInfo{ .imageType = vk::ImageType::e2D,
+										   .format = FORMAT,
+										   .extent = {top.width, top.height, 1},
+										   .mipLevels = entry.mipCount - resize.firstMip,
+										   .arrayLayers = 1,
+										   .samples = vk::SampleCountFlagBits::e1,
+										   .tiling = vk::ImageTiling::eOptimal,
+										   .usage = vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst,
+										   .sharingMode = vk::SharingMode::eExclusive,
+										   .initialLayout = vk::ImageLayout::eUndefined };
+			images.emplace_back(*allocator, *device, imageInfo, vk::MemoryPropertyFlagBits::eDeviceLocal);
+			barriers.push_back(imageBarrier(*images.back(), {}, {}, vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite,
+											vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal));
+			if (entry.handle != INVALID_BINDLESS_HANDLE)
+			{
+				// frames in flight sample the old image until the table points elsewhere; this one only copies from it
+				barriers.push_back(imageBarrier(*entry.image, vk::PipelineStageFlagBits2::eFragmentShader, vk::AccessFlagBits2::eShaderSampledRead,
+												vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferRead, vk::ImageLayout::eShaderReadOnlyOptimal,
+												vk::ImageLayout::eTransferSrcOptimal));
+			}
+		}
+		commandBuffer.pipelineBarrier2(vk::DependencyInfo{ .imageMemoryBarrierCount = static_cast<uint32_t>(barriers.size()), .pImageMemoryBarriers = barriers.data() });
+
+		for (size_t i = 0; i < resizes.size(); i++)
+		{
+			Entry const& entry = *resizes[i].entry;
+			uint32_t const firstMip = resizes[i].firstMip;
+			auto const&    mips = entry.texture.mips();
+
+			std::vector<vk::BufferImageCopy> uploads;
+			for (uint32_t level = firstMip; level < entry.residentMip; level++)
+			{
+				uploads.push_back({ .bufferOffset = resizes[i].stagingOffset + mips[level].offset - mips[firstMip].offset,
+									.imageSubresource = {vk::ImageAspectFlagBits::eColor, level - firstMip, 0, 1},
+									.imageExtent = {mips[level].width, mips[level].height, 1} });
+			}
+			if (!uploads.empty())
+			{
+				commandBuffer.copyBufferToImage(*frameSlot.staging, *images[i], vk::ImageLayout::eTransferDstOptimal, uploads);
+			}
+
+			std::vector<vk::ImageCopy> copies;
+			for (uint32_t level = std::max(firstMip, entry.residentMip); level < entry.mipCount && entry.handle != INVALID_BINDLESS_HANDLE; level++)
+			{
+				copies.push_back({ .srcSubresource = {vk::ImageAspectFlagBits::eColor, level - entry.residentMip, 0, 1},
+								   .dstSubresource = {vk::ImageAspectFlagBits::eColor, level - firstMip, 0, 1},
+								   .extent = {mips[level].width, mips[level].height, 1} });
+			}
+			if (!copies.empty())
+			{
+				commandBuffer.copyImage(*entry.image, vk::ImageLayout::eTransferSrcOptimal, *images[i], vk::ImageLayout::eTransferDstOptimal, copies);
+			}
+		}
+
+		barriers.clear();
+		for (GpuImage const& image : images)
+		{
+			barriers.push_back(imageBarrier(*image, vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite, vk::PipelineStageFlagBits2::eFragmentShader,
+											vk::AccessFlagBits2::eShaderSampledRead, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal));
+		}
+		// frames in flight may still read the table, and the first update clears it
+		vk::BufferMemoryBarrier2 tableBarrier{ .srcStageMask = vk::PipelineStageFlagBits2::eFragmentShader | vk::PipelineStageFlagBits2::eTransfer,
+											   .srcAccessMask = vk::AccessFlagBits2::eTransferWrite,
+											   .dstStageMask = vk::PipelineStageFlagBits2::eTransfer,
+											   .dstAccessMask = vk::AccessFlagBits2::eTransferWrite,
+											   .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+											   .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+											   .buffer = *table,
+											   .size = vk::WholeSize };
+		if (!tableInitialized)
+		{
+			commandBuffer.fillBuffer(*table, 0, vk::WholeSize, ~0u);
+			tableInitialized = true;
+		}
+		commandBuffer.pipelineBarrier2(vk::DependencyInfo{ .bufferMemoryBarrierCount = 1,
+														   .pBufferMemoryBarriers = &tableBarrier,
+														   .imageMemoryBarrierCount = static_cast<uint32_t>(barriers.size()),
+														   .pImageMemoryBarriers = barriers.data() });
+
+		for (size_t i = 0; i < resizes.size(); i++)
+		{
+			Entry&         entry = *resizes[i].entry;
+			uint32_t const firstMip = resizes[i].firstMip;
+			if (firstMip < entry.residentMip)
+			{
+				stats.levelsStreamed += entry.residentMip - firstMip;
+			}
+			else
+			{
+				stats.levelsEvicted += firstMip - entry.residentMip;
+			}
+			if (entry.handle != INVALID_BINDLESS_HANDLE)
+			{
+				heap->release(BindlessHeap::Kind::eSampledImage, entry.handle, frameValue);
+				vk::DeviceSize const bytes = entry.image.getSize();
+				stats.residentBytes -= bytes;
+				stats.retiringBytes += bytes;
+				retired.push_back({ .image = std::move(entry.image), .view = std::move(entry.view), .bytes = bytes, .retireValue = frameValue });
+			}
+
+			entry.image = std::move(images[i]);
+			vk::ImageViewCreateInfo viewInfo{ .image = *entry.image,
+											  .viewType = vk::ImageViewType::e2D,
+											  .format = FORMAT,
+											  .subresourceRange = {vk::ImageAspectFlagBits::eColor, 0, entry.mipCount - firstMip, 0, 1} };
+			entry.view = vk::raii::ImageView(*device, viewInfo);
+			entry.handle = heap->addImage(*entry.view);
+			entry.residentMip = firstMip;
+			stats.residentBytes += entry.image.getSize();
+
+			GpuTexture const texture{ .image = entry.handle, .width = entry.texture.getWidth(), .height = entry.texture.getHeight(), .residentMip = firstMip };
+			commandBuffer.updateBuffer<GpuTexture>(*table, entry.id * sizeof(GpuTexture), texture);
+		}
+		bufferBarrier(commandBuffer, *table, vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite, vk::PipelineStageFlagBits2::eFragmentShader,
+					  vk::AccessFlagBits2::eShaderStorageRead);
+	}
+
+	static vk::ImageMemoryBarrier2 imageBarrier(vk::Image image, vk::PipelineStageFlags2 srcStage, vk::AccessFlags2 srcAccess, vk::PipelineStageFlags2 dstStage,
+												vk::AccessFlags2 dstAccess, vk::ImageLayout oldLayout, vk::ImageLayout newLayout)
+	{
+		return { .srcStageMask = srcStage,
+				 .srcAccessMask = srcAccess,
+				 .dstStageMask = dstStage,
+				 .dstAccessMask = dstAccess,
+				 .oldLayout = oldLayout,
+				 .newLayout = newLayout,
+				 .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				 .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				 .image = image,
+				 .subresourceRange = {vk::ImageAspectFlagBits::eColor, 0, vk::RemainingMipLevels, 0, 1} };
+	}
+
+	static void bufferBarrier(vk::raii::CommandBuffer const& commandBuffer, vk::Buffer buffer, vk::PipelineStageFlags2 srcStage, vk::AccessFlags2 srcAccess,
+							  vk::PipelineStageFlags2 dstStage, vk::AccessFlags2 dstAccess)
+	{
+		vk::BufferMemoryBarrier2 barrier{ .srcStageMask = srcStage,
+										  .srcAccessMask = srcAccess,
+										  .dstStageMask = dstStage,
+										  .dstAccessMask = dstAccess,
+										  .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+										  .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+										  .buffer = buffer,
+										  .size = vk::WholeSize };
+		commandBuffer.pipelineBarrier2(vk::DependencyInfo{ .bufferMemoryBarrierCount = 1, .pBufferMemoryBarriers = &barrier });
+	}
+};
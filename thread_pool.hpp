@@ -0,0 +1,154 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <latch>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads draining a FIFO of jobs.
+class ThreadPool
+{
+public:
+	explicit ThreadPool(size_t threadCount = defaultThreadCount())
+	{
+		workers.reserve(threadCount);
+		for (size_t i = 0; i < threadCount; i++)
+		{
+			workers.emplace_back([this] { workerLoop(); });
+		}
+	}
+
+	~ThreadPool()
+	{
+		{
+			std::lock_guard lock(mutex);
+			stopping = true;
+		}
+		jobAvailable.notify_all();
+		// std::jthread joins on destruction, after the queue has drained
+	}
+
+	ThreadPool(ThreadPool const&) = delete;
+	ThreadPool& operator=(ThreadPool const&) = delete;
+
+	void submit(std::function<void()> job)
+	{
+		{
+			std::lock_guard lock(mutex);
+			jobs.push_back(std::move(job));
+			pending++;
+		}
+		jobAvailable.notify_one();
+	}
+
+	// Blocks until every job submitted so far has finished.
+	void waitIdle()
+	{
+		std::unique_lock lock(mutex);
+		allDone.wait(lock, [this] { return pending == 0; });
+	}
+
+	[[nodiscard]] size_t threadCount() const
+	{
+		return workers.size();
+	}
+
+	static size_t defaultThreadCount()
+	{
+		// leave one core for the render thread
+		return std::max<size_t>(2, std::thread::hardware_concurrency()) - 1;
+	}
+
+private:
+	std::mutex                        mutex;
+	std::condition_variable           jobAvailable;
+	std::condition_variable           allDone;
+	std::deque<std::function<void()>> jobs;
+	size_t                            pending = 0;
+	bool                              stopping = false;
+	std::vector<std::jthread>         workers;
+
+	void workerLoop()
+	{
+		for (;;)
+		{
+			std::function<void()> job;
+			{
+				std::unique_lock lock(mutex);
+				jobAvailable.wait(lock, [this] { return stopping || !jobs.empty(); });
+				if (jobs.empty())
+				{
+					return;
+				}
+				job = std::move(jobs.front());
+				jobs.pop_front();
+			}
+
+			job();
+
+			{
+				std::lock_guard lock(mutex);
+				pending--;
+			}
+			allDone.notify_all();
+		}
+	}
+};
+
+// Runs fn(chunk) for every chunk in [0, chunks): chunk 0 on the calling thread, the others as jobs of pool, or
+// all of them in turn on the calling thread without one. Returns once every chunk is done; a chunk that throws
+// still counts as done, and the first exception is rethrown here afterwards, so no job outlives the state the
+// caller lent it.
+template <typename Fn>
+void parallelFor(ThreadPool* pool, uint32_t chunks, Fn&& fn)
+{
+	if (!pool)
+	{
+		for (uint32_t chunk = 0; chunk < chunks; chunk++)
+		{
+			fn(chunk);
+		}
+		return;
+	}
+	std::latch         done(chunks - 1);
+	std::exception_ptr failure;
+	std::mutex         failureMutex;
+	auto const         runChunk = [&](uint32_t chunk) {
+		try
+		{
+			fn(chunk);
+		}
+		catch (...)
+		{
+			std::scoped_lock lock(failureMutex);
+			if (!failure)
+			{
+				failure = std::current_exception();
+			}
+		}
+	};
+	for (uint32_t chunk = 1; chunk < chunks; chunk++)
+	{
+		pool->submit([&, chunk] {
+			struct CountDown
+			{
+				std::latch& latch;
+				~CountDown() { latch.count_down(); }
+			} const countDown{ done };
+			runChunk(chunk);
+		});
+	}
+	runChunk(0);
+	done.wait();
+	if (failure)
+	{
+		std::rethrow_exception(failure);
+	}
+}
@@ -0,0 +1,306 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <vector>
+
+// Two-level segregated fit allocator over an abstract [0, capacity) range; it only hands out offsets, so the
+// same code manages device memory blocks, staging rings or anything else addressed by offset. Allocation and
+// free are O(1): a first-level index picks the power of two, a second-level index splits that range into
+// SL_COUNT linear classes, and two bitmaps find the smallest non-empty class that is guaranteed to fit.
+class TlsfAllocator
+{
+public:
+	static constexpr uint32_t INVALID = std::numeric_limits<uint32_t>::max();
+
+	struct Allocation
+	{
+		uint64_t offset = 0;
+		uint64_t size = 0;
+		uint32_t node = INVALID;
+
+		explicit operator bool() const
+		{
+			return node != INVALID;
+		}
+	};
+
+	struct Stats
+	{
+		uint64_t capacity = 0;
+		uint64_t usedBytes = 0;
+		uint64_t freeBytes = 0;
+		uint64_t largestFreeRegion = 0;
+		uint32_t allocationCount = 0;
+		uint32_t freeRegionCount = 0;
+	};
+
+	explicit TlsfAllocator(uint64_t capacity)
+	{
+		flBitmap = 0;
+		slBitmaps.fill(0);
+		for (auto& heads : freeHeads)
+		{
+			heads.fill(INVALID);
+		}
+		uint32_t const node = createNode(0, capacity);
+		insertFree(node);
+		this->capacity = capacity;
+		freeBytes = capacity;
+	}
+
+	std::optional<Allocation> allocate(uint64_t size, uint64_t alignment = 1)
+	{
+		assert(alignment != 0 && std::has_single_bit(alignment));
+		size = std::max<uint64_t>(size, 1);
+
+		// worst case the block starts one byte past an alignment boundary
+		uint64_t const searchSize = size + alignment - 1;
+		uint32_t       node = findFree(searchSize);
+		if (node == INVALID)
+		{
+			return std::nullopt;
+		}
+		removeFree(node);
+
+		// split off the front padding so the allocation itself starts aligned
+		uint64_t const alignedOffset = alignUp(nodes[node].offset, alignment);
+		if (uint64_t const padding = alignedOffset - nodes[node].offset; padding > 0)
+		{
+			uint32_t const front = node;
+			node = splitTail(front, padding);
+			insertFree(front);
+		}
+
+		// hand the remainder back unless it is too small to be worth tracking
+		if (nodes[node].size - size >= MIN_SPLIT_SIZE)
+		{
+			uint32_t const tail = splitTail(node, size);
+			insertFree(tail);
+		}
+
+		nodes[node].free = false;
+		freeBytes -= nodes[node].size;
+		allocationCount++;
+		return Allocation{ .offset = nodes[node].offset, .size = nodes[node].size, .node = node };
+	}
+
+	void free(Allocation const& allocation)
+	{
+		uint32_t node = allocation.node;
+		assert(node < nodes.size() && !nodes[node].free);
+		freeBytes += nodes[node].size;
+		allocationCount--;
+
+		// coalesce with free physical neighbours
+		if (uint32_t const prev = nodes[node].prevPhys; prev != INVALID && nodes[prev].free)
+		{
+			removeFree(prev);
+			node = merge(prev, node);
+		}
+		if (uint32_t const next = nodes[node].nextPhys; next != INVALID && nodes[next].free)
+		{
+			removeFree(next);
+			node = merge(node, next);
+		}
+		insertFree(node);
+	}
+
+	[[nodiscard]] bool empty() const
+	{
+		return allocationCount == 0;
+	}
+
+	[[nodiscard]] Stats stats() const
+	{
+		Stats s{ .capacity = capacity, .usedBytes = capacity - freeBytes, .freeBytes = freeBytes, .allocationCount = allocationCount };
+		for (auto const& heads : freeHeads)
+		{
+			for (uint32_t head : heads)
+			{
+				for (uint32_t node = head; node != INVALID; node = nodes[node].nextFree)
+				{
+					s.largestFreeRegion = std::max(s.largestFreeRegion, nodes[node].size);
+					s.freeRegionCount++;
+				}
+			}
+		}
+		return s;
+	}
+
+private:
+	static constexpr uint32_t SL_LOG2 = 4;
+	static constexpr uint32_t SL_COUNT = 1u << SL_LOG2;
+	static constexpr uint32_t FL_COUNT = 64 - SL_LOG2 + 1;
+	static constexpr uint64_t SMALL_SIZE = SL_COUNT;
+	static constexpr uint64_t MIN_SPLIT_SIZE = 64;
+
+	struct Node
+	{
+		uint64_t offset = 0;
+		uint64_t size = 0;
+		uint32_t prevPhys = INVALID;
+		uint32_t nextPhys = INVALID;
+		uint32_t prevFree = INVALID;
+		uint32_t nextFree = INVALID;
+		bool     free = false;
+	};
+
+	std::vector<Node>                                    nodes;
+	std::vector<uint32_t>                                unusedNodes;
+	std::array<std::array<uint32_t, SL_COUNT>, FL_COUNT> freeHeads;
+	uint64_t                                             flBitmap = 0;
+	std::array<uint32_t, FL_COUNT>                       slBitmaps;
+	uint64_t                                             capacity = 0;
+	uint64_t                                             freeBytes = 0;
+	uint32_t                                             allocationCount = 0;
+
+	static uint64_t alignUp(uint64_t value, uint64_t alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	static void mapping(uint64_t size, uint32_t& fl, uint32_t& sl)
+	{
+		if (size < SMALL_SIZE)
+		{
+			fl = 0;
+			sl = static_cast<uint32_t>(size);
+			return;
+		}
+		uint32_t const log2 = static_cast<uint32_t>(std::bit_width(size)) - 1;
+		sl = static_cast<uint32_t>(size >> (log2 - SL_LOG2)) ^ SL_COUNT;
+		fl = log2 - SL_LOG2 + 1;
+	}
+
+	uint32_t findFree(uint64_t size) const
+	{
+		// round up to the next class boundary so every block in the chosen list is large enough
+		if (size >= SMALL_SIZE)
+		{
+			uint32_t const log2 = static_cast<uint32_t>(std::bit_width(size)) - 1;
+			uint64_t const roundUp = (uint64_t(1) << (log2 - SL_LOG2)) - 1;
+			if (size > std::numeric_limits<uint64_t>::max() - roundUp)
+			{
+				return INVALID;
+			}
+			size += roundUp;
+		}
+		uint32_t fl, sl;
+		mapping(size, fl, sl);
+		if (fl >= FL_COUNT)
+		{
+			return INVALID;
+		}
+
+		uint32_t slMap = slBitmaps[fl] & (~0u << sl);
+		if (slMap == 0)
+		{
+			uint64_t const flMap = fl + 1 < FL_COUNT ? flBitmap & (~0ull << (fl + 1)) : 0;
+			if (flMap == 0)
+			{
+				return INVALID;
+			}
+			fl = static_cast<uint32_t>(std::countr_zero(flMap));
+			slMap = slBitmaps[fl];
+		}
+		sl = static_cast<uint32_t>(std::countr_zero(slMap));
+		return freeHeads[fl][sl];
+	}
+
+	uint32_t createNode(uint64_t offset, uint64_t size)
+	{
+		uint32_t index;
+		if (!unusedNodes.empty())
+		{
+			index = unusedNodes.back();
+			unusedNodes.pop_back();
+		}
+		else
+		{
+			index = static_cast<uint32_t>(nodes.size());
+			nodes.emplace_back();
+		}
+		nodes[index] = Node{ .offset = offset, .size = size };
+		return index;
+	}
+
+	void insertFree(uint32_t node)
+	{
+		uint32_t fl, sl;
+		mapping(nodes[node].size, fl, sl);
+		nodes[node].free = true;
+		nodes[node].prevFree = INVALID;
+		nodes[node].nextFree = freeHeads[fl][sl];
+		if (freeHeads[fl][sl] != INVALID)
+		{
+			nodes[freeHeads[fl][sl]].prevFree = node;
+		}
+		freeHeads[fl][sl] = node;
+		flBitmap |= 1ull << fl;
+		slBitmaps[fl] |= 1u << sl;
+	}
+
+	void removeFree(uint32_t node)
+	{
+		uint32_t fl, sl;
+		mapping(nodes[node].size, fl, sl);
+		Node& n = nodes[node];
+		if (n.prevFree != INVALID)
+		{
+			nodes[n.prevFree].nextFree = n.nextFree;
+		}
+		else
+		{
+			freeHeads[fl][sl] = n.nextFree;
+		}
+		if (n.nextFree != INVALID)
+		{
+			nodes[n.nextFree].prevFree = n.prevFree;
+		}
+		if (freeHeads[fl][sl] == INVALID)
+		{
+			slBitmaps[fl] &= ~(1u << sl);
+			if (slBitmaps[fl] == 0)
+			{
+				flBitmap &= ~(1ull << fl);
+			}
+		}
+		n.free = false;
+		n.prevFree = INVALID;
+		n.nextFree = INVALID;
+	}
+
+	// Shrinks node to keepSize and returns a new node for the bytes after it.
+	uint32_t splitTail(uint32_t node, uint64_t keepSize)
+	{
+		uint32_t const tail = createNode(nodes[node].offset + keepSize, nodes[node].size - keepSize);
+		nodes[node].size = keepSize;
+		nodes[tail].prevPhys = node;
+		nodes[tail].nextPhys = nodes[node].nextPhys;
+		if (nodes[tail].nextPhys != INVALID)
+		{
+			nodes[nodes[tail].nextPhys].prevPhys = tail;
+		}
+		nodes[node].nextPhys = tail;
+		return tail;
+	}
+
+	// Folds second into first (its physical successor) and returns first.
+	uint32_t merge(uint32_t first, uint32_t second)
+	{
+		nodes[first].size += nodes[second].size;
+		nodes[first].nextPhys = nodes[second].nextPhys;
+		if (nodes[first].nextPhys != INVALID)
+		{
+			nodes[nodes[first].nextPhys].prevPhys = first;
+		}
+		unusedNodes.push_back(second);
+		return first;
+	}
+};
@@ -0,0 +1,88 @@
+// Bakes scenes into the mesh cache ahead of time, so rstd never has to parse them at startup.
+#define TINYOBJLOADER_IMPLEMENTATION
+#include "mesh_cache.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+struct BakeConfig
+{
+	std::string              cacheDir = "mesh_cache";
+	SceneImportSettings      importSettings;
+	bool                     force = false;
+	std::vector<std::string> scenes;
+};
+
+static BakeConfig parseArguments(int argc, char** argv)
+{
+	BakeConfig config;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string const arg = argv[i];
+		if (arg == "--out" && i + 1 < argc)
+		{
+			config.cacheDir = argv[++i];
+		}
+		else if (arg == "--scene-scale" && i + 1 < argc)
+		{
+			config.importSettings.scale = std::stof(argv[++i]);
+		}
+		else if (arg == "--force")
+		{
+			config.force = true;
+		}
+		else if (!arg.starts_with("--"))
+		{
+			config.scenes.push_back(arg);
+		}
+		else
+		{
+			throw std::runtime_error("unknown argument: " + arg);
+		}
+	}
+	if (config.scenes.empty())
+	{
+		throw std::runtime_error("usage: rstd_bake [--out DIR] [--scene-scale S] [--force] SCENE...");
+	}
+	return config;
+}
+
+int main(int argc, char** argv)
+{
+	try
+	{
+		BakeConfig const config = parseArguments(argc, argv);
+		bool             failed = false;
+		for (std::string const& scenePath : config.scenes)
+		{
+			std::filesystem::path const cachePath = MeshCache::pathFor(config.cacheDir, scenePath, config.importSettings);
+			if (!config.force && MeshCache::open(cachePath, config.importSettings))
+			{
+				std::cout << scenePath << ": up to date (" << cachePath.string() << ")" << std::endl;
+				continue;
+			}
+
+			auto const        bakeStart = std::chrono::steady_clock::now();
+			SceneSource const scene = SceneSource::load(scenePath, config.importSettings);
+			SceneLods const   lods = SceneLods::build(scene);
+			if (!MeshCache::write(cachePath, scene, lods, config.importSettings))
+			{
+				failed = true;
+				continue;
+			}
+			std::cout << scenePath << " -> " << cachePath.string() << ": " << scene.draws().size() << " draws, " << scene.vertexCount() << " vertices, "
+					  << scene.indexCount() << " indices, " << lods.indexCount() << " LOD indices, " << scene.materials().size() << " materials, " << scene.textures().size() << " textures in " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - bakeStart).count()
+					  << " ms" << std::endl;
+		}
+		return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+}
@@ -0,0 +1,365 @@
+// Benchmark suite: renders a fixed set of generated scenes headless through rstd, with a fixed camera path and
+// frame count, collects every run's JSON results (--bench-json) into one file and, given the results of an
+// earlier run as a baseline, fails when a metric regressed by more than the allowed threshold. Any Vulkan 1.3
+// device will do, lavapipe included (--device llvmpipe), so CI can gate merges on it. Run it from the directory
+// rstd normally runs from, since rstd finds its shaders relative to the working directory.
+#include "json.hpp" // nlohmann::json, bundled with tinygltf
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <initializer_list>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+struct BenchConfig
+{
+	std::string              renderer = RSTD_RENDERER;
+	std::string              workDir = "bench_scenes"; // generated scenes and per-run results
+	std::string              outPath = "bench_results.json";
+	std::string              baselinePath;
+	std::string              deviceName;
+	uint32_t                 frames = 300;
+	double                   maxTimeRegression = 0.15;   // fraction over the baseline that still passes
+	double                   maxMemoryRegression = 0.05;
+	std::vector<std::string> scenes;                     // empty: all of them
+};
+
+struct BenchScene
+{
+	char const* name;
+	std::string arguments; // for rstd, on top of the ones every run gets
+};
+
+// Timing differences below this are noise, whatever the percentage.
+constexpr double MIN_TIME_DELTA_MS = 0.05;
+
+// The instanced scenes repeat a UV sphere of this many rings and segments: 224 triangles.
+constexpr uint32_t SPHERE_RINGS = 8;
+constexpr uint32_t SPHERE_SEGMENTS = 16;
+
+// The textured scene: a row of quads, each with a material and texture of its own.
+constexpr uint32_t TEXTURE_COUNT = 64;
+constexpr uint32_t TEXTURE_SIZE = 512;
+
+static BenchConfig parseArguments(int argc, char** argv)
+{
+	BenchConfig config;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string const arg = argv[i];
+		if (arg == "--renderer" && i + 1 < argc)
+		{
+			config.renderer = argv[++i];
+		}
+		else if (arg == "--work-dir" && i + 1 < argc)
+		{
+			config.workDir = argv[++i];
+		}
+		else if (arg == "--out" && i + 1 < argc)
+		{
+			config.outPath = argv[++i];
+		}
+		else if (arg == "--baseline" && i + 1 < argc)
+		{
+			config.baselinePath = argv[++i];
+		}
+		else if (arg == "--device" && i + 1 < argc)
+		{
+			config.deviceName = argv[++i];
+		}
+		else if (arg == "--frames" && i + 1 < argc)
+		{
+			config.frames = std::max(1u, static_cast<uint32_t>(std::stoul(argv[++i])));
+		}
+		else if (arg == "--max-regression" && i + 1 < argc)
+		{
+			config.maxTimeRegression = std::stod(argv[++i]) / 100.0;
+		}
+		else if (arg == "--max-memory-regression" && i + 1 < argc)
+		{
+			config.maxMemoryRegression = std::stod(argv[++i]) / 100.0;
+		}
+		else if (arg == "--scene" && i + 1 < argc)
+		{
+			config.scenes.push_back(argv[++i]);
+		}
+		else
+		{
+			throw std::runtime_error("usage: rstd_bench [--frames N] [--scene NAME]... [--device NAME] [--renderer PATH] [--work-dir DIR] [--out PATH]\n"
+									 "                  [--baseline PATH] [--max-regression PCT] [--max-memory-regression PCT]");
+		}
+	}
+	return config;
+}
+
+static std::ofstream openOutput(std::filesystem::path const& path, std::ios::openmode mode = std::ios::out)
+{
+	std::ofstream file(path, mode);
+	if (!file)
+	{
+		throw std::runtime_error("failed to open " + path.string() + "!");
+	}
+	return file;
+}
+
+// A unit UV sphere centered on the origin, y-up and counter-clockwise like every scene rstd loads.
+static void writeSphere(std::filesystem::path const& path)
+{
+	std::ofstream obj = openOutput(path);
+	for (uint32_t ring = 0; ring <= SPHERE_RINGS; ring++)
+	{
+		float const theta = 3.14159265f * static_cast<float>(ring) / static_cast<float>(SPHERE_RINGS);
+		for (uint32_t segment = 0; segment <= SPHERE_SEGMENTS; segment++)
+		{
+			float const phi = 2.0f * 3.14159265f * static_cast<float>(segment) / static_cast<float>(SPHERE_SEGMENTS);
+			float const x = std::sin(theta) * std::cos(phi);
+			float const y = std::cos(theta);
+			float const z = -std::sin(theta) * std::sin(phi);
+			obj << "v " << x << ' ' << y << ' ' << z << "\nvn " << x << ' ' << y << ' ' << z << '\n';
+		}
+	}
+	// 1-based, and the poles' degenerate halves are left out
+	uint32_t const row = SPHERE_SEGMENTS + 1;
+	for (uint32_t ring = 0; ring < SPHERE_RINGS; ring++)
+	{
+		for (uint32_t segment = 0; segment < SPHERE_SEGMENTS; segment++)
+		{
+			uint32_t const a = ring * row + segment + 1;
+			uint32_t const b = a + row;
+			if (ring != 0)
+			{
+				obj << "f " << a << "//" << a << ' ' << b << "//" << b << ' ' << a + 1 << "//" << a + 1 << '\n';
+			}
+			if (ring != SPHERE_RINGS - 1)
+			{
+				obj << "f " << a + 1 << "//" << a + 1 << ' ' << b << "//" << b << ' ' << b + 1 << "//" << b + 1 << '\n';
+			}
+		}
+	}
+}
+
+// An uncompressed, top-left origin 32-bit TGA: a checkerboard in a color that differs per texture, so no two
+// decode to the same image.
+static void writeCheckerTexture(std::filesystem::path const& path, uint32_t seed)
+{
+	std::array<uint8_t, 18> header = {};
+	header[2] = 2; // uncompressed true-color
+	header[12] = TEXTURE_SIZE & 0xff;
+	header[13] = TEXTURE_SIZE >> 8;
+	header[14] = TEXTURE_SIZE & 0xff;
+	header[15] = TEXTURE_SIZE >> 8;
+	header[16] = 32;
+	header[17] = 0x28; // 8 alpha bits, rows top to bottom
+
+	std::array<uint8_t, 4> const color = { static_cast<uint8_t>(seed * 37), static_cast<uint8_t>(seed * 91), static_cast<uint8_t>(seed * 157), 255 };
+	std::vector<uint8_t>         pixels(static_cast<size_t>(TEXTURE_SIZE) * TEXTURE_SIZE * 4);
+	for (uint32_t y = 0; y < TEXTURE_SIZE; y++)
+	{
+		for (uint32_t x = 0; x < TEXTURE_SIZE; x++)
+		{
+			bool const     dark = ((x / 32) + (y / 32)) % 2 != 0;
+			uint8_t* const pixel = &pixels[(static_cast<size_t>(y) * TEXTURE_SIZE + x) * 4];
+			for (int c = 0; c < 4; c++)
+			{
+				pixel[c] = dark && c != 3 ? color[c] / 4 : color[c]; // BGRA
+			}
+		}
+	}
+
+	std::ofstream file = openOutput(path, std::ios::binary);
+	file.write(reinterpret_cast<char const*>(header.data()), header.size());
+	file.write(reinterpret_cast<char const*>(pixels.data()), static_cast<std::streamsize>(pixels.size()));
+}
+
+// TEXTURE_COUNT unit quads side by side in the xz plane, each its own OBJ object with its own material.
+static void writeTexturedScene(std::filesystem::path const& directory)
+{
+	std::ofstream mtl = openOutput(directory / "textured.mtl");
+	std::ofstream obj = openOutput(directory / "textured.obj");
+	obj << "mtllib textured.mtl\nvn 0 1 0\nvt 0 0\nvt 1 0\nvt 1 1\nvt 0 1\n";
+	for (uint32_t texture = 0; texture < TEXTURE_COUNT; texture++)
+	{
+		std::string const name = "checker" + std::to_string(texture);
+		writeCheckerTexture(directory / (name + ".tga"), texture + 1);
+		mtl << "newmtl " << name << "\nKd 1 1 1\nmap_Kd " << name << ".tga\n";
+
+		float const x = 1.25f * static_cast<float>(texture);
+		obj << "o quad" << texture << "\nusemtl " << name << '\n';
+		obj << "v " << x << " 0 0\nv " << x + 1.0f << " 0 0\nv " << x + 1.0f << " 0 -1\nv " << x << " 0 -1\n";
+		uint32_t const v = 4 * texture + 1;
+		obj << "f " << v << "/1/1 " << v + 1 << "/2/1 " << v + 2 << "/3/1\n";
+		obj << "f " << v << "/1/1 " << v + 2 << "/3/1 " << v + 3 << "/4/1\n";
+	}
+}
+
+static std::vector<BenchScene> createScenes(std::filesystem::path const& workDir)
+{
+	std::filesystem::create_directories(workDir);
+	writeSphere(workDir / "sphere.obj");
+	writeTexturedScene(workDir);
+
+	std::string const sphere = "--scene \"" + (workDir / "sphere.obj").string() + "\"";
+	std::string const textured = "--scene \"" + (workDir / "textured.obj").string() + "\"";
+	return {
+		{ .name = "triangle", .arguments = "" },
+		{ .name = "instanced-10k", .arguments = sphere + " --draws 10000 --camera-path orbit-all" },
+		{ .name = "culled-100k", .arguments = sphere + " --draws 100000 --camera-path orbit" }, // only the center copy is in view
+		{ .name = "textured", .arguments = textured + " --camera-path orbit" },
+	};
+}
+
+// Runs rstd on one scene; returns its results, or nothing when it failed.
+static std::optional<nlohmann::json> runScene(BenchConfig const& config, BenchScene const& scene)
+{
+	std::filesystem::path const resultPath = std::filesystem::path(config.workDir) / (std::string(scene.name) + ".json");
+	std::filesystem::remove(resultPath);
+
+	// no caches and no hot reload: every run starts from the same state
+	std::string command = "\"" + config.renderer + "\" --headless --profile --no-pipeline-cache --no-mesh-cache --no-shader-reload --frames " +
+		std::to_string(config.frames) + " --bench-json \"" + resultPath.string() + "\" " + scene.arguments;
+	if (!config.deviceName.empty())
+	{
+		command += " --device \"" + config.deviceName + "\"";
+	}
+#ifdef _WIN32
+	// cmd.exe strips the outer pair of quotes when the command starts with one
+	command = "\"" + command + "\"";
+#endif
+
+	std::cout << "== " << scene.name << ": " << command << std::endl;
+	if (std::system(command.c_str()) != 0 || !std::filesystem::exists(resultPath))
+	{
+		std::cerr << scene.name << ": rstd failed" << std::endl;
+		return std::nullopt;
+	}
+	std::ifstream file(resultPath);
+	return nlohmann::json::parse(file);
+}
+
+static std::optional<double> number(nlohmann::json const& object, std::initializer_list<char const*> keys)
+{
+	nlohmann::json const* value = &object;
+	for (char const* key : keys)
+	{
+		if (!value->is_object() || !value->contains(key))
+		{
+			return std::nullopt;
+		}
+		value = &(*value)[key];
+	}
+	return value->is_number() ? std::optional(value->get<double>()) : std::nullopt;
+}
+
+// Compares one metric; returns false when it regressed by more than tolerance (a fraction of the baseline).
+static bool compare(std::string const& label, std::optional<double> baseline, std::optional<double> current, double tolerance, double minDelta)
+{
+	if (!baseline || !current)
+	{
+		return true;
+	}
+	double const delta = *current - *baseline;
+	bool const   regressed = delta > minDelta && *current > *baseline * (1.0 + tolerance);
+	std::cout << (regressed ? "  REGRESSION " : "  ") << label << ": " << *baseline << " -> " << *current;
+	if (*baseline > 0.0)
+	{
+		std::cout << " (" << (delta >= 0.0 ? "+" : "") << 100.0 * delta / *baseline << "%)";
+	}
+	std::cout << std::endl;
+	return !regressed;
+}
+
+// Compares every scene both result sets have. CPU and GPU times, and the triangles submitted per frame, may grow
+// by maxTimeRegression and memory by maxMemoryRegression; frames that allocate on the render thread after the
+// warm-up may not grow at all.
+static bool compareWithBaseline(BenchConfig const& config, nlohmann::json const& results, nlohmann::json const& baseline)
+{
+	bool passed = true;
+	for (auto const& [name, scene] : results["scenes"].items())
+	{
+		if (!baseline.contains("scenes") || !baseline["scenes"].contains(name))
+		{
+			std::cout << name << ": not in the baseline" << std::endl;
+			continue;
+		}
+		nlohmann::json const& base = baseline["scenes"][name];
+		std::cout << name << ":" << std::endl;
+		passed &= compare("cpu frame median ms", number(base, { "cpuFrameMs", "median" }), number(scene, { "cpuFrameMs", "median" }), config.maxTimeRegression,
+						  MIN_TIME_DELTA_MS);
+		passed &= compare("cpu frame p99 ms", number(base, { "cpuFrameMs", "p99" }), number(scene, { "cpuFrameMs", "p99" }), config.maxTimeRegression, MIN_TIME_DELTA_MS);
+		if (base.contains("gpuPassMs"))
+		{
+			for (auto const& [pass, passStats] : base["gpuPassMs"].items())
+			{
+				passed &= compare("gpu " + pass + " avg ms", number(passStats, { "avg" }), number(scene, { "gpuPassMs", pass.c_str(), "avg" }),
+								  config.maxTimeRegression, MIN_TIME_DELTA_MS);
+			}
+		}
+		passed &= compare("triangles submitted", number(base, { "triangles", "submitted" }), number(scene, { "triangles", "submitted" }),
+						  config.maxTimeRegression, 0.0);
+		passed &= compare("device memory used", number(base, { "memory", "deviceUsedBytes" }), number(scene, { "memory", "deviceUsedBytes" }),
+						  config.maxMemoryRegression, 0.0);
+		passed &= compare("peak RSS", number(base, { "memory", "peakResidentSetBytes" }), number(scene, { "memory", "peakResidentSetBytes" }),
+						  config.maxMemoryRegression, 0.0);
+		passed &= compare("allocating steady frames", number(base, { "heapAllocations", "allocatingSteadyFrames" }),
+						  number(scene, { "heapAllocations", "allocatingSteadyFrames" }), 0.0, 0.0);
+	}
+	return passed;
+}
+
+int main(int argc, char** argv)
+{
+	try
+	{
+		BenchConfig const             config = parseArguments(argc, argv);
+		std::vector<BenchScene> const scenes = createScenes(config.workDir);
+
+		nlohmann::json results = { { "frames", config.frames }, { "scenes", nlohmann::json::object() } };
+		bool           failed = false;
+		for (BenchScene const& scene : scenes)
+		{
+			if (!config.scenes.empty() && std::ranges::find(config.scenes, scene.name) == config.scenes.end())
+			{
+				continue;
+			}
+			if (std::optional<nlohmann::json> const result = runScene(config, scene))
+			{
+				results["scenes"][scene.name] = *result;
+			}
+			else
+			{
+				failed = true;
+			}
+		}
+		std::ofstream out = openOutput(config.outPath);
+		out << results.dump(2) << std::endl;
+		std::cout << "results: " << config.outPath << std::endl;
+
+		if (!config.baselinePath.empty())
+		{
+			std::ifstream baselineFile(config.baselinePath);
+			if (!baselineFile)
+			{
+				throw std::runtime_error("failed to open " + config.baselinePath + "!");
+			}
+			if (!compareWithBaseline(config, results, nlohmann::json::parse(baselineFile)))
+			{
+				std::cerr << "benchmark: regressed against " << config.baselinePath << std::endl;
+				failed = true;
+			}
+		}
+		return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+}
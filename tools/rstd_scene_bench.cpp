@@ -0,0 +1,140 @@
+// Times SceneGraph::update() on a large synthetic hierarchy with a few or all nodes moved.
+#include "scene_graph.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct BenchConfig
+{
+	uint32_t nodes = 1'000'000;
+	uint32_t roots = 1024;
+	uint32_t branching = 4; // children per node below the roots
+	uint32_t iterations = 20;
+	uint32_t threads = std::max(1u, std::thread::hardware_concurrency());
+};
+
+static BenchConfig parseArguments(int argc, char** argv)
+{
+	BenchConfig config;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string const arg = argv[i];
+		if (arg == "--nodes" && i + 1 < argc)
+		{
+			config.nodes = static_cast<uint32_t>(std::stoul(argv[++i]));
+		}
+		else if (arg == "--roots" && i + 1 < argc)
+		{
+			config.roots = std::max(1u, static_cast<uint32_t>(std::stoul(argv[++i])));
+		}
+		else if (arg == "--branching" && i + 1 < argc)
+		{
+			config.branching = std::max(1u, static_cast<uint32_t>(std::stoul(argv[++i])));
+		}
+		else if (arg == "--iterations" && i + 1 < argc)
+		{
+			config.iterations = std::max(1u, static_cast<uint32_t>(std::stoul(argv[++i])));
+		}
+		else if (arg == "--threads" && i + 1 < argc)
+		{
+			config.threads = std::max(1u, static_cast<uint32_t>(std::stoul(argv[++i])));
+		}
+		else
+		{
+			throw std::runtime_error("usage: rstd_scene_bench [--nodes N] [--roots N] [--branching N] [--iterations N] [--threads N]");
+		}
+	}
+	config.roots = std::min(config.roots, config.nodes);
+	return config;
+}
+
+static NodeTransform randomTransform(std::mt19937& random)
+{
+	std::uniform_real_distribution<float> offset(-10.0f, 10.0f);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	std::uniform_real_distribution<float> scale(0.5f, 2.0f);
+
+	std::array<float, 4> rotation = { unit(random), unit(random), unit(random), unit(random) };
+	float const          length = std::sqrt(rotation[0] * rotation[0] + rotation[1] * rotation[1] + rotation[2] * rotation[2] + rotation[3] * rotation[3]);
+	for (float& component : rotation)
+	{
+		component = length > 1e-6f ? component / length : (&component == &rotation[3] ? 1.0f : 0.0f);
+	}
+	return { .translation = { offset(random), offset(random), offset(random) }, .scale = scale(random), .rotation = rotation };
+}
+
+// Moves `moved` random nodes (all of them when moved == nodes) before every update and reports its time.
+static void run(SceneGraph& graph, BenchConfig const& config, uint32_t moved, char const* name, std::mt19937& random)
+{
+	std::uniform_int_distribution<uint32_t> pick(0, config.nodes - 1);
+	std::vector<double>                     times;
+	uint64_t                                dirtyNodes = 0;
+	for (uint32_t iteration = 0; iteration < config.iterations; iteration++)
+	{
+		for (uint32_t i = 0; i < moved; i++)
+		{
+			SceneGraph::Node const node = moved == config.nodes ? i : pick(random);
+			graph.setLocal(node, randomTransform(random));
+		}
+		auto const start = std::chrono::steady_clock::now();
+		graph.update();
+		times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+		dirtyNodes += graph.getStats().lastDirtyNodes;
+	}
+	std::ranges::sort(times);
+	double total = 0.0;
+	for (double time : times)
+	{
+		total += time;
+	}
+	std::cout << "  " << name << ": " << moved << " moved, " << dirtyNodes / config.iterations << " recomputed; update avg " << total / static_cast<double>(times.size())
+			  << " ms, median " << times[times.size() / 2] << " ms, min " << times.front() << " ms" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+	try
+	{
+		BenchConfig const config = parseArguments(argc, argv);
+		std::mt19937      random(1234);
+
+		// roots first, then every node below them hangs off an earlier one, `branching` children each
+		SceneGraph graph;
+		for (uint32_t node = 0; node < config.nodes; node++)
+		{
+			SceneGraph::Node const parent = node < config.roots ? SceneGraph::NO_PARENT : (node - config.roots) / config.branching;
+			graph.add(parent, randomTransform(random), { 0.0f, 0.0f, 0.0f, 1.0f });
+		}
+		auto const layoutStart = std::chrono::steady_clock::now();
+		graph.update();
+		std::cout << "scene bench: " << config.nodes << " nodes in " << graph.getStats().levels << " levels, laid out and updated in "
+				  << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - layoutStart).count() << " ms" << std::endl;
+
+		std::vector<uint32_t> threadCounts = { 1 };
+		if (config.threads > 1)
+		{
+			threadCounts.push_back(config.threads);
+		}
+		for (uint32_t const threads : threadCounts)
+		{
+			graph.init(threads);
+			std::cout << threads << (threads == 1 ? " thread" : " threads") << std::endl;
+			run(graph, config, std::max(1u, config.nodes / 100), "1% dirty", random);
+			run(graph, config, config.nodes, "100% dirty", random);
+		}
+		return EXIT_SUCCESS;
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+}
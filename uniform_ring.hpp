@@ -0,0 +1,137 @@
+#pragma once
+
+#ifndef VULKAN_HPP_NO_STRUCT_CONSTRUCTORS
+#	define VULKAN_HPP_NO_STRUCT_CONSTRUCTORS
+#endif
+#include <vulkan/vulkan_raii.hpp>
+
+#include "gpu_allocator.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+// A sub-allocation of the UniformRing, valid for the frame that made it.
+struct UniformSpan
+{
+	void*             data = nullptr; // persistently mapped
+	vk::DeviceSize    offset = 0;     // into UniformRing::getBuffer(), for dynamic offsets
+	vk::DeviceAddress address = 0;
+	vk::DeviceSize    size = 0;
+};
+
+struct UniformRingStats
+{
+	vk::DeviceSize partitionBytes = 0;
+	vk::DeviceSize lastBytes = 0; // used by the last frame
+	vk::DeviceSize peakBytes = 0;
+	uint64_t       allocations = 0;
+	uint64_t       frames = 0;
+};
+
+// Per-frame data the CPU writes and the GPU reads once: camera, object transforms, culling inputs. One
+// host-coherent buffer, mapped once for its whole life, is split into a partition per frame in flight; a
+// frame bump-allocates from its slot's partition, which is free again once the frame pacer has waited for
+// the slot. Every allocation is aligned to the device's uniform and storage offset alignments, so it can be
+// bound as a uniform or storage buffer with a dynamic offset, but the renderer hands out device addresses
+// through push constants: no descriptor is ever written and nothing is mapped in steady state. The memory
+// prefers device-local (resizable BAR) so shaders do not read it across the bus.
+class UniformRing
+{
+public:
+	static constexpr vk::DeviceSize DEFAULT_PARTITION_SIZE = 64 * 1024;
+
+	// sharedFamilies: the queue families that read the ring when there are several (see GpuBuffer).
+	void init(GpuAllocator& allocator, vk::raii::Device const& device, vk::raii::PhysicalDevice const& physicalDevice, uint32_t framesInFlight,
+			  vk::DeviceSize partitionSize = DEFAULT_PARTITION_SIZE, std::span<uint32_t const> sharedFamilies = {})
+	{
+		vk::PhysicalDeviceLimits const limits = physicalDevice.getProperties().limits;
+		alignment = std::max({ limits.minUniformBufferOffsetAlignment, limits.minStorageBufferOffsetAlignment, vk::DeviceSize(16) });
+		this->partitionSize = (partitionSize + alignment - 1) / alignment * alignment;
+		stats = { .partitionBytes = this->partitionSize };
+
+		buffer = GpuBuffer(allocator, device, this->partitionSize * framesInFlight,
+						   vk::BufferUsageFlagBits::eUniformBuffer | vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eShaderDeviceAddress,
+						   vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, vk::MemoryPropertyFlagBits::eDeviceLocal, sharedFamilies);
+		baseAddress = device.getBufferAddress(vk::BufferDeviceAddressInfo{ .buffer = *buffer });
+		base = static_cast<char*>(buffer.mapped());
+		partitionStart = 0;
+		head = 0;
+	}
+
+	// Starts allocating from slot's partition; the frame that last used the slot must have completed.
+	void beginFrame(uint32_t slot)
+	{
+		if (stats.frames > 0)
+		{
+			stats.lastBytes = head - partitionStart;
+			stats.peakBytes = std::max(stats.peakBytes, stats.lastBytes);
+		}
+		stats.frames++;
+		partitionStart = slot * partitionSize;
+		head = partitionStart;
+	}
+
+	UniformSpan allocate(vk::DeviceSize size)
+	{
+		vk::DeviceSize const offset = head;
+		vk::DeviceSize const end = offset + (size + alignment - 1) / alignment * alignment;
+		if (end > partitionStart + partitionSize)
+		{
+			throw std::runtime_error("uniform ring: a frame needs more than the " + std::to_string(partitionSize / 1024) + " KiB partition!");
+		}
+		head = end;
+		stats.allocations++;
+		return { .data = base + offset, .offset = offset, .address = baseAddress + offset, .size = size };
+	}
+
+	template <typename T>
+	UniformSpan push(T const& value)
+	{
+		return pushArray(std::span<T const>(&value, 1));
+	}
+
+	template <typename T>
+	UniformSpan pushArray(std::span<T const> values)
+	{
+		static_assert(std::is_trivially_copyable_v<T>);
+		UniformSpan const span = allocate(values.size_bytes());
+		memcpy(span.data, values.data(), values.size_bytes());
+		return span;
+	}
+
+	[[nodiscard]] vk::Buffer getBuffer() const
+	{
+		return *buffer;
+	}
+
+	[[nodiscard]] UniformRingStats const& getStats() const
+	{
+		return stats;
+	}
+
+	void report(std::ostream& out) const
+	{
+		if (stats.frames == 0)
+		{
+			return;
+		}
+		out << "uniform ring: " << stats.lastBytes / 1024 << " KiB last frame, " << stats.peakBytes / 1024 << " KiB peak of " << stats.partitionBytes / 1024
+			<< " KiB per frame, " << static_cast<double>(stats.allocations) / static_cast<double>(stats.frames) << " allocations per frame, "
+			<< alignment << " byte alignment" << std::endl;
+	}
+
+private:
+	GpuBuffer         buffer;
+	char*             base = nullptr;
+	vk::DeviceAddress baseAddress = 0;
+	vk::DeviceSize    alignment = 16;
+	vk::DeviceSize    partitionSize = 0;
+	vk::DeviceSize    partitionStart = 0; // of the current frame
+	vk::DeviceSize    head = 0;
+	UniformRingStats  stats;
+};
@@ -0,0 +1,376 @@
+#pragma once
+
+#ifndef VULKAN_HPP_NO_STRUCT_CONSTRUCTORS
+#	define VULKAN_HPP_NO_STRUCT_CONSTRUCTORS
+#endif
+#include <vulkan/vulkan_raii.hpp>
+
+#include "gpu_allocator.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// Streams data to device-local resources through one persistently mapped staging ring. Every copy recorded
+// between two flush() calls lands in a single transfer command buffer ("batch"), submitted on the transfer
+// queue with a timeline semaphore signal. Ring space and command buffers are reclaimed once the semaphore
+// passes the batch's value, so nothing ever waits for the device to go idle. When the transfer queue belongs
+// to another family, resources are released there and acquired by the graphics queue (recordAcquireBarriers()).
+class UploadManager
+{
+public:
+	static constexpr vk::DeviceSize DEFAULT_RING_SIZE = 32ull * 1024 * 1024;
+
+	struct Stats
+	{
+		uint64_t bytesUploaded = 0;  // bytes whose batch has completed
+		uint32_t batchesSubmitted = 0;
+		double   cpuCopyMs = 0.0;    // time spent writing into the ring
+		double   gpuCopyMs = 0.0;    // transfer queue time, 0 when the family has no timestamps
+		uint32_t ringStalls = 0;     // uploads that had to wait for the ring to drain
+
+		[[nodiscard]] double gpuMBps() const
+		{
+			return gpuCopyMs > 0.0 ? static_cast<double>(bytesUploaded) / (1024.0 * 1024.0) / (gpuCopyMs * 1e-3) : 0.0;
+		}
+
+		[[nodiscard]] double cpuMBps() const
+		{
+			return cpuCopyMs > 0.0 ? static_cast<double>(bytesUploaded) / (1024.0 * 1024.0) / (cpuCopyMs * 1e-3) : 0.0;
+		}
+	};
+
+	void init(vk::raii::Device const& device, vk::raii::PhysicalDevice const& physicalDevice, GpuAllocator& allocator, vk::raii::Queue const& transferQueue,
+			  uint32_t transferFamily, uint32_t graphicsFamily, vk::DeviceSize ringSize = DEFAULT_RING_SIZE)
+	{
+		this->device = &device;
+		this->transferQueue = &transferQueue;
+		this->transferFamily = transferFamily;
+		this->graphicsFamily = graphicsFamily;
+
+		ring = GpuBuffer(allocator, device, ringSize, vk::BufferUsageFlagBits::eTransferSrc,
+						 vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+		ringData = static_cast<char*>(ring.mapped());
+		ringCapacity = ringSize;
+
+		vk::StructureChain<vk::SemaphoreCreateInfo, vk::SemaphoreTypeCreateInfo> timelineInfo = {
+			{},
+			{.semaphoreType = vk::SemaphoreType::eTimeline, .initialValue = 0} };
+		timelineSemaphore = vk::raii::Semaphore(device, timelineInfo.get<vk::SemaphoreCreateInfo>());
+
+		vk::CommandPoolCreateInfo poolInfo{ .flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer, .queueFamilyIndex = transferFamily };
+		commandPool = vk::raii::CommandPool(device, poolInfo);
+
+		uint32_t const timestampBits = physicalDevice.getQueueFamilyProperties()[transferFamily].timestampValidBits;
+		if (timestampBits != 0)
+		{
+			timestampMask = timestampBits >= 64 ? ~0ull : ((1ull << timestampBits) - 1);
+			timestampPeriod = physicalDevice.getProperties().limits.timestampPeriod;
+			vk::QueryPoolCreateInfo queryPoolInfo{ .queryType = vk::QueryType::eTimestamp, .queryCount = 2 * MAX_BATCHES };
+			queryPool = vk::raii::QueryPool(device, queryPoolInfo);
+		}
+	}
+
+	// Copies size bytes into dst at dstOffset. dstStage/dstAccess describe the first graphics-queue use of the data.
+	// A concurrent dst (GpuBuffer::isConcurrent(), shared with the transfer family) has no ownership to transfer.
+	void uploadBuffer(vk::Buffer dst, vk::DeviceSize dstOffset, void const* data, vk::DeviceSize size, vk::PipelineStageFlags2 dstStage, vk::AccessFlags2 dstAccess,
+					  bool concurrent = false)
+	{
+		auto const* bytes = static_cast<char const*>(data);
+		copyToBuffer(dst, dstOffset, size, 1, [bytes](void* out, vk::DeviceSize offset, vk::DeviceSize chunkSize) { memcpy(out, bytes + offset, chunkSize); });
+		addOwnershipTransfer(vk::BufferMemoryBarrier2{ .srcStageMask = vk::PipelineStageFlagBits2::eTransfer,
+													   .srcAccessMask = vk::AccessFlagBits2::eTransferWrite,
+													   .dstStageMask = dstStage,
+													   .dstAccessMask = dstAccess,
+													   .buffer = dst,
+													   .offset = 0,
+													   .size = vk::WholeSize },
+							 concurrent);
+	}
+
+	// Like uploadBuffer(), but fill(out, offset, chunkSize) produces bytes [offset, offset + chunkSize) of the data
+	// directly in the staging ring, so data that is converted on the fly never needs a temporary copy. Chunks are
+	// whole multiples of elementSize and 16-byte aligned.
+	template <typename Fill>
+	void uploadBufferWith(vk::Buffer dst, vk::DeviceSize dstOffset, vk::DeviceSize size, vk::DeviceSize elementSize, vk::PipelineStageFlags2 dstStage,
+						  vk::AccessFlags2 dstAccess, Fill&& fill)
+	{
+		copyToBuffer(dst, dstOffset, size, elementSize, fill);
+		addOwnershipTransfer(vk::BufferMemoryBarrier2{ .srcStageMask = vk::PipelineStageFlagBits2::eTransfer,
+													   .srcAccessMask = vk::AccessFlagBits2::eTransferWrite,
+													   .dstStageMask = dstStage,
+													   .dstAccessMask = dstAccess,
+													   .buffer = dst,
+													   .offset = 0,
+													   .size = vk::WholeSize },
+							 false);
+	}
+
+	// Submits the open batch, if any. Returns the timeline value the next graphics submission must wait for,
+	// or 0 when nothing was uploaded since the previous call.
+	uint64_t flush()
+	{
+		if (currentBatch.commandIndex != INVALID_INDEX)
+		{
+			submitCurrentBatch();
+		}
+		return std::exchange(unconsumedValue, 0);
+	}
+
+	// Records the graphics-side half of every ownership transfer (or a plain memory barrier on a shared queue
+	// family) for the batches returned by flush(). Must be recorded before the data is used.
+	void recordAcquireBarriers(vk::raii::CommandBuffer const& commandBuffer)
+	{
+		if (acquireBarriers.empty())
+		{
+			return;
+		}
+		vk::DependencyInfo dependencyInfo{ .bufferMemoryBarrierCount = static_cast<uint32_t>(acquireBarriers.size()),
+										   .pBufferMemoryBarriers = acquireBarriers.data() };
+		commandBuffer.pipelineBarrier2(dependencyInfo);
+		acquireBarriers.clear();
+	}
+
+	// Recycles ring space and command buffers of every batch the transfer queue has finished.
+	void reclaim()
+	{
+		if (batches.empty())
+		{
+			return;
+		}
+		uint64_t const completed = timelineSemaphore.getCounterValue();
+		while (!batches.empty() && batches.front().value <= completed)
+		{
+			Batch const& batch = batches.front();
+			ringTail = batch.ringHead;
+			stats.bytesUploaded += batch.bytes;
+			if (*queryPool)
+			{
+				auto [result, timestamps] = queryPool.getResults<uint64_t>(2 * batch.commandIndex, 2, 2 * sizeof(uint64_t), sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+				if (result == vk::Result::eSuccess)
+				{
+					uint64_t const elapsed = ((timestamps[1] & timestampMask) - (timestamps[0] & timestampMask)) & timestampMask;
+					stats.gpuCopyMs += static_cast<double>(elapsed) * timestampPeriod * 1e-6;
+				}
+			}
+			freeCommandIndices.push_back(batch.commandIndex);
+			batches.pop_front();
+		}
+	}
+
+	[[nodiscard]] vk::Semaphore timeline() const
+	{
+		return *timelineSemaphore;
+	}
+
+	[[nodiscard]] Stats const& getStats() const
+	{
+		return stats;
+	}
+
+	void report(std::ostream& out) const
+	{
+		out << "uploads: " << stats.bytesUploaded / 1024 << " KiB in " << stats.batchesSubmitted << " batches, staging copy " << stats.cpuMBps()
+			<< " MB/s, transfer queue " << stats.gpuMBps() << " MB/s, " << stats.ringStalls << " ring stalls"
+			<< (transferFamily != graphicsFamily ? " (dedicated transfer queue)" : "") << std::endl;
+	}
+
+private:
+	static constexpr uint32_t MAX_BATCHES = 16;
+	static constexpr uint32_t INVALID_INDEX = ~0u;
+
+	struct Batch
+	{
+		uint64_t value = 0;                  // timeline value signaled when the batch completes
+		uint32_t commandIndex = INVALID_INDEX;
+		uint64_t ringHead = 0;               // ring position after the batch's last allocation
+		uint64_t bytes = 0;
+	};
+
+	vk::raii::Device const* device = nullptr;
+	vk::raii::Queue const*  transferQueue = nullptr;
+	uint32_t                transferFamily = 0;
+	uint32_t                graphicsFamily = 0;
+
+	GpuBuffer      ring;
+	char*          ringData = nullptr;
+	vk::DeviceSize ringCapacity = 0;
+	uint64_t       ringHead = 0; // monotonically increasing; the physical offset is ringHead % ringCapacity
+	uint64_t       ringTail = 0;
+
+	vk::raii::Semaphore                  timelineSemaphore = nullptr;
+	uint64_t                             submittedValue = 0;
+	uint64_t                             unconsumedValue = 0;
+	vk::raii::CommandPool                commandPool = nullptr;
+	std::vector<vk::raii::CommandBuffer> commandBuffers;
+	std::vector<uint32_t>                freeCommandIndices;
+	std::deque<Batch>                    batches;
+	Batch                                currentBatch;
+
+	std::vector<vk::BufferMemoryBarrier2> releaseBarriers;
+	std::vector<vk::BufferMemoryBarrier2> acquireBarriers;
+
+	vk::raii::QueryPool queryPool = nullptr;
+	uint64_t            timestampMask = 0;
+	float               timestampPeriod = 1.0f;
+
+	Stats stats;
+
+	// Records the copies of an upload, filled chunk by chunk into the ring.
+	template <typename Fill>
+	void copyToBuffer(vk::Buffer dst, vk::DeviceSize dstOffset, vk::DeviceSize size, vk::DeviceSize elementSize, Fill&& fill)
+	{
+		vk::DeviceSize const maxChunkSize = ringCapacity / 2 / elementSize * elementSize;
+		vk::DeviceSize       offset = 0;
+		while (offset < size)
+		{
+			vk::DeviceSize const chunkSize = std::min(size - offset, maxChunkSize);
+			vk::DeviceSize const ringOffset = allocateRing(chunkSize, 16);
+
+			auto const copyStart = std::chrono::steady_clock::now();
+			fill(ringData + ringOffset, offset, chunkSize);
+			stats.cpuCopyMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - copyStart).count();
+
+			currentCommandBuffer().copyBuffer(*ring, dst, vk::BufferCopy{ .srcOffset = ringOffset, .dstOffset = dstOffset + offset, .size = chunkSize });
+			currentBatch.bytes += chunkSize;
+			offset += chunkSize;
+		}
+	}
+
+	vk::raii::CommandBuffer& currentCommandBuffer()
+	{
+		if (currentBatch.commandIndex == INVALID_INDEX)
+		{
+			beginBatch();
+		}
+		return commandBuffers[currentBatch.commandIndex];
+	}
+
+	void beginBatch()
+	{
+		if (freeCommandIndices.empty())
+		{
+			if (commandBuffers.size() == MAX_BATCHES)
+			{
+				waitForOldestBatch();
+			}
+			else
+			{
+				vk::CommandBufferAllocateInfo allocInfo{ .commandPool = commandPool, .level = vk::CommandBufferLevel::ePrimary, .commandBufferCount = 1 };
+				commandBuffers.push_back(std::move(vk::raii::CommandBuffers(*device, allocInfo).front()));
+				freeCommandIndices.push_back(static_cast<uint32_t>(commandBuffers.size() - 1));
+			}
+		}
+		currentBatch = Batch{ .commandIndex = freeCommandIndices.back() };
+		freeCommandIndices.pop_back();
+
+		auto& commandBuffer = commandBuffers[currentBatch.commandIndex];
+		commandBuffer.reset();
+		commandBuffer.begin({ .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
+		if (*queryPool)
+		{
+			queryPool.reset(2 * currentBatch.commandIndex, 2);
+			commandBuffer.writeTimestamp2(vk::PipelineStageFlagBits2::eTopOfPipe, *queryPool, 2 * currentBatch.commandIndex);
+		}
+	}
+
+	void submitCurrentBatch()
+	{
+		auto& commandBuffer = commandBuffers[currentBatch.commandIndex];
+		if (!releaseBarriers.empty())
+		{
+			vk::DependencyInfo dependencyInfo{ .bufferMemoryBarrierCount = static_cast<uint32_t>(releaseBarriers.size()),
+											   .pBufferMemoryBarriers = releaseBarriers.data() };
+			commandBuffer.pipelineBarrier2(dependencyInfo);
+			releaseBarriers.clear();
+		}
+		if (*queryPool)
+		{
+			commandBuffer.writeTimestamp2(vk::PipelineStageFlagBits2::eAllTransfer, *queryPool, 2 * currentBatch.commandIndex + 1);
+		}
+		commandBuffer.end();
+
+		currentBatch.value = ++submittedValue;
+		currentBatch.ringHead = ringHead;
+
+		vk::CommandBufferSubmitInfo commandBufferInfo{ .commandBuffer = *commandBuffer };
+		vk::SemaphoreSubmitInfo     signalInfo{ .semaphore = *timelineSemaphore, .value = currentBatch.value, .stageMask = vk::PipelineStageFlagBits2::eAllCommands };
+		vk::SubmitInfo2             submitInfo{ .commandBufferInfoCount = 1, .pCommandBufferInfos = &commandBufferInfo, .signalSemaphoreInfoCount = 1, .pSignalSemaphoreInfos = &signalInfo };
+		transferQueue->submit2(submitInfo);
+
+		batches.push_back(currentBatch);
+		unconsumedValue = currentBatch.value;
+		stats.batchesSubmitted++;
+		currentBatch = Batch{};
+	}
+
+	void waitForOldestBatch()
+	{
+		assert(!batches.empty());
+		uint64_t const        value = batches.front().value;
+		vk::Semaphore const   semaphore = *timelineSemaphore;
+		vk::SemaphoreWaitInfo waitInfo{ .semaphoreCount = 1, .pSemaphores = &semaphore, .pValues = &value };
+		while (vk::Result::eTimeout == device->waitSemaphores(waitInfo, UINT64_MAX))
+			;
+		reclaim();
+	}
+
+	// Returns a physical ring offset with room for size bytes, draining completed batches if the ring is full.
+	vk::DeviceSize allocateRing(vk::DeviceSize size, vk::DeviceSize alignment)
+	{
+		assert(size <= ringCapacity);
+		for (;;)
+		{
+			uint64_t       head = (ringHead + alignment - 1) & ~(alignment - 1);
+			uint64_t const physical = head % ringCapacity;
+			if (physical + size > ringCapacity)
+			{
+				// not enough room before the end of the buffer: skip to the start
+				head += ringCapacity - physical;
+			}
+			if (head + size - ringTail <= ringCapacity)
+			{
+				ringHead = head + size;
+				return head % ringCapacity;
+			}
+
+			// the ring is full of data the transfer queue has not consumed yet
+			stats.ringStalls++;
+			if (currentBatch.commandIndex != INVALID_INDEX)
+			{
+				submitCurrentBatch();
+			}
+			waitForOldestBatch();
+		}
+	}
+
+	void addOwnershipTransfer(vk::BufferMemoryBarrier2 barrier, bool concurrent)
+	{
+		if (transferFamily == graphicsFamily || concurrent)
+		{
+			acquireBarriers.push_back(barrier);
+			return;
+		}
+
+		// release on the transfer queue: the destination half is ignored
+		vk::BufferMemoryBarrier2 release = barrier;
+		release.dstStageMask = vk::PipelineStageFlagBits2::eNone;
+		release.dstAccessMask = vk::AccessFlagBits2::eNone;
+		release.srcQueueFamilyIndex = transferFamily;
+		release.dstQueueFamilyIndex = graphicsFamily;
+		releaseBarriers.push_back(release);
+
+		// acquire on the graphics queue: the source half is ignored
+		vk::BufferMemoryBarrier2 acquire = barrier;
+		acquire.srcStageMask = vk::PipelineStageFlagBits2::eNone;
+		acquire.srcAccessMask = vk::AccessFlagBits2::eNone;
+		acquire.srcQueueFamilyIndex = transferFamily;
+		acquire.dstQueueFamilyIndex = graphicsFamily;
+		acquireBarriers.push_back(acquire);
+	}
+};